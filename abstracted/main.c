@@ -22,6 +22,7 @@
 
 #include <ctype.h>
 #include <sys/sysinfo.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <dlfcn.h>
 #include <gdk/gdkx.h>
@@ -29,6 +30,12 @@
 
 #include "uber.h"
 #include "uber-blktrace.h"
+#include "uber-sample-clock.h"
+#include "uber-ingest.h"
+#include "uber-shm-ring.h"
+#include "uber-replay.h"
+
+#define NSEC_PER_SEC G_GINT64_CONSTANT(1000000000)
 
 typedef struct
 {
@@ -48,6 +55,7 @@ typedef struct
 	gdouble total_out;
 	gdouble last_total_in;
 	gdouble last_total_out;
+	gint64  last_stamp;
 } NetInfo;
 
 typedef struct
@@ -56,10 +64,70 @@ typedef struct
 	gulong x_event_count;
 } UIInfo;
 
+typedef struct
+{
+	GtkWidget       **graphs;
+	guint             n_graphs;
+	cairo_surface_t  *surface;
+	FILE             *stream;
+	guint             frame;
+	GMainLoop        *main_loop;
+} HeadlessInfo;
+
 static gboolean     want_blktrace    = FALSE;
+static UberSampleClock *sample_clock = NULL;
 static UIInfo       ui_info          = { 0 };
 static CpuInfo      cpu_info         = { 0 };
 static NetInfo      net_info         = { 0 };
+static HeadlessInfo headless_info    = { 0 };
+static gboolean     headless         = FALSE;
+static gint         headless_width   = 640;
+static gint         headless_height  = 120;
+static gdouble      headless_interval = 1.;
+static gint         headless_frames  = 0;
+static gchar       *headless_output  = NULL;
+static gchar       *headless_stream  = NULL;
+static gchar       *ingest_path      = NULL;
+static gint         ingest_port      = 0;
+static gchar      **ingest_series    = NULL;
+static gchar       *shm_name         = NULL;
+static gchar       *record_path      = NULL;
+static gchar       *replay_path      = NULL;
+static gdouble      replay_speed     = 1.;
+static GOptionEntry entries[]        = {
+	{ "i-can-haz-blktrace", 0, 0, G_OPTION_ARG_NONE, &want_blktrace,
+	  "Graph block device activity using blktrace", NULL },
+	{ "headless", 0, 0, G_OPTION_ARG_NONE, &headless,
+	  "Render without a display", NULL },
+	{ "width", 0, 0, G_OPTION_ARG_INT, &headless_width,
+	  "Width of headless graphs", "PIXELS" },
+	{ "height", 0, 0, G_OPTION_ARG_INT, &headless_height,
+	  "Height of each headless graph", "PIXELS" },
+	{ "interval", 0, 0, G_OPTION_ARG_DOUBLE, &headless_interval,
+	  "Seconds between headless frames", "SECONDS" },
+	{ "frames", 0, 0, G_OPTION_ARG_INT, &headless_frames,
+	  "Number of headless frames to write, or 0 to run forever", "N" },
+	{ "output", 0, 0, G_OPTION_ARG_FILENAME, &headless_output,
+	  "Write headless frames to PREFIX-NNNNNN.png", "PREFIX" },
+	{ "stream", 0, 0, G_OPTION_ARG_FILENAME, &headless_stream,
+	  "Write headless frames as raw ARGB32 to FILE, or - for stdout",
+	  "FILE" },
+	{ "ingest", 0, 0, G_OPTION_ARG_FILENAME, &ingest_path,
+	  "Receive samples on the Unix-domain socket PATH", "PATH" },
+	{ "ingest-port", 0, 0, G_OPTION_ARG_INT, &ingest_port,
+	  "Receive samples on localhost UDP port PORT", "PORT" },
+	{ "ingest-series", 0, 0, G_OPTION_ARG_STRING_ARRAY, &ingest_series,
+	  "Graph the received series NAME; may be repeated", "NAME" },
+	{ "shm", 0, 0, G_OPTION_ARG_STRING, &shm_name,
+	  "Scatter samples from the shared memory ring NAME", "NAME" },
+	{ "record", 0, 0, G_OPTION_ARG_FILENAME, &record_path,
+	  "Record every sample graphed to FILE", "FILE" },
+	{ "replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_path,
+	  "Graph the samples recorded in FILE", "FILE" },
+	{ "replay-speed", 0, 0, G_OPTION_ARG_DOUBLE, &replay_speed,
+	  "Speed of replay, or 0 for as fast as possible", "SPEED" },
+	{ NULL }
+};
 static const gchar *default_colors[] = { "#73d216",
                                          "#f57900",
                                          "#3465a4",
@@ -99,6 +167,19 @@ get_xevent_info (UberLineGraph *graph,     /* IN */
 	return TRUE;
 }
 
+static gboolean
+get_shm_values (UberScatter  *scatter,   /* IN */
+                GArray      **values,    /* OUT */
+                gpointer      user_data) /* IN */
+{
+	/*
+	 * A scatter cannot show more points than this per data point anyway.
+	 */
+	*values = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	uber_shm_ring_read_values(user_data, *values, 4096);
+	return TRUE;
+}
+
 static gboolean
 get_cpu_info (UberLineGraph *graph,     /* IN */
               guint          line,      /* IN */
@@ -304,9 +385,10 @@ next_cpu_freq_info (void)
 }
 
 static void
-next_net_info (void)
+next_net_info (gint64 stamp) /* IN */
 {
 	GError *error = NULL;
+	gdouble elapsed;
 	gulong total_in = 0;
 	gulong total_out = 0;
 	gulong bytes_in;
@@ -348,24 +430,33 @@ next_net_info (void)
 		}
 	}
 
-	if ((net_info.last_total_in != 0.) && (net_info.last_total_out != 0.)) {
-		net_info.total_in = (total_in - net_info.last_total_in);
-		net_info.total_out = (total_out - net_info.last_total_out);
+	/*
+	 * Divide by the time that actually elapsed between the stamps of the
+	 * two samples so that late wakeups do not show up as bursts of traffic.
+	 */
+	elapsed = (stamp - net_info.last_stamp) / (gdouble)NSEC_PER_SEC;
+	if ((net_info.last_total_in != 0.) && (net_info.last_total_out != 0.) &&
+	    (elapsed > 0.)) {
+		net_info.total_in = (total_in - net_info.last_total_in) / elapsed;
+		net_info.total_out = (total_out - net_info.last_total_out) / elapsed;
 	}
 
 	net_info.last_total_in = total_in;
 	net_info.last_total_out = total_out;
+	net_info.last_stamp = stamp;
 	g_free(buf);
 }
 
 static void G_GNUC_NORETURN
 sample_thread (gpointer data)
 {
+	gint64 stamp;
+
 	while (TRUE) {
-		g_usleep(G_USEC_PER_SEC);
+		uber_sample_clock_wait(sample_clock, &stamp);
 		next_cpu_info();
 		next_cpu_freq_info();
-		next_net_info();
+		next_net_info(stamp);
 		if (want_blktrace) {
 			uber_blktrace_next();
 		}
@@ -402,6 +493,111 @@ dummy_scatter_func (UberScatter  *scatter,   /* IN */
 }
 #endif
 
+static gboolean
+headless_write_frame (gpointer data) /* IN */
+{
+	cairo_t *cr;
+	GtkStyle *style;
+	guchar *pixels;
+	gchar *path;
+	gint stride;
+	gint height;
+	gint i;
+
+	/*
+	 * Compose the graphs on top of each other.
+	 */
+	cr = cairo_create(headless_info.surface);
+	style = gtk_widget_get_style(headless_info.graphs[0]);
+	gdk_cairo_set_source_color(cr, &style->bg[GTK_STATE_NORMAL]);
+	cairo_paint(cr);
+	for (i = 0; i < headless_info.n_graphs; i++) {
+		cairo_save(cr);
+		cairo_translate(cr, 0, i * headless_height);
+		uber_graph_paint(UBER_GRAPH(headless_info.graphs[i]), cr);
+		cairo_restore(cr);
+	}
+	cairo_destroy(cr);
+	cairo_surface_flush(headless_info.surface);
+	/*
+	 * Write a PNG snapshot.
+	 */
+	if (headless_output) {
+		path = g_strdup_printf("%s-%06u.png", headless_output,
+		                       headless_info.frame);
+		if (cairo_surface_write_to_png(headless_info.surface, path) !=
+		    CAIRO_STATUS_SUCCESS) {
+			g_printerr("Failed to write %s.\n", path);
+		}
+		g_free(path);
+	}
+	/*
+	 * Append the raw frame to the stream, without row padding.
+	 */
+	if (headless_info.stream) {
+		pixels = cairo_image_surface_get_data(headless_info.surface);
+		stride = cairo_image_surface_get_stride(headless_info.surface);
+		height = cairo_image_surface_get_height(headless_info.surface);
+		for (i = 0; i < height; i++) {
+			if (fwrite(pixels + (i * stride), 4, headless_width,
+			           headless_info.stream) != headless_width) {
+				g_printerr("Failed to write frame to stream.\n");
+				g_main_loop_quit(headless_info.main_loop);
+				return FALSE;
+			}
+		}
+		fflush(headless_info.stream);
+	}
+	headless_info.frame++;
+	if (headless_frames > 0 && headless_info.frame >= headless_frames) {
+		g_main_loop_quit(headless_info.main_loop);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+run_headless (GtkWidget **graphs,   /* IN */
+              guint       n_graphs) /* IN */
+{
+	gint i;
+
+	headless_info.graphs = graphs;
+	headless_info.n_graphs = n_graphs;
+	for (i = 0; i < n_graphs; i++) {
+		uber_graph_set_offscreen(UBER_GRAPH(graphs[i]),
+		                         headless_width, headless_height);
+	}
+	/*
+	 * Open the raw frame stream.
+	 */
+	if (g_strcmp0(headless_stream, "-") == 0) {
+		headless_info.stream = stdout;
+	} else if (headless_stream) {
+		if (!(headless_info.stream = fopen(headless_stream, "wb"))) {
+			g_printerr("Failed to open %s.\n", headless_stream);
+			return;
+		}
+	}
+	/*
+	 * Write frames at the requested cadence.
+	 */
+	headless_info.surface =
+		cairo_image_surface_create(CAIRO_FORMAT_ARGB32, headless_width,
+		                           headless_height * n_graphs);
+	headless_info.main_loop = g_main_loop_new(NULL, FALSE);
+	g_timeout_add(headless_interval * 1000, headless_write_frame, NULL);
+	g_main_loop_run(headless_info.main_loop);
+	/*
+	 * Cleanup.
+	 */
+	g_main_loop_unref(headless_info.main_loop);
+	cairo_surface_destroy(headless_info.surface);
+	if (headless_info.stream && headless_info.stream != stdout) {
+		fclose(headless_info.stream);
+	}
+}
+
 gint
 main (gint   argc,   /* IN */
       gchar *argv[]) /* IN */
@@ -416,23 +612,65 @@ main (gint   argc,   /* IN */
 	GtkWidget *line;
 	GtkWidget *map;
 	GtkWidget *scatter;
+	GtkWidget *ingested = NULL;
+	GtkWidget *samples = NULL;
 	GtkWidget *label;
+	GtkWidget *graphs[5];
+	UberIngest *ingest = NULL;
+	UberShmRing *shm = NULL;
+	UberRecorder *recorder = NULL;
+	UberReplay *replay = NULL;
 	GtkAccelGroup *ag;
+	GOptionContext *context;
+	GError *error = NULL;
+	UberSampleClockStats stats;
 	GdkColor color;
 	gint lineno;
+	gint n_graphs;
 	gint nprocs;
 	gint i;
 	gint mod;
 
 	g_thread_init(NULL);
-	gtk_init(&argc, &argv);
-	nprocs = get_nprocs();
 	/*
-	 * Check for blktrace hack.
+	 * Parse options.  GTK+ is initialized without opening the display so
+	 * that headless rendering works on servers without one.
 	 */
-	if (argc > 1 && (g_strcmp0(argv[1], "--i-can-haz-blktrace") == 0)) {
-		want_blktrace = TRUE;
+	context = g_option_context_new("- realtime system graphs");
+	g_option_context_add_main_entries(context, entries, NULL);
+	g_option_context_add_group(context, gtk_get_option_group(FALSE));
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+	if (headless) {
+		if (!headless_output && !headless_stream) {
+			g_printerr("--headless requires --output or --stream.\n");
+			return EXIT_FAILURE;
+		}
+		if (headless_width <= 0 || headless_height <= 0 ||
+		    headless_interval <= 0.) {
+			g_printerr("Invalid headless size or interval.\n");
+			return EXIT_FAILURE;
+		}
+	} else {
+		gtk_init(&argc, &argv);
+	}
+	if ((ingest_path || ingest_port) && !ingest_series) {
+		g_printerr("--ingest and --ingest-port require --ingest-series.\n");
+		return EXIT_FAILURE;
 	}
+	if (ingest_port < 0 || ingest_port > G_MAXUINT16) {
+		g_printerr("Invalid ingest port.\n");
+		return EXIT_FAILURE;
+	}
+	if (replay_speed < 0.) {
+		g_printerr("Invalid replay speed.\n");
+		return EXIT_FAILURE;
+	}
+	nprocs = get_nprocs();
 	/*
 	 * Warm up differential samplers.
 	 */
@@ -448,7 +686,7 @@ main (gint   argc,   /* IN */
 	/*
 	 * Create window and graphs.
 	 */
-	window = uber_window_new();
+	window = headless ? NULL : uber_window_new();
 	cpu = uber_line_graph_new();
 	net = uber_line_graph_new();
 	line = uber_line_graph_new();
@@ -510,6 +748,47 @@ main (gint   argc,   /* IN */
 	uber_label_set_text(UBER_LABEL(label), "Bytes Out");
 	gdk_color_parse("#4e9a06", &color);
 	uber_line_graph_add_line(UBER_LINE_GRAPH(net), &color, UBER_LABEL(label));
+	/*
+	 * Add a line for each series received from other processes.
+	 */
+	if (ingest_path || ingest_port) {
+		ingested = uber_line_graph_new();
+		ingest = uber_ingest_new();
+		for (i = 0; ingest_series[i]; i++) {
+			mod = i % G_N_ELEMENTS(default_colors);
+			gdk_color_parse(default_colors[mod], &color);
+			label = uber_label_new();
+			uber_label_set_text(UBER_LABEL(label), ingest_series[i]);
+			lineno = uber_line_graph_add_line(UBER_LINE_GRAPH(ingested),
+			                                  &color, UBER_LABEL(label));
+			uber_ingest_route(ingest, ingest_series[i],
+			                  UBER_LINE_GRAPH(ingested), lineno);
+		}
+		if ((ingest_path &&
+		     !uber_ingest_listen_unix(ingest, ingest_path, &error)) ||
+		    (!ingest_path &&
+		     !uber_ingest_listen_udp(ingest, ingest_port, &error))) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+			return EXIT_FAILURE;
+		}
+	}
+	/*
+	 * Scatter samples written to shared memory by another process.
+	 */
+	if (shm_name) {
+		if (!(shm = uber_shm_ring_open(shm_name, &error))) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+			return EXIT_FAILURE;
+		}
+		samples = uber_scatter_new();
+		uber_graph_set_show_ylines(UBER_GRAPH(samples), FALSE);
+		gdk_color_parse(default_colors[2], &color);
+		uber_scatter_set_fg_color(UBER_SCATTER(samples), &color);
+		uber_scatter_set_data_func(UBER_SCATTER(samples), get_shm_values,
+		                           shm, NULL);
+	}
 	/*
 	 * Configure heat map.
 	 */
@@ -524,7 +803,7 @@ main (gint   argc,   /* IN */
 	/*
 	 * Configure scatter.
 	 */
-	if (want_blktrace) {
+	if (want_blktrace && window) {
 		uber_graph_set_show_ylines(UBER_GRAPH(scatter), FALSE);
 		gdk_color_parse(default_colors[3], &color);
 		uber_scatter_set_fg_color(UBER_SCATTER(scatter), &color);
@@ -541,12 +820,84 @@ main (gint   argc,   /* IN */
 		uber_graph_set_show_xlabels(UBER_GRAPH(map), FALSE);
 		gtk_widget_show(map);
 	}
+	/*
+	 * Record or replay the samples of each graph by its title.
+	 */
+	if (record_path) {
+		if (!(recorder = uber_recorder_new(record_path, &error))) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+			return EXIT_FAILURE;
+		}
+		uber_graph_set_recorder(UBER_GRAPH(cpu), recorder, "CPU");
+		uber_graph_set_recorder(UBER_GRAPH(net), recorder, "Network");
+		uber_graph_set_recorder(UBER_GRAPH(line), recorder, "UI Events");
+		if (ingested) {
+			uber_graph_set_recorder(UBER_GRAPH(ingested), recorder,
+			                        "Ingested");
+		}
+		if (samples) {
+			uber_graph_set_recorder(UBER_GRAPH(samples), recorder, shm_name);
+		}
+	}
+	if (replay_path) {
+		if (!(replay = uber_replay_new(replay_path, &error))) {
+			g_printerr("%s\n", error->message);
+			g_error_free(error);
+			return EXIT_FAILURE;
+		}
+		uber_replay_attach(replay, "CPU", UBER_GRAPH(cpu));
+		uber_replay_attach(replay, "Network", UBER_GRAPH(net));
+		uber_replay_attach(replay, "UI Events", UBER_GRAPH(line));
+		if (ingested) {
+			uber_replay_attach(replay, "Ingested", UBER_GRAPH(ingested));
+		}
+		if (samples) {
+			uber_replay_attach(replay, shm_name, UBER_GRAPH(samples));
+		}
+		uber_replay_set_speed(replay, replay_speed);
+		uber_replay_start(replay);
+	}
+	/*
+	 * Start sampling thread.
+	 */
+	sample_clock = uber_sample_clock_new(G_USEC_PER_SEC);
+	g_thread_create((GThreadFunc)sample_thread, NULL, FALSE, NULL);
+	/*
+	 * Render to files instead of a window when headless.
+	 */
+	if (headless) {
+		graphs[0] = cpu;
+		graphs[1] = net;
+		graphs[2] = line;
+		n_graphs = 3;
+		if (ingested) {
+			graphs[n_graphs++] = ingested;
+		}
+		if (samples) {
+			graphs[n_graphs++] = samples;
+		}
+		run_headless(graphs, n_graphs);
+		goto cleanup;
+	}
 	/*
 	 * Add graphs.
 	 */
 	uber_window_add_graph(UBER_WINDOW(window), UBER_GRAPH(cpu), "CPU");
 	uber_window_add_graph(UBER_WINDOW(window), UBER_GRAPH(net), "Network");
 	uber_window_add_graph(UBER_WINDOW(window), UBER_GRAPH(line), "UI Events");
+	if (ingested) {
+		uber_window_add_graph(UBER_WINDOW(window), UBER_GRAPH(ingested),
+		                      "Ingested");
+		uber_graph_set_show_xlabels(UBER_GRAPH(ingested), FALSE);
+		gtk_widget_show(ingested);
+	}
+	if (samples) {
+		uber_window_add_graph(UBER_WINDOW(window), UBER_GRAPH(samples),
+		                      shm_name);
+		uber_graph_set_show_xlabels(UBER_GRAPH(samples), FALSE);
+		gtk_widget_show(samples);
+	}
 	/*
 	 * Disable X tick labels by default (except last).
 	 */
@@ -578,16 +929,49 @@ main (gint   argc,   /* IN */
 	                 "delete-event",
 	                 G_CALLBACK(gtk_main_quit),
 	                 NULL);
+	gtk_main();
+  cleanup:
 	/*
-	 * Start sampling thread.
+	 * Report how well the sampler kept its schedule.
 	 */
-	g_thread_create((GThreadFunc)sample_thread, NULL, FALSE, NULL);
-	gtk_main();
+	if (g_getenv("UBER_SHOW_SAMPLER")) {
+		uber_sample_clock_get_stats(sample_clock, &stats);
+		g_print("Sampler: %" G_GUINT64_FORMAT " ticks, "
+		        "%" G_GUINT64_FORMAT " overruns, "
+		        "jitter mean %.1f usec max %.1f usec\n",
+		        stats.n_ticks, stats.n_overruns,
+		        stats.jitter_mean, stats.jitter_max);
+	}
 	/*
 	 * Cleanup after blktrace.
 	 */
 	if (want_blktrace) {
 		uber_blktrace_shutdown();
 	}
+	if (ingest) {
+		uber_ingest_free(ingest);
+	}
+	if (replay) {
+		uber_replay_free(replay);
+	}
+	if (recorder) {
+		uber_graph_set_recorder(UBER_GRAPH(cpu), NULL, NULL);
+		uber_graph_set_recorder(UBER_GRAPH(net), NULL, NULL);
+		uber_graph_set_recorder(UBER_GRAPH(line), NULL, NULL);
+		if (ingested) {
+			uber_graph_set_recorder(UBER_GRAPH(ingested), NULL, NULL);
+		}
+		if (samples) {
+			uber_graph_set_recorder(UBER_GRAPH(samples), NULL, NULL);
+		}
+		uber_recorder_free(recorder);
+	}
+	if (shm) {
+		if (g_getenv("UBER_SHOW_SAMPLER")) {
+			g_print("Shared memory: %" G_GUINT64_FORMAT " overruns\n",
+			        uber_shm_ring_get_overruns(shm));
+		}
+		uber_shm_ring_free(shm);
+	}
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,476 @@
+/* microbench.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glib.h>
+
+#include "g-ring.h"
+#include "uber-buffer.h"
+#include "uber-scale.h"
+
+/*
+ * Fixed seed so that every run operates on the same data.
+ */
+#define MICROBENCH_SEED (42)
+
+/*
+ * Number of element operations per repetition.  The number of iterations
+ * is derived from this rather than from elapsed time so that every run
+ * performs exactly the same work.
+ */
+#define MICROBENCH_TARGET (1 << 24)
+
+typedef struct
+{
+	gint        size;       /* Number of elements in the structures. */
+	gint        iterations; /* Number of passes over the structures. */
+	gdouble    *values;     /* Random input values. */
+	GRing      *ring;       /* Ring filled with values. */
+	UberBuffer *buffer;     /* Buffer filled with values. */
+	UberRange   range;      /* Value range for scaling. */
+	UberRange   pixels;     /* Pixel range for scaling. */
+} Fixture;
+
+/*
+ * Each case performs its work on the fixture and returns the number of
+ * operations that were performed.
+ */
+typedef guint64 (*MicrobenchFunc) (Fixture *fixture);
+
+typedef struct
+{
+	const gchar    *name;
+	MicrobenchFunc  func;
+} MicrobenchCase;
+
+static gint             sizes[]     = { 60, 1000, 65536, 1048576 };
+static gint             repeat      = 5;
+static gchar           *filter      = NULL;
+static volatile gdouble sink        = 0.;
+static volatile guint64 alloc_bytes = 0;
+static UberScale        scale_func  = uber_scale_linear;
+static GOptionEntry     entries[]   = {
+	{ "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+	  "Number of repetitions per case", "N" },
+	{ "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+	  "Only run cases whose name contains FILTER", "FILTER" },
+	{ NULL }
+};
+
+/*
+ * Allocation accounting.  Every byte requested through g_malloc() and
+ * friends is counted; realloc counts the full new size since that is what
+ * may be copied.
+ */
+
+static gpointer
+counting_malloc (gsize n_bytes) /* IN */
+{
+	alloc_bytes += n_bytes;
+	return malloc(n_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem,     /* IN */
+                  gsize    n_bytes) /* IN */
+{
+	alloc_bytes += n_bytes;
+	return realloc(mem, n_bytes);
+}
+
+static gpointer
+counting_calloc (gsize n_blocks,      /* IN */
+                 gsize n_block_bytes) /* IN */
+{
+	alloc_bytes += n_blocks * n_block_bytes;
+	return calloc(n_blocks, n_block_bytes);
+}
+
+static GMemVTable counting_vtable = {
+	counting_malloc,
+	counting_realloc,
+	free,
+	counting_calloc,
+	counting_malloc,
+	counting_realloc,
+};
+
+/**
+ * microbench_get_time:
+ *
+ * Retrieves the current monotonic time in nanoseconds.
+ *
+ * Returns: The monotonic time.
+ * Side effects: None.
+ */
+static inline gint64
+microbench_get_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000)) + ts.tv_nsec;
+}
+
+static guint64
+bench_ring_append_vals (Fixture *fixture) /* IN */
+{
+	gint i;
+	gint j;
+
+	for (i = 0; i < fixture->iterations; i++) {
+		for (j = 0; j < fixture->size; j++) {
+			g_ring_append_vals(fixture->ring, &fixture->values[j], 1);
+		}
+	}
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static guint64
+bench_ring_get_index (Fixture *fixture) /* IN */
+{
+	gdouble total = 0.;
+	gint i;
+	gint j;
+
+	for (i = 0; i < fixture->iterations; i++) {
+		for (j = 0; j < fixture->size; j++) {
+			total += g_ring_get_index(fixture->ring, gdouble, j);
+		}
+	}
+	sink = total;
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static void
+bench_ring_foreach_func (gpointer data,      /* IN */
+                         gpointer user_data) /* IN/OUT */
+{
+	*(gdouble *)user_data += *(gdouble *)data;
+}
+
+static guint64
+bench_ring_foreach (Fixture *fixture) /* IN */
+{
+	gdouble total = 0.;
+	gint i;
+
+	for (i = 0; i < fixture->iterations; i++) {
+		g_ring_foreach(fixture->ring, bench_ring_foreach_func, &total);
+	}
+	sink = total;
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static guint64
+bench_buffer_append (Fixture *fixture) /* IN */
+{
+	gint i;
+	gint j;
+
+	for (i = 0; i < fixture->iterations; i++) {
+		for (j = 0; j < fixture->size; j++) {
+			uber_buffer_append(fixture->buffer, fixture->values[j]);
+		}
+	}
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static gboolean
+bench_buffer_foreach_func (UberBuffer *buffer,    /* IN */
+                           gdouble     value,     /* IN */
+                           gpointer    user_data) /* IN/OUT */
+{
+	*(gdouble *)user_data += value;
+	return FALSE;
+}
+
+static guint64
+bench_buffer_foreach (Fixture *fixture) /* IN */
+{
+	gdouble total = 0.;
+	gint i;
+
+	for (i = 0; i < fixture->iterations; i++) {
+		uber_buffer_foreach(fixture->buffer, bench_buffer_foreach_func,
+		                    &total);
+	}
+	sink = total;
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static guint64
+bench_buffer_set_size (Fixture *fixture) /* IN */
+{
+	gint half = MAX(1, fixture->size / 2);
+	gint i;
+
+	/*
+	 * Alternate between shrinking and growing as happens when a graph
+	 * is resized.  Each resize is one operation.
+	 */
+	for (i = 0; i < fixture->iterations; i++) {
+		uber_buffer_append(fixture->buffer, fixture->values[i % fixture->size]);
+		uber_buffer_set_size(fixture->buffer, (i % 2) ? fixture->size : half);
+	}
+	uber_buffer_set_size(fixture->buffer, fixture->size);
+	return fixture->iterations + 1;
+}
+
+static guint64
+bench_scale_linear (Fixture *fixture) /* IN */
+{
+	gdouble total = 0.;
+	gdouble value;
+	gint i;
+	gint j;
+
+	for (i = 0; i < fixture->iterations; i++) {
+		for (j = 0; j < fixture->size; j++) {
+			value = fixture->values[j];
+			uber_scale_linear(&fixture->range, &fixture->pixels, &value, NULL);
+			total += value;
+		}
+	}
+	sink = total;
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static guint64
+bench_scale_indirect (Fixture *fixture) /* IN */
+{
+	UberScale scale = scale_func;
+	gdouble total = 0.;
+	gdouble value;
+	gint i;
+	gint j;
+
+	/*
+	 * Graphs call their scale through an UberScale pointer so the call
+	 * cannot be inlined.
+	 */
+	for (i = 0; i < fixture->iterations; i++) {
+		for (j = 0; j < fixture->size; j++) {
+			value = fixture->values[j];
+			scale(&fixture->range, &fixture->pixels, &value, NULL);
+			total += value;
+		}
+	}
+	sink = total;
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static gboolean
+bench_scale_buffer_func (UberBuffer *buffer,    /* IN */
+                         gdouble     value,     /* IN */
+                         gpointer    user_data) /* IN/OUT */
+{
+	Fixture *fixture = user_data;
+
+	uber_scale_linear(&fixture->range, &fixture->pixels, &value, NULL);
+	sink += value;
+	return FALSE;
+}
+
+static guint64
+bench_scale_buffer (Fixture *fixture) /* IN */
+{
+	gint i;
+
+	/*
+	 * The root graph rescales every value of a buffer in a foreach.
+	 */
+	for (i = 0; i < fixture->iterations; i++) {
+		uber_buffer_foreach(fixture->buffer, bench_scale_buffer_func, fixture);
+	}
+	return (guint64)fixture->iterations * fixture->size;
+}
+
+static const MicrobenchCase cases[] = {
+	{ "g_ring_append_vals",         bench_ring_append_vals },
+	{ "g_ring_get_index",           bench_ring_get_index },
+	{ "g_ring_foreach",             bench_ring_foreach },
+	{ "uber_buffer_append",         bench_buffer_append },
+	{ "uber_buffer_foreach",        bench_buffer_foreach },
+	{ "uber_buffer_set_size",       bench_buffer_set_size },
+	{ "uber_scale_linear",          bench_scale_linear },
+	{ "uber_scale_linear/indirect", bench_scale_indirect },
+	{ "uber_scale_linear/buffer",   bench_scale_buffer },
+};
+
+/**
+ * fixture_new:
+ * @grand: A #GRand.
+ * @size: The number of elements.
+ *
+ * Creates a fixture with a ring and a buffer of @size elements filled
+ * with random values from @grand.
+ *
+ * Returns: A new fixture which should be freed with fixture_free().
+ * Side effects: None.
+ */
+static Fixture*
+fixture_new (GRand *grand, /* IN */
+             gint   size)  /* IN */
+{
+	Fixture *fixture;
+	gint i;
+
+	fixture = g_slice_new0(Fixture);
+	fixture->size = size;
+	fixture->iterations = MAX(1, MICROBENCH_TARGET / size);
+	fixture->values = g_new(gdouble, size);
+	fixture->ring = g_ring_sized_new(sizeof(gdouble), size, NULL);
+	fixture->buffer = uber_buffer_new();
+	uber_buffer_set_size(fixture->buffer, size);
+	for (i = 0; i < size; i++) {
+		fixture->values[i] = g_rand_double_range(grand, 0., 100.);
+		g_ring_append_val(fixture->ring, fixture->values[i]);
+		uber_buffer_append(fixture->buffer, fixture->values[i]);
+	}
+	fixture->range.begin = 0.;
+	fixture->range.end = 100.;
+	fixture->range.range = 100.;
+	fixture->pixels.begin = 0.;
+	fixture->pixels.end = 480.;
+	fixture->pixels.range = 480.;
+	return fixture;
+}
+
+/**
+ * fixture_free:
+ * @fixture: A fixture.
+ *
+ * Frees @fixture and its structures.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+fixture_free (Fixture *fixture) /* IN */
+{
+	g_ring_unref(fixture->ring);
+	uber_buffer_unref(fixture->buffer);
+	g_free(fixture->values);
+	g_slice_free(Fixture, fixture);
+}
+
+static gint
+microbench_compare (gconstpointer a, /* IN */
+                    gconstpointer b) /* IN */
+{
+	gdouble av = *(const gdouble *)a;
+	gdouble bv = *(const gdouble *)b;
+
+	return (av > bv) - (av < bv);
+}
+
+/**
+ * microbench_run:
+ * @bench: A #MicrobenchCase.
+ * @size: The number of elements.
+ *
+ * Runs @bench against a fresh fixture of @size elements for each
+ * repetition and prints the median ns/op and the bytes allocated per op.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+microbench_run (const MicrobenchCase *bench, /* IN */
+                gint                  size)  /* IN */
+{
+	Fixture *fixture;
+	GRand *grand;
+	gdouble *ns_per_op;
+	gdouble bytes_per_op = 0.;
+	guint64 ops = 0;
+	guint64 bytes;
+	gint64 begin;
+	gint64 end;
+	gchar *name;
+	gint i;
+
+	ns_per_op = g_new0(gdouble, repeat);
+	for (i = 0; i < repeat; i++) {
+		grand = g_rand_new_with_seed(MICROBENCH_SEED);
+		fixture = fixture_new(grand, size);
+		bytes = alloc_bytes;
+		begin = microbench_get_time();
+		ops = bench->func(fixture);
+		end = microbench_get_time();
+		bytes = alloc_bytes - bytes;
+		ns_per_op[i] = (gdouble)(end - begin) / ops;
+		bytes_per_op = (gdouble)bytes / ops;
+		fixture_free(fixture);
+		g_rand_free(grand);
+	}
+	qsort(ns_per_op, repeat, sizeof(gdouble), microbench_compare);
+	name = g_strdup_printf("%s/%d", bench->name, size);
+	g_print("%-36s %12" G_GUINT64_FORMAT " ops %10.2f ns/op %10.2f B/op\n",
+	        name, ops, ns_per_op[repeat / 2], bytes_per_op);
+	g_free(name);
+	g_free(ns_per_op);
+}
+
+gint
+main (gint   argc,   /* IN */
+      gchar *argv[]) /* IN */
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	gint i;
+	gint j;
+
+	/*
+	 * The allocator must be replaced before anything is allocated, and
+	 * slices must come from it for them to be counted.
+	 */
+	g_mem_set_vtable(&counting_vtable);
+	g_setenv("G_SLICE", "always-malloc", TRUE);
+	context = g_option_context_new("- benchmark GRing, UberBuffer and scales");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+	if (repeat < 1) {
+		g_printerr("Invalid number of repetitions.\n");
+		return EXIT_FAILURE;
+	}
+	g_print("# seed=%d repeat=%d target=%d\n",
+	        MICROBENCH_SEED, repeat, MICROBENCH_TARGET);
+	for (i = 0; i < G_N_ELEMENTS(cases); i++) {
+		if (filter && !strstr(cases[i].name, filter)) {
+			continue;
+		}
+		for (j = 0; j < G_N_ELEMENTS(sizes); j++) {
+			microbench_run(&cases[i], sizes[j]);
+		}
+	}
+	g_free(filter);
+	return EXIT_SUCCESS;
+}
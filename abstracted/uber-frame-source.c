@@ -29,6 +29,7 @@
 #include "config.h"
 #endif
 
+#include "uber-frame-clock.h"
 #include "uber-frame-source.h"
 #include "uber-timeout-interval.h"
 
@@ -142,11 +143,8 @@ uber_frame_source_prepare (GSource *source,
                               gint    *delay)
 {
   UberFrameSource *frame_source = (UberFrameSource *) source;
-  GTimeVal current_time;
 
-  g_source_get_current_time (source, &current_time);
-
-  return _uber_timeout_interval_prepare (&current_time,
+  return _uber_timeout_interval_prepare (uber_frame_clock_get_time (),
                                             &frame_source->timeout,
                                             delay);
 }
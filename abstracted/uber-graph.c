@@ -24,11 +24,17 @@
 #include <math.h>
 #include <string.h>
 
+#include "uber-fps-governor.h"
 #include "uber-graph.h"
 #include "uber-scale.h"
-#include "uber-frame-source.h"
+#include "uber-text-cache.h"
+#include "uber-timing-stats.h"
 
 #define WIDGET_CLASS (GTK_WIDGET_CLASS(uber_graph_parent_class))
+#define NSEC_PER_SEC (1000000000.)
+#define DEFAULT_RENDER_BUDGET (0.05)
+#define REDRAW_BUDGET (NSEC_PER_SEC / 250.) /* Time per slice of a full redraw. */
+#define REDRAW_CHUNK  (16)                  /* Slots rendered between clock checks. */
 #define RECT_RIGHT(r)  ((r).x + (r).width)
 #define RECT_BOTTOM(r) ((r).y + (r).height)
 #define UNSET_PIXMAP(p)        \
@@ -38,6 +44,13 @@
             p = NULL;          \
         }                      \
     } G_STMT_END
+#define UNSET_SURFACE(s)              \
+    G_STMT_START {                    \
+        if (s) {                      \
+            cairo_surface_destroy(s); \
+            s = NULL;                 \
+        }                             \
+    } G_STMT_END
 #define CLEAR_CAIRO(c, a)                             \
     G_STMT_START {                                    \
         cairo_save(c);                                \
@@ -62,9 +75,34 @@
  * a rendering of just a new data sample.  Ideally, UberGraph::render_fast is
  * going to be called.
  *
+ * Subclasses may also implement UberGraph::render_range to render a span of
+ * data points.  Full renders are then split into slices, most recent data
+ * first, which are spread across main loop iterations.
+ *
  * #UberGraph uses a #GdkPixmap as a ring buffer to store the contents of the
  * graph.  Upon destructive changes to the widget such as allocation changed
  * or a new #GtkStyle set, a full rendering of the graph will be required.
+ *
+ * Both the data and frame callbacks are driven by an #UberFrameClock.  Graphs
+ * sharing a clock are ticked in the same main loop iteration and exposed in
+ * a single pass.  Unless uber_graph_set_frame_clock() is called, the default
+ * clock is used.
+ *
+ * While a graph is unmapped, fully obscured, or its toplevel is iconified,
+ * rendering is suspended.  Data points are still retrieved, and a single
+ * full render is performed once the graph becomes visible again.
+ *
+ * The time spent rendering is measured, and the frame rate is lowered when
+ * a graph would use more than its share of the CPU.  See
+ * uber_graph_set_render_budget().  Rendering times and dropped frames are
+ * also kept per graph; see uber_graph_get_stats().  Setting UBER_SHOW_HUD in
+ * the environment, or calling uber_graph_set_show_hud(), overlays them on
+ * the graph.
+ *
+ * A graph may also be rendered without a display by calling
+ * uber_graph_set_offscreen() before it is realized.  The background and
+ * foreground are then kept in client side image surfaces, and frames are
+ * produced on demand with uber_graph_paint().
  */
 
 G_DEFINE_ABSTRACT_TYPE(UberGraph, uber_graph, GTK_TYPE_DRAWING_AREA)
@@ -73,6 +111,9 @@ struct _UberGraphPrivate
 {
 	GdkPixmap       *fg_pixmap;     /* Server side pixmap for foreground. */
 	GdkPixmap       *bg_pixmap;     /* Server side pixmap for background. */
+	gboolean         offscreen;     /* Render without a GdkWindow. */
+	cairo_surface_t *fg_surface;    /* Image surface for offscreen foreground. */
+	cairo_surface_t *bg_surface;    /* Image surface for offscreen background. */
 	GdkRectangle     content_rect;  /* Content area rectangle. */
 	GdkRectangle     nonvis_rect;   /* Non-visible drawing area larger than
 	                                 * content rect. Used to draw over larger
@@ -86,12 +127,23 @@ struct _UberGraphPrivate
 	gint             fps;           /* Desired frames per second. */
 	gint             fps_real;      /* Milleseconds between FPS callbacks. */
 	gfloat           fps_each;      /* How far to move in each FPS tick. */
-	guint            fps_handler;   /* Timeout for moving the content. */
+	gboolean         fps_active;    /* Is content being moved each frame. */
+	gint64           fps_deadline;  /* Monotonic deadline of next frame. */
 	gfloat           dps;           /* Desired data points per second. */
 	gint             dps_slot;      /* Which slot in the pixmap buffer. */
+	gint64           dps_shifts;    /* Data points rendered by fast draws. */
+	gint64           scroll_x;      /* Scroll position of the last frame. */
+	GdkRegion       *grid_region;   /* Grid lines drawn within the content. */
+	GdkRectangle     hud_rect;      /* Area last covered by the HUD. */
 	gfloat           dps_each;      /* How many pixels between data points. */
-	GTimeVal         dps_tv;        /* Timeval of last data point. */
-	guint            dps_handler;   /* Timeout for getting new data. */
+	gint64           dps_time;      /* Monotonic time of last data point. */
+	gboolean         dps_active;    /* Is new data being retrieved. */
+	gboolean         external_dps;  /* Are data points added by the caller. */
+	gint64           dps_deadline;  /* Monotonic deadline of next data point. */
+	UberFrameClock  *clock;         /* Clock driving data and frames. */
+	guint            clock_id;      /* Client id within clock. */
+	gint             stride;        /* Stride last given to the subclass. */
+	gboolean         collect_detached; /* Retrieve data while unrealized. */
 	guint            dps_downscale; /* Count since last downscale. */
 	gboolean         fg_dirty;      /* Does the foreground need to be redrawn. */
 	gboolean         bg_dirty;      /* Does the background need to be redrawn. */
@@ -106,9 +158,34 @@ struct _UberGraphPrivate
 	GtkWidget       *labels;        /* Container for graph labels. */
 	GtkWidget       *align;         /* Alignment for labels. */
 	gint             fps_count;     /* Track actual FPS. */
+	UberFpsGovernor *governor;      /* Adapts FPS to the render cost. */
+	gboolean         mapped;        /* Is the widget mapped. */
+	gboolean         obscured;      /* Is the widget fully obscured. */
+	gboolean         iconified;     /* Is the toplevel iconified or withdrawn. */
+	gboolean         suspended;     /* Is rendering suspended. */
+	GtkWidget       *toplevel;      /* Toplevel watched for state changes. */
+	gulong           state_handler; /* Handler for "window-state-event". */
+	UberGraphTimingFunc timing_func; /* Callback for rendering times. */
+	gpointer         timing_data;   /* User data for timing_func. */
+	UberTimingStats  stats[UBER_GRAPH_STAT_LAST]; /* Rendering times. */
+	guint64          dropped;       /* Frames skipped due to late ticks. */
+	gboolean         show_hud;      /* Overlay rendering times. */
+	UberTextCache   *label_cache;   /* Rendered axis labels. */
+	guint            refine_handler; /* Idle redraw after a rescale. */
+	gint             redraw_k;      /* Next slot of a progressive redraw, counted
+	                                 * back from the most recent data point.
+	                                 */
+	guint            redraw_handler; /* Idle handler continuing the redraw. */
+	UberRecorder    *recorder;      /* Log of retrieved samples, or NULL. */
+	guint            record_series; /* Series of the graph within recorder. */
 };
 
 static gboolean show_fps = FALSE;
+static gboolean show_hud = FALSE;
+static const gchar *stat_names[] = { "expose", "bg", "fast", "full" };
+
+static void uber_graph_register_fps_handler (UberGraph *graph);
+static gfloat uber_graph_get_fps_offset (UberGraph *graph);
 
 /**
  * uber_graph_new:
@@ -127,11 +204,166 @@ uber_graph_new (void)
 	return GTK_WIDGET(graph);
 }
 
+/**
+ * uber_graph_timing_begin:
+ * @graph: A #UberGraph.
+ *
+ * Starts timing a section of rendering.
+ *
+ * Returns: The current monotonic time.
+ * Side effects: None.
+ */
+static inline gint64
+uber_graph_timing_begin (UberGraph *graph) /* IN */
+{
+	return uber_frame_clock_get_time();
+}
+
+/**
+ * uber_graph_timing_end:
+ * @graph: A #UberGraph.
+ * @timing: The #UberGraphTiming that was measured.
+ * @stat: The #UberGraphStat to record the time in.
+ * @begin: The result of uber_graph_timing_begin().
+ *
+ * Records the time spent since @begin and reports it to the timing
+ * callback if one is set.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static inline void
+uber_graph_timing_end (UberGraph       *graph,  /* IN */
+                       UberGraphTiming  timing, /* IN */
+                       UberGraphStat    stat,   /* IN */
+                       gint64           begin)  /* IN */
+{
+	UberGraphPrivate *priv;
+	gint64 elapsed;
+
+	priv = graph->priv;
+	elapsed = uber_frame_clock_get_time() - begin;
+	uber_timing_stats_add(&priv->stats[stat], elapsed);
+	if (G_UNLIKELY(priv->timing_func)) {
+		priv->timing_func(graph, timing, elapsed, priv->timing_data);
+	}
+}
+
+/**
+ * uber_graph_create_layer_cairo:
+ * @pixmap: A #GdkPixmap or %NULL.
+ * @surface: A #cairo_surface_t used if @pixmap is %NULL.
+ *
+ * Creates a cairo context for a foreground or background layer, which is
+ * either a server side pixmap or an offscreen image surface.
+ *
+ * Returns: A new cairo_t which should be freed with cairo_destroy().
+ * Side effects: None.
+ */
+static inline cairo_t*
+uber_graph_create_layer_cairo (GdkPixmap       *pixmap,  /* IN */
+                               cairo_surface_t *surface) /* IN */
+{
+	if (pixmap) {
+		return gdk_cairo_create(pixmap);
+	}
+	return cairo_create(surface);
+}
+
+/**
+ * uber_graph_set_layer_source:
+ * @cr: A cairo_t.
+ * @pixmap: A #GdkPixmap or %NULL.
+ * @surface: A #cairo_surface_t used if @pixmap is %NULL.
+ * @x: The x offset of the layer.
+ * @y: The y offset of the layer.
+ *
+ * Sets a foreground or background layer as the source of @cr.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static inline void
+uber_graph_set_layer_source (cairo_t         *cr,      /* IN */
+                             GdkPixmap       *pixmap,  /* IN */
+                             cairo_surface_t *surface, /* IN */
+                             gdouble          x,       /* IN */
+                             gdouble          y)       /* IN */
+{
+	if (pixmap) {
+		gdk_cairo_set_source_pixmap(cr, pixmap, x, y);
+	} else {
+		cairo_set_source_surface(cr, surface, x, y);
+	}
+}
+
+/**
+ * uber_graph_get_scroll_x:
+ * @graph: A #UberGraph.
+ * @pending: Count a fast draw that has not been rendered yet.
+ *
+ * Retrieves how far the foreground has scrolled, in whole pixels, since the
+ * graph was created.  Frames whose scroll positions differ by less than the
+ * width of the content area share all but the newly exposed pixels.
+ *
+ * Returns: The scroll position in pixels.
+ * Side effects: None.
+ */
+static gint64
+uber_graph_get_scroll_x (UberGraph *graph,   /* IN */
+                         gboolean   pending) /* IN */
+{
+	UberGraphPrivate *priv;
+	gint64 shifts;
+
+	priv = graph->priv;
+	shifts = priv->dps_shifts;
+	if (pending) {
+		shifts++;
+	}
+	return (shifts * (gint)priv->dps_each)
+	     + (gint)uber_graph_get_fps_offset(graph);
+}
+
+/**
+ * uber_graph_add_grid_line:
+ * @graph: A #UberGraph.
+ * @x: The left of the line.
+ * @y: The top of the line.
+ * @width: The width of the line.
+ * @height: The height of the line.
+ *
+ * Notes that a grid line was drawn within the content area.  Grid lines do
+ * not move with the foreground, so they must be repainted when the window
+ * contents are scrolled.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static inline void
+uber_graph_add_grid_line (UberGraph *graph,  /* IN */
+                          gint       x,      /* IN */
+                          gint       y,      /* IN */
+                          gint       width,  /* IN */
+                          gint       height) /* IN */
+{
+	GdkRectangle rect;
+
+	rect.x = x;
+	rect.y = y;
+	rect.width = width;
+	rect.height = height;
+	gdk_region_union_with_rect(graph->priv->grid_region, &rect);
+}
+
 /**
  * uber_graph_fps_timeout:
  * @graph: A #UberGraph.
  *
- * XXX
+ * Invalidates the window for the next frame.  If the previous frame is
+ * still valid, the content already on screen is scrolled by the server
+ * and only the newly exposed sliver, the grid lines and the HUD are
+ * repainted.  Otherwise the whole content area is repainted.
  *
  * Returns: %TRUE always.
  * Side effects: None.
@@ -140,15 +372,68 @@ static gboolean
 uber_graph_fps_timeout (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
+	GdkRectangle area;
+	GdkRegion *region;
+	GdkRegion *damage;
+	GdkWindow *window;
+	gboolean fast;
+	gint64 scroll_x;
+	gint64 dx;
 
 	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
 
 	priv = graph->priv;
-	gtk_widget_queue_draw_area(GTK_WIDGET(graph),
-	                           priv->content_rect.x,
-	                           priv->content_rect.y,
-	                           priv->content_rect.width,
-	                           priv->content_rect.height);
+	if (!(window = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+		return TRUE;
+	}
+	/*
+	 * A dirty foreground is rendered during the expose.  Only a fast draw
+	 * keeps the previous contents, shifted by one data point.
+	 */
+	fast = !priv->full_draw && UBER_GRAPH_GET_CLASS(graph)->render_fast;
+	scroll_x = uber_graph_get_scroll_x(graph, priv->fg_dirty && fast);
+	dx = priv->scroll_x - scroll_x;
+	priv->scroll_x = scroll_x;
+	/*
+	 * Anything pending a full render must be repainted in full.
+	 */
+	if ((priv->fg_dirty && !fast) || priv->bg_dirty || priv->redraw_handler ||
+	    !priv->grid_region || dx > 0 || -dx >= priv->content_rect.width) {
+		gdk_window_invalidate_rect(window, &priv->content_rect, FALSE);
+		return TRUE;
+	}
+	if (dx != 0) {
+		/*
+		 * Scroll the content on the server.  Only the part that lands
+		 * within the content area is moved, and the sliver uncovered at
+		 * the right is invalidated by GDK.
+		 */
+		area = priv->content_rect;
+		area.x -= dx;
+		area.width += dx;
+		region = gdk_region_rectangle(&area);
+		gdk_window_move_region(window, region, dx, 0);
+		gdk_region_destroy(region);
+		/*
+		 * Grid lines stay put, so repaint them where they are and where
+		 * the scroll moved a copy of them to.
+		 */
+		region = gdk_region_rectangle(&priv->content_rect);
+		damage = gdk_region_copy(priv->grid_region);
+		gdk_region_offset(damage, dx, 0);
+		gdk_region_union(damage, priv->grid_region);
+		gdk_region_intersect(damage, region);
+		gdk_window_invalidate_region(window, damage, FALSE);
+		gdk_region_destroy(damage);
+		gdk_region_destroy(region);
+	}
+	/*
+	 * The HUD is updated every frame and any copy of it was scrolled
+	 * into its own area.
+	 */
+	if (priv->show_hud) {
+		gdk_window_invalidate_rect(window, &priv->hud_rect, FALSE);
+	}
 	return TRUE;
 }
 
@@ -297,6 +582,7 @@ uber_graph_scale_changed (UberGraph *graph) /* IN */
 	UberGraphPrivate *priv;
 	GtkAllocation alloc;
 	GdkRectangle rect;
+	GdkWindow *window;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 
@@ -305,13 +591,18 @@ uber_graph_scale_changed (UberGraph *graph) /* IN */
 		priv->fg_dirty = TRUE;
 		priv->bg_dirty = TRUE;
 		priv->full_draw = TRUE;
+		/*
+		 * Offscreen graphs have no window to invalidate.
+		 */
+		if (!(window = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+			return;
+		}
 		gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
 		rect.x = 0;
 		rect.y = 0;
 		rect.width = alloc.width;
 		rect.height = alloc.height;
-		gdk_window_invalidate_rect(gtk_widget_get_window(GTK_WIDGET(graph)),
-		                           &rect, TRUE);
+		gdk_window_invalidate_rect(window, &rect, TRUE);
 	}
 }
 
@@ -337,7 +628,7 @@ uber_graph_get_next_data (UberGraph *graph) /* IN */
 	 * the proper offset in the FPS callback.
 	 */
 	priv = graph->priv;
-	g_get_current_time(&priv->dps_tv);
+	priv->dps_time = uber_frame_clock_get_frame_time(priv->clock);
 	/*
 	 * Notify the subclass to retrieve the data point.
 	 */
@@ -372,6 +663,16 @@ uber_graph_init_texture (UberGraph *graph) /* IN */
 
 	priv = graph->priv;
 	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
+	width = MAX(priv->nonvis_rect.x + priv->nonvis_rect.width, alloc.width);
+	/*
+	 * Offscreen graphs render into a client side image surface, which is
+	 * created cleared.
+	 */
+	if (priv->offscreen) {
+		priv->fg_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+		                                              width, alloc.height);
+		return;
+	}
 	/*
 	 * Get drawable to base pixmaps upon.
 	 */
@@ -389,7 +690,6 @@ uber_graph_init_texture (UberGraph *graph) /* IN */
 	/*
 	 * Initialize foreground and background pixmaps.
 	 */
-	width = MAX(priv->nonvis_rect.x + priv->nonvis_rect.width, alloc.width);
 	priv->fg_pixmap = gdk_pixmap_new(drawable, width, alloc.height, depth);
 	/*
 	 * Create a 32-bit colormap if needed.
@@ -432,6 +732,15 @@ uber_graph_init_bg (UberGraph *graph) /* IN */
 
 	priv = graph->priv;
 	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
+	/*
+	 * Offscreen graphs render into a client side image surface.
+	 */
+	if (priv->offscreen) {
+		priv->bg_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+		                                              alloc.width,
+		                                              alloc.height);
+		return;
+	}
 	/*
 	 * Get drawable for pixmap.
 	 */
@@ -466,6 +775,41 @@ uber_graph_init_bg (UberGraph *graph) /* IN */
 	cairo_destroy(cr);
 }
 
+/**
+ * uber_graph_calculate_fps:
+ * @graph: A #UberGraph.
+ *
+ * Calculates how far the content moves for each data point and for each
+ * frame at the frame rate currently allowed by the governor.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_calculate_fps (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+	guint fps;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	fps = uber_fps_governor_get_fps(priv->governor);
+	priv->dps_each = ceil((gfloat)priv->content_rect.width
+	                      / (gfloat)(priv->x_slots - 1));
+	priv->fps_each = priv->dps_each
+	               / ((gfloat)fps / (gfloat)priv->dps);
+	/*
+	 * XXX: Small hack to make things a bit smoother at small scales.
+	 */
+	if (priv->fps_each < .5) {
+		priv->fps_each = 1;
+		priv->fps_real = (1000. / priv->dps_each) / 2.;
+	} else {
+		priv->fps_real = 1000. / fps;
+	}
+}
+
 /**
  * uber_graph_calculate_rects:
  * @graph: A #UberGraph.
@@ -483,6 +827,7 @@ uber_graph_calculate_rects (UberGraph *graph) /* IN */
 	PangoLayout *layout;
 	PangoFontDescription *font_desc;
 	GdkDrawable *drawable;
+	cairo_surface_t *surface;
 	gint pango_width;
 	gint pango_height;
 	cairo_t *cr;
@@ -492,15 +837,22 @@ uber_graph_calculate_rects (UberGraph *graph) /* IN */
 	priv = graph->priv;
 	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
 	/*
-	 * We can't calculate rectangles before we have a GdkWindow.
+	 * We can't calculate rectangles before we have a GdkWindow, unless we
+	 * are rendering offscreen, in which case the font metrics of an image
+	 * surface are used.
 	 */
-	if (!(drawable = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+	if (priv->offscreen) {
+		surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+		cr = cairo_create(surface);
+		cairo_surface_destroy(surface);
+	} else if ((drawable = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+		cr = gdk_cairo_create(drawable);
+	} else {
 		return;
 	}
 	/*
 	 * Determine the pixels required for labels.
 	 */
-	cr = gdk_cairo_create(drawable);
 	layout = pango_cairo_create_layout(cr);
 	font_desc = pango_font_description_new();
 	pango_font_description_set_family_static(font_desc, "Monospace");
@@ -528,27 +880,12 @@ uber_graph_calculate_rects (UberGraph *graph) /* IN */
 	/*
 	 * Calculate FPS/DPS adjustments.
 	 */
-	priv->dps_each = ceil((gfloat)priv->content_rect.width
-	                      / (gfloat)(priv->x_slots - 1));
-	priv->fps_each = priv->dps_each
-	               / ((gfloat)priv->fps / (gfloat)priv->dps);
-	/*
-	 * XXX: Small hack to make things a bit smoother at small scales.
-	 */
-	if (priv->fps_each < .5) {
-		priv->fps_each = 1;
-		priv->fps_real = (1000. / priv->dps_each) / 2.;
-	} else {
-		priv->fps_real = 1000. / priv->fps;
-	}
+	uber_graph_calculate_fps(graph);
 	/*
 	 * Update FPS callback.
 	 */
-	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
-		priv->fps_handler = uber_frame_source_add(priv->fps,
-		                                  (GSourceFunc)uber_graph_fps_timeout,
-		                                  graph);
+	if (priv->fps_active) {
+		uber_graph_register_fps_handler(graph);
 	}
 	/*
 	 * Calculate the non-visible area that drawing should happen within.
@@ -630,7 +967,12 @@ uber_graph_dps_timeout (UberGraph *graph) /* IN */
 		 */
 	}
 	if (G_UNLIKELY(show_fps)) {
-		g_print("UberGraph[%p] %02d FPS\n", graph, priv->fps_count);
+		g_print("UberGraph[%p] %02d FPS (%02u allowed, %0.2f ms/frame, "
+		        "%" G_GUINT64_FORMAT " dropped)\n",
+		        graph, priv->fps_count,
+		        uber_fps_governor_get_fps(priv->governor),
+		        uber_fps_governor_get_cost(priv->governor),
+		        priv->dropped);
 		priv->fps_count = 0;
 	}
 	/*
@@ -662,135 +1004,172 @@ uber_graph_dps_timeout (UberGraph *graph) /* IN */
 }
 
 /**
- * uber_graph_register_dps_handler:
+ * uber_graph_get_next_deadline:
  * @graph: A #UberGraph.
  *
- * XXX
+ * Determines the earliest deadline of the active data and frame callbacks.
  *
- * Returns: None.
+ * Returns: The monotonic deadline in nanoseconds, or -1 if idle.
  * Side effects: None.
  */
-static void
-uber_graph_register_dps_handler (UberGraph *graph) /* IN */
+static inline gint64
+uber_graph_get_next_deadline (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
-	guint dps_freq;
-	gboolean do_now = TRUE;
-
-	g_return_if_fail(UBER_IS_GRAPH(graph));
+	gint64 deadline = -1;
 
 	priv = graph->priv;
-	if (priv->dps_handler) {
-		g_source_remove(priv->dps_handler);
-		do_now = FALSE;
+	if (priv->dps_active && !priv->external_dps) {
+		deadline = priv->dps_deadline;
 	}
-	/*
-	 * Calculate the update frequency.
-	 */
-	dps_freq = 1000 / priv->dps;
-	/*
-	 * Install the data handler.
-	 */
-	priv->dps_handler = g_timeout_add(dps_freq,
-	                                  (GSourceFunc)uber_graph_dps_timeout,
-	                                  graph);
-	/*
-	 * Call immediately.
-	 */
-	if (do_now) {
-		uber_graph_dps_timeout(graph);
+	if (priv->fps_active) {
+		if (deadline < 0 || priv->fps_deadline < deadline) {
+			deadline = priv->fps_deadline;
+		}
 	}
+	return deadline;
 }
 
 /**
- * uber_graph_register_fps_handler:
+ * uber_graph_schedule:
  * @graph: A #UberGraph.
  *
- * XXX
+ * Updates the deadline of @graph within its frame clock.
  *
  * Returns: None.
  * Side effects: None.
  */
 static void
-uber_graph_register_fps_handler (UberGraph *graph) /* IN */
+uber_graph_schedule (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 
 	priv = graph->priv;
-	/*
-	 * Remove any existing FPS handler.
-	 */
-	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
+	if (!priv->clock) {
+		uber_graph_set_frame_clock(graph, uber_frame_clock_get_default());
+		return;
 	}
-	/*
-	 * Install the FPS timeout.
-	 */
-	priv->fps_handler = uber_frame_source_add(priv->fps,
-	                                  (GSourceFunc)uber_graph_fps_timeout,
-	                                  graph);
+	uber_frame_clock_schedule(priv->clock, priv->clock_id,
+	                          uber_graph_get_next_deadline(graph));
 }
 
 /**
- * uber_graph_set_dps:
+ * uber_graph_advance_deadline:
+ * @deadline: A location of a monotonic deadline.
+ * @period: The period in nanoseconds.
+ * @frame_time: The current frame time.
+ *
+ * Advances @deadline by one @period.  If that is already in the past,
+ * the missed periods are skipped rather than run back to back.
+ *
+ * Returns: The number of periods that were skipped.
+ * Side effects: None.
+ */
+static inline guint
+uber_graph_advance_deadline (gint64 *deadline,   /* IN/OUT */
+                             gint64  period,     /* IN */
+                             gint64  frame_time) /* IN */
+{
+	guint missed = 0;
+
+	*deadline += period;
+	if (*deadline <= frame_time) {
+		missed = ((frame_time - *deadline) / period) + 1;
+		*deadline = frame_time + period;
+	}
+	return missed;
+}
+
+/**
+ * uber_graph_tick:
+ * @clock: An #UberFrameClock.
+ * @frame_time: The frame time in nanoseconds.
  * @graph: A #UberGraph.
  *
- * XXX
+ * Frame clock callback.  Retrieves the next data point and queues the
+ * content area to be redrawn as their deadlines pass.
  *
- * Returns: None.
+ * Returns: The next deadline, or -1 if idle.
  * Side effects: None.
  */
-void
-uber_graph_set_dps (UberGraph *graph, /* IN */
-                    gfloat     dps)   /* IN */
+static gint64
+uber_graph_tick (UberFrameClock *clock,      /* IN */
+                 gint64          frame_time, /* IN */
+                 gpointer        data)       /* IN */
 {
+	UberGraph *graph = data;
 	UberGraphPrivate *priv;
 
-	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), -1);
 
 	priv = graph->priv;
-	priv->dps = dps;
-	/*
-	 * TODO: Does this belong somewhere else?
-	 */
-	if (UBER_GRAPH_GET_CLASS(graph)->set_stride) {
-		UBER_GRAPH_GET_CLASS(graph)->set_stride(graph, priv->x_slots);
+	if (priv->dps_active && !priv->external_dps &&
+	    frame_time >= priv->dps_deadline) {
+		uber_graph_advance_deadline(&priv->dps_deadline,
+		                            NSEC_PER_SEC / priv->dps,
+		                            frame_time);
+		uber_graph_dps_timeout(graph);
 	}
-	/*
-	 * Recalculate frame rates and timeouts.
-	 */
-	uber_graph_calculate_rects(graph);
-	uber_graph_register_dps_handler(graph);
-	uber_graph_register_fps_handler(graph);
+	if (priv->fps_active && frame_time >= priv->fps_deadline) {
+		/*
+		 * Let the governor adjust the frame rate to the cost of the
+		 * frames rendered so far.
+		 */
+		if (uber_fps_governor_tick(priv->governor, frame_time)) {
+			uber_graph_calculate_fps(graph);
+		}
+		priv->dropped +=
+			uber_graph_advance_deadline(&priv->fps_deadline,
+			                            NSEC_PER_SEC /
+			                            uber_fps_governor_get_fps(priv->governor),
+			                            frame_time);
+		uber_graph_fps_timeout(graph);
+	}
+	return uber_graph_get_next_deadline(graph);
 }
 
 /**
- * uber_graph_set_fps:
+ * uber_graph_set_frame_clock:
  * @graph: A #UberGraph.
+ * @clock: An #UberFrameClock or %NULL.
  *
- * XXX
+ * Sets the clock used to drive data retrieval and frame updates.  Graphs
+ * within the same window should share a clock so that they are ticked and
+ * exposed together.
  *
  * Returns: None.
  * Side effects: None.
  */
 void
-uber_graph_set_fps (UberGraph *graph, /* IN */
-                    guint      fps)   /* IN */
+uber_graph_set_frame_clock (UberGraph      *graph, /* IN */
+                            UberFrameClock *clock) /* IN */
 {
 	UberGraphPrivate *priv;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 
 	priv = graph->priv;
-	priv->fps = fps;
-	uber_graph_register_fps_handler(graph);
+	if (priv->clock == clock) {
+		return;
+	}
+	if (priv->clock) {
+		uber_frame_clock_remove(priv->clock, priv->clock_id);
+		uber_frame_clock_unref(priv->clock);
+		priv->clock = NULL;
+		priv->clock_id = 0;
+	}
+	if (clock) {
+		priv->clock = uber_frame_clock_ref(clock);
+		priv->clock_id = uber_frame_clock_add(clock, uber_graph_tick, graph);
+		uber_graph_schedule(graph);
+	}
 }
 
 /**
- * uber_graph_realize:
- * @widget: A #GtkWidget.
+ * uber_graph_register_dps_handler:
+ * @graph: A #UberGraph.
  *
  * XXX
  *
@@ -798,53 +1177,596 @@ uber_graph_set_fps (UberGraph *graph, /* IN */
  * Side effects: None.
  */
 static void
-uber_graph_realize (GtkWidget *widget) /* IN */
+uber_graph_register_dps_handler (UberGraph *graph) /* IN */
 {
-	UberGraph *graph;
 	UberGraphPrivate *priv;
+	gboolean do_now;
 
-	g_return_if_fail(UBER_IS_GRAPH(widget));
+	g_return_if_fail(UBER_IS_GRAPH(graph));
 
-	graph = UBER_GRAPH(widget);
 	priv = graph->priv;
-	WIDGET_CLASS->realize(widget);
+	do_now = !priv->dps_active;
 	/*
-	 * Calculate new layout based on allocation.
-	 */
-	uber_graph_calculate_rects(graph);
-	/*
-	 * Re-initialize textures for updated sizes.
+	 * Calculate the next deadline and update the frame clock.
 	 */
-	UNSET_PIXMAP(priv->bg_pixmap);
-	UNSET_PIXMAP(priv->fg_pixmap);
-	uber_graph_init_bg(graph);
-	uber_graph_init_texture(graph);
+	priv->dps_active = TRUE;
+	priv->dps_deadline = uber_frame_clock_get_time()
+	                   + (gint64)(NSEC_PER_SEC / priv->dps);
+	uber_graph_schedule(graph);
 	/*
-	 * Notify subclass of current data stride (points per graph).
+	 * Call immediately.
 	 */
-	if (UBER_GRAPH_GET_CLASS(widget)->set_stride) {
-		UBER_GRAPH_GET_CLASS(widget)->set_stride(UBER_GRAPH(widget),
-		                                         priv->x_slots);
+	if (do_now && !priv->external_dps) {
+		uber_graph_dps_timeout(graph);
 	}
-	/*
-	 * Install the data collector.
-	 */
-	uber_graph_register_dps_handler(graph);
 }
 
 /**
- * uber_graph_unrealize:
- * @widget: A #GtkWidget.
+ * uber_graph_unregister_dps_handler:
+ * @graph: A #UberGraph.
  *
- * XXX
+ * Stops retrieving new data points.
  *
  * Returns: None.
  * Side effects: None.
  */
 static void
-uber_graph_unrealize (GtkWidget *widget) /* IN */
+uber_graph_unregister_dps_handler (UberGraph *graph) /* IN */
 {
-	UberGraph *graph;
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	if (priv->dps_active) {
+		priv->dps_active = FALSE;
+		uber_graph_schedule(graph);
+	}
+}
+
+/**
+ * uber_graph_register_fps_handler:
+ * @graph: A #UberGraph.
+ *
+ * XXX
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_register_fps_handler (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	/*
+	 * Frames are only needed while we are visible and running.
+	 */
+	if (priv->suspended || priv->paused) {
+		return;
+	}
+	/*
+	 * Restart the frame schedule from now.
+	 */
+	priv->fps_active = TRUE;
+	priv->fps_deadline = uber_frame_clock_get_time()
+	                   + (gint64)(NSEC_PER_SEC /
+	                              uber_fps_governor_get_fps(priv->governor));
+	uber_graph_schedule(graph);
+}
+
+/**
+ * uber_graph_unregister_fps_handler:
+ * @graph: A #UberGraph.
+ *
+ * Stops moving the content each frame.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_unregister_fps_handler (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	if (priv->fps_active) {
+		priv->fps_active = FALSE;
+		uber_graph_schedule(graph);
+	}
+}
+
+/**
+ * uber_graph_get_dps:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves the number of data points the graph shows per second.
+ *
+ * Returns: The data points per second.
+ * Side effects: None.
+ */
+gfloat
+uber_graph_get_dps (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), 0.);
+
+	return graph->priv->dps;
+}
+
+/**
+ * uber_graph_map_samples:
+ * @graph: A #UberGraph.
+ * @timestamps: The time of each sample in microseconds, oldest first.
+ * @n_samples: The number of samples.
+ * @slots: A location for the sample of each data point.
+ * @n_slots: The number of data points.
+ *
+ * Maps timestamped samples, such as history being loaded into the graph,
+ * onto its data points.  Data point 0 is at the time of the newest sample
+ * and older data points are spaced by the data points per second.  Each
+ * is given the index of the newest sample at or before its time, or -1 if
+ * there is none.  A sample may be given to several data points if samples
+ * are sparser than data points.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_map_samples (UberGraph    *graph,      /* IN */
+                        const gint64 *timestamps, /* IN */
+                        guint         n_samples,  /* IN */
+                        gint         *slots,      /* OUT */
+                        guint         n_slots)    /* IN */
+{
+	UberGraphPrivate *priv;
+	gdouble period;
+	gint64 newest;
+	gint64 t;
+	guint k;
+	gint j;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(timestamps != NULL || n_samples == 0);
+	g_return_if_fail(slots != NULL || n_slots == 0);
+
+	priv = graph->priv;
+	period = G_USEC_PER_SEC / priv->dps;
+	newest = n_samples ? timestamps[n_samples - 1] : 0;
+	j = (gint)n_samples - 1;
+	for (k = 0; k < n_slots; k++) {
+		t = newest - (gint64)(k * period);
+		while (j >= 0 && timestamps[j] > t) {
+			j--;
+		}
+		slots[k] = j;
+	}
+}
+
+/**
+ * uber_graph_set_external_data:
+ * @graph: A #UberGraph.
+ * @external: Are data points added by the caller.
+ *
+ * Sets whether the data points of @graph are added by the caller with
+ * uber_graph_add_data_point() rather than retrieved at the data points
+ * per second, such as when playing back a recording at another speed.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_external_data (UberGraph *graph,    /* IN */
+                              gboolean   external) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	priv->external_dps = external;
+	if (priv->dps_active) {
+		priv->dps_deadline = uber_frame_clock_get_time()
+		                   + (gint64)(NSEC_PER_SEC / priv->dps);
+		uber_graph_schedule(graph);
+	}
+}
+
+/**
+ * uber_graph_add_data_point:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves the next data point of @graph now, as it would at the data
+ * points per second.  This is meant for graphs whose data points are
+ * added by the caller; see uber_graph_set_external_data().
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_add_data_point (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	/*
+	 * A fast draw only renders one data point, so render in full if
+	 * several are added between frames.
+	 */
+	priv = graph->priv;
+	if (priv->fg_dirty) {
+		priv->full_draw = TRUE;
+	}
+	uber_graph_dps_timeout(graph);
+}
+
+/**
+ * uber_graph_set_dps:
+ * @graph: A #UberGraph.
+ *
+ * XXX
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_dps (UberGraph *graph, /* IN */
+                    gfloat     dps)   /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	priv->dps = dps;
+	/*
+	 * TODO: Does this belong somewhere else?
+	 */
+	if (UBER_GRAPH_GET_CLASS(graph)->set_stride) {
+		UBER_GRAPH_GET_CLASS(graph)->set_stride(graph, priv->x_slots);
+		priv->stride = priv->x_slots;
+	}
+	/*
+	 * Recalculate frame rates and timeouts.
+	 */
+	uber_graph_calculate_rects(graph);
+	uber_graph_register_dps_handler(graph);
+	uber_graph_register_fps_handler(graph);
+}
+
+/**
+ * uber_graph_set_fps:
+ * @graph: A #UberGraph.
+ *
+ * XXX
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_fps (UberGraph *graph, /* IN */
+                    guint      fps)   /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	priv->fps = fps;
+	uber_fps_governor_set_fps(priv->governor, fps);
+	uber_graph_calculate_fps(graph);
+	uber_graph_register_fps_handler(graph);
+}
+
+/**
+ * uber_graph_set_render_budget:
+ * @graph: A #UberGraph.
+ * @budget: The fraction of one CPU that rendering may use, or 0.
+ *
+ * Sets how much of a CPU the graph may spend rendering.  When the measured
+ * cost of rendering exceeds @budget, the frame rate is lowered below the
+ * rate set with uber_graph_set_fps() and recovers once the cost drops.  A
+ * @budget of 0 disables the adjustment.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_render_budget (UberGraph *graph,  /* IN */
+                              gdouble    budget) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(budget >= 0.);
+
+	priv = graph->priv;
+	uber_fps_governor_set_budget(priv->governor, budget);
+	uber_graph_calculate_fps(graph);
+}
+
+/**
+ * uber_graph_get_render_budget:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves the fraction of a CPU the graph may spend rendering.
+ *
+ * Returns: The budget, or 0 if unlimited.
+ * Side effects: None.
+ */
+gdouble
+uber_graph_get_render_budget (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), 0.);
+
+	return uber_fps_governor_get_budget(graph->priv->governor);
+}
+
+/**
+ * uber_graph_set_timing_func:
+ * @graph: A #UberGraph.
+ * @func: An #UberGraphTimingFunc or %NULL.
+ * @user_data: User data for @func.
+ *
+ * Sets a callback that receives the time spent in each expose and in each
+ * render of the foreground and background.  This is meant for benchmarks;
+ * when no callback is set, the clock is not read.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_timing_func (UberGraph           *graph,     /* IN */
+                            UberGraphTimingFunc  func,      /* IN */
+                            gpointer             user_data) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	priv->timing_func = func;
+	priv->timing_data = user_data;
+}
+
+/**
+ * uber_graph_get_stats:
+ * @graph: A #UberGraph.
+ * @stat: The #UberGraphStat to retrieve.
+ * @stats: A location for the #UberTimingStats.
+ *
+ * Retrieves the count, total time and latency histogram of a section of
+ * rendering since the graph was created or uber_graph_reset_stats() was
+ * called.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_get_stats (UberGraph       *graph, /* IN */
+                      UberGraphStat    stat,  /* IN */
+                      UberTimingStats *stats) /* OUT */
+{
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(stat < UBER_GRAPH_STAT_LAST);
+	g_return_if_fail(stats != NULL);
+
+	*stats = graph->priv->stats[stat];
+}
+
+/**
+ * uber_graph_get_dropped_frames:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves the number of frames that were skipped because the frame clock
+ * ticked too late to show them.
+ *
+ * Returns: The number of dropped frames.
+ * Side effects: None.
+ */
+guint64
+uber_graph_get_dropped_frames (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), 0);
+
+	return graph->priv->dropped;
+}
+
+/**
+ * uber_graph_reset_stats:
+ * @graph: A #UberGraph.
+ *
+ * Clears the rendering statistics and dropped frame count of @graph.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_reset_stats (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+	gint i;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	for (i = 0; i < UBER_GRAPH_STAT_LAST; i++) {
+		uber_timing_stats_reset(&priv->stats[i]);
+	}
+	priv->dropped = 0;
+}
+
+/**
+ * uber_graph_set_recorder:
+ * @graph: A #UberGraph.
+ * @recorder: An #UberRecorder, or %NULL.
+ * @name: The name of the series for @graph, used to match it up on replay.
+ *
+ * Records every sample retrieved by @graph to @recorder, or stops
+ * recording if @recorder is %NULL.  @recorder must outlive the recording.
+ *
+ * Returns: None.
+ * Side effects: A series is added to @recorder.
+ */
+void
+uber_graph_set_recorder (UberGraph    *graph,    /* IN */
+                         UberRecorder *recorder, /* IN */
+                         const gchar  *name)     /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(!recorder || name);
+
+	priv = graph->priv;
+	priv->recorder = recorder;
+	priv->record_series = 0;
+	if (recorder) {
+		priv->record_series = uber_recorder_add_series(recorder, name);
+	}
+}
+
+/**
+ * uber_graph_record:
+ * @graph: A #UberGraph.
+ * @values: The values of the sample.
+ * @n_values: The number of values.
+ *
+ * Records a sample retrieved by @graph if it has a recorder.  This should
+ * be called by subclasses for each data point they retrieve.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_record (UberGraph     *graph,    /* IN */
+                   const gdouble *values,   /* IN */
+                   guint          n_values) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	if (priv->recorder) {
+		uber_recorder_write(priv->recorder, priv->record_series,
+		                    values, n_values);
+	}
+}
+
+/**
+ * uber_graph_set_show_hud:
+ * @graph: A #UberGraph.
+ * @show_hud: Should the statistics be shown.
+ *
+ * Sets if the rendering statistics should be overlaid on the graph.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_show_hud (UberGraph *graph,    /* IN */
+                         gboolean   show_hud) /* IN */
+{
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	graph->priv->show_hud = show_hud;
+	gtk_widget_queue_draw(GTK_WIDGET(graph));
+}
+
+/**
+ * uber_graph_get_show_hud:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves if the rendering statistics are overlaid on the graph.
+ *
+ * Returns: %TRUE if the statistics are shown.
+ * Side effects: None.
+ */
+gboolean
+uber_graph_get_show_hud (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	return graph->priv->show_hud;
+}
+
+/**
+ * uber_graph_realize:
+ * @widget: A #GtkWidget.
+ *
+ * XXX
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_realize (GtkWidget *widget) /* IN */
+{
+	UberGraph *graph;
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(widget));
+
+	graph = UBER_GRAPH(widget);
+	priv = graph->priv;
+	WIDGET_CLASS->realize(widget);
+	/*
+	 * Calculate new layout based on allocation.
+	 */
+	uber_graph_calculate_rects(graph);
+	/*
+	 * Re-initialize textures for updated sizes.
+	 */
+	UNSET_PIXMAP(priv->bg_pixmap);
+	UNSET_PIXMAP(priv->fg_pixmap);
+	UNSET_SURFACE(priv->bg_surface);
+	UNSET_SURFACE(priv->fg_surface);
+	uber_graph_init_bg(graph);
+	uber_graph_init_texture(graph);
+	/*
+	 * The new textures are empty, so render all of the data retrieved so
+	 * far, including any retrieved while we were unrealized.
+	 */
+	priv->fg_dirty = TRUE;
+	priv->bg_dirty = TRUE;
+	priv->full_draw = TRUE;
+	/*
+	 * Notify subclass of current data stride (points per graph).  Changing
+	 * the stride discards the data, so skip it if we are being realized
+	 * again with the same stride.
+	 */
+	if (UBER_GRAPH_GET_CLASS(widget)->set_stride &&
+	    priv->stride != priv->x_slots) {
+		UBER_GRAPH_GET_CLASS(widget)->set_stride(UBER_GRAPH(widget),
+		                                         priv->x_slots);
+		priv->stride = priv->x_slots;
+	}
+	/*
+	 * Install the data collector.
+	 */
+	if (!priv->dps_active) {
+		uber_graph_register_dps_handler(graph);
+	}
+}
+
+/**
+ * uber_graph_unrealize:
+ * @widget: A #GtkWidget.
+ *
+ * XXX
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_unrealize (GtkWidget *widget) /* IN */
+{
+	UberGraph *graph;
 	UberGraphPrivate *priv;
 
 	g_return_if_fail(UBER_IS_GRAPH(widget));
@@ -852,17 +1774,19 @@ uber_graph_unrealize (GtkWidget *widget) /* IN */
 	graph = UBER_GRAPH(widget);
 	priv = graph->priv;
 	/*
-	 * Unregister any data acquisition handlers.
+	 * Unregister any data acquisition handlers, unless we are to keep
+	 * retrieving data while out of view.
 	 */
-	if (priv->dps_handler) {
-		g_source_remove(priv->dps_handler);
-		priv->dps_handler = 0;
+	if (!priv->collect_detached) {
+		uber_graph_unregister_dps_handler(graph);
 	}
 	/*
 	 * Destroy textures.
 	 */
 	UNSET_PIXMAP(priv->bg_pixmap);
 	UNSET_PIXMAP(priv->fg_pixmap);
+	UNSET_SURFACE(priv->bg_surface);
+	UNSET_SURFACE(priv->fg_surface);
 }
 
 /**
@@ -894,53 +1818,194 @@ uber_graph_screen_changed (GtkWidget *widget,     /* IN */
 }
 
 /**
- * uber_graph_show:
+ * uber_graph_update_suspended:
+ * @graph: A #UberGraph.
+ *
+ * Suspends rendering if the graph cannot be seen, or resumes it with a
+ * full redraw once it can be seen again.  Data retrieval continues while
+ * suspended.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_update_suspended (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+	gboolean suspended;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	suspended = !priv->mapped || priv->obscured || priv->iconified;
+	if (suspended == priv->suspended) {
+		return;
+	}
+	priv->suspended = suspended;
+	if (suspended) {
+		uber_graph_unregister_fps_handler(graph);
+	} else if (!priv->paused) {
+		/*
+		 * Samples retrieved while suspended were never rendered, so
+		 * catch up with a single full render.
+		 */
+		uber_graph_redraw(graph);
+		uber_graph_register_fps_handler(graph);
+	}
+}
+
+/**
+ * uber_graph_map:
  * @widget: A #GtkWidget.
  *
- * XXX
+ * Resumes rendering when the graph is mapped.
  *
  * Returns: None.
  * Side effects: None.
  */
 static void
-uber_graph_show (GtkWidget *widget) /* IN */
+uber_graph_map (GtkWidget *widget) /* IN */
 {
 	UberGraphPrivate *priv;
 
 	g_return_if_fail(UBER_IS_GRAPH(widget));
 
 	priv = UBER_GRAPH(widget)->priv;
-	WIDGET_CLASS->show(widget);
-	/*
-	 * Only run the FPS timeout when we are visible.
-	 */
-	uber_graph_register_fps_handler(UBER_GRAPH(widget));
+	WIDGET_CLASS->map(widget);
+	priv->mapped = TRUE;
+	priv->obscured = FALSE;
+	uber_graph_update_suspended(UBER_GRAPH(widget));
 }
 
 /**
- * uber_graph_hide:
- * @widget: A #GtkWIdget.
+ * uber_graph_unmap:
+ * @widget: A #GtkWidget.
  *
- * XXX
+ * Suspends rendering when the graph is unmapped.
  *
  * Returns: None.
  * Side effects: None.
  */
 static void
-uber_graph_hide (GtkWidget *widget) /* IN */
+uber_graph_unmap (GtkWidget *widget) /* IN */
 {
 	UberGraphPrivate *priv;
 
 	g_return_if_fail(UBER_IS_GRAPH(widget));
 
 	priv = UBER_GRAPH(widget)->priv;
-	/*
-	 * Disable the FPS timeout when we are not visible.
-	 */
-	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
-		priv->fps_handler = 0;
+	priv->mapped = FALSE;
+	uber_graph_update_suspended(UBER_GRAPH(widget));
+	WIDGET_CLASS->unmap(widget);
+}
+
+/**
+ * uber_graph_visibility_notify_event:
+ * @widget: A #GtkWidget.
+ * @visibility: A #GdkEventVisibility.
+ *
+ * Suspends rendering while the graph is fully obscured, such as when it is
+ * covered by another window or scrolled out of view.
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_visibility_notify_event (GtkWidget          *widget,     /* IN */
+                                    GdkEventVisibility *visibility) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(widget), FALSE);
+
+	priv = UBER_GRAPH(widget)->priv;
+	priv->obscured = (visibility->state == GDK_VISIBILITY_FULLY_OBSCURED);
+	uber_graph_update_suspended(UBER_GRAPH(widget));
+	return FALSE;
+}
+
+/**
+ * uber_graph_toplevel_window_state_event:
+ * @toplevel: The toplevel #GtkWidget.
+ * @state: A #GdkEventWindowState.
+ * @graph: A #UberGraph.
+ *
+ * Suspends rendering while the toplevel is iconified or withdrawn, which
+ * is also how many window managers hide windows on other workspaces.
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_toplevel_window_state_event (GtkWidget           *toplevel, /* IN */
+                                        GdkEventWindowState *state,    /* IN */
+                                        UberGraph           *graph)    /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	priv = graph->priv;
+	priv->iconified = !!(state->new_window_state &
+	                     (GDK_WINDOW_STATE_ICONIFIED |
+	                      GDK_WINDOW_STATE_WITHDRAWN));
+	uber_graph_update_suspended(graph);
+	return FALSE;
+}
+
+/**
+ * uber_graph_set_toplevel:
+ * @graph: A #UberGraph.
+ * @toplevel: The new toplevel #GtkWidget or %NULL.
+ *
+ * Moves the "window-state-event" handler to the new toplevel.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_set_toplevel (UberGraph *graph,    /* IN */
+                         GtkWidget *toplevel) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	if (priv->toplevel) {
+		g_signal_handler_disconnect(priv->toplevel, priv->state_handler);
+		priv->toplevel = NULL;
+		priv->state_handler = 0;
+	}
+	priv->iconified = FALSE;
+	if (toplevel && GTK_IS_WINDOW(toplevel)) {
+		priv->toplevel = toplevel;
+		priv->state_handler =
+			g_signal_connect(toplevel, "window-state-event",
+			                 G_CALLBACK(uber_graph_toplevel_window_state_event),
+			                 graph);
 	}
+	uber_graph_update_suspended(graph);
+}
+
+/**
+ * uber_graph_hierarchy_changed:
+ * @widget: A #GtkWidget.
+ * @old_toplevel: The previous toplevel or %NULL.
+ *
+ * Tracks the toplevel of the graph so that iconification is noticed.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_hierarchy_changed (GtkWidget *widget,       /* IN */
+                              GtkWidget *old_toplevel) /* IN */
+{
+	g_return_if_fail(UBER_IS_GRAPH(widget));
+
+	uber_graph_set_toplevel(UBER_GRAPH(widget),
+	                        gtk_widget_get_toplevel(widget));
 }
 
 static inline void
@@ -961,6 +2026,115 @@ uber_graph_get_pixmap_rect (UberGraph    *graph, /* IN */
 	rect->height = alloc.height;
 }
 
+/**
+ * uber_graph_render_fg_slice:
+ * @graph: A #UberGraph.
+ * @cr: A cairo_t for the foreground.
+ *
+ * Continues a progressive full render of the foreground using
+ * UberGraph::render_range, newest slots first, until it completes or
+ * REDRAW_BUDGET has elapsed.  Each slot is cleared before it is rendered.
+ *
+ * Returns: %TRUE if slots remain to be rendered; otherwise %FALSE.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_render_fg_slice (UberGraph *graph, /* IN */
+                            cairo_t   *cr)    /* IN */
+{
+	UberGraphPrivate *priv;
+	GdkRectangle rect;
+	gint64 begin;
+	gint slot;
+	gint end;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	priv = graph->priv;
+	begin = uber_graph_timing_begin(graph);
+	while (priv->redraw_k < priv->x_slots) {
+		/*
+		 * Stop at the start of the ring so the slots do not wrap.
+		 */
+		slot = (priv->dps_slot - 1 - priv->redraw_k) % priv->x_slots;
+		if (slot < 0) {
+			slot += priv->x_slots;
+		}
+		end = MIN(priv->redraw_k + REDRAW_CHUNK, priv->x_slots);
+		end = MIN(end, priv->redraw_k + slot + 1);
+		rect.x = priv->content_rect.x
+		       + (priv->dps_each * (slot - (end - priv->redraw_k - 1)));
+		rect.y = priv->content_rect.y;
+		rect.width = priv->dps_each * (end - priv->redraw_k);
+		rect.height = priv->content_rect.height;
+		cairo_save(cr);
+		gdk_cairo_rectangle(cr, &rect);
+		cairo_clip(cr);
+		cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+		cairo_paint(cr);
+		cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+		UBER_GRAPH_GET_CLASS(graph)->render_range(graph,
+		                                          cr,
+		                                          &rect,
+		                                          RECT_RIGHT(rect),
+		                                          priv->dps_each,
+		                                          priv->redraw_k,
+		                                          end);
+		cairo_restore(cr);
+		priv->redraw_k = end;
+		if (uber_frame_clock_get_time() - begin >= REDRAW_BUDGET) {
+			break;
+		}
+	}
+	uber_graph_timing_end(graph, UBER_GRAPH_TIMING_RENDER_FG,
+	                      UBER_GRAPH_STAT_RENDER_FULL, begin);
+	return priv->redraw_k < priv->x_slots;
+}
+
+/**
+ * uber_graph_redraw_timeout:
+ * @data: An #UberGraph.
+ *
+ * Idle handler which renders the next slice of a progressive full render.
+ *
+ * Returns: %TRUE while slots remain to be rendered.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_redraw_timeout (gpointer data) /* IN */
+{
+	UberGraph *graph = data;
+	UberGraphPrivate *priv;
+	gboolean more;
+	cairo_t *cr;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	priv = graph->priv;
+	/*
+	 * Start over once the graph can be seen, or if the texture is gone.
+	 */
+	if (priv->suspended || priv->paused ||
+	    (!priv->fg_pixmap && !priv->fg_surface)) {
+		priv->redraw_handler = 0;
+		priv->fg_dirty = TRUE;
+		priv->full_draw = TRUE;
+		return FALSE;
+	}
+	cr = uber_graph_create_layer_cairo(priv->fg_pixmap, priv->fg_surface);
+	more = uber_graph_render_fg_slice(graph, cr);
+	cairo_destroy(cr);
+	if (!more) {
+		priv->redraw_handler = 0;
+	}
+	gtk_widget_queue_draw_area(GTK_WIDGET(graph),
+	                           priv->content_rect.x,
+	                           priv->content_rect.y,
+	                           priv->content_rect.width,
+	                           priv->content_rect.height);
+	return more;
+}
+
 /**
  * uber_graph_render_fg:
  * @graph: A #UberGraph.
@@ -977,8 +2151,10 @@ uber_graph_render_fg (UberGraph *graph) /* IN */
 	GtkAllocation alloc;
 	GdkRectangle rect;
 	cairo_t *cr;
+	UberGraphStat stat = UBER_GRAPH_STAT_RENDER_FULL;
 	gfloat each;
 	gfloat x_epoch;
+	gint64 begin;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 
@@ -986,9 +2162,10 @@ uber_graph_render_fg (UberGraph *graph) /* IN */
 	 * Acquire resources.
 	 */
 	priv = graph->priv;
+	begin = uber_graph_timing_begin(graph);
 	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
 	uber_graph_get_pixmap_rect(graph, &rect);
-	cr = gdk_cairo_create(priv->fg_pixmap);
+	cr = uber_graph_create_layer_cairo(priv->fg_pixmap, priv->fg_surface);
 	/*
 	 * Render to texture if needed.
 	 */
@@ -1003,6 +2180,7 @@ uber_graph_render_fg (UberGraph *graph) /* IN */
 		 * buffer at the next offset.
 		 */
 		if (!priv->full_draw && UBER_GRAPH_GET_CLASS(graph)->render_fast) {
+			stat = UBER_GRAPH_STAT_RENDER_FAST;
 			/*
 			 * Determine next rendering slot.
 			 */
@@ -1012,7 +2190,15 @@ uber_graph_render_fg (UberGraph *graph) /* IN */
 			rect.y = priv->content_rect.y;
 			rect.height = priv->content_rect.height;
 			priv->dps_slot = (priv->dps_slot + 1) % priv->x_slots;
+			priv->dps_shifts++;
 			x_epoch = RECT_RIGHT(rect);
+			/*
+			 * Slots of a progressive render are now one further from
+			 * the most recent data point.
+			 */
+			if (priv->redraw_handler) {
+				priv->redraw_k++;
+			}
 			/*
 			 * Clear content area.
 			 */
@@ -1041,7 +2227,7 @@ uber_graph_render_fg (UberGraph *graph) /* IN */
 			 * Render new content clipped.
 			 */
 			cairo_save(cr);
-			gdk_cairo_reset_clip(cr, priv->fg_pixmap);
+			cairo_reset_clip(cr);
 			gdk_cairo_rectangle(cr, &rect);
 			cairo_clip(cr);
 			/*
@@ -1053,6 +2239,18 @@ uber_graph_render_fg (UberGraph *graph) /* IN */
 			                                         x_epoch,
 			                                         each + .5);
 			cairo_restore(cr);
+		} else if (UBER_GRAPH_GET_CLASS(graph)->render_range &&
+		           !priv->offscreen) {
+			/*
+			 * Render the most recent slots now and the rest in slices
+			 * when idle.  Slots not yet rendered keep their contents.
+			 */
+			priv->redraw_k = 0;
+			if (uber_graph_render_fg_slice(graph, cr) &&
+			    !priv->redraw_handler) {
+				priv->redraw_handler =
+					g_idle_add(uber_graph_redraw_timeout, graph);
+			}
 		} else {
 			/*
 			 * Clear content area.
@@ -1079,37 +2277,156 @@ uber_graph_render_fg (UberGraph *graph) /* IN */
 			}
 		}
 	}
-	/*
-	 * Foreground is no longer dirty.
-	 */
-	priv->fg_dirty = FALSE;
-	priv->full_draw = FALSE;
-	/*
-	 * Cleanup.
-	 */
-	cairo_destroy(cr);
+	/*
+	 * Foreground is no longer dirty.
+	 */
+	priv->fg_dirty = FALSE;
+	priv->full_draw = FALSE;
+	/*
+	 * Cleanup.
+	 */
+	cairo_destroy(cr);
+	uber_graph_timing_end(graph, UBER_GRAPH_TIMING_RENDER_FG, stat, begin);
+}
+
+/**
+ * uber_graph_redraw:
+ * @graph: A #UberGraph.
+ *
+ * XXX
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_redraw (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	priv->fg_dirty = TRUE;
+	priv->bg_dirty = TRUE;
+	priv->full_draw = TRUE;
+	gtk_widget_queue_draw(GTK_WIDGET(graph));
+}
+
+/**
+ * uber_graph_refine_timeout:
+ * @data: An #UberGraph.
+ *
+ * Idle handler which replaces the approximate foreground shown after
+ * uber_graph_rescale() with a full render at the new scale.
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_refine_timeout (gpointer data) /* IN */
+{
+	UberGraph *graph = data;
+	UberGraphPrivate *priv;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	priv = graph->priv;
+	priv->refine_handler = 0;
+	if (priv->full_draw || priv->paused || priv->suspended) {
+		return FALSE;
+	}
+	priv->fg_dirty = TRUE;
+	priv->full_draw = TRUE;
+	uber_graph_render_fg(graph);
+	gtk_widget_queue_draw_area(GTK_WIDGET(graph),
+	                           priv->content_rect.x,
+	                           priv->content_rect.y,
+	                           priv->content_rect.width,
+	                           priv->content_rect.height);
+	return FALSE;
 }
 
 /**
- * uber_graph_redraw:
+ * uber_graph_rescale:
  * @graph: A #UberGraph.
+ * @factor: The ratio of the old y-axis range to the new one.
  *
- * XXX
+ * Notifies the graph that its y-axis range changed and that values are now
+ * drawn @factor times as far above the bottom of the content area as they
+ * were, as is the case for uber_scale_linear().  The foreground already
+ * rendered is stretched to match and shown until it is rendered again at
+ * the new scale when idle.
+ *
+ * Subclasses using other scales should call uber_graph_scale_changed()
+ * instead.
  *
  * Returns: None.
  * Side effects: None.
  */
 void
-uber_graph_redraw (UberGraph *graph) /* IN */
+uber_graph_rescale (UberGraph *graph,  /* IN */
+                    gdouble    factor) /* IN */
 {
 	UberGraphPrivate *priv;
+	cairo_surface_t *target;
+	cairo_surface_t *copy;
+	cairo_t *cr;
+	gdouble y_end;
+	gint width;
+	gint height;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 
 	priv = graph->priv;
-	priv->fg_dirty = TRUE;
+	if (priv->paused || priv->full_draw || !(factor > 0.) || isinf(factor) ||
+	    (!priv->fg_pixmap && !priv->fg_surface)) {
+		uber_graph_scale_changed(graph);
+		return;
+	}
+	if (priv->fg_pixmap) {
+		gdk_drawable_get_size(GDK_DRAWABLE(priv->fg_pixmap), &width, &height);
+	} else {
+		width = cairo_image_surface_get_width(priv->fg_surface);
+		height = cairo_image_surface_get_height(priv->fg_surface);
+	}
+	/*
+	 * Copy the foreground aside and draw it back scaled about the bottom
+	 * of the content area.
+	 */
+	cr = uber_graph_create_layer_cairo(priv->fg_pixmap, priv->fg_surface);
+	target = cairo_get_target(cr);
+	copy = cairo_surface_create_similar(target,
+	                                    cairo_surface_get_content(target),
+	                                    width, height);
+	cairo_destroy(cr);
+	cr = cairo_create(copy);
+	uber_graph_set_layer_source(cr, priv->fg_pixmap, priv->fg_surface, 0, 0);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	y_end = RECT_BOTTOM(priv->content_rect);
+	cr = uber_graph_create_layer_cairo(priv->fg_pixmap, priv->fg_surface);
+	cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+	cairo_rectangle(cr, 0, priv->content_rect.y,
+	                width, priv->content_rect.height);
+	cairo_clip(cr);
+	cairo_translate(cr, 0, y_end * (1. - factor));
+	cairo_scale(cr, 1., factor);
+	cairo_set_source_surface(cr, copy, 0, 0);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	cairo_surface_destroy(copy);
+	/*
+	 * Labels change with the range; lines are refined once idle.
+	 */
 	priv->bg_dirty = TRUE;
-	priv->full_draw = TRUE;
+	if (!priv->refine_handler) {
+		priv->refine_handler = g_idle_add_full(G_PRIORITY_LOW,
+		                                       uber_graph_refine_timeout,
+		                                       graph, NULL);
+	}
 	gtk_widget_queue_draw(GTK_WIDGET(graph));
 }
 
@@ -1164,8 +2481,6 @@ uber_graph_render_x_axis (UberGraph *graph, /* IN */
 {
 	UberGraphPrivate *priv;
 	const gdouble dashes[] = { 1.0, 2.0 };
-	PangoFontDescription *fd;
-	PangoLayout *pl;
 	GtkStyle *style;
 	gfloat each;
 	gfloat x;
@@ -1187,11 +2502,6 @@ uber_graph_render_x_axis (UberGraph *graph, /* IN */
 	 * Draw ticks.
 	 */
 	cairo_save(cr);
-	pl = pango_cairo_create_layout(cr);
-	fd = pango_font_description_new();
-	pango_font_description_set_family_static(fd, "Monospace");
-	pango_font_description_set_size(fd, 6 * PANGO_SCALE);
-	pango_layout_set_font_description(pl, fd);
 	gdk_cairo_set_source_color(cr, &style->fg[GTK_STATE_NORMAL]);
 	cairo_set_line_width(cr, 1.0);
 	cairo_set_dash(cr, dashes, G_N_ELEMENTS(dashes), 0);
@@ -1208,30 +2518,31 @@ uber_graph_render_x_axis (UberGraph *graph, /* IN */
 			cairo_move_to(cr, x, y);
 			cairo_line_to(cr, x, y + h);
 			cairo_stroke(cr);
+			if (priv->show_xlines) {
+				uber_graph_add_grid_line(graph, (gint)x, priv->content_rect.y,
+				                         1, priv->content_rect.height);
+			}
 		}
 		/*
 		 * Render the label.
 		 */
 		if (priv->show_xlabels) {
 			g_snprintf(text, sizeof(text), "%d", i * 10);
-			pango_layout_set_text(pl, text, -1);
-			pango_layout_get_pixel_size(pl, &wi, &hi);
+			uber_text_cache_get_size(priv->label_cache, text, &wi, &hi);
 			if (i != 0 && i != count) {
-				cairo_move_to(cr, x - (wi / 2), y + h);
+				uber_text_cache_show(priv->label_cache, cr, text,
+				                     x - (wi / 2), y + h);
 			} else if (i == 0) {
-				cairo_move_to(cr,
-				              RECT_RIGHT(priv->content_rect) - (wi / 2),
-				              RECT_BOTTOM(priv->content_rect) + priv->tick_len);
+				uber_text_cache_show(priv->label_cache, cr, text,
+				                     RECT_RIGHT(priv->content_rect) - (wi / 2),
+				                     RECT_BOTTOM(priv->content_rect) + priv->tick_len);
 			} else if (i == count) {
-				cairo_move_to(cr,
-				              priv->content_rect.x - (wi / 2),
-				              RECT_BOTTOM(priv->content_rect) + priv->tick_len);
+				uber_text_cache_show(priv->label_cache, cr, text,
+				                     priv->content_rect.x - (wi / 2),
+				                     RECT_BOTTOM(priv->content_rect) + priv->tick_len);
 			}
-			pango_cairo_show_layout(cr, pl);
 		}
 	}
-	g_object_unref(pl);
-	pango_font_description_free(fd);
 	cairo_restore(cr);
 }
 
@@ -1246,11 +2557,9 @@ uber_graph_render_y_line (UberGraph   *graph,     /* IN */
 {
 	UberGraphPrivate *priv;
 	const gdouble dashes[] = { 1.0, 2.0 };
-	PangoFontDescription *fd;
-	PangoLayout *pl;
 	GtkStyle *style;
 	va_list args;
-	gchar *text;
+	gchar text[64];
 	gint width;
 	gint height;
 	gfloat real_y = y + .5;
@@ -1273,6 +2582,8 @@ uber_graph_render_y_line (UberGraph   *graph,     /* IN */
 		cairo_line_to(cr, priv->content_rect.x, real_y);
 	} else {
 		cairo_line_to(cr, RECT_RIGHT(priv->content_rect), real_y);
+		uber_graph_add_grid_line(graph, priv->content_rect.x, y,
+		                         priv->content_rect.width, 1);
 	}
 	cairo_stroke(cr);
 	cairo_restore(cr);
@@ -1286,27 +2597,15 @@ uber_graph_render_y_line (UberGraph   *graph,     /* IN */
 		 * Format text.
 		 */
 		va_start(args, format);
-		text = g_strdup_vprintf(format, args);
+		g_vsnprintf(text, sizeof(text), format, args);
 		va_end(args);
 		/*
-		 * Render pango layout.
-		 */
-		pl = pango_cairo_create_layout(cr);
-		fd = pango_font_description_new();
-		pango_font_description_set_family_static(fd, "Monospace");
-		pango_font_description_set_size(fd, 6 * PANGO_SCALE);
-		pango_layout_set_font_description(pl, fd);
-		pango_layout_set_text(pl, text, -1);
-		pango_layout_get_pixel_size(pl, &width, &height);
-		cairo_move_to(cr, priv->content_rect.x - priv->tick_len - width - 3,
-		              real_y - height / 2);
-		pango_cairo_show_layout(cr, pl);
-		/*
-		 * Cleanup resources.
+		 * Show the cached rendering of the label.
 		 */
-		g_free(text);
-		pango_font_description_free(fd);
-		g_object_unref(pl);
+		uber_text_cache_get_size(priv->label_cache, text, &width, &height);
+		uber_text_cache_show(priv->label_cache, cr, text,
+		                     priv->content_rect.x - priv->tick_len - width - 3,
+		                     real_y - height / 2);
 		cairo_restore(cr);
 	}
 }
@@ -1512,6 +2811,7 @@ uber_graph_render_bg (UberGraph *graph) /* IN */
 	GtkAllocation alloc;
 	GtkStyle *style;
 	cairo_t *cr;
+	gint64 begin;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 
@@ -1519,14 +2819,27 @@ uber_graph_render_bg (UberGraph *graph) /* IN */
 	 * Acquire resources.
 	 */
 	priv = graph->priv;
+	begin = uber_graph_timing_begin(graph);
 	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
 	style = gtk_widget_get_style(GTK_WIDGET(graph));
-	cr = gdk_cairo_create(priv->bg_pixmap);
+	cr = uber_graph_create_layer_cairo(priv->bg_pixmap, priv->bg_surface);
 	/*
 	 * Ensure valid resources.
 	 */
 	g_assert(style);
-	g_assert(priv->bg_pixmap);
+	g_assert(priv->bg_pixmap || priv->bg_surface);
+	if (priv->grid_region) {
+		gdk_region_destroy(priv->grid_region);
+	}
+	priv->grid_region = gdk_region_new();
+	/*
+	 * Lay out labels as the widget would.  Offscreen graphs may have no
+	 * screen, in which case the defaults are used.
+	 */
+	if (gtk_widget_has_screen(GTK_WIDGET(graph))) {
+		uber_text_cache_set_context(priv->label_cache,
+		                            gtk_widget_get_pango_context(GTK_WIDGET(graph)));
+	}
 	/*
 	 * Clear entire background.  Hopefully this looks okay for RGBA themes
 	 * that are translucent.
@@ -1572,23 +2885,8 @@ uber_graph_render_bg (UberGraph *graph) /* IN */
 	 * Cleanup.
 	 */
 	cairo_destroy(cr);
-}
-
-static inline void
-g_time_val_subtract (GTimeVal *a, /* IN */
-                     GTimeVal *b, /* IN */
-                     GTimeVal *c) /* OUT */
-{
-	g_return_if_fail(a != NULL);
-	g_return_if_fail(b != NULL);
-	g_return_if_fail(c != NULL);
-
-	c->tv_sec = a->tv_sec - b->tv_sec;
-	c->tv_usec = a->tv_usec - b->tv_usec;
-	if (c->tv_usec < 0) {
-		c->tv_usec += G_USEC_PER_SEC;
-		c->tv_sec -= 1;
-	}
+	uber_graph_timing_end(graph, UBER_GRAPH_TIMING_RENDER_BG,
+	                      UBER_GRAPH_STAT_RENDER_BG, begin);
 }
 
 /**
@@ -1605,94 +2903,156 @@ static gfloat
 uber_graph_get_fps_offset (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
-	GTimeVal rel;
-	GTimeVal tv;
+	gint64 rel;
 	gfloat f;
 
 	g_return_val_if_fail(UBER_IS_GRAPH(graph), 0.);
 
+	/*
+	 * Use the frame time so that all graphs sharing the clock scroll by
+	 * the same amount within an expose pass.
+	 */
 	priv = graph->priv;
-	g_get_current_time(&tv);
-	g_time_val_subtract(&tv, &priv->dps_tv, &rel);
-	f = ((rel.tv_sec * 1000) + (rel.tv_usec / 1000))
-	  / (1000. / priv->dps) /* MSec Per Data Point */
-	  * priv->dps_each;     /* Pixels Per Data Point */
+	rel = uber_frame_clock_get_frame_time(priv->clock) - priv->dps_time;
+	f = rel
+	  / (NSEC_PER_SEC / priv->dps) /* NSec Per Data Point */
+	  * priv->dps_each;            /* Pixels Per Data Point */
 	return MIN(f, (priv->dps_each - priv->fps_each));
 }
 
 /**
- * uber_graph_expose_event:
- * @widget: A #GtkWidget.
+ * uber_graph_render_hud:
+ * @graph: A #UberGraph.
+ * @cr: A cairo_t positioned at the origin of the graph.
  *
- * XXX
+ * Overlays the frame rate, dropped frames, and the mean and 99th percentile
+ * rendering times in the corner of the content area.
  *
- * Returns: %FALSE always.
+ * Returns: None.
  * Side effects: None.
  */
-static gboolean
-uber_graph_expose_event (GtkWidget      *widget, /* IN */
-                         GdkEventExpose *expose) /* IN */
+static void
+uber_graph_render_hud (UberGraph *graph, /* IN */
+                       cairo_t   *cr)    /* IN */
+{
+	UberGraphPrivate *priv;
+	PangoFontDescription *fd;
+	PangoLayout *pl;
+	GString *str;
+	gint wi;
+	gint hi;
+	gint i;
+
+	priv = graph->priv;
+	str = g_string_new(NULL);
+	g_string_append_printf(str, "%2u/%-2d fps %5" G_GUINT64_FORMAT " dropped",
+	                       uber_fps_governor_get_fps(priv->governor),
+	                       priv->fps, priv->dropped);
+	for (i = 0; i < UBER_GRAPH_STAT_LAST; i++) {
+		g_string_append_printf(str, "\n%-6s %6.2f %6.2f ms", stat_names[i],
+		                       uber_timing_stats_get_mean(&priv->stats[i]),
+		                       uber_timing_stats_get_percentile(&priv->stats[i],
+		                                                        99.));
+	}
+	cairo_save(cr);
+	gdk_cairo_rectangle(cr, &priv->content_rect);
+	cairo_clip(cr);
+	pl = pango_cairo_create_layout(cr);
+	fd = pango_font_description_new();
+	pango_font_description_set_family_static(fd, "Monospace");
+	pango_font_description_set_size(fd, 6 * PANGO_SCALE);
+	pango_layout_set_font_description(pl, fd);
+	pango_layout_set_text(pl, str->str, str->len);
+	pango_layout_get_pixel_size(pl, &wi, &hi);
+	/*
+	 * Darken the area behind the text so it is readable over any content.
+	 */
+	priv->hud_rect.x = priv->content_rect.x;
+	priv->hud_rect.y = priv->content_rect.y;
+	priv->hud_rect.width = wi + 6;
+	priv->hud_rect.height = hi + 4;
+	cairo_set_source_rgba(cr, 0., 0., 0., .6);
+	gdk_cairo_rectangle(cr, &priv->hud_rect);
+	cairo_fill(cr);
+	cairo_set_source_rgb(cr, 1., 1., 1.);
+	cairo_move_to(cr, priv->content_rect.x + 3, priv->content_rect.y + 2);
+	pango_cairo_show_layout(cr, pl);
+	g_object_unref(pl);
+	pango_font_description_free(fd);
+	cairo_restore(cr);
+	g_string_free(str, TRUE);
+}
+
+/**
+ * uber_graph_paint:
+ * @graph: A #UberGraph.
+ * @cr: A cairo_t to paint to.
+ *
+ * Paints the current frame of the graph to @cr with the origin of the graph
+ * at the origin of @cr.  The background and foreground are rendered first
+ * if they are out of date.  This is used both to handle exposes and to
+ * produce frames of graphs rendered with uber_graph_set_offscreen().
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_paint (UberGraph *graph, /* IN */
+                  cairo_t   *cr)    /* IN */
 {
 	UberGraphPrivate *priv;
 	GtkAllocation alloc;
-	cairo_t *cr;
-	gfloat offset;
+	GdkWindow *window;
+	gint64 scroll_x;
+	gint offset;
 	gint x;
 
-	g_return_val_if_fail(UBER_IS_GRAPH(widget), FALSE);
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(cr != NULL);
 
-	priv = UBER_GRAPH(widget)->priv;
-	gtk_widget_get_allocation(widget, &alloc);
-	priv->fps_count++;
+	priv = graph->priv;
+	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
 	/*
 	 * Ensure that the texture is initialized.
 	 */
-	g_assert(priv->fg_pixmap);
-	g_assert(priv->bg_pixmap);
-	/*
-	 * Clear window background.
-	 */
-	gdk_window_clear_area(expose->window,
-	                      expose->area.x,
-	                      expose->area.y,
-	                      expose->area.width,
-	                      expose->area.height);
-	/*
-	 * Allocate resources.
-	 */
-	cr = gdk_cairo_create(expose->window);
-	/*
-	 * Clip to exposure area.
-	 */
-	gdk_cairo_rectangle(cr, &expose->area);
-	cairo_clip(cr);
+	g_assert(priv->fg_pixmap || priv->fg_surface);
+	g_assert(priv->bg_pixmap || priv->bg_surface);
 	/*
 	 * Render background or foreground if needed.
 	 */
 	if (priv->bg_dirty) {
-		uber_graph_render_bg(UBER_GRAPH(widget));
+		uber_graph_render_bg(graph);
 	}
 	if (priv->fg_dirty) {
-		uber_graph_render_fg(UBER_GRAPH(widget));
+		uber_graph_render_fg(graph);
 	}
 	/*
-	 * Paint the background to the exposure area.
+	 * Paint the background.
 	 */
 	cairo_save(cr);
-	gdk_cairo_set_source_pixmap(cr, priv->bg_pixmap, 0, 0);
+	uber_graph_set_layer_source(cr, priv->bg_pixmap, priv->bg_surface, 0, 0);
 	cairo_rectangle(cr, 0, 0, alloc.width, alloc.height);
 	cairo_fill(cr);
 	cairo_restore(cr);
 	/*
-	 * Draw the foreground.
-	 */
-	offset = uber_graph_get_fps_offset(UBER_GRAPH(widget));
-	if (priv->have_rgba) {
+	 * Draw the foreground at a whole pixel offset so that the frames
+	 * scrolled by uber_graph_fps_timeout() line up.  If the frame differs
+	 * from the one that was predicted, repaint the content next frame.
+	 */
+	offset = (gint)uber_graph_get_fps_offset(graph);
+	scroll_x = uber_graph_get_scroll_x(graph, FALSE);
+	if (scroll_x != priv->scroll_x) {
+		priv->scroll_x = scroll_x;
+		if (!priv->offscreen &&
+		    (window = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+			gdk_window_invalidate_rect(window, &priv->content_rect, FALSE);
+		}
+	}
+	if (priv->have_rgba || priv->offscreen) {
 		cairo_save(cr);
 		/*
-		 * Clip exposure to the content area.
+		 * Clip to the content area.
 		 */
-		gdk_cairo_reset_clip(cr, expose->window);
 		gdk_cairo_rectangle(cr, &priv->content_rect);
 		cairo_clip(cr);
 		/*
@@ -1700,14 +3060,16 @@ uber_graph_expose_event (GtkWidget      *widget, /* IN */
 		 * at its given offset.
 		 */
 		x = ((priv->x_slots - priv->dps_slot) * priv->dps_each) - offset;
-		gdk_cairo_set_source_pixmap(cr, priv->fg_pixmap, (gint)x, 0);
+		uber_graph_set_layer_source(cr, priv->fg_pixmap, priv->fg_surface,
+		                            x, 0);
 		gdk_cairo_rectangle(cr, &priv->content_rect);
 		cairo_fill(cr);
 		/*
 		 * Render the second part of the ring pixmap buffer.
 		 */
 		x = (priv->dps_each * -priv->dps_slot) - offset;
-		gdk_cairo_set_source_pixmap(cr, priv->fg_pixmap, (gint)x, 0);
+		uber_graph_set_layer_source(cr, priv->fg_pixmap, priv->fg_surface,
+		                            x, 0);
 		gdk_cairo_rectangle(cr, &priv->content_rect);
 		cairo_fill(cr);
 		/*
@@ -1720,13 +3082,173 @@ uber_graph_expose_event (GtkWidget      *widget, /* IN */
 		 */
 		g_warn_if_reached();
 	}
+	/*
+	 * Overlay rendering statistics.
+	 */
+	if (G_UNLIKELY(priv->show_hud)) {
+		uber_graph_render_hud(graph, cr);
+	}
+}
+
+/**
+ * uber_graph_expose_event:
+ * @widget: A #GtkWidget.
+ *
+ * XXX
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_expose_event (GtkWidget      *widget, /* IN */
+                         GdkEventExpose *expose) /* IN */
+{
+	UberGraphPrivate *priv;
+	cairo_t *cr;
+	gint64 begin;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(widget), FALSE);
+
+	priv = UBER_GRAPH(widget)->priv;
+	priv->fps_count++;
+	begin = uber_graph_timing_begin(UBER_GRAPH(widget));
+	uber_fps_governor_begin(priv->governor);
+	/*
+	 * Allocate resources.  The window background is not cleared since the
+	 * background pixmap covers the entire allocation.
+	 */
+	cr = gdk_cairo_create(expose->window);
+	/*
+	 * Clip to the exposed region rather than its bounding box so that only
+	 * damaged pixels are sent to the server.
+	 */
+	gdk_cairo_region(cr, expose->region);
+	cairo_clip(cr);
+	/*
+	 * Paint the frame.
+	 */
+	uber_graph_paint(UBER_GRAPH(widget), cr);
 	/*
 	 * Cleanup resources.
 	 */
 	cairo_destroy(cr);
+	uber_fps_governor_end(priv->governor);
+	uber_graph_timing_end(UBER_GRAPH(widget), UBER_GRAPH_TIMING_EXPOSE,
+	                      UBER_GRAPH_STAT_EXPOSE, begin);
 	return FALSE;
 }
 
+/**
+ * uber_graph_set_offscreen:
+ * @graph: A #UberGraph.
+ * @width: The width of the graph in pixels.
+ * @height: The height of the graph in pixels.
+ *
+ * Renders @graph into client side image surfaces of the given size rather
+ * than server side pixmaps, so that no display is required.  Data points
+ * are retrieved on the frame clock as usual; frames are produced on demand
+ * with uber_graph_paint().
+ *
+ * This must be called before the graph is realized.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_offscreen (UberGraph *graph,  /* IN */
+                          gint       width,  /* IN */
+                          gint       height) /* IN */
+{
+	UberGraphPrivate *priv;
+	GtkAllocation alloc;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(!gtk_widget_get_realized(GTK_WIDGET(graph)));
+	g_return_if_fail(width > 0);
+	g_return_if_fail(height > 0);
+
+	priv = graph->priv;
+	priv->offscreen = TRUE;
+	/*
+	 * Allocate the requested size, which creates the surfaces.
+	 */
+	alloc.x = 0;
+	alloc.y = 0;
+	alloc.width = width;
+	alloc.height = height;
+	gtk_widget_size_allocate(GTK_WIDGET(graph), &alloc);
+	/*
+	 * Notify subclass of current data stride (points per graph).
+	 */
+	if (UBER_GRAPH_GET_CLASS(graph)->set_stride) {
+		UBER_GRAPH_GET_CLASS(graph)->set_stride(graph, priv->x_slots);
+		priv->stride = priv->x_slots;
+	}
+	/*
+	 * Install the data collector.
+	 */
+	if (!priv->dps_active) {
+		uber_graph_register_dps_handler(graph);
+	}
+}
+
+/**
+ * uber_graph_set_collect_detached:
+ * @graph: A #UberGraph.
+ * @collect_detached: If data should be retrieved while unrealized.
+ *
+ * Sets whether @graph keeps retrieving data points while it is not
+ * realized, such as when a container has removed it from view.  Its
+ * pixmaps are still released when unrealized, and the data retrieved in
+ * the meantime is rendered once it is realized again.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_collect_detached (UberGraph *graph,            /* IN */
+                                 gboolean   collect_detached) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	priv = graph->priv;
+	priv->collect_detached = collect_detached;
+	if (gtk_widget_get_realized(GTK_WIDGET(graph)) || priv->offscreen) {
+		return;
+	}
+	if (collect_detached) {
+		if (UBER_GRAPH_GET_CLASS(graph)->set_stride &&
+		    priv->stride != priv->x_slots) {
+			UBER_GRAPH_GET_CLASS(graph)->set_stride(graph, priv->x_slots);
+			priv->stride = priv->x_slots;
+		}
+		if (!priv->dps_active) {
+			uber_graph_register_dps_handler(graph);
+		}
+	} else {
+		uber_graph_unregister_dps_handler(graph);
+	}
+}
+
+/**
+ * uber_graph_get_offscreen:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves if @graph renders without a display.
+ *
+ * Returns: %TRUE if uber_graph_set_offscreen() was called.
+ * Side effects: None.
+ */
+gboolean
+uber_graph_get_offscreen (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	return graph->priv->offscreen;
+}
+
 /**
  * uber_graph_style_set:
  * @widget: A #GtkWidget.
@@ -1746,6 +3268,7 @@ uber_graph_style_set (GtkWidget *widget,    /* IN */
 
 	priv = UBER_GRAPH(widget)->priv;
 	WIDGET_CLASS->style_set(widget, old_style);
+	uber_text_cache_clear(priv->label_cache);
 	priv->fg_dirty = TRUE;
 	priv->bg_dirty = TRUE;
 	gtk_widget_queue_draw(widget);
@@ -1775,7 +3298,7 @@ uber_graph_size_allocate (GtkWidget     *widget, /* IN */
 	/*
 	 * If there is no window yet, we can defer setup.
 	 */
-	if (!gtk_widget_get_window(widget)) {
+	if (!gtk_widget_get_window(widget) && !priv->offscreen) {
 		return;
 	}
 	/*
@@ -1787,6 +3310,8 @@ uber_graph_size_allocate (GtkWidget     *widget, /* IN */
 	 */
 	UNSET_PIXMAP(priv->bg_pixmap);
 	UNSET_PIXMAP(priv->fg_pixmap);
+	UNSET_SURFACE(priv->bg_surface);
+	UNSET_SURFACE(priv->fg_surface);
 	uber_graph_init_bg(graph);
 	uber_graph_init_texture(graph);
 	/*
@@ -1923,13 +3448,10 @@ uber_graph_toggle_paused (UberGraph *graph) /* IN */
 
 	priv = graph->priv;
 	priv->paused = !priv->paused;
-	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
-		priv->fps_handler = 0;
+	if (priv->paused) {
+		uber_graph_unregister_fps_handler(graph);
 	} else {
-		if (!priv->paused) {
-			uber_graph_redraw(graph);
-		}
+		uber_graph_redraw(graph);
 		uber_graph_register_fps_handler(graph);
 	}
 }
@@ -1980,6 +3502,14 @@ uber_graph_button_press_event (GtkWidget      *widget, /* IN */
 static void
 uber_graph_finalize (GObject *object) /* IN */
 {
+	UberGraphPrivate *priv;
+
+	priv = UBER_GRAPH(object)->priv;
+	uber_fps_governor_free(priv->governor);
+	uber_text_cache_free(priv->label_cache);
+	if (priv->grid_region) {
+		gdk_region_destroy(priv->grid_region);
+	}
 	G_OBJECT_CLASS(uber_graph_parent_class)->finalize(object);
 }
 
@@ -2002,19 +3532,36 @@ uber_graph_dispose (GObject *object) /* IN */
 	graph = UBER_GRAPH(object);
 	priv = graph->priv;
 	/*
-	 * Stop any timeout handlers.
+	 * Drop any pending refinement of a rescale.
 	 */
-	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
+	if (priv->refine_handler) {
+		g_source_remove(priv->refine_handler);
+		priv->refine_handler = 0;
 	}
-	if (priv->dps_handler) {
-		g_source_remove(priv->dps_handler);
+	if (priv->redraw_handler) {
+		g_source_remove(priv->redraw_handler);
+		priv->redraw_handler = 0;
 	}
+	/*
+	 * Stop watching the toplevel.
+	 */
+	if (priv->toplevel) {
+		g_signal_handler_disconnect(priv->toplevel, priv->state_handler);
+		priv->toplevel = NULL;
+	}
+	/*
+	 * Detach from the frame clock.
+	 */
+	priv->fps_active = FALSE;
+	priv->dps_active = FALSE;
+	uber_graph_set_frame_clock(graph, NULL);
 	/*
 	 * Destroy textures.
 	 */
 	UNSET_PIXMAP(priv->bg_pixmap);
 	UNSET_PIXMAP(priv->fg_pixmap);
+	UNSET_SURFACE(priv->bg_surface);
+	UNSET_SURFACE(priv->fg_surface);
 	/*
 	 * Call base class.
 	 */
@@ -2043,10 +3590,12 @@ uber_graph_class_init (UberGraphClass *klass) /* IN */
 
 	widget_class = GTK_WIDGET_CLASS(klass);
 	widget_class->expose_event = uber_graph_expose_event;
-	widget_class->hide = uber_graph_hide;
+	widget_class->hierarchy_changed = uber_graph_hierarchy_changed;
+	widget_class->map = uber_graph_map;
 	widget_class->realize = uber_graph_realize;
 	widget_class->screen_changed = uber_graph_screen_changed;
-	widget_class->show = uber_graph_show;
+	widget_class->unmap = uber_graph_unmap;
+	widget_class->visibility_notify_event = uber_graph_visibility_notify_event;
 	widget_class->size_allocate = uber_graph_size_allocate;
 	widget_class->style_set = uber_graph_style_set;
 	widget_class->unrealize = uber_graph_unrealize;
@@ -2054,6 +3603,7 @@ uber_graph_class_init (UberGraphClass *klass) /* IN */
 	widget_class->button_press_event = uber_graph_button_press_event;
 
 	show_fps = !!g_getenv("UBER_SHOW_FPS");
+	show_hud = !!g_getenv("UBER_SHOW_HUD");
 }
 
 /**
@@ -2069,6 +3619,7 @@ static void
 uber_graph_init (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
+	PangoFontDescription *fd;
 
 	/*
 	 * Store pointer to private data allocation.
@@ -2080,13 +3631,16 @@ uber_graph_init (UberGraph *graph) /* IN */
 	/*
 	 * Enable required events.
 	 */
-	gtk_widget_set_events(GTK_WIDGET(graph), GDK_BUTTON_PRESS_MASK);
+	gtk_widget_set_events(GTK_WIDGET(graph),
+	                      GDK_BUTTON_PRESS_MASK | GDK_VISIBILITY_NOTIFY_MASK);
 	/*
 	 * Prepare default values.
 	 */
 	priv->tick_len = 10;
 	priv->fps = 20;
 	priv->fps_real = 1000. / priv->fps;
+	priv->governor = uber_fps_governor_new(priv->fps);
+	uber_fps_governor_set_budget(priv->governor, DEFAULT_RENDER_BUDGET);
 	priv->dps = 1.;
 	priv->x_slots = 60;
 	priv->fg_dirty = TRUE;
@@ -2094,6 +3648,16 @@ uber_graph_init (UberGraph *graph) /* IN */
 	priv->full_draw = TRUE;
 	priv->show_xlines = TRUE;
 	priv->show_ylines = TRUE;
+	priv->suspended = TRUE;
+	priv->show_hud = show_hud;
+	/*
+	 * Axis labels are drawn from a cache of rendered strings.
+	 */
+	fd = pango_font_description_new();
+	pango_font_description_set_family_static(fd, "Monospace");
+	pango_font_description_set_size(fd, 6 * PANGO_SCALE);
+	priv->label_cache = uber_text_cache_new(fd, FALSE);
+	pango_font_description_free(fd);
 	/*
 	 * TODO: Support labels in a grid.
 	 */
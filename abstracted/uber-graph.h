@@ -21,8 +21,11 @@
 
 #include <gtk/gtk.h>
 
+#include "uber-frame-clock.h"
 #include "uber-range.h"
 #include "uber-label.h"
+#include "uber-recorder.h"
+#include "uber-timing-stats.h"
 
 G_BEGIN_DECLS
 
@@ -45,6 +48,57 @@ typedef struct _UberGraph        UberGraph;
 typedef struct _UberGraphClass   UberGraphClass;
 typedef struct _UberGraphPrivate UberGraphPrivate;
 
+/**
+ * UberGraphTiming:
+ * @UBER_GRAPH_TIMING_EXPOSE: Handling of an expose event.
+ * @UBER_GRAPH_TIMING_RENDER_FG: Rendering of the foreground.
+ * @UBER_GRAPH_TIMING_RENDER_BG: Rendering of the background.
+ *
+ * #UberGraphTiming describes which section of rendering was measured.
+ */
+typedef enum
+{
+	UBER_GRAPH_TIMING_EXPOSE,
+	UBER_GRAPH_TIMING_RENDER_FG,
+	UBER_GRAPH_TIMING_RENDER_BG,
+} UberGraphTiming;
+
+/**
+ * UberGraphStat:
+ * @UBER_GRAPH_STAT_EXPOSE: Handling of expose events.
+ * @UBER_GRAPH_STAT_RENDER_BG: Rendering of the background.
+ * @UBER_GRAPH_STAT_RENDER_FAST: Rendering of a new data point only.
+ * @UBER_GRAPH_STAT_RENDER_FULL: Rendering of the entire foreground.
+ *
+ * #UberGraphStat selects the rendering statistics to retrieve with
+ * uber_graph_get_stats().
+ */
+typedef enum
+{
+	UBER_GRAPH_STAT_EXPOSE,
+	UBER_GRAPH_STAT_RENDER_BG,
+	UBER_GRAPH_STAT_RENDER_FAST,
+	UBER_GRAPH_STAT_RENDER_FULL,
+	UBER_GRAPH_STAT_LAST
+} UberGraphStat;
+
+/**
+ * UberGraphTimingFunc:
+ * @graph: A #UberGraph.
+ * @timing: The section of rendering that was measured.
+ * @elapsed: The time spent in nanoseconds.
+ * @user_data: User data supplied to uber_graph_set_timing_func().
+ *
+ * Callback receiving rendering times of the graph.
+ *
+ * Returns: None.
+ * Side effects: Implementation specific.
+ */
+typedef void (*UberGraphTimingFunc) (UberGraph       *graph,
+                                     UberGraphTiming  timing,
+                                     gint64           elapsed,
+                                     gpointer         user_data);
+
 struct _UberGraph
 {
 	GtkDrawingArea parent;
@@ -71,13 +125,26 @@ struct _UberGraphClass
 	                             GdkRectangle *content_area,
 	                             guint         epoch,
 	                             gfloat        each);
+	void       (*render_range)  (UberGraph    *graph,
+	                             cairo_t      *cairo,
+	                             GdkRectangle *content_area,
+	                             guint         epoch,
+	                             gfloat        each,
+	                             guint         begin,
+	                             guint         end);
 	void       (*set_stride)    (UberGraph    *graph,
 	                             guint         stride);
 };
 
 GType      uber_graph_get_type         (void) G_GNUC_CONST;
+gfloat     uber_graph_get_dps          (UberGraph       *graph);
 void       uber_graph_set_dps          (UberGraph       *graph,
                                         gfloat           dps);
+void       uber_graph_map_samples      (UberGraph       *graph,
+                                        const gint64    *timestamps,
+                                        guint            n_samples,
+                                        gint            *slots,
+                                        guint            n_slots);
 void       uber_graph_set_fps          (UberGraph       *graph,
                                         guint            fps);
 void       uber_graph_redraw           (UberGraph       *graph);
@@ -98,6 +165,41 @@ gboolean   uber_graph_get_show_ylines  (UberGraph       *graph);
 void       uber_graph_set_show_ylines  (UberGraph       *graph,
                                         gboolean         show_ylines);
 void       uber_graph_scale_changed    (UberGraph       *graph);
+void       uber_graph_rescale          (UberGraph       *graph,
+                                        gdouble          factor);
+void       uber_graph_set_frame_clock  (UberGraph       *graph,
+                                        UberFrameClock  *clock);
+void       uber_graph_set_render_budget(UberGraph       *graph,
+                                        gdouble          budget);
+gdouble    uber_graph_get_render_budget(UberGraph       *graph);
+void       uber_graph_set_offscreen    (UberGraph       *graph,
+                                        gint             width,
+                                        gint             height);
+gboolean   uber_graph_get_offscreen    (UberGraph       *graph);
+void       uber_graph_set_collect_detached (UberGraph   *graph,
+                                        gboolean         collect_detached);
+void       uber_graph_paint            (UberGraph       *graph,
+                                        cairo_t         *cr);
+void       uber_graph_set_timing_func  (UberGraph       *graph,
+                                        UberGraphTimingFunc func,
+                                        gpointer         user_data);
+void       uber_graph_get_stats        (UberGraph       *graph,
+                                        UberGraphStat    stat,
+                                        UberTimingStats *stats);
+guint64    uber_graph_get_dropped_frames (UberGraph     *graph);
+void       uber_graph_reset_stats      (UberGraph       *graph);
+void       uber_graph_set_show_hud     (UberGraph       *graph,
+                                        gboolean         show_hud);
+gboolean   uber_graph_get_show_hud     (UberGraph       *graph);
+void       uber_graph_set_recorder     (UberGraph       *graph,
+                                        UberRecorder    *recorder,
+                                        const gchar     *name);
+void       uber_graph_record           (UberGraph       *graph,
+                                        const gdouble   *values,
+                                        guint            n_values);
+void       uber_graph_set_external_data (UberGraph      *graph,
+                                        gboolean         external);
+void       uber_graph_add_data_point   (UberGraph       *graph);
 
 G_END_DECLS
 
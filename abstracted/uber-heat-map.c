@@ -76,7 +76,7 @@ uber_heat_map_destroy_array (gpointer data) /* IN */
 {
 	GArray **ar = data;
 
-	if (ar) {
+	if (ar && *ar) {
 		g_array_unref(*ar);
 	}
 }
@@ -257,12 +257,61 @@ uber_heat_map_get_next_data (UberGraph *graph) /* IN */
 	 * Store data points.
 	 */
 	g_ring_append_val(priv->raw_data, array);
+	uber_graph_record(graph, &g_array_index(array, gdouble, 0), array->len);
 	for (i = 0; i < array->len; i++) {
 		g_print("==> %f\n", g_array_index(array, gdouble, i));
 	}
 	return TRUE;
 }
 
+/**
+ * uber_heat_map_load:
+ * @map: A #UberHeatMap.
+ * @timestamps: The time of each sample in microseconds, oldest first.
+ * @values: A #GArray of values for each sample, which may be %NULL.
+ * @n_samples: The number of samples.
+ *
+ * Replaces the contents of the graph with history, such as the last few
+ * minutes of an existing data source.  The samples are mapped onto the
+ * data points with uber_graph_map_samples() and stored in a single pass,
+ * then the graph is rendered once in full.  Each sample is shown only in
+ * the newest data point it maps to.  A reference is taken on each array.
+ *
+ * Returns: None.
+ * Side effects: The graph is redrawn.
+ */
+void
+uber_heat_map_load (UberHeatMap   *map,        /* IN */
+                    const gint64  *timestamps, /* IN */
+                    GArray       **values,     /* IN */
+                    guint          n_samples)  /* IN */
+{
+	UberHeatMapPrivate *priv;
+	GArray *array;
+	gint *slots;
+	gint k;
+
+	g_return_if_fail(UBER_IS_HEAT_MAP(map));
+	g_return_if_fail(timestamps != NULL || n_samples == 0);
+	g_return_if_fail(values != NULL || n_samples == 0);
+	g_return_if_fail(map->priv->raw_data != NULL);
+
+	priv = map->priv;
+	slots = g_new(gint, priv->raw_data->len);
+	uber_graph_map_samples(UBER_GRAPH(map), timestamps, n_samples,
+	                       slots, priv->raw_data->len);
+	for (k = priv->raw_data->len - 1; k >= 0; k--) {
+		array = NULL;
+		if (slots[k] >= 0 && (k == 0 || slots[k - 1] != slots[k]) &&
+		    values[slots[k]]) {
+			array = g_array_ref(values[slots[k]]);
+		}
+		g_ring_append_val(priv->raw_data, array);
+	}
+	g_free(slots);
+	uber_graph_redraw(UBER_GRAPH(map));
+}
+
 /**
  * uber_heat_map_set_fg_color:
  * @map: A #UberHeatMap.
@@ -54,6 +54,10 @@ struct _UberHeatMapClass
 
 GType      uber_heat_map_get_type      (void) G_GNUC_CONST;
 GtkWidget* uber_heat_map_new           (void);
+void       uber_heat_map_load          (UberHeatMap     *map,
+                                        const gint64    *timestamps,
+                                        GArray         **values,
+                                        guint            n_samples);
 void       uber_heat_map_set_fg_color  (UberHeatMap     *map,
                                         const GdkColor  *color);
 void       uber_heat_map_set_data_func (UberHeatMap     *map,
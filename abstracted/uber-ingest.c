@@ -0,0 +1,531 @@
+/* uber-ingest.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "uber-ingest.h"
+
+/*
+ * Largest datagram accepted, and the most datagrams handled before the
+ * samples are pushed into the graphs.
+ */
+#define MAX_DATAGRAM (65536)
+#define MAX_BATCH    (64)
+
+/*
+ * Receive buffer requested so that bursts are not dropped while a batch
+ * is being handled.
+ */
+#define RCVBUF_SIZE  (1 << 20)
+
+/**
+ * SECTION:uber-ingest
+ * @title: UberIngest
+ * @short_description: Samples from other processes over a local socket.
+ *
+ * Other processes send datagrams to a Unix-domain socket or a UDP port
+ * bound to localhost.  Each datagram holds one or more lines of the form
+ *
+ * |[
+ * series:value[|field]...
+ * ]|
+ *
+ * A field of only digits is the time of the sample in microseconds of
+ * CLOCK_MONOTONIC, as from g_get_monotonic_time(); otherwise the time the
+ * datagram was handled is used.  Later times are clamped to that time.
+ * Other fields, such as the type of a statsd gauge, are ignored, so statsd
+ * clients may send to it directly.
+ *
+ * Datagrams are read in batches on a thread of their own.  Each series is
+ * routed to a line with uber_ingest_route(); once per batch, the latest
+ * value of every routed series is pushed into its graph with a single
+ * uber_line_graph_push().  Samples for unrouted series are dropped.
+ */
+
+struct _UberIngest
+{
+	GMutex     *mutex;   /* Protects routes. */
+	GHashTable *routes;  /* Map of series name to UberIngestRoute. */
+	GThread    *thread;  /* Thread reading the socket. */
+	gint        fd;      /* Socket, or -1. */
+	gint        wake[2]; /* Pipe to stop the thread. */
+	gchar      *path;    /* Path of a Unix-domain socket, or NULL. */
+	GArray     *values;  /* Values of the graph being pushed. */
+};
+
+typedef struct
+{
+	UberLineGraph *graph; /* Graph of the series. */
+	guint          index; /* Index of the line within the graph. */
+	gdouble        value; /* Latest value within the batch. */
+	gint64         time;  /* Time of the latest value. */
+	gboolean       dirty; /* Has a value within the batch. */
+} UberIngestRoute;
+
+/**
+ * uber_ingest_route_free:
+ * @data: An #UberIngestRoute.
+ *
+ * Frees @data and its reference to the graph.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_ingest_route_free (gpointer data) /* IN */
+{
+	UberIngestRoute *route = data;
+
+	g_object_unref(route->graph);
+	g_slice_free(UberIngestRoute, route);
+}
+
+/**
+ * uber_ingest_new:
+ *
+ * Creates a new #UberIngest.  It does not receive samples until
+ * uber_ingest_listen_unix() or uber_ingest_listen_udp() is called.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_ingest_free().
+ * Side effects: None.
+ */
+UberIngest*
+uber_ingest_new (void)
+{
+	UberIngest *ingest;
+
+	ingest = g_slice_new0(UberIngest);
+	ingest->mutex = g_mutex_new();
+	ingest->routes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                       uber_ingest_route_free);
+	ingest->fd = -1;
+	ingest->wake[0] = -1;
+	ingest->wake[1] = -1;
+	ingest->values = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	return ingest;
+}
+
+/**
+ * uber_ingest_free:
+ * @ingest: An #UberIngest.
+ *
+ * Stops receiving samples and frees @ingest.  A Unix-domain socket is
+ * removed.
+ *
+ * Returns: None.
+ * Side effects: The thread reading the socket is joined.
+ */
+void
+uber_ingest_free (UberIngest *ingest) /* IN */
+{
+	g_return_if_fail(ingest != NULL);
+
+	if (ingest->thread) {
+		if (write(ingest->wake[1], "q", 1) < 0) {
+			g_warning("Failed to stop ingest thread: %s", g_strerror(errno));
+		}
+		g_thread_join(ingest->thread);
+		close(ingest->wake[0]);
+		close(ingest->wake[1]);
+	}
+	if (ingest->fd >= 0) {
+		close(ingest->fd);
+	}
+	if (ingest->path) {
+		unlink(ingest->path);
+		g_free(ingest->path);
+	}
+	g_hash_table_destroy(ingest->routes);
+	g_array_unref(ingest->values);
+	g_mutex_free(ingest->mutex);
+	g_slice_free(UberIngest, ingest);
+}
+
+/**
+ * uber_ingest_route:
+ * @ingest: An #UberIngest.
+ * @series: The name of the series.
+ * @graph: An #UberLineGraph.
+ * @line: The line of @graph, starting from 1.
+ *
+ * Routes samples of @series to @line of @graph, replacing any previous
+ * route of @series.  A reference is held on @graph until the route is
+ * removed.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_ingest_route (UberIngest    *ingest, /* IN */
+                   const gchar   *series, /* IN */
+                   UberLineGraph *graph,  /* IN */
+                   gint           line)   /* IN */
+{
+	UberIngestRoute *route;
+
+	g_return_if_fail(ingest != NULL);
+	g_return_if_fail(series != NULL);
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+	g_return_if_fail(line > 0);
+
+	route = g_slice_new0(UberIngestRoute);
+	route->graph = g_object_ref(graph);
+	route->index = line - 1;
+	g_mutex_lock(ingest->mutex);
+	g_hash_table_replace(ingest->routes, g_strdup(series), route);
+	g_mutex_unlock(ingest->mutex);
+}
+
+/**
+ * uber_ingest_unroute:
+ * @ingest: An #UberIngest.
+ * @series: The name of the series.
+ *
+ * Removes the route of @series so that its samples are dropped.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_ingest_unroute (UberIngest  *ingest, /* IN */
+                     const gchar *series) /* IN */
+{
+	g_return_if_fail(ingest != NULL);
+	g_return_if_fail(series != NULL);
+
+	g_mutex_lock(ingest->mutex);
+	g_hash_table_remove(ingest->routes, series);
+	g_mutex_unlock(ingest->mutex);
+}
+
+/**
+ * uber_ingest_parse:
+ * @ingest: An #UberIngest.
+ * @buf: The contents of a datagram, which is modified.
+ * @now: The time the datagram was handled.
+ * @dirty: The routes with a value within the batch.
+ *
+ * Parses each line of @buf and stores the value within its route.  The
+ * mutex must be held.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_ingest_parse (UberIngest *ingest, /* IN */
+                   gchar      *buf,    /* IN */
+                   gint64      now,    /* IN */
+                   GPtrArray  *dirty)  /* IN/OUT */
+{
+	UberIngestRoute *route;
+	gchar *line;
+	gchar *next;
+	gchar *colon;
+	gchar *end;
+	gdouble value;
+	gint64 time;
+
+	for (line = buf; line && *line; line = next) {
+		if ((next = strchr(line, '\n'))) {
+			*next++ = '\0';
+		}
+		if (!(colon = strchr(line, ':'))) {
+			continue;
+		}
+		*colon = '\0';
+		value = g_ascii_strtod(colon + 1, &end);
+		if (end == colon + 1) {
+			continue;
+		}
+		time = now;
+		while ((end = strchr(end, '|'))) {
+			end++;
+			if (g_ascii_isdigit(*end)) {
+				time = g_ascii_strtoll(end, &end, 10);
+			}
+		}
+		/*
+		 * Samples from the future, or from another clock, would
+		 * otherwise win over every sample that follows them.
+		 */
+		time = MIN(time, now);
+		if (!(route = g_hash_table_lookup(ingest->routes, line))) {
+			continue;
+		}
+		if (!route->dirty) {
+			route->dirty = TRUE;
+			g_ptr_array_add(dirty, route);
+		} else if (time < route->time) {
+			continue;
+		}
+		route->value = value;
+		route->time = time;
+	}
+}
+
+/**
+ * uber_ingest_flush:
+ * @ingest: An #UberIngest.
+ * @dirty: The routes with a value within the batch.
+ *
+ * Pushes the latest value of each route into its graph, once for each
+ * graph.  Lines without a value are pushed NaN so they are left as they
+ * are.  The mutex must be held.
+ *
+ * Returns: None.
+ * Side effects: @dirty is emptied.
+ */
+static void
+uber_ingest_flush (UberIngest *ingest, /* IN */
+                   GPtrArray  *dirty)  /* IN/OUT */
+{
+	UberIngestRoute *route;
+	UberIngestRoute *other;
+	gdouble nan = NAN;
+	gint64 time;
+	guint i;
+	guint j;
+
+	for (i = 0; i < dirty->len; i++) {
+		route = g_ptr_array_index(dirty, i);
+		if (!route->dirty) {
+			continue;
+		}
+		g_array_set_size(ingest->values, 0);
+		time = route->time;
+		for (j = i; j < dirty->len; j++) {
+			other = g_ptr_array_index(dirty, j);
+			if (!other->dirty || other->graph != route->graph) {
+				continue;
+			}
+			while (ingest->values->len <= other->index) {
+				g_array_append_val(ingest->values, nan);
+			}
+			g_array_index(ingest->values, gdouble, other->index) = other->value;
+			time = MAX(time, other->time);
+			other->dirty = FALSE;
+		}
+		uber_line_graph_push(route->graph, time,
+		                     (gdouble *)ingest->values->data,
+		                     ingest->values->len);
+	}
+	g_ptr_array_set_size(dirty, 0);
+}
+
+/**
+ * uber_ingest_thread:
+ * @data: An #UberIngest.
+ *
+ * Reads datagrams in batches until the wake pipe is written to.
+ *
+ * Returns: None.
+ * Side effects: Samples are pushed into the routed graphs.
+ */
+static gpointer
+uber_ingest_thread (gpointer data) /* IN */
+{
+	UberIngest *ingest = data;
+	struct pollfd fds[2];
+	GPtrArray *dirty;
+	gchar *buf;
+	gssize len;
+	gint64 now;
+	guint n;
+
+	buf = g_malloc(MAX_DATAGRAM + 1);
+	dirty = g_ptr_array_new();
+	fds[0].fd = ingest->fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = ingest->wake[0];
+	fds[1].events = POLLIN;
+	while (TRUE) {
+		if (poll(fds, G_N_ELEMENTS(fds), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			g_warning("Failed to poll ingest socket: %s", g_strerror(errno));
+			break;
+		}
+		if (fds[1].revents) {
+			break;
+		}
+		now = g_get_monotonic_time();
+		g_mutex_lock(ingest->mutex);
+		for (n = 0; n < MAX_BATCH; n++) {
+			len = recv(ingest->fd, buf, MAX_DATAGRAM, MSG_DONTWAIT);
+			if (len < 0) {
+				break;
+			}
+			buf[len] = '\0';
+			uber_ingest_parse(ingest, buf, now, dirty);
+		}
+		uber_ingest_flush(ingest, dirty);
+		g_mutex_unlock(ingest->mutex);
+	}
+	g_ptr_array_free(dirty, TRUE);
+	g_free(buf);
+	return NULL;
+}
+
+/**
+ * uber_ingest_start:
+ * @ingest: An #UberIngest.
+ * @fd: A bound datagram socket.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Takes ownership of @fd and starts the thread reading it.  @fd is closed
+ * on failure.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ * Side effects: None.
+ */
+static gboolean
+uber_ingest_start (UberIngest  *ingest, /* IN */
+                   gint         fd,     /* IN */
+                   GError     **error)  /* OUT */
+{
+	gint size = RCVBUF_SIZE;
+
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	if (pipe(ingest->wake) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to create ingest pipe: %s", g_strerror(errno));
+		goto failure;
+	}
+	ingest->fd = fd;
+	ingest->thread = g_thread_create(uber_ingest_thread, ingest, TRUE, error);
+	if (!ingest->thread) {
+		close(ingest->wake[0]);
+		close(ingest->wake[1]);
+		ingest->fd = -1;
+		goto failure;
+	}
+	return TRUE;
+
+  failure:
+	ingest->wake[0] = -1;
+	ingest->wake[1] = -1;
+	close(fd);
+	return FALSE;
+}
+
+/**
+ * uber_ingest_listen_unix:
+ * @ingest: An #UberIngest.
+ * @path: The path of the socket.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Receives samples from a Unix-domain datagram socket at @path, replacing
+ * any file already there.  An #UberIngest listens on a single socket.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ * Side effects: The socket is created and removed by uber_ingest_free().
+ */
+gboolean
+uber_ingest_listen_unix (UberIngest   *ingest, /* IN */
+                         const gchar  *path,   /* IN */
+                         GError      **error)  /* OUT */
+{
+	struct sockaddr_un addr;
+	gint fd;
+
+	g_return_val_if_fail(ingest != NULL, FALSE);
+	g_return_val_if_fail(path != NULL, FALSE);
+	g_return_val_if_fail(ingest->fd < 0, FALSE);
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NAMETOOLONG,
+		            "Socket path \"%s\" is too long", path);
+		return FALSE;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if ((fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to create socket: %s", g_strerror(errno));
+		return FALSE;
+	}
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to bind \"%s\": %s", path, g_strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+	if (!uber_ingest_start(ingest, fd, error)) {
+		unlink(path);
+		return FALSE;
+	}
+	ingest->path = g_strdup(path);
+	return TRUE;
+}
+
+/**
+ * uber_ingest_listen_udp:
+ * @ingest: An #UberIngest.
+ * @port: The UDP port.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Receives samples sent to @port on the loopback interface.  An
+ * #UberIngest listens on a single socket.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ * Side effects: None.
+ */
+gboolean
+uber_ingest_listen_udp (UberIngest  *ingest, /* IN */
+                        guint16      port,   /* IN */
+                        GError     **error)  /* OUT */
+{
+	struct sockaddr_in addr;
+	gint fd;
+
+	g_return_val_if_fail(ingest != NULL, FALSE);
+	g_return_val_if_fail(ingest->fd < 0, FALSE);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to create socket: %s", g_strerror(errno));
+		return FALSE;
+	}
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to bind UDP port %u: %s", port, g_strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+	return uber_ingest_start(ingest, fd, error);
+}
@@ -0,0 +1,51 @@
+/* uber-ingest.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_INGEST_H__
+#define __UBER_INGEST_H__
+
+#include "uber-line-graph.h"
+
+G_BEGIN_DECLS
+
+/**
+ * UberIngest:
+ *
+ * #UberIngest receives samples from other processes over a local socket
+ * and pushes them into the lines of #UberLineGraph<!-- -->s by series name.
+ */
+typedef struct _UberIngest UberIngest;
+
+UberIngest* uber_ingest_new         (void);
+void        uber_ingest_free        (UberIngest     *ingest);
+void        uber_ingest_route       (UberIngest     *ingest,
+                                     const gchar    *series,
+                                     UberLineGraph  *graph,
+                                     gint            line);
+void        uber_ingest_unroute     (UberIngest     *ingest,
+                                     const gchar    *series);
+gboolean    uber_ingest_listen_unix (UberIngest     *ingest,
+                                     const gchar    *path,
+                                     GError        **error);
+gboolean    uber_ingest_listen_udp  (UberIngest     *ingest,
+                                     guint16         port,
+                                     GError        **error);
+
+G_END_DECLS
+
+#endif /* __UBER_INGEST_H__ */
@@ -24,13 +24,27 @@
 #include <string.h>
 
 #include "uber-line-graph.h"
+#include "uber-autoscale.h"
 #include "uber-range.h"
 #include "uber-scale.h"
+#include "uber-render-worker.h"
 #include "g-ring.h"
 
 #define RECT_BOTTOM(r) ((r).y + (r).height)
 #define RECT_RIGHT(r)  ((r).x + (r).width)
-#define SCALE_FACTOR   (0.2)
+#define PARALLEL_LINES (32) /* Lines needed to render on the render workers. */
+#define ENVELOPE_DECAY (0.9) /* Weight of the previous deviation of a line. */
+#define ENVELOPE_WIDTH (2.0) /* Width of the median line. */
+
+enum
+{
+	ENVELOPE_MIN,
+	ENVELOPE_LOW,
+	ENVELOPE_MEDIAN,
+	ENVELOPE_HIGH,
+	ENVELOPE_MAX,
+	ENVELOPE_LAST
+};
 
 /**
  * SECTION:uber-line-graph.h
@@ -53,14 +67,56 @@ typedef struct
 	gdouble    dash_offset;
 	UberLabel *label;
 	guint      label_id;
+	gdouble    deviation;
+	gboolean   has_pushed;
+	gdouble    pushed;
+	gint64     pushed_time;
+	guint      pushed_tick;
 } LineInfo;
 
+typedef struct _PushBatch PushBatch;
+
+struct _PushBatch
+{
+	PushBatch *next;      /* Batch pushed before this one. */
+	gint64     timestamp; /* Time of the values. */
+	guint      n_values;  /* Number of values. */
+	gdouble   *values;    /* Value of each line. */
+};
+
+typedef struct
+{
+	LineInfo *style; /* Line whose style the batch is stroked with. */
+	guint     first; /* First path of the batch. */
+	guint     last;  /* Path after the last of the batch. */
+} LineBatch;
+
+typedef struct
+{
+	UberLineGraph *graph;   /* Graph being rendered. */
+	GArray        *points;  /* Y position of every point of every path. */
+	GArray        *offsets; /* Offset of each path within points, then the end. */
+	GArray        *batches; /* LineBatch of consecutive lines sharing a style. */
+	guint          epoch;   /* X position of the first point of each path. */
+	gfloat         each;    /* Space between points. */
+} LinePlan;
+
+typedef struct
+{
+	LinePlan        *plan;    /* Plan being rendered. */
+	guint            first;   /* First batch to render. */
+	guint            last;    /* Batch after the last to render. */
+	GdkRectangle     area;    /* Area covered by surface. */
+	cairo_surface_t *surface; /* Private surface of the group. */
+} LineGroup;
+
 struct _UberLineGraphPrivate
 {
 	GArray            *lines;
 	cairo_antialias_t  antialias;
 	guint              stride;
 	gboolean           autoscale;
+	UberAutoscale     *policy;
 	UberRange          range;
 	UberScale          scale;
 	gpointer           scale_data;
@@ -68,6 +124,19 @@ struct _UberLineGraphPrivate
 	UberLineGraphFunc  func;
 	gpointer           func_data;
 	GDestroyNotify     func_notify;
+	gboolean           envelope;                 /* Render lines as an envelope. */
+	GdkColor           env_color;                /* Color of the envelope. */
+	gdouble            env_low;                  /* Percentile of the inner band bottom. */
+	gdouble            env_high;                 /* Percentile of the inner band top. */
+	GRing             *env_rings[ENVELOPE_LAST]; /* Aggregates of each sample. */
+	GArray            *samples;                  /* Latest value of each line. */
+	GArray            *sorted;                   /* Scratch space for aggregation. */
+	guint              n_outliers;               /* Number of outliers to highlight. */
+	guint              n_found;                  /* Number of outliers found. */
+	guint             *outliers;                 /* Lines furthest from the median. */
+	volatile gpointer  pushed;                   /* Stack of pushed PushBatch. */
+	gboolean           has_pushed;               /* Have values been pushed. */
+	guint              push_tick;                /* Ticks that consumed values. */
 };
 
 /**
@@ -204,6 +273,33 @@ uber_line_graph_get_autoscale (UberLineGraph *graph) /* IN */
 	return graph->priv->autoscale;
 }
 
+/**
+ * uber_line_graph_set_autoscale_policy:
+ * @graph: A #UberLineGraph.
+ * @headroom: The fraction of the largest value kept free above it.
+ * @hysteresis: The additional fraction which must be free to shrink.
+ * @interval: The minimum number of seconds between shrinking the range.
+ *
+ * Sets how the range autoscales.  New values outside of the range grow it
+ * to the next step of 1, 2 or 5 times a power of ten with @headroom to
+ * spare.  The range only shrinks once every @interval seconds at most, and
+ * only if @headroom plus @hysteresis would be left free.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_line_graph_set_autoscale_policy (UberLineGraph *graph,      /* IN */
+                                      gdouble        headroom,   /* IN */
+                                      gdouble        hysteresis, /* IN */
+                                      gdouble        interval)   /* IN */
+{
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+
+	uber_autoscale_set_policy(graph->priv->policy, headroom, hysteresis,
+	                          interval);
+}
+
 /**
  * uber_line_graph_add_line:
  * @graph: A #UberLineGraph.
@@ -304,6 +400,332 @@ uber_line_graph_get_antialias (UberLineGraph *graph) /* IN */
 	return graph->priv->antialias;
 }
 
+/**
+ * uber_line_graph_select:
+ * @values: An array of values.
+ * @begin: The first index to consider.
+ * @end: The last index to consider.
+ * @k: The index to select, between @begin and @end.
+ *
+ * Reorders @values between @begin and @end so that the value at @k is the
+ * one that would be there if they were sorted, with no larger values
+ * before it and no smaller values after it.
+ *
+ * Returns: The value at @k.
+ * Side effects: @values is reordered.
+ */
+static gdouble
+uber_line_graph_select (gdouble *values, /* IN/OUT */
+                        gint     begin,  /* IN */
+                        gint     end,    /* IN */
+                        gint     k)      /* IN */
+{
+	gdouble pivot;
+	gdouble tmp;
+	gint i;
+	gint j;
+
+	while (begin < end) {
+		pivot = values[begin + ((end - begin) / 2)];
+		i = begin;
+		j = end;
+		while (i <= j) {
+			while (values[i] < pivot) {
+				i++;
+			}
+			while (values[j] > pivot) {
+				j--;
+			}
+			if (i <= j) {
+				tmp = values[i];
+				values[i] = values[j];
+				values[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+		if (k <= j) {
+			end = j;
+		} else if (k >= i) {
+			begin = i;
+		} else {
+			break;
+		}
+	}
+	return values[k];
+}
+
+/**
+ * uber_line_graph_aggregate:
+ * @graph: A #UberLineGraph.
+ *
+ * Aggregates the latest value of each line, found in the samples array,
+ * into the envelope.  The minimum and maximum are found with a single
+ * pass over the values and the median and percentiles by selection, so
+ * the cost is linear in the number of lines.  The distance of each line
+ * from the median is tracked so that the lines straying furthest from the
+ * rest may be highlighted.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_aggregate (UberLineGraph *graph) /* IN */
+{
+	UberLineGraphPrivate *priv;
+	gdouble env[ENVELOPE_LAST];
+	gdouble *samples;
+	gdouble *sorted;
+	LineInfo *line;
+	gdouble val;
+	guint n = 0;
+	guint i;
+	guint j;
+	gint mid;
+
+	priv = graph->priv;
+	samples = (gdouble *)priv->samples->data;
+	g_array_set_size(priv->sorted, priv->samples->len);
+	sorted = (gdouble *)priv->sorted->data;
+	for (i = 0; i < priv->samples->len; i++) {
+		if (!isnan(samples[i]) && !isinf(samples[i])) {
+			sorted[n++] = samples[i];
+		}
+	}
+	if (!n) {
+		for (i = 0; i < ENVELOPE_LAST; i++) {
+			val = -INFINITY;
+			g_ring_append_val(priv->env_rings[i], val);
+		}
+		return;
+	}
+	env[ENVELOPE_MIN] = sorted[0];
+	env[ENVELOPE_MAX] = sorted[0];
+	for (i = 1; i < n; i++) {
+		env[ENVELOPE_MIN] = MIN(env[ENVELOPE_MIN], sorted[i]);
+		env[ENVELOPE_MAX] = MAX(env[ENVELOPE_MAX], sorted[i]);
+	}
+	/*
+	 * Once the median is selected, lower percentiles lie before it and
+	 * higher percentiles after it.
+	 */
+	mid = (n - 1) / 2;
+	env[ENVELOPE_MEDIAN] = uber_line_graph_select(sorted, 0, n - 1, mid);
+	env[ENVELOPE_LOW] =
+		uber_line_graph_select(sorted, 0, mid,
+		                       floor((priv->env_low / 100.) * (n - 1) + .5));
+	env[ENVELOPE_HIGH] =
+		uber_line_graph_select(sorted, mid, n - 1,
+		                       floor((priv->env_high / 100.) * (n - 1) + .5));
+	for (i = 0; i < ENVELOPE_LAST; i++) {
+		g_ring_append_val(priv->env_rings[i], env[i]);
+	}
+	/*
+	 * Keep the lines with the largest deviation, largest first.
+	 */
+	priv->n_found = 0;
+	for (i = 0; i < priv->lines->len; i++) {
+		line = &g_array_index(priv->lines, LineInfo, i);
+		if (!isnan(samples[i]) && !isinf(samples[i])) {
+			line->deviation = (line->deviation * ENVELOPE_DECAY) +
+			                  (fabs(samples[i] - env[ENVELOPE_MEDIAN]) *
+			                   (1. - ENVELOPE_DECAY));
+		}
+		if (!priv->n_outliers) {
+			continue;
+		}
+		for (j = priv->n_found; j > 0; j--) {
+			if (g_array_index(priv->lines, LineInfo,
+			                  priv->outliers[j - 1]).deviation >= line->deviation) {
+				break;
+			}
+			if (j < priv->n_outliers) {
+				priv->outliers[j] = priv->outliers[j - 1];
+			}
+		}
+		if (j < priv->n_outliers) {
+			priv->outliers[j] = i;
+			priv->n_found = MIN(priv->n_found + 1, priv->n_outliers);
+		}
+	}
+}
+
+/**
+ * uber_line_graph_rebuild_envelope:
+ * @graph: A #UberLineGraph.
+ *
+ * Aggregates every data point already within the lines into the envelope,
+ * oldest first, so the envelope covers the whole graph once enabled.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_rebuild_envelope (UberLineGraph *graph) /* IN */
+{
+	UberLineGraphPrivate *priv;
+	LineInfo *line;
+	guint i;
+	gint j;
+
+	priv = graph->priv;
+	for (i = 0; i < ENVELOPE_LAST; i++) {
+		uber_line_graph_init_ring(priv->env_rings[i]);
+	}
+	for (i = 0; i < priv->lines->len; i++) {
+		g_array_index(priv->lines, LineInfo, i).deviation = 0.;
+	}
+	g_array_set_size(priv->samples, priv->lines->len);
+	for (j = priv->stride - 1; j >= 0; j--) {
+		for (i = 0; i < priv->lines->len; i++) {
+			line = &g_array_index(priv->lines, LineInfo, i);
+			g_array_index(priv->samples, gdouble, i) =
+				g_ring_get_index(line->raw_data, gdouble, j);
+		}
+		uber_line_graph_aggregate(graph);
+	}
+}
+
+/**
+ * uber_line_graph_push_batch_free:
+ * @batch: A PushBatch.
+ *
+ * Frees @batch.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_push_batch_free (PushBatch *batch) /* IN */
+{
+	g_free(batch->values);
+	g_slice_free(PushBatch, batch);
+}
+
+/**
+ * uber_line_graph_steal_pushed:
+ * @graph: A #UberLineGraph.
+ *
+ * Atomically takes every batch pushed so far.
+ *
+ * Returns: The pushed batches, oldest first, which should be freed with
+ *   uber_line_graph_push_batch_free().
+ * Side effects: None.
+ */
+static PushBatch*
+uber_line_graph_steal_pushed (UberLineGraph *graph) /* IN */
+{
+	UberLineGraphPrivate *priv;
+	PushBatch *batches;
+	PushBatch *batch;
+	PushBatch *next;
+	PushBatch *head;
+
+	priv = graph->priv;
+	do {
+		head = g_atomic_pointer_get(&priv->pushed);
+	} while (head &&
+	         !g_atomic_pointer_compare_and_exchange(&priv->pushed, head, NULL));
+	/*
+	 * The stack is newest first.
+	 */
+	for (batches = NULL, batch = head; batch; batch = next) {
+		next = batch->next;
+		batch->next = batches;
+		batches = batch;
+	}
+	return batches;
+}
+
+/**
+ * uber_line_graph_push:
+ * @graph: A #UberLineGraph.
+ * @timestamp: The time of the values, such as g_get_monotonic_time().
+ * @values: The value of each line, starting with line 1.
+ * @n_values: The number of values.
+ *
+ * Pushes the next values of the lines in the graph.  This may be called
+ * from any thread, at any rate, while holding a reference on @graph; the
+ * values are queued without taking a lock and consumed on the next tick
+ * of the graph.  If several values for a line arrive within a tick, the
+ * one with the latest @timestamp is used; values of a later tick always
+ * replace it.  Until a new value is pushed, the previous one is repeated.
+ * A value of NaN leaves its line as it is, so that only some of the lines
+ * may be pushed.
+ *
+ * Lines which have never been pushed a value are still retrieved with the
+ * function set with uber_line_graph_set_data_func().
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_line_graph_push (UberLineGraph *graph,     /* IN */
+                      gint64         timestamp, /* IN */
+                      const gdouble *values,    /* IN */
+                      guint          n_values)  /* IN */
+{
+	UberLineGraphPrivate *priv;
+	PushBatch *batch;
+	gpointer head;
+
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+	g_return_if_fail(values != NULL || n_values == 0);
+
+	priv = graph->priv;
+	batch = g_slice_new(PushBatch);
+	batch->timestamp = timestamp;
+	batch->n_values = n_values;
+	batch->values = g_memdup(values, sizeof(gdouble) * n_values);
+	do {
+		head = g_atomic_pointer_get(&priv->pushed);
+		batch->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange(&priv->pushed, head, batch));
+}
+
+/**
+ * uber_line_graph_consume_pushed:
+ * @graph: A #UberLineGraph.
+ *
+ * Takes the values pushed since the last tick and stores the latest value
+ * of each line.  Timestamps are only compared between values of the same
+ * tick, so a bogus timestamp cannot hold a line at its value.
+ *
+ * Returns: %TRUE if any line has been pushed a value.
+ * Side effects: None.
+ */
+static gboolean
+uber_line_graph_consume_pushed (UberLineGraph *graph) /* IN */
+{
+	UberLineGraphPrivate *priv;
+	PushBatch *batch;
+	PushBatch *next;
+	LineInfo *line;
+	guint i;
+
+	priv = graph->priv;
+	priv->push_tick++;
+	for (batch = uber_line_graph_steal_pushed(graph); batch; batch = next) {
+		next = batch->next;
+		for (i = 0; i < batch->n_values && i < priv->lines->len; i++) {
+			if (isnan(batch->values[i])) {
+				continue;
+			}
+			line = &g_array_index(priv->lines, LineInfo, i);
+			if (line->pushed_tick != priv->push_tick ||
+			    batch->timestamp >= line->pushed_time) {
+				line->has_pushed = TRUE;
+				line->pushed = batch->values[i];
+				line->pushed_time = batch->timestamp;
+				line->pushed_tick = priv->push_tick;
+			}
+		}
+		priv->has_pushed = TRUE;
+		uber_line_graph_push_batch_free(batch);
+	}
+	return priv->has_pushed;
+}
+
 /**
  * uber_line_graph_get_next_data:
  * @graph: A #UberGraph.
@@ -319,6 +741,7 @@ uber_line_graph_get_next_data (UberGraph *graph) /* IN */
 	UberLineGraphPrivate *priv;
 	gboolean scale_changed = FALSE;
 	gboolean ret = FALSE;
+	UberRange range;
 	LineInfo *line;
 	gdouble val;
 	gint i;
@@ -326,38 +749,115 @@ uber_line_graph_get_next_data (UberGraph *graph) /* IN */
 	g_return_val_if_fail(UBER_IS_LINE_GRAPH(graph), FALSE);
 
 	priv = UBER_LINE_GRAPH(graph)->priv;
+	range = priv->range;
 	/*
-	 * Retrieve the next data point.
+	 * Retrieve the next data point, preferring pushed values.
 	 */
-	if (priv->func) {
+	if (uber_line_graph_consume_pushed(UBER_LINE_GRAPH(graph)) || priv->func) {
+		g_array_set_size(priv->samples, priv->lines->len);
 		for (i = 0; i < priv->lines->len; i++) {
 			val = 0.;
 			line = &g_array_index(priv->lines, LineInfo, i);
-			if (!(ret = priv->func(UBER_LINE_GRAPH(graph),
-			                       i + 1, &val,
-			                       priv->func_data))) {
+			if (line->has_pushed) {
+				val = line->pushed;
+				ret = TRUE;
+			} else if (!priv->func ||
+			           !(ret = priv->func(UBER_LINE_GRAPH(graph),
+			                              i + 1, &val,
+			                              priv->func_data))) {
 				val = -INFINITY;
 			}
 			g_ring_append_val(line->raw_data, val);
-			if (priv->autoscale) {
-				if (val < priv->range.begin) {
-					priv->range.begin = val - (val * SCALE_FACTOR);
-					priv->range.range = priv->range.end - priv->range.begin;
-					scale_changed = TRUE;
-				} else if (val > priv->range.end) {
-					priv->range.end = val + (val * SCALE_FACTOR);
-					priv->range.range = priv->range.end - priv->range.begin;
-					scale_changed = TRUE;
-				}
+			g_array_index(priv->samples, gdouble, i) = val;
+			if (priv->autoscale &&
+			    uber_autoscale_grow(priv->policy, &priv->range, val)) {
+				scale_changed = TRUE;
 			}
 		}
+		if (priv->envelope) {
+			uber_line_graph_aggregate(UBER_LINE_GRAPH(graph));
+		}
+		uber_graph_record(graph, &g_array_index(priv->samples, gdouble, 0),
+		                  priv->samples->len);
 	}
+	/*
+	 * Linear scales only depend on the size of the range, so the existing
+	 * foreground can be stretched until it is rendered again.
+	 */
 	if (scale_changed) {
-		uber_graph_scale_changed(graph);
+		if (priv->scale == uber_scale_linear && range.range > 0.) {
+			uber_graph_rescale(graph, range.range / priv->range.range);
+		} else {
+			uber_graph_scale_changed(graph);
+		}
 	}
 	return ret;
 }
 
+/**
+ * uber_line_graph_load:
+ * @graph: A #UberLineGraph.
+ * @timestamps: The time of each sample in microseconds, oldest first.
+ * @values: The values of each sample, @n_values per sample.
+ * @n_samples: The number of samples.
+ * @n_values: The number of values per sample, starting with line 1.
+ *
+ * Replaces the contents of the lines with history, such as the last few
+ * minutes of an existing data source.  The samples are mapped onto the
+ * data points with uber_graph_map_samples() and stored in a single pass,
+ * the range is autoscaled once to fit them and the graph is rendered once
+ * in full.  Lines beyond @n_values are cleared.
+ *
+ * Returns: None.
+ * Side effects: The graph is redrawn.
+ */
+void
+uber_line_graph_load (UberLineGraph *graph,      /* IN */
+                      const gint64  *timestamps, /* IN */
+                      const gdouble *values,     /* IN */
+                      guint          n_samples,  /* IN */
+                      guint          n_values)   /* IN */
+{
+	UberLineGraphPrivate *priv;
+	UberRange loaded = { G_MAXDOUBLE, -G_MAXDOUBLE, 0. };
+	LineInfo *line;
+	gdouble val;
+	gint *slots;
+	guint i;
+	gint k;
+
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+	g_return_if_fail(timestamps != NULL || n_samples == 0);
+	g_return_if_fail(values != NULL || n_samples == 0);
+
+	priv = graph->priv;
+	slots = g_new(gint, priv->stride);
+	uber_graph_map_samples(UBER_GRAPH(graph), timestamps, n_samples,
+	                       slots, priv->stride);
+	for (i = 0; i < priv->lines->len; i++) {
+		line = &g_array_index(priv->lines, LineInfo, i);
+		for (k = priv->stride - 1; k >= 0; k--) {
+			val = -INFINITY;
+			if (i < n_values && slots[k] >= 0) {
+				val = values[(slots[k] * n_values) + i];
+			}
+			g_ring_append_val(line->raw_data, val);
+			if (!isnan(val) && !isinf(val)) {
+				loaded.begin = MIN(loaded.begin, val);
+				loaded.end = MAX(loaded.end, val);
+			}
+		}
+	}
+	g_free(slots);
+	if (priv->autoscale && loaded.begin <= loaded.end) {
+		uber_autoscale_grow_range(priv->policy, &priv->range, &loaded);
+	}
+	if (priv->envelope) {
+		uber_line_graph_rebuild_envelope(graph);
+	}
+	uber_graph_redraw(UBER_GRAPH(graph));
+}
+
 /**
  * uber_line_graph_set_data_func:
  * @graph: A #UberLineGraph.
@@ -429,58 +929,68 @@ uber_line_graph_stylize_line (UberLineGraph *graph, /* IN */
 }
 
 /**
- * uber_line_graph_render:
- * @graph: A #UberGraph.
- * @cr: A #cairo_t context.
+ * uber_line_graph_same_style:
+ * @a: A LineInfo.
+ * @b: A LineInfo.
+ *
+ * Checks if two lines are stroked the same way, in which case they may be
+ * stroked together.
+ *
+ * Returns: %TRUE if @a and @b share a style.
+ * Side effects: None.
+ */
+static gboolean
+uber_line_graph_same_style (const LineInfo *a, /* IN */
+                            const LineInfo *b) /* IN */
+{
+	if (!gdk_color_equal(&a->color, &b->color) ||
+	    a->alpha != b->alpha ||
+	    a->width != b->width ||
+	    a->num_dashes != b->num_dashes) {
+		return FALSE;
+	}
+	if (a->dashes && b->dashes) {
+		return (a->dash_offset == b->dash_offset) &&
+		       !memcmp(a->dashes, b->dashes, sizeof(gdouble) * a->num_dashes);
+	}
+	return (a->dashes == b->dashes);
+}
+
+/**
+ * uber_line_graph_scale_ring:
+ * @graph: A #UberLineGraph.
+ * @ring: A #GRing of data points.
  * @area: Full area to render contents within.
- * @line: The line to render.
+ * @begin: The first data point to translate, 0 being the most recent.
+ * @end: The last data point to translate.
+ * @points: A #GArray to append the y positions to.
  *
- * Render a particular line to the graph.
+ * Translates data points @begin through @end of @ring into the coordinate
+ * system, stopping at the first data point which is not known.
  *
  * Returns: None.
  * Side effects: None.
  */
 static void
-uber_line_graph_render_line (UberLineGraph *graph, /* IN */
-                             cairo_t       *cr,    /* IN */
-                             GdkRectangle  *area,  /* IN */
-                             LineInfo      *line,  /* IN */
-                             guint          epoch, /* IN */
-                             gfloat         each)  /* IN */
+uber_line_graph_scale_ring (UberLineGraph *graph,  /* IN */
+                            GRing         *ring,   /* IN */
+                            GdkRectangle  *area,   /* IN */
+                            guint          begin,  /* IN */
+                            guint          end,    /* IN */
+                            GArray        *points) /* IN/OUT */
 {
 	UberLineGraphPrivate *priv;
 	UberRange pixel_range;
-	GdkRectangle vis;
-	guint x;
-	guint last_x;
-	gdouble y;
-	gdouble last_y;
 	gdouble val;
-	gint i;
-
-	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+	gdouble y;
+	gint j;
 
 	priv = graph->priv;
-	uber_graph_get_content_area(UBER_GRAPH(graph), &vis);
 	pixel_range.begin = area->y + 1;
 	pixel_range.end = area->y + area->height;
 	pixel_range.range = pixel_range.end - pixel_range.begin;
-	/*
-	 * Prepare cairo settings.
-	 */
-	uber_line_graph_stylize_line(graph, line, cr);
-	/*
-	 * Force a new path.
-	 */
-	cairo_new_path(cr);
-	/*
-	 * Draw the line contents as bezier curves.
-	 */
-	for (i = 0; i < line->raw_data->len; i++) {
-		/*
-		 * Retrieve data point.
-		 */
-		val = g_ring_get_index(line->raw_data, gdouble, i);
+	for (j = begin; j <= end && j < ring->len; j++) {
+		val = g_ring_get_index(ring, gdouble, j);
 		/*
 		 * Once we get to -INFINITY, we must be at the end of the data
 		 * sequence.  This may not always be true in the future.
@@ -488,42 +998,422 @@ uber_line_graph_render_line (UberLineGraph *graph, /* IN */
 		if (val == -INFINITY) {
 			break;
 		}
-		/*
-		 * Translate value to coordinate system.
-		 */
 		if (!priv->scale(&priv->range, &pixel_range, &val, priv->scale_data)) {
 			break;
 		}
-		/*
-		 * Calculate X/Y coordinate.
-		 */
 		y = (gint)(RECT_BOTTOM(*area) - val) - .5;
-		x = epoch - (each * i);
-		if (i == 0) {
-			/*
-			 * Just move to the right position on first entry.
-			 */
-			cairo_move_to(cr, x, y);
-			goto next;
-		} else {
+		g_array_append_val(points, y);
+	}
+}
+
+/**
+ * uber_line_graph_plan_init:
+ * @graph: A #UberLineGraph.
+ * @plan: A LinePlan to initialize.
+ * @area: Full area to render contents within.
+ * @epoch: The x position of data point @begin.
+ * @each: The space between data points.
+ * @begin: The first data point to render, 0 being the most recent.
+ * @end: The last data point to render.
+ * @indexes: The indexes of the lines to render, or %NULL for all.
+ * @n_indexes: The number of indexes.
+ *
+ * Translates data points @begin through @end of the lines into the
+ * coordinate system and groups consecutive lines sharing a style into
+ * batches.  Scaling is done here so that rendering the plan does not call
+ * back into the graph.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_plan_init (UberLineGraph *graph,     /* IN */
+                           LinePlan      *plan,      /* OUT */
+                           GdkRectangle  *area,      /* IN */
+                           guint          epoch,     /* IN */
+                           gfloat         each,      /* IN */
+                           guint          begin,     /* IN */
+                           guint          end,       /* IN */
+                           const guint   *indexes,   /* IN */
+                           guint          n_indexes) /* IN */
+{
+	UberLineGraphPrivate *priv;
+	LineBatch *batch = NULL;
+	LineInfo *line;
+	guint offset;
+	guint i;
+
+	priv = graph->priv;
+	if (!indexes) {
+		n_indexes = priv->lines->len;
+	}
+	plan->graph = graph;
+	plan->epoch = epoch;
+	plan->each = each;
+	plan->points = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	plan->offsets = g_array_sized_new(FALSE, FALSE, sizeof(guint),
+	                                  n_indexes + 1);
+	plan->batches = g_array_new(FALSE, FALSE, sizeof(LineBatch));
+	for (i = 0; i < n_indexes; i++) {
+		line = &g_array_index(priv->lines, LineInfo,
+		                      indexes ? indexes[i] : i);
+		offset = plan->points->len;
+		g_array_append_val(plan->offsets, offset);
+		uber_line_graph_scale_ring(graph, line->raw_data, area, begin, end,
+		                           plan->points);
+		if (!batch || !uber_line_graph_same_style(batch->style, line)) {
+			g_array_set_size(plan->batches, plan->batches->len + 1);
+			batch = &g_array_index(plan->batches, LineBatch,
+			                       plan->batches->len - 1);
+			batch->style = line;
+			batch->first = i;
+		}
+		batch->last = i + 1;
+	}
+	offset = plan->points->len;
+	g_array_append_val(plan->offsets, offset);
+}
+
+/**
+ * uber_line_graph_plan_destroy:
+ * @plan: A LinePlan.
+ *
+ * Releases the resources of @plan.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_plan_destroy (LinePlan *plan) /* IN */
+{
+	g_array_free(plan->points, TRUE);
+	g_array_free(plan->offsets, TRUE);
+	g_array_free(plan->batches, TRUE);
+}
+
+/**
+ * uber_line_graph_stroke_batches:
+ * @plan: A LinePlan.
+ * @cr: A #cairo_t context.
+ * @first: The first batch to stroke.
+ * @last: The batch after the last to stroke.
+ *
+ * Strokes batches @first through @last - 1 of @plan, each with a single
+ * stroke of all of its lines.  This may be called from a render worker.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_stroke_batches (LinePlan *plan,  /* IN */
+                                cairo_t  *cr,    /* IN */
+                                guint     first, /* IN */
+                                guint     last)  /* IN */
+{
+	LineBatch *batch;
+	gdouble *points;
+	guint last_x = 0;
+	guint x;
+	guint offset;
+	guint n_points;
+	guint b;
+	guint i;
+	guint j;
+
+	for (b = first; b < last; b++) {
+		batch = &g_array_index(plan->batches, LineBatch, b);
+		uber_line_graph_stylize_line(plan->graph, batch->style, cr);
+		cairo_new_path(cr);
+		for (i = batch->first; i < batch->last; i++) {
+			offset = g_array_index(plan->offsets, guint, i);
+			n_points = g_array_index(plan->offsets, guint, i + 1) - offset;
+			points = &g_array_index(plan->points, gdouble, offset);
 			/*
-			 * Draw curve to data point using the last X/Y positions as
-			 * control points.
+			 * Draw the line contents as bezier curves, using the last X/Y
+			 * positions as control points.
 			 */
+			for (j = 0; j < n_points; j++) {
+				x = plan->epoch - (plan->each * j);
+				if (j == 0) {
+					cairo_move_to(cr, x, points[j]);
+				} else {
+					cairo_curve_to(cr,
+					               last_x - (plan->each / 2.),
+					               points[j - 1],
+					               last_x - (plan->each / 2.),
+					               points[j], x, points[j]);
+				}
+				last_x = x;
+			}
+		}
+		cairo_stroke(cr);
+	}
+}
+
+/**
+ * uber_line_graph_render_group:
+ * @data: A LineGroup.
+ *
+ * Render worker callback which strokes the batches of a group into the
+ * private surface of the group.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_render_group (gpointer data) /* IN */
+{
+	LineGroup *group = data;
+	cairo_t *cr;
+
+	group->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+	                                            group->area.width,
+	                                            group->area.height);
+	cr = cairo_create(group->surface);
+	cairo_translate(cr, -group->area.x, -group->area.y);
+	uber_line_graph_stroke_batches(group->plan, cr, group->first,
+	                               group->last);
+	cairo_destroy(cr);
+}
+
+/**
+ * uber_line_graph_path_points:
+ * @cr: A #cairo_t context.
+ * @points: A #GArray of y positions, newest first.
+ * @n_points: The number of points to use.
+ * @epoch: The x position of the first point.
+ * @each: The space between points.
+ * @reverse: Should the points be added oldest first.
+ *
+ * Adds bezier curves through the points to the path of @cr, continuing
+ * the current sub-path if there is one.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_path_points (cairo_t  *cr,       /* IN */
+                             GArray   *points,   /* IN */
+                             guint     n_points, /* IN */
+                             guint     epoch,    /* IN */
+                             gfloat    each,     /* IN */
+                             gboolean  reverse)  /* IN */
+{
+	gdouble last_x = 0.;
+	gdouble last_y = 0.;
+	gdouble x;
+	gdouble y;
+	guint i;
+	guint j;
+
+	for (i = 0; i < n_points; i++) {
+		j = reverse ? n_points - 1 - i : i;
+		x = epoch - (each * j);
+		y = g_array_index(points, gdouble, j);
+		if (i > 0) {
 			cairo_curve_to(cr,
-			               last_x - (each / 2.),
-			               last_y,
-			               last_x - (each / 2.),
-			               y, x, y);
+			               (last_x + x) / 2., last_y,
+			               (last_x + x) / 2., y,
+			               x, y);
+		} else if (cairo_has_current_point(cr)) {
+			cairo_line_to(cr, x, y);
+		} else {
+			cairo_move_to(cr, x, y);
 		}
-	  next:
-		last_y = y;
 		last_x = x;
+		last_y = y;
+	}
+}
+
+/**
+ * uber_line_graph_render_envelope:
+ * @graph: A #UberLineGraph.
+ * @cr: A #cairo_t context.
+ * @area: Full area to render contents within.
+ * @epoch: The x position of data point @begin.
+ * @each: The space between data points.
+ * @begin: The first data point to render, 0 being the most recent.
+ * @end: The last data point to render.
+ *
+ * Renders data points @begin through @end of the envelope.  The range
+ * between the minimum and maximum is filled, the range between the
+ * percentiles is filled again on top, and the median is stroked over
+ * both.  Finally the outlying lines are stroked as usual.  The cost does
+ * not depend on the number of lines other than the outliers.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_render_envelope (UberLineGraph *graph, /* IN */
+                                 cairo_t       *cr,    /* IN */
+                                 GdkRectangle  *area,  /* IN */
+                                 guint          epoch, /* IN */
+                                 gfloat         each,  /* IN */
+                                 guint          begin, /* IN */
+                                 guint          end)   /* IN */
+{
+	static const struct {
+		gint    bottom;
+		gint    top;
+		gdouble alpha;
+	} bands[] = {
+		{ ENVELOPE_MIN, ENVELOPE_MAX,  .25 },
+		{ ENVELOPE_LOW, ENVELOPE_HIGH, .5 },
+	};
+	UberLineGraphPrivate *priv;
+	GArray *points[ENVELOPE_LAST];
+	LinePlan plan;
+	guint n_points = G_MAXUINT;
+	guint i;
+
+	priv = graph->priv;
+	for (i = 0; i < ENVELOPE_LAST; i++) {
+		points[i] = g_array_new(FALSE, FALSE, sizeof(gdouble));
+		uber_line_graph_scale_ring(graph, priv->env_rings[i], area,
+		                           begin, end, points[i]);
+		n_points = MIN(n_points, points[i]->len);
+	}
+	cairo_save(cr);
+	cairo_set_antialias(cr, priv->antialias);
+	if (n_points > 1) {
+		for (i = 0; i < G_N_ELEMENTS(bands); i++) {
+			cairo_new_path(cr);
+			uber_line_graph_path_points(cr, points[bands[i].top], n_points,
+			                            epoch, each, FALSE);
+			uber_line_graph_path_points(cr, points[bands[i].bottom],
+			                            n_points, epoch, each, TRUE);
+			cairo_close_path(cr);
+			cairo_set_source_rgba(cr,
+			                      priv->env_color.red / 65535.,
+			                      priv->env_color.green / 65535.,
+			                      priv->env_color.blue / 65535.,
+			                      bands[i].alpha);
+			cairo_fill(cr);
+		}
+		cairo_new_path(cr);
+		uber_line_graph_path_points(cr, points[ENVELOPE_MEDIAN], n_points,
+		                            epoch, each, FALSE);
+		cairo_set_dash(cr, NULL, 0, 0);
+		cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+		cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+		cairo_set_line_width(cr, ENVELOPE_WIDTH);
+		gdk_cairo_set_source_color(cr, &priv->env_color);
+		cairo_stroke(cr);
+	}
+	cairo_restore(cr);
+	for (i = 0; i < ENVELOPE_LAST; i++) {
+		g_array_free(points[i], TRUE);
+	}
+	if (priv->n_found) {
+		uber_line_graph_plan_init(graph, &plan, area, epoch, each, begin, end,
+		                          priv->outliers, priv->n_found);
+		uber_line_graph_stroke_batches(&plan, cr, 0, plan.batches->len);
+		uber_line_graph_plan_destroy(&plan);
+	}
+}
+
+/**
+ * uber_line_graph_render_lines:
+ * @graph: A #UberLineGraph.
+ * @cr: A #cairo_t context.
+ * @area: Full area to render contents within.
+ * @epoch: The x position of data point @begin.
+ * @each: The space between data points.
+ * @begin: The first data point to render, 0 being the most recent.
+ * @end: The last data point to render.
+ *
+ * Renders data points @begin through @end of every line.  Lines sharing a
+ * style are stroked together.  Graphs with many lines are split into
+ * groups of consecutive batches which are stroked by the render workers
+ * into private surfaces, then composited in order so lines overlap as if
+ * stroked one after another.  In envelope mode the envelope is rendered
+ * instead.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_render_lines (UberLineGraph *graph, /* IN */
+                              cairo_t       *cr,    /* IN */
+                              GdkRectangle  *area,  /* IN */
+                              guint          epoch, /* IN */
+                              gfloat         each,  /* IN */
+                              guint          begin, /* IN */
+                              guint          end)   /* IN */
+{
+	LinePlan plan;
+	LineGroup *groups;
+	LineBatch *batch;
+	gpointer *jobs;
+	gdouble x1;
+	gdouble y1;
+	gdouble x2;
+	gdouble y2;
+	guint n_groups;
+	guint n_points;
+	guint target;
+	guint count;
+	guint g;
+	guint b;
+
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+
+	if (graph->priv->envelope) {
+		uber_line_graph_render_envelope(graph, cr, area, epoch, each,
+		                                begin, end);
+		return;
+	}
+	uber_line_graph_plan_init(graph, &plan, area, epoch, each, begin, end,
+	                          NULL, 0);
+	n_groups = MIN(uber_render_worker_get_n_workers(), plan.batches->len);
+	if (graph->priv->lines->len < PARALLEL_LINES || n_groups < 2) {
+		uber_line_graph_stroke_batches(&plan, cr, 0, plan.batches->len);
+		uber_line_graph_plan_destroy(&plan);
+		return;
 	}
 	/*
-	 * Stroke the line content.
+	 * Split the batches into groups with about the same number of points.
 	 */
-	cairo_stroke(cr);
+	groups = g_new0(LineGroup, n_groups);
+	jobs = g_new0(gpointer, n_groups);
+	cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+	target = (plan.points->len + n_groups - 1) / n_groups;
+	for (g = 0, b = 0; g < n_groups; g++) {
+		groups[g].plan = &plan;
+		groups[g].first = b;
+		groups[g].area.x = floor(x1);
+		groups[g].area.y = floor(y1);
+		groups[g].area.width = MAX(ceil(x2) - groups[g].area.x, 1);
+		groups[g].area.height = MAX(ceil(y2) - groups[g].area.y, 1);
+		count = 0;
+		while (b < plan.batches->len &&
+		       (count < target || g == n_groups - 1) &&
+		       (plan.batches->len - b) > (n_groups - g - 1)) {
+			batch = &g_array_index(plan.batches, LineBatch, b);
+			n_points = g_array_index(plan.offsets, guint, batch->last)
+			         - g_array_index(plan.offsets, guint, batch->first);
+			count += MAX(n_points, 1);
+			b++;
+		}
+		groups[g].last = b;
+		jobs[g] = &groups[g];
+	}
+	uber_render_worker_run(uber_line_graph_render_group, jobs, n_groups);
+	/*
+	 * Composite the groups in z-order.
+	 */
+	cairo_save(cr);
+	for (g = 0; g < n_groups; g++) {
+		cairo_set_source_surface(cr, groups[g].surface,
+		                         groups[g].area.x, groups[g].area.y);
+		cairo_paint(cr);
+		cairo_surface_destroy(groups[g].surface);
+	}
+	cairo_restore(cr);
+	g_free(jobs);
+	g_free(groups);
+	uber_line_graph_plan_destroy(&plan);
 }
 
 /**
@@ -543,20 +1433,36 @@ uber_line_graph_render (UberGraph    *graph, /* IN */
                         gfloat        each)  /* IN */
 {
 	UberLineGraphPrivate *priv;
-	LineInfo *line;
-	gint i;
 
 	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
 
 	priv = UBER_LINE_GRAPH(graph)->priv;
-	/*
-	 * Render each line to the graph.
-	 */
-	for (i = 0; i < priv->lines->len; i++) {
-		line = &g_array_index(priv->lines, LineInfo, i);
-		uber_line_graph_render_line(UBER_LINE_GRAPH(graph), cr, rect,
-		                            line, epoch, each);
-	}
+	uber_line_graph_render_lines(UBER_LINE_GRAPH(graph), cr, rect, epoch,
+	                             each, 0, priv->stride - 1);
+}
+
+/**
+ * uber_line_graph_render_range:
+ * @graph: A #UberGraph.
+ *
+ * Render data points @begin through @end of the graph.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_line_graph_render_range (UberGraph    *graph, /* IN */
+                              cairo_t      *cr,    /* IN */
+                              GdkRectangle *rect,  /* IN */
+                              guint         epoch, /* IN */
+                              gfloat        each,  /* IN */
+                              guint         begin, /* IN */
+                              guint         end)   /* IN */
+{
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+
+	uber_line_graph_render_lines(UBER_LINE_GRAPH(graph), cr, rect, epoch,
+	                             each, begin, end);
 }
 
 /**
@@ -587,6 +1493,11 @@ uber_line_graph_render_fast (UberGraph    *graph, /* IN */
 	g_return_if_fail(rect != NULL);
 
 	priv = UBER_LINE_GRAPH(graph)->priv;
+	if (priv->envelope) {
+		uber_line_graph_render_envelope(UBER_LINE_GRAPH(graph), cr, rect,
+		                                epoch, each, 0, 1);
+		return;
+	}
 	pixel_range.begin = rect->y + 1;
 	pixel_range.end = rect->y + rect->height;
 	pixel_range.range = pixel_range.end - pixel_range.begin;
@@ -657,6 +1568,12 @@ uber_line_graph_set_stride (UberGraph *graph,  /* IN */
 
 	priv = UBER_LINE_GRAPH(graph)->priv;
 	priv->stride = stride;
+	for (i = 0; i < ENVELOPE_LAST; i++) {
+		g_ring_unref(priv->env_rings[i]);
+		priv->env_rings[i] = g_ring_sized_new(sizeof(gdouble), priv->stride,
+		                                      NULL);
+		uber_line_graph_init_ring(priv->env_rings[i]);
+	}
 	/*
 	 * TODO: Support changing stride after lines have been added.
 	 */
@@ -810,6 +1727,122 @@ uber_line_graph_set_line_width (UberLineGraph *graph, /* IN */
 	uber_graph_redraw(UBER_GRAPH(graph));
 }
 
+/**
+ * uber_line_graph_set_envelope:
+ * @graph: A #UberLineGraph.
+ * @envelope: Should the lines be rendered as an envelope.
+ * @color: The color of the envelope, or %NULL for the default.
+ *
+ * Sets if the lines are rendered as an envelope rather than one by one,
+ * which is easier to read and much cheaper to render for graphs with many
+ * lines.  For each data point, the minimum, maximum, median and the
+ * percentiles set with uber_line_graph_set_envelope_percentiles() are
+ * computed across all of the lines as they are retrieved.  The envelope is
+ * rendered as a band from the minimum to the maximum, a darker band
+ * between the percentiles and a line at the median.
+ *
+ * Returns: None.
+ * Side effects: The graph is redrawn.
+ */
+void
+uber_line_graph_set_envelope (UberLineGraph  *graph,    /* IN */
+                              gboolean        envelope, /* IN */
+                              const GdkColor *color)    /* IN */
+{
+	UberLineGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+
+	priv = graph->priv;
+	if (color) {
+		priv->env_color = *color;
+	}
+	if (envelope && !priv->envelope) {
+		uber_line_graph_rebuild_envelope(graph);
+	}
+	priv->envelope = envelope;
+	uber_graph_redraw(UBER_GRAPH(graph));
+}
+
+/**
+ * uber_line_graph_get_envelope:
+ * @graph: A #UberLineGraph.
+ *
+ * Retrieves if the lines are rendered as an envelope.
+ *
+ * Returns: %TRUE if in envelope mode.
+ * Side effects: None.
+ */
+gboolean
+uber_line_graph_get_envelope (UberLineGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_LINE_GRAPH(graph), FALSE);
+
+	return graph->priv->envelope;
+}
+
+/**
+ * uber_line_graph_set_envelope_percentiles:
+ * @graph: A #UberLineGraph.
+ * @low: The percentile of the bottom of the inner band, up to 50.
+ * @high: The percentile of the top of the inner band, from 50.
+ *
+ * Sets the percentiles the inner band of the envelope spans.  The default
+ * is the interquartile range of 25 to 75.
+ *
+ * Returns: None.
+ * Side effects: The envelope is computed again.
+ */
+void
+uber_line_graph_set_envelope_percentiles (UberLineGraph *graph, /* IN */
+                                          gdouble        low,   /* IN */
+                                          gdouble        high)  /* IN */
+{
+	UberLineGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+	g_return_if_fail(low >= 0. && low <= 50.);
+	g_return_if_fail(high >= 50. && high <= 100.);
+
+	priv = graph->priv;
+	priv->env_low = low;
+	priv->env_high = high;
+	if (priv->envelope) {
+		uber_line_graph_rebuild_envelope(graph);
+		uber_graph_redraw(UBER_GRAPH(graph));
+	}
+}
+
+/**
+ * uber_line_graph_set_envelope_outliers:
+ * @graph: A #UberLineGraph.
+ * @n_outliers: The number of outlying lines to highlight.
+ *
+ * Sets the number of lines that are still rendered on top of the envelope.
+ * These are the lines which have recently strayed furthest from the
+ * median.
+ *
+ * Returns: None.
+ * Side effects: The envelope is computed again.
+ */
+void
+uber_line_graph_set_envelope_outliers (UberLineGraph *graph,      /* IN */
+                                       guint          n_outliers) /* IN */
+{
+	UberLineGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph));
+
+	priv = graph->priv;
+	priv->outliers = g_renew(guint, priv->outliers, n_outliers);
+	priv->n_outliers = n_outliers;
+	priv->n_found = 0;
+	if (priv->envelope) {
+		uber_line_graph_rebuild_envelope(graph);
+		uber_graph_redraw(UBER_GRAPH(graph));
+	}
+}
+
 /**
  * uber_line_graph_downscale:
  * @graph: A #UberGraph.
@@ -823,6 +1856,7 @@ static gboolean
 uber_line_graph_downscale (UberGraph *graph) /* IN */
 {
 	UberLineGraphPrivate *priv;
+	UberRange values;
 	gboolean ret = FALSE;
 	gdouble val = 0;
 	gdouble cur;
@@ -850,15 +1884,12 @@ uber_line_graph_downscale (UberGraph *graph) /* IN */
 		}
 	}
 	/*
-	 * Downscale if we can.
+	 * Downscale if the autoscale policy allows.
 	 */
-	if (val != priv->range.begin) {
-		if ((val * (1. + SCALE_FACTOR)) < priv->range.end) {
-			priv->range.end = val * (1. + SCALE_FACTOR);
-			priv->range.range = priv->range.end - priv->range.begin;
-			ret = TRUE;
-		}
-	}
+	values.begin = priv->range.begin;
+	values.end = val;
+	values.range = values.end - values.begin;
+	ret = uber_autoscale_shrink(priv->policy, &priv->range, &values);
 	return ret;
 }
 
@@ -876,6 +1907,8 @@ static void
 uber_line_graph_finalize (GObject *object) /* IN */
 {
 	UberLineGraphPrivate *priv;
+	PushBatch *batch;
+	PushBatch *next;
 	LineInfo *line;
 	gint i;
 
@@ -888,6 +1921,19 @@ uber_line_graph_finalize (GObject *object) /* IN */
 		g_ring_unref(line->raw_data);
 		g_free(line->dashes);
 	}
+	for (i = 0; i < ENVELOPE_LAST; i++) {
+		g_ring_unref(priv->env_rings[i]);
+	}
+	g_array_free(priv->samples, TRUE);
+	g_array_free(priv->sorted, TRUE);
+	g_free(priv->outliers);
+	uber_autoscale_free(priv->policy);
+	for (batch = uber_line_graph_steal_pushed(UBER_LINE_GRAPH(object));
+	     batch;
+	     batch = next) {
+		next = batch->next;
+		uber_line_graph_push_batch_free(batch);
+	}
 	G_OBJECT_CLASS(uber_line_graph_parent_class)->finalize(object);
 }
 
@@ -916,6 +1962,7 @@ uber_line_graph_class_init (UberLineGraphClass *klass) /* IN */
 	graph_class->get_yrange = uber_line_graph_get_yrange;
 	graph_class->render = uber_line_graph_render;
 	graph_class->render_fast = uber_line_graph_render_fast;
+	graph_class->render_range = uber_line_graph_render_range;
 	graph_class->set_stride = uber_line_graph_set_stride;
 }
 
@@ -932,6 +1979,7 @@ static void
 uber_line_graph_init (UberLineGraph *graph) /* IN */
 {
 	UberLineGraphPrivate *priv;
+	gint i;
 
 	/*
 	 * Keep pointer to private data.
@@ -948,4 +1996,15 @@ uber_line_graph_init (UberLineGraph *graph) /* IN */
 	priv->lines = g_array_sized_new(FALSE, FALSE, sizeof(LineInfo), 2);
 	priv->scale = uber_scale_linear;
 	priv->autoscale = TRUE;
+	priv->policy = uber_autoscale_new();
+	priv->samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	priv->sorted = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	priv->env_low = 25.;
+	priv->env_high = 75.;
+	gdk_color_parse("#729fcf", &priv->env_color);
+	for (i = 0; i < ENVELOPE_LAST; i++) {
+		priv->env_rings[i] = g_ring_sized_new(sizeof(gdouble), priv->stride,
+		                                      NULL);
+		uber_line_graph_init_ring(priv->env_rings[i]);
+	}
 }
@@ -72,6 +72,15 @@ gint              uber_line_graph_add_line       (UberLineGraph     *graph,
 cairo_antialias_t uber_line_graph_get_antialias  (UberLineGraph     *graph);
 GType             uber_line_graph_get_type       (void) G_GNUC_CONST;
 GtkWidget*        uber_line_graph_new            (void);
+void              uber_line_graph_load           (UberLineGraph     *graph,
+                                                  const gint64      *timestamps,
+                                                  const gdouble     *values,
+                                                  guint              n_samples,
+                                                  guint              n_values);
+void              uber_line_graph_push           (UberLineGraph     *graph,
+                                                  gint64             timestamp,
+                                                  const gdouble     *values,
+                                                  guint              n_values);
 void              uber_line_graph_set_antialias  (UberLineGraph     *graph,
                                                   cairo_antialias_t  antialias);
 void              uber_line_graph_set_data_func  (UberLineGraph     *graph,
@@ -81,8 +90,24 @@ void              uber_line_graph_set_data_func  (UberLineGraph     *graph,
 gboolean          uber_line_graph_get_autoscale  (UberLineGraph     *graph);
 void              uber_line_graph_set_autoscale  (UberLineGraph     *graph,
                                                   gboolean           autoscale);
+void              uber_line_graph_set_autoscale_policy
+                                                 (UberLineGraph     *graph,
+                                                  gdouble            headroom,
+                                                  gdouble            hysteresis,
+                                                  gdouble            interval);
 void              uber_line_graph_set_range      (UberLineGraph     *graph,
                                                   const UberRange   *range);
+gboolean          uber_line_graph_get_envelope   (UberLineGraph     *graph);
+void              uber_line_graph_set_envelope   (UberLineGraph     *graph,
+                                                  gboolean           envelope,
+                                                  const GdkColor    *color);
+void              uber_line_graph_set_envelope_percentiles
+                                                 (UberLineGraph     *graph,
+                                                  gdouble            low,
+                                                  gdouble            high);
+void              uber_line_graph_set_envelope_outliers
+                                                 (UberLineGraph     *graph,
+                                                  guint              n_outliers);
 void              uber_line_graph_set_line_dash  (UberLineGraph     *graph,
                                                   guint              line,
                                                   const gdouble     *dashes,
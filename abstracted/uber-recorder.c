@@ -0,0 +1,269 @@
+/* uber-recorder.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "uber-recorder.h"
+
+/*
+ * Bytes of samples between index records.  The log is also flushed at
+ * each index so that little is lost if the process dies.
+ */
+#define INDEX_INTERVAL (1 << 16)
+
+/**
+ * SECTION:uber-recorder
+ * @title: UberRecorder
+ * @short_description: Append-only log of graph samples.
+ *
+ * Each graph which records is given a series with
+ * uber_recorder_add_series(), and writes every sample it retrieves with
+ * uber_recorder_write(), normally through uber_graph_set_recorder().
+ * Records are written in the byte order of the machine and buffered.
+ *
+ * Every %INDEX_INTERVAL bytes an index record is written which repeats the
+ * name of every series and links to the previous index, so that a replay
+ * can start from the middle of a log without reading what came before.
+ * The last index is linked from the end record written when the log is
+ * closed; logs of processes which died may be played from the start.
+ */
+
+struct _UberRecorder
+{
+	FILE      *stream;     /* Log being written. */
+	gchar     *filename;   /* Name of the log. */
+	GPtrArray *names;      /* Name of each series, less one. */
+	gint64     last_index; /* Offset of the last index, or -1. */
+	glong      offset;     /* Offset of the end of the log. */
+	glong      unindexed;  /* Bytes written since the last index. */
+	gboolean   failed;     /* Has a write failed. */
+};
+
+/**
+ * uber_recorder_write_record:
+ * @recorder: An #UberRecorder.
+ * @type: The #UberRecordType.
+ * @series: The id of the series, or 0.
+ * @time: The time of the record.
+ * @payload: The payload.
+ * @length: The length of @payload in bytes.
+ *
+ * Writes a record to the log.  A failure is reported once and stops
+ * further recording.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_recorder_write_record (UberRecorder  *recorder, /* IN */
+                            guint          type,     /* IN */
+                            guint          series,   /* IN */
+                            gint64         time,     /* IN */
+                            gconstpointer  payload,  /* IN */
+                            guint          length)   /* IN */
+{
+	UberRecordHeader header = { 0 };
+
+	if (recorder->failed) {
+		return;
+	}
+	header.type = type;
+	header.series = series;
+	header.time = time;
+	header.length = length;
+	if (fwrite(&header, sizeof(header), 1, recorder->stream) != 1 ||
+	    (length && fwrite(payload, length, 1, recorder->stream) != 1)) {
+		g_warning("Failed to write \"%s\": %s", recorder->filename,
+		          g_strerror(errno));
+		recorder->failed = TRUE;
+		return;
+	}
+	recorder->offset += sizeof(header) + length;
+	recorder->unindexed += sizeof(header) + length;
+}
+
+/**
+ * uber_recorder_write_index:
+ * @recorder: An #UberRecorder.
+ * @time: The time of the next sample.
+ *
+ * Writes an index record with the name of every series and flushes the
+ * log.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_recorder_write_index (UberRecorder *recorder, /* IN */
+                           gint64        time)     /* IN */
+{
+	GByteArray *payload;
+	const gchar *name;
+	guint32 len;
+	gint64 offset;
+	guint i;
+
+	payload = g_byte_array_new();
+	g_byte_array_append(payload, (guint8 *)&recorder->last_index,
+	                    sizeof(recorder->last_index));
+	for (i = 0; i < recorder->names->len; i++) {
+		name = g_ptr_array_index(recorder->names, i);
+		len = strlen(name);
+		g_byte_array_append(payload, (guint8 *)&len, sizeof(len));
+		g_byte_array_append(payload, (const guint8 *)name, len);
+	}
+	offset = recorder->offset;
+	uber_recorder_write_record(recorder, UBER_RECORD_INDEX, 0, time,
+	                           payload->data, payload->len);
+	g_byte_array_free(payload, TRUE);
+	recorder->last_index = offset;
+	recorder->unindexed = 0;
+	fflush(recorder->stream);
+}
+
+/**
+ * uber_recorder_new:
+ * @filename: The log to write, which is replaced.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Creates a new #UberRecorder writing to @filename.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_recorder_free(), or %NULL and @error is set.
+ * Side effects: @filename is created.
+ */
+UberRecorder*
+uber_recorder_new (const gchar  *filename, /* IN */
+                   GError      **error)    /* OUT */
+{
+	UberRecorder *recorder;
+	guint32 prologue[2] = { UBER_RECORD_VERSION, UBER_RECORD_BYTE_ORDER };
+	FILE *stream;
+
+	g_return_val_if_fail(filename != NULL, NULL);
+
+	if (!(stream = fopen(filename, "wb"))) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to open \"%s\": %s", filename, g_strerror(errno));
+		return NULL;
+	}
+	if (fwrite(UBER_RECORD_MAGIC, sizeof(UBER_RECORD_MAGIC), 1, stream) != 1 ||
+	    fwrite(prologue, sizeof(prologue), 1, stream) != 1) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to write \"%s\": %s", filename, g_strerror(errno));
+		fclose(stream);
+		return NULL;
+	}
+	recorder = g_slice_new0(UberRecorder);
+	recorder->stream = stream;
+	recorder->filename = g_strdup(filename);
+	recorder->names = g_ptr_array_new_with_free_func(g_free);
+	recorder->last_index = -1;
+	recorder->offset = sizeof(UBER_RECORD_MAGIC) + sizeof(prologue);
+	return recorder;
+}
+
+/**
+ * uber_recorder_free:
+ * @recorder: An #UberRecorder.
+ *
+ * Writes the end record, closes the log and frees @recorder.  Graphs
+ * recording to @recorder must be given another recorder first.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_recorder_free (UberRecorder *recorder) /* IN */
+{
+	g_return_if_fail(recorder != NULL);
+
+	uber_recorder_write_record(recorder, UBER_RECORD_END, 0,
+	                           g_get_real_time(), &recorder->last_index,
+	                           sizeof(recorder->last_index));
+	if (fclose(recorder->stream) != 0 && !recorder->failed) {
+		g_warning("Failed to write \"%s\": %s", recorder->filename,
+		          g_strerror(errno));
+	}
+	g_ptr_array_free(recorder->names, TRUE);
+	g_free(recorder->filename);
+	g_slice_free(UberRecorder, recorder);
+}
+
+/**
+ * uber_recorder_add_series:
+ * @recorder: An #UberRecorder.
+ * @name: The name of the series, used to match it up on replay.
+ *
+ * Adds a series to the log.
+ *
+ * Returns: The id of the series, starting from 1.
+ * Side effects: None.
+ */
+guint
+uber_recorder_add_series (UberRecorder *recorder, /* IN */
+                          const gchar  *name)     /* IN */
+{
+	g_return_val_if_fail(recorder != NULL, 0);
+	g_return_val_if_fail(name != NULL, 0);
+
+	g_ptr_array_add(recorder->names, g_strdup(name));
+	uber_recorder_write_record(recorder, UBER_RECORD_SERIES,
+	                           recorder->names->len, g_get_real_time(),
+	                           name, strlen(name));
+	return recorder->names->len;
+}
+
+/**
+ * uber_recorder_write:
+ * @recorder: An #UberRecorder.
+ * @series: The id of the series.
+ * @values: The values of the sample.
+ * @n_values: The number of values.
+ *
+ * Appends a sample of @series to the log, timestamped with the current
+ * wall-clock time.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_recorder_write (UberRecorder  *recorder, /* IN */
+                     guint          series,   /* IN */
+                     const gdouble *values,   /* IN */
+                     guint          n_values) /* IN */
+{
+	gint64 now;
+
+	g_return_if_fail(recorder != NULL);
+	g_return_if_fail(series > 0 && series <= recorder->names->len);
+	g_return_if_fail(values != NULL || n_values == 0);
+
+	now = g_get_real_time();
+	if (recorder->unindexed >= INDEX_INTERVAL) {
+		uber_recorder_write_index(recorder, now);
+	}
+	uber_recorder_write_record(recorder, UBER_RECORD_SAMPLE, series, now,
+	                           values, n_values * sizeof(gdouble));
+}
@@ -0,0 +1,96 @@
+/* uber-recorder.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_RECORDER_H__
+#define __UBER_RECORDER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Start of every log, followed by a guint32 version and a guint32 of
+ * UBER_RECORD_BYTE_ORDER in the byte order of the machine which wrote it.
+ */
+#define UBER_RECORD_MAGIC      "UBERREC"
+#define UBER_RECORD_VERSION    (1)
+#define UBER_RECORD_BYTE_ORDER (0x01020304)
+
+/**
+ * UberRecordType:
+ * @UBER_RECORD_SERIES: Names a series.  The payload is the name.
+ * @UBER_RECORD_SAMPLE: A sample delivered to a graph.  The payload is an
+ *   array of gdouble; the value of each line of a line graph, or the
+ *   values given to a scatter or heat map.
+ * @UBER_RECORD_INDEX: Written periodically before a sample.  The payload
+ *   is the gint64 offset of the previous index, or -1, followed by the
+ *   name of every series so far as a guint32 length and the name.
+ * @UBER_RECORD_END: Written when the log is closed.  The payload is the
+ *   gint64 offset of the last index, or -1.
+ *
+ * #UberRecordType is the type of a record within a log.
+ */
+typedef enum
+{
+	UBER_RECORD_SERIES = 1,
+	UBER_RECORD_SAMPLE,
+	UBER_RECORD_INDEX,
+	UBER_RECORD_END,
+} UberRecordType;
+
+/**
+ * UberRecordHeader:
+ * @type: The #UberRecordType.
+ * @series: The id of the series, or 0.
+ * @time: The wall-clock time in microseconds, as from g_get_real_time().
+ * @length: The length of the payload in bytes.
+ * @reserved: Zero.
+ *
+ * #UberRecordHeader starts every record of a log and is followed by its
+ * payload.
+ */
+typedef struct
+{
+	guint32 type;
+	guint32 series;
+	gint64  time;
+	guint32 length;
+	guint32 reserved;
+} UberRecordHeader;
+
+/**
+ * UberRecorder:
+ *
+ * #UberRecorder appends every sample delivered to a set of graphs to a
+ * binary log which can be played back with #UberReplay.
+ */
+typedef struct _UberRecorder UberRecorder;
+
+UberRecorder* uber_recorder_new        (const gchar    *filename,
+                                        GError        **error);
+void          uber_recorder_free       (UberRecorder   *recorder);
+guint         uber_recorder_add_series (UberRecorder   *recorder,
+                                        const gchar    *name);
+void          uber_recorder_write      (UberRecorder   *recorder,
+                                        guint           series,
+                                        const gdouble  *values,
+                                        guint           n_values);
+
+G_END_DECLS
+
+#endif /* __UBER_RECORDER_H__ */
@@ -0,0 +1,622 @@
+/* uber-replay.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "uber-heat-map.h"
+#include "uber-line-graph.h"
+#include "uber-recorder.h"
+#include "uber-replay.h"
+#include "uber-scatter.h"
+
+/*
+ * Milliseconds between deliveries when playing at a given speed, and the
+ * samples delivered per main loop iteration when playing as fast as
+ * possible.
+ */
+#define TICK_MSEC  (10)
+#define FAST_BATCH (64)
+
+/**
+ * SECTION:uber-replay
+ * @title: UberReplay
+ * @short_description: Playback of logs written by UberRecorder.
+ *
+ * Graphs are attached to the series of the same name within the log.
+ * Attached graphs stop retrieving data points on their own; each recorded
+ * sample is added as exactly one data point with
+ * uber_graph_add_data_point(), whatever the speed.  Samples of line graphs
+ * are given to uber_line_graph_push() first, so they take precedence over
+ * the data function of the graph; scatters and heat maps are given a data
+ * function which returns the values of the sample being played.
+ *
+ * Samples are delivered from the main loop, paced by the time they were
+ * recorded scaled by the speed, or as fast as the main loop allows.
+ * Playback may start from the middle of a log with uber_replay_seek(),
+ * which follows the index records back from the end of the log.
+ */
+
+struct _UberReplay
+{
+	FILE             *stream;      /* Log being played. */
+	gchar            *filename;    /* Name of the log. */
+	glong             data_start;  /* Offset of the first record. */
+	GPtrArray        *names;       /* Name of each series, less one. */
+	GHashTable       *targets;     /* Map of name to UberReplayTarget. */
+	gdouble           speed;       /* Speed, or 0 for as fast as possible. */
+	guint             handler;     /* Source delivering samples. */
+	gint64            start_time;  /* Recorded time playback started at. */
+	gint64            start_clock; /* Monotonic time playback started. */
+	UberRecordHeader  next;        /* Header of the next record. */
+	GByteArray       *payload;     /* Payload of the next record. */
+	gboolean          has_next;    /* Has the next record been read. */
+	gboolean          finished;    /* Has the end of the log been reached. */
+};
+
+typedef struct
+{
+	gint       ref_count; /* Held by the replay and a data function. */
+	UberGraph *graph;     /* Graph played into, or NULL once released. */
+	GArray    *pending;   /* Values of the data point being added. */
+} UberReplayTarget;
+
+/**
+ * uber_replay_target_unref:
+ * @data: An #UberReplayTarget.
+ *
+ * Drops a reference on @data, freeing it once there are none.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_replay_target_unref (gpointer data) /* IN */
+{
+	UberReplayTarget *target = data;
+
+	if (--target->ref_count == 0) {
+		g_array_unref(target->pending);
+		g_slice_free(UberReplayTarget, target);
+	}
+}
+
+/**
+ * uber_replay_take_pending:
+ * @target: An #UberReplayTarget.
+ *
+ * Takes the values of the sample being played into @target.
+ *
+ * Returns: A #GArray of gdouble owned by the caller.
+ * Side effects: None.
+ */
+static GArray*
+uber_replay_take_pending (UberReplayTarget *target) /* IN */
+{
+	GArray *values;
+
+	values = target->pending;
+	target->pending = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	return values;
+}
+
+/**
+ * uber_replay_scatter_func:
+ * @scatter: An #UberScatter.
+ * @values: A location for the values.
+ * @user_data: An #UberReplayTarget.
+ *
+ * Data function of scatters attached to a replay.
+ *
+ * Returns: %TRUE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_replay_scatter_func (UberScatter  *scatter,   /* IN */
+                          GArray      **values,    /* OUT */
+                          gpointer      user_data) /* IN */
+{
+	*values = uber_replay_take_pending(user_data);
+	return TRUE;
+}
+
+/**
+ * uber_replay_heat_map_func:
+ * @map: An #UberHeatMap.
+ * @values: A location for the values.
+ * @user_data: An #UberReplayTarget.
+ *
+ * Data function of heat maps attached to a replay.
+ *
+ * Returns: %TRUE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_replay_heat_map_func (UberHeatMap  *map,       /* IN */
+                           GArray      **values,    /* OUT */
+                           gpointer      user_data) /* IN */
+{
+	*values = uber_replay_take_pending(user_data);
+	return TRUE;
+}
+
+/**
+ * uber_replay_release_target:
+ * @key: The name of the series.
+ * @value: An #UberReplayTarget.
+ * @user_data: Unused.
+ *
+ * Gives the graph of a target back its own data points.  The reference on
+ * the graph is dropped here rather than with the target, since the data
+ * function of the graph may hold the target.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_replay_release_target (gpointer key,       /* IN */
+                            gpointer value,     /* IN */
+                            gpointer user_data) /* IN */
+{
+	UberReplayTarget *target = value;
+
+	uber_graph_set_external_data(target->graph, FALSE);
+	g_object_unref(target->graph);
+	target->graph = NULL;
+}
+
+/**
+ * uber_replay_new:
+ * @filename: The log to play.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Creates a new #UberReplay of @filename, positioned at its start and
+ * playing at the speed it was recorded.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_replay_free(), or %NULL and @error is set.
+ * Side effects: None.
+ */
+UberReplay*
+uber_replay_new (const gchar  *filename, /* IN */
+                 GError      **error)    /* OUT */
+{
+	UberReplay *replay;
+	gchar magic[sizeof(UBER_RECORD_MAGIC)];
+	guint32 prologue[2];
+	FILE *stream;
+
+	g_return_val_if_fail(filename != NULL, NULL);
+
+	if (!(stream = fopen(filename, "rb"))) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to open \"%s\": %s", filename, g_strerror(errno));
+		return NULL;
+	}
+	if (fread(magic, sizeof(magic), 1, stream) != 1 ||
+	    fread(prologue, sizeof(prologue), 1, stream) != 1 ||
+	    memcmp(magic, UBER_RECORD_MAGIC, sizeof(magic)) != 0 ||
+	    prologue[0] != UBER_RECORD_VERSION) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		            "\"%s\" is not a recording", filename);
+		fclose(stream);
+		return NULL;
+	}
+	if (prologue[1] != UBER_RECORD_BYTE_ORDER) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		            "\"%s\" was recorded with another byte order", filename);
+		fclose(stream);
+		return NULL;
+	}
+	replay = g_slice_new0(UberReplay);
+	replay->stream = stream;
+	replay->filename = g_strdup(filename);
+	replay->data_start = ftell(stream);
+	replay->names = g_ptr_array_new_with_free_func(g_free);
+	replay->targets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                        uber_replay_target_unref);
+	replay->speed = 1.;
+	replay->start_time = -1;
+	replay->payload = g_byte_array_new();
+	return replay;
+}
+
+/**
+ * uber_replay_free:
+ * @replay: An #UberReplay.
+ *
+ * Stops playback and frees @replay.  Attached graphs retrieve their own
+ * data points again; scatters and heat maps return empty data points until
+ * given another data function.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_replay_free (UberReplay *replay) /* IN */
+{
+	g_return_if_fail(replay != NULL);
+
+	if (replay->handler) {
+		g_source_remove(replay->handler);
+	}
+	fclose(replay->stream);
+	g_hash_table_foreach(replay->targets, uber_replay_release_target, NULL);
+	g_hash_table_destroy(replay->targets);
+	g_ptr_array_free(replay->names, TRUE);
+	g_byte_array_free(replay->payload, TRUE);
+	g_free(replay->filename);
+	g_slice_free(UberReplay, replay);
+}
+
+/**
+ * uber_replay_attach:
+ * @replay: An #UberReplay.
+ * @name: The name of a series within the log.
+ * @graph: An #UberLineGraph, #UberScatter or #UberHeatMap.
+ *
+ * Plays the samples of the series @name into @graph, one data point per
+ * sample.  The series should have been recorded from a graph of the same
+ * type, and for line graphs, the same lines.
+ *
+ * Returns: None.
+ * Side effects: @graph stops retrieving its own data points, and the data
+ *   function of scatters and heat maps is replaced.
+ */
+void
+uber_replay_attach (UberReplay  *replay, /* IN */
+                    const gchar *name,   /* IN */
+                    UberGraph   *graph)  /* IN */
+{
+	UberReplayTarget *target;
+	UberReplayTarget *old;
+
+	g_return_if_fail(replay != NULL);
+	g_return_if_fail(name != NULL);
+	g_return_if_fail(UBER_IS_LINE_GRAPH(graph) ||
+	                 UBER_IS_SCATTER(graph) ||
+	                 UBER_IS_HEAT_MAP(graph));
+
+	if ((old = g_hash_table_lookup(replay->targets, name))) {
+		uber_replay_release_target(NULL, old, NULL);
+	}
+	target = g_slice_new0(UberReplayTarget);
+	target->ref_count = 1;
+	target->pending = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	target->graph = g_object_ref(graph);
+	uber_graph_set_external_data(graph, TRUE);
+	if (UBER_IS_SCATTER(graph)) {
+		target->ref_count++;
+		uber_scatter_set_data_func(UBER_SCATTER(graph),
+		                           uber_replay_scatter_func, target,
+		                           uber_replay_target_unref);
+	} else if (UBER_IS_HEAT_MAP(graph)) {
+		target->ref_count++;
+		uber_heat_map_set_data_func(UBER_HEAT_MAP(graph),
+		                            uber_replay_heat_map_func, target,
+		                            uber_replay_target_unref);
+	}
+	g_hash_table_replace(replay->targets, g_strdup(name), target);
+}
+
+/**
+ * uber_replay_set_speed:
+ * @replay: An #UberReplay.
+ * @speed: The speed relative to the recording, or 0 to play as fast as
+ *   possible.
+ *
+ * Sets the speed of playback.  This should be called before
+ * uber_replay_start().
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_replay_set_speed (UberReplay *replay, /* IN */
+                       gdouble     speed)  /* IN */
+{
+	g_return_if_fail(replay != NULL);
+	g_return_if_fail(speed >= 0.);
+
+	replay->speed = speed;
+}
+
+/**
+ * uber_replay_read:
+ * @replay: An #UberReplay.
+ *
+ * Reads the next record of the log.
+ *
+ * Returns: %TRUE if a record was read; otherwise %FALSE at the end of the
+ *   log.
+ * Side effects: None.
+ */
+static gboolean
+uber_replay_read (UberReplay *replay) /* IN */
+{
+	if (fread(&replay->next, sizeof(replay->next), 1, replay->stream) != 1) {
+		return FALSE;
+	}
+	g_byte_array_set_size(replay->payload, replay->next.length);
+	if (replay->next.length &&
+	    fread(replay->payload->data, replay->next.length, 1,
+	          replay->stream) != 1) {
+		return FALSE;
+	}
+	return replay->next.type != UBER_RECORD_END;
+}
+
+/**
+ * uber_replay_set_name:
+ * @replay: An #UberReplay.
+ * @series: The id of a series.
+ * @name: The name of the series.
+ * @len: The length of @name.
+ *
+ * Stores the name of @series.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_replay_set_name (UberReplay   *replay, /* IN */
+                      guint         series, /* IN */
+                      const guint8 *name,   /* IN */
+                      guint         len)    /* IN */
+{
+	if (series == 0) {
+		return;
+	}
+	if (replay->names->len < series) {
+		g_ptr_array_set_size(replay->names, series);
+	}
+	g_free(g_ptr_array_index(replay->names, series - 1));
+	g_ptr_array_index(replay->names, series - 1) =
+		g_strndup((const gchar *)name, len);
+}
+
+/**
+ * uber_replay_load_index:
+ * @replay: An #UberReplay.
+ * @prev: A location for the offset of the previous index.
+ *
+ * Loads the name of every series from the index record just read.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_replay_load_index (UberReplay *replay, /* IN */
+                        gint64     *prev)   /* OUT */
+{
+	const guint8 *data = replay->payload->data;
+	guint length = replay->payload->len;
+	guint pos = sizeof(gint64);
+	guint32 len;
+	guint series = 0;
+
+	*prev = -1;
+	if (length < sizeof(gint64)) {
+		return;
+	}
+	memcpy(prev, data, sizeof(gint64));
+	while (pos + sizeof(len) <= length) {
+		memcpy(&len, data + pos, sizeof(len));
+		pos += sizeof(len);
+		if (len > length - pos) {
+			break;
+		}
+		uber_replay_set_name(replay, ++series, data + pos, len);
+		pos += len;
+	}
+}
+
+/**
+ * uber_replay_deliver:
+ * @replay: An #UberReplay.
+ *
+ * Adds the sample record just read as the next data point of its graph,
+ * if one is attached.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_replay_deliver (UberReplay *replay) /* IN */
+{
+	UberReplayTarget *target;
+	const gchar *name;
+	const gdouble *values;
+	guint n_values;
+
+	if (replay->next.series == 0 || replay->next.series > replay->names->len) {
+		return;
+	}
+	name = g_ptr_array_index(replay->names, replay->next.series - 1);
+	if (!name || !(target = g_hash_table_lookup(replay->targets, name))) {
+		return;
+	}
+	values = (const gdouble *)replay->payload->data;
+	n_values = replay->payload->len / sizeof(gdouble);
+	if (UBER_IS_LINE_GRAPH(target->graph)) {
+		uber_line_graph_push(UBER_LINE_GRAPH(target->graph),
+		                     g_get_monotonic_time(), values, n_values);
+	} else {
+		g_array_set_size(target->pending, 0);
+		g_array_append_vals(target->pending, values, n_values);
+	}
+	uber_graph_add_data_point(target->graph);
+}
+
+/**
+ * uber_replay_tick:
+ * @data: An #UberReplay.
+ *
+ * Delivers the samples which are due.
+ *
+ * Returns: %TRUE until the end of the log is reached.
+ * Side effects: Samples are played into attached graphs.
+ */
+static gboolean
+uber_replay_tick (gpointer data) /* IN */
+{
+	UberReplay *replay = data;
+	gint64 now;
+	gint64 prev;
+	guint n = 0;
+
+	now = g_get_monotonic_time();
+	while (TRUE) {
+		if (!replay->has_next && !uber_replay_read(replay)) {
+			replay->finished = TRUE;
+			replay->handler = 0;
+			return FALSE;
+		}
+		replay->has_next = TRUE;
+		switch ((UberRecordType)replay->next.type) {
+		case UBER_RECORD_SERIES:
+			uber_replay_set_name(replay, replay->next.series,
+			                     replay->payload->data,
+			                     replay->payload->len);
+			break;
+		case UBER_RECORD_INDEX:
+			uber_replay_load_index(replay, &prev);
+			break;
+		case UBER_RECORD_SAMPLE:
+			if (replay->start_time < 0) {
+				replay->start_time = replay->next.time;
+				replay->start_clock = now;
+			}
+			if (replay->speed > 0.) {
+				if (replay->next.time > replay->start_time +
+				    ((now - replay->start_clock) * replay->speed)) {
+					return TRUE;
+				}
+			} else if (n++ >= FAST_BATCH) {
+				return TRUE;
+			}
+			uber_replay_deliver(replay);
+			break;
+		case UBER_RECORD_END:
+		default:
+			break;
+		}
+		replay->has_next = FALSE;
+	}
+}
+
+/**
+ * uber_replay_seek:
+ * @replay: An #UberReplay.
+ * @timestamp: The recorded wall-clock time to play from.
+ *
+ * Positions @replay at the last index at or before @timestamp, or at the
+ * start of the log if there is none.  Playback is paced as if it started
+ * at @timestamp, so samples between the index and @timestamp are played
+ * at once.
+ *
+ * Returns: %TRUE if an index was found; otherwise %FALSE, such as for a
+ *   log which was not closed.
+ * Side effects: None.
+ */
+gboolean
+uber_replay_seek (UberReplay *replay,    /* IN */
+                  gint64      timestamp) /* IN */
+{
+	gint64 offset = -1;
+	gint64 prev;
+
+	g_return_val_if_fail(replay != NULL, FALSE);
+
+	replay->has_next = FALSE;
+	replay->finished = FALSE;
+	replay->start_time = timestamp;
+	replay->start_clock = g_get_monotonic_time();
+	/*
+	 * The end record holds the offset of the last index.
+	 */
+	if (fseek(replay->stream,
+	          -(glong)(sizeof(UberRecordHeader) + sizeof(gint64)),
+	          SEEK_END) == 0 &&
+	    fread(&replay->next, sizeof(replay->next), 1, replay->stream) == 1 &&
+	    replay->next.type == UBER_RECORD_END &&
+	    fread(&offset, sizeof(offset), 1, replay->stream) == 1) {
+		while (offset >= 0) {
+			if (fseek(replay->stream, offset, SEEK_SET) != 0 ||
+			    !uber_replay_read(replay) ||
+			    replay->next.type != UBER_RECORD_INDEX) {
+				offset = -1;
+				break;
+			}
+			uber_replay_load_index(replay, &prev);
+			if (replay->next.time <= timestamp) {
+				return TRUE;
+			}
+			offset = prev;
+		}
+	}
+	fseek(replay->stream, replay->data_start, SEEK_SET);
+	return FALSE;
+}
+
+/**
+ * uber_replay_start:
+ * @replay: An #UberReplay.
+ *
+ * Starts playing samples into the attached graphs from the main loop.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_replay_start (UberReplay *replay) /* IN */
+{
+	g_return_if_fail(replay != NULL);
+
+	if (replay->handler || replay->finished) {
+		return;
+	}
+	replay->start_clock = g_get_monotonic_time();
+	if (replay->speed > 0.) {
+		replay->handler = g_timeout_add(TICK_MSEC, uber_replay_tick, replay);
+	} else {
+		replay->handler = g_idle_add(uber_replay_tick, replay);
+	}
+}
+
+/**
+ * uber_replay_is_finished:
+ * @replay: An #UberReplay.
+ *
+ * Retrieves if every sample of the log has been played.
+ *
+ * Returns: %TRUE if playback has finished.
+ * Side effects: None.
+ */
+gboolean
+uber_replay_is_finished (UberReplay *replay) /* IN */
+{
+	g_return_val_if_fail(replay != NULL, FALSE);
+
+	return replay->finished;
+}
@@ -0,0 +1,48 @@
+/* uber-replay.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_REPLAY_H__
+#define __UBER_REPLAY_H__
+
+#include "uber-graph.h"
+
+G_BEGIN_DECLS
+
+/**
+ * UberReplay:
+ *
+ * #UberReplay plays a log written by #UberRecorder back into graphs.
+ */
+typedef struct _UberReplay UberReplay;
+
+UberReplay* uber_replay_new          (const gchar  *filename,
+                                      GError      **error);
+void        uber_replay_free         (UberReplay   *replay);
+void        uber_replay_attach       (UberReplay   *replay,
+                                      const gchar  *name,
+                                      UberGraph    *graph);
+void        uber_replay_set_speed    (UberReplay   *replay,
+                                      gdouble       speed);
+gboolean    uber_replay_seek         (UberReplay   *replay,
+                                      gint64        timestamp);
+void        uber_replay_start        (UberReplay   *replay);
+gboolean    uber_replay_is_finished  (UberReplay   *replay);
+
+G_END_DECLS
+
+#endif /* __UBER_REPLAY_H__ */
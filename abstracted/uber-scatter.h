@@ -54,6 +54,10 @@ struct _UberScatterClass
 
 GType      uber_scatter_get_type      (void) G_GNUC_CONST;
 GtkWidget* uber_scatter_new           (void);
+void       uber_scatter_load          (UberScatter     *scatter,
+                                       const gint64    *timestamps,
+                                       GArray         **values,
+                                       guint            n_samples);
 void       uber_scatter_set_fg_color  (UberScatter     *scatter,
                                        const GdkColor  *color);
 void       uber_scatter_set_data_func (UberScatter     *scatter,
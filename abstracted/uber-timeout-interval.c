@@ -28,36 +28,39 @@
 /* This file contains the common code to check whether an interval has
    expired used in uber-frame-source and uber-timeout-pool. */
 
+#include "uber-frame-clock.h"
 #include "uber-timeout-interval.h"
 
+#define NSEC_PER_SEC  G_GINT64_CONSTANT (1000000000)
+#define NSEC_PER_MSEC G_GINT64_CONSTANT (1000000)
+
 void
 _uber_timeout_interval_init (UberTimeoutInterval *interval,
                                 guint                   fps)
 {
-  g_get_current_time (&interval->start_time);
+  interval->start_time = uber_frame_clock_get_time ();
   interval->fps = fps;
   interval->frame_count = 0;
 }
 
-static guint
-_uber_timeout_interval_get_ticks (const GTimeVal         *current_time,
+static gint64
+_uber_timeout_interval_get_ticks (gint64                  current_time,
                                      UberTimeoutInterval *interval)
 {
-  return ((current_time->tv_sec - interval->start_time.tv_sec) * 1000
-        + (current_time->tv_usec - interval->start_time.tv_usec) / 1000);
+  return current_time - interval->start_time;
 }
 
 gboolean
-_uber_timeout_interval_prepare (const GTimeVal         *current_time,
+_uber_timeout_interval_prepare (gint64                  current_time,
                                    UberTimeoutInterval *interval,
                                    gint                   *delay)
 {
-  guint elapsed_time, new_frame_num;
+  gint64 elapsed_time, new_frame_num, next_frame_time;
 
   elapsed_time = _uber_timeout_interval_get_ticks (current_time,
                                                       interval);
   new_frame_num = elapsed_time * interval->fps
-                / 1000;
+                / NSEC_PER_SEC;
 
   /* If time has gone backwards or the time since the last frame is
      greater than the two frames worth then reset the time and do a
@@ -65,14 +68,11 @@ _uber_timeout_interval_prepare (const GTimeVal         *current_time,
   if (new_frame_num < interval->frame_count ||
       new_frame_num - interval->frame_count > 2)
     {
-      /* Get the frame time rounded up to the nearest ms */
-      guint frame_time = (1000 + interval->fps - 1) / interval->fps;
-
       /* Reset the start time */
-      interval->start_time = *current_time;
+      interval->start_time = current_time;
 
       /* Move the start time as if one whole frame has elapsed */
-      g_time_val_add (&interval->start_time, -(gint) frame_time * 1000);
+      interval->start_time -= NSEC_PER_SEC / interval->fps;
 
       interval->frame_count = 0;
 
@@ -90,9 +90,14 @@ _uber_timeout_interval_prepare (const GTimeVal         *current_time,
     }
   else
     {
+      /* Round up to the next millisecond so that we never wake up
+         before the frame is due */
+      next_frame_time = (interval->frame_count + 1) * NSEC_PER_SEC
+                      / interval->fps;
+
       if (delay)
-	*delay = ((interval->frame_count + 1) * 1000 / interval->fps
-               - elapsed_time);
+	*delay = (next_frame_time - elapsed_time + NSEC_PER_MSEC - 1)
+               / NSEC_PER_MSEC;
 
       return FALSE;
     }
@@ -117,18 +122,15 @@ gint
 _uber_timeout_interval_compare_expiration (const UberTimeoutInterval *a,
                                               const UberTimeoutInterval *b)
 {
-  guint a_delay = 1000 / a->fps;
-  guint b_delay = 1000 / b->fps;
-  glong b_difference;
-  gint comparison;
-
-  b_difference = ((a->start_time.tv_sec - b->start_time.tv_sec) * 1000
-               + (a->start_time.tv_usec - b->start_time.tv_usec) / 1000);
+  gint64 a_expiration;
+  gint64 b_expiration;
 
-  comparison = ((gint) ((a->frame_count + 1) * a_delay)
-             - (gint) ((b->frame_count + 1) * b_delay + b_difference));
+  a_expiration = a->start_time
+               + (a->frame_count + 1) * NSEC_PER_SEC / a->fps;
+  b_expiration = b->start_time
+               + (b->frame_count + 1) * NSEC_PER_SEC / b->fps;
 
-  return (comparison < 0 ? -1
-                         : comparison > 0 ? 1
-                                          : 0);
+  return (a_expiration < b_expiration ? -1
+                                      : a_expiration > b_expiration ? 1
+                                                                    : 0);
 }
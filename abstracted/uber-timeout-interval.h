@@ -32,14 +32,14 @@ typedef struct _UberTimeoutInterval UberTimeoutInterval;
 
 struct _UberTimeoutInterval
 {
-  GTimeVal start_time;
+  gint64 start_time; /* monotonic, in nanoseconds */
   guint frame_count, fps;
 };
 
 void _uber_timeout_interval_init (UberTimeoutInterval *interval,
                                      guint fps);
 
-gboolean _uber_timeout_interval_prepare (const GTimeVal *current_time,
+gboolean _uber_timeout_interval_prepare (gint64 current_time,
                                             UberTimeoutInterval *interval,
                                             gint *delay);
 
@@ -0,0 +1,153 @@
+/* uber-timing-stats.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "uber-timing-stats.h"
+
+#define NSEC_PER_USEC (1000)
+#define NSEC_PER_MSEC (1000000.)
+
+/**
+ * uber_timing_stats_reset:
+ * @stats: An #UberTimingStats.
+ *
+ * Clears all samples from @stats.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_timing_stats_reset (UberTimingStats *stats) /* IN */
+{
+	g_return_if_fail(stats != NULL);
+
+	memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * uber_timing_stats_add:
+ * @stats: An #UberTimingStats.
+ * @elapsed: The measured time in nanoseconds.
+ *
+ * Adds a sample to @stats.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_timing_stats_add (UberTimingStats *stats,   /* IN */
+                       gint64           elapsed) /* IN */
+{
+	guint64 usec;
+	guint bucket = 0;
+
+	g_return_if_fail(stats != NULL);
+
+	elapsed = MAX(0, elapsed);
+	stats->count++;
+	stats->total += elapsed;
+	stats->max = MAX(stats->max, elapsed);
+	/*
+	 * Find the power of two bucket for the sample.
+	 */
+	usec = elapsed / NSEC_PER_USEC;
+	while ((usec >>= 1) && bucket < (UBER_TIMING_STATS_N_BUCKETS - 1)) {
+		bucket++;
+	}
+	stats->buckets[bucket]++;
+}
+
+/**
+ * uber_timing_stats_get_mean:
+ * @stats: An #UberTimingStats.
+ *
+ * Retrieves the mean of the samples in @stats.
+ *
+ * Returns: The mean in milliseconds, or 0 if there are no samples.
+ * Side effects: None.
+ */
+gdouble
+uber_timing_stats_get_mean (const UberTimingStats *stats) /* IN */
+{
+	g_return_val_if_fail(stats != NULL, 0.);
+
+	if (!stats->count) {
+		return 0.;
+	}
+	return stats->total / (gdouble)stats->count / NSEC_PER_MSEC;
+}
+
+/**
+ * uber_timing_stats_bucket_limit:
+ * @bucket: The index of a bucket.
+ *
+ * Retrieves the upper limit of a histogram bucket.  The last bucket is
+ * unbounded and its limit is that of the bucket before it doubled.
+ *
+ * Returns: The limit in milliseconds.
+ * Side effects: None.
+ */
+gdouble
+uber_timing_stats_bucket_limit (guint bucket) /* IN */
+{
+	g_return_val_if_fail(bucket < UBER_TIMING_STATS_N_BUCKETS, 0.);
+
+	return (G_GUINT64_CONSTANT(2) << bucket) * NSEC_PER_USEC / NSEC_PER_MSEC;
+}
+
+/**
+ * uber_timing_stats_get_percentile:
+ * @stats: An #UberTimingStats.
+ * @percent: The percentile to estimate, from 0 to 100.
+ *
+ * Estimates a percentile of the samples in @stats.  The result is the
+ * upper limit of the bucket containing the percentile, capped to the
+ * largest sample, so it is never an underestimate.
+ *
+ * Returns: The percentile in milliseconds, or 0 if there are no samples.
+ * Side effects: None.
+ */
+gdouble
+uber_timing_stats_get_percentile (const UberTimingStats *stats,   /* IN */
+                                  gdouble                percent) /* IN */
+{
+	guint64 rank;
+	guint64 seen = 0;
+	gdouble max;
+	gint i;
+
+	g_return_val_if_fail(stats != NULL, 0.);
+
+	if (!stats->count) {
+		return 0.;
+	}
+	max = stats->max / NSEC_PER_MSEC;
+	rank = MAX(1, (guint64)(CLAMP(percent, 0., 100.) / 100. * stats->count));
+	for (i = 0; i < UBER_TIMING_STATS_N_BUCKETS; i++) {
+		seen += stats->buckets[i];
+		if (seen >= rank) {
+			return MIN(max, uber_timing_stats_bucket_limit(i));
+		}
+	}
+	return max;
+}
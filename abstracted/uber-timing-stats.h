@@ -0,0 +1,64 @@
+/* uber-timing-stats.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_TIMING_STATS_H__
+#define __UBER_TIMING_STATS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Bucket 0 holds samples below 2 microseconds, bucket N holds samples from
+ * 2^N up to 2^(N+1) microseconds, and the last bucket holds everything
+ * from about half a second.
+ */
+#define UBER_TIMING_STATS_N_BUCKETS (20)
+
+typedef struct _UberTimingStats UberTimingStats;
+
+/**
+ * UberTimingStats:
+ * @count: The number of samples.
+ * @total: The sum of all samples in nanoseconds.
+ * @max: The largest sample in nanoseconds.
+ * @buckets: The number of samples within each power of two bucket.
+ *
+ * #UberTimingStats accumulates the latency of a repeated operation along
+ * with a coarse histogram so that percentiles can be estimated without
+ * keeping every sample.
+ */
+struct _UberTimingStats
+{
+	guint64 count;
+	gint64  total;
+	gint64  max;
+	guint64 buckets[UBER_TIMING_STATS_N_BUCKETS];
+};
+
+void    uber_timing_stats_reset          (UberTimingStats       *stats);
+void    uber_timing_stats_add            (UberTimingStats       *stats,
+                                          gint64                 elapsed);
+gdouble uber_timing_stats_get_mean       (const UberTimingStats *stats);
+gdouble uber_timing_stats_get_percentile (const UberTimingStats *stats,
+                                          gdouble                percent);
+gdouble uber_timing_stats_bucket_limit   (guint                  bucket);
+
+G_END_DECLS
+
+#endif /* __UBER_TIMING_STATS_H__ */
@@ -22,22 +22,46 @@
 
 #include "uber-window.h"
 
+#define FRAME_CLOCK_FPS (60)
+#define MIN_ROW_HEIGHT  (120)
+#define OVERSCAN_ROWS   (1)
+
 /**
  * SECTION:uber-window.h
  * @title: UberWindow
  * @short_description: 
  *
  * Section overview.
+ *
+ * All graphs added to an #UberWindow share a single #UberFrameClock so that
+ * they are updated in the same main loop iteration.
+ *
+ * Graphs are stacked in rows within a scrolled #GtkLayout.  Only the rows
+ * within %OVERSCAN_ROWS of the visible area are placed in the layout, so
+ * only those graphs are realized and hold pixmaps; rows scrolled away are
+ * removed and their pixmaps released.  Every graph keeps retrieving data
+ * while removed, so it is current when scrolled back into view.
  */
 
 G_DEFINE_TYPE(UberWindow, uber_window, GTK_TYPE_WINDOW)
 
+typedef struct
+{
+	UberGraph *graph;     /* Graph within the row. */
+	GtkWidget *container; /* Title, graph and labels; we hold a reference. */
+	gboolean   attached;  /* Is the container placed in the layout. */
+} UberWindowRow;
+
 struct _UberWindowPrivate
 {
-	gint       graph_count;
-	GList     *graphs;
-	GtkWidget *notebook;
-	GtkWidget *table;
+	gint            graph_count;
+	GList          *graphs;
+	GArray         *rows;
+	GtkWidget      *notebook;
+	GtkWidget      *scrolled;
+	GtkWidget      *layout;
+	guint           update_handler;
+	UberFrameClock *clock;
 };
 
 /**
@@ -177,6 +201,160 @@ uber_window_graph_button_press_event (GtkWidget      *widget, /* IN */
 	return FALSE;
 }
 
+/**
+ * uber_window_update_rows:
+ * @window: A #UberWindow.
+ *
+ * Sizes the rows to the visible area and places the rows near it in the
+ * layout, removing the others.
+ *
+ * Returns: None.
+ * Side effects: Graphs are realized and unrealized.
+ */
+static void
+uber_window_update_rows (UberWindow *window) /* IN */
+{
+	UberWindowPrivate *priv;
+	UberWindowRow *row;
+	GtkAdjustment *vadj;
+	GtkAllocation alloc;
+	gint row_height;
+	gint first;
+	gint last;
+	gint i;
+
+	g_return_if_fail(UBER_IS_WINDOW(window));
+
+	priv = window->priv;
+	if (!priv->rows->len) {
+		return;
+	}
+	/*
+	 * Share the visible height among the rows, but scroll once they would
+	 * become too small to read.
+	 */
+	gtk_widget_get_allocation(priv->layout, &alloc);
+	row_height = MAX(MIN_ROW_HEIGHT, alloc.height / (gint)priv->rows->len);
+	gtk_layout_set_size(GTK_LAYOUT(priv->layout), alloc.width,
+	                    row_height * priv->rows->len);
+	/*
+	 * Determine the rows which are visible, plus a few either side so they
+	 * are ready before being scrolled into view.
+	 */
+	vadj = gtk_layout_get_vadjustment(GTK_LAYOUT(priv->layout));
+	first = (gint)gtk_adjustment_get_value(vadj) / row_height - OVERSCAN_ROWS;
+	last = (gint)(gtk_adjustment_get_value(vadj) +
+	              gtk_adjustment_get_page_size(vadj)) / row_height
+	     + OVERSCAN_ROWS;
+	for (i = 0; i < priv->rows->len; i++) {
+		row = &g_array_index(priv->rows, UberWindowRow, i);
+		if (i < first || i > last) {
+			/*
+			 * Removing the row unrealizes the graph, releasing its pixmaps.
+			 */
+			if (row->attached) {
+				gtk_container_remove(GTK_CONTAINER(priv->layout),
+				                     row->container);
+				row->attached = FALSE;
+			}
+			continue;
+		}
+		gtk_widget_set_size_request(row->container, alloc.width, row_height);
+		if (row->attached) {
+			gtk_layout_move(GTK_LAYOUT(priv->layout), row->container,
+			                0, i * row_height);
+		} else {
+			gtk_layout_put(GTK_LAYOUT(priv->layout), row->container,
+			               0, i * row_height);
+			row->attached = TRUE;
+		}
+	}
+}
+
+/**
+ * uber_window_update_timeout:
+ * @data: An #UberWindow.
+ *
+ * Idle handler to update the rows after the layout was resized or
+ * scrolled.
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_window_update_timeout (gpointer data) /* IN */
+{
+	UberWindow *window = data;
+
+	g_return_val_if_fail(UBER_IS_WINDOW(window), FALSE);
+
+	window->priv->update_handler = 0;
+	uber_window_update_rows(window);
+	return FALSE;
+}
+
+/**
+ * uber_window_queue_update:
+ * @window: A #UberWindow.
+ *
+ * Queues the rows to be updated.  This happens at a higher priority than
+ * redrawing so that rows scrolled into view are in place when drawn.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_window_queue_update (UberWindow *window) /* IN */
+{
+	UberWindowPrivate *priv;
+
+	g_return_if_fail(UBER_IS_WINDOW(window));
+
+	priv = window->priv;
+	if (!priv->update_handler) {
+		priv->update_handler =
+			g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+			                uber_window_update_timeout,
+			                window, NULL);
+	}
+}
+
+/**
+ * uber_window_layout_size_allocate:
+ * @widget: The #GtkLayout.
+ * @alloc: The new allocation.
+ * @window: A #UberWindow.
+ *
+ * Handles resizing of the visible area.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_window_layout_size_allocate (GtkWidget     *widget, /* IN */
+                                  GtkAllocation *alloc,  /* IN */
+                                  UberWindow    *window) /* IN */
+{
+	uber_window_queue_update(window);
+}
+
+/**
+ * uber_window_vadjustment_value_changed:
+ * @vadj: The vertical #GtkAdjustment of the layout.
+ * @window: A #UberWindow.
+ *
+ * Handles scrolling of the visible area.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_window_vadjustment_value_changed (GtkAdjustment *vadj,   /* IN */
+                                       UberWindow    *window) /* IN */
+{
+	uber_window_queue_update(window);
+}
+
 /**
  * uber_window_add_graph:
  * @window: A #UberWindow.
@@ -192,13 +370,12 @@ uber_window_add_graph (UberWindow  *window, /* IN */
                        const gchar *title)  /* IN */
 {
 	UberWindowPrivate *priv;
+	UberWindowRow row;
 	GtkWidget *vbox;
 	GtkWidget *hbox;
 	GtkWidget *label;
 	GtkWidget *labels;
 	gchar *formatted;
-	gint left_attach;
-	gint top_attach;
 
 	g_return_if_fail(UBER_IS_WINDOW(window));
 
@@ -226,18 +403,14 @@ uber_window_add_graph (UberWindow  *window, /* IN */
 	gtk_widget_show(hbox);
 	gtk_widget_show(vbox);
 	/*
-	 * Append graph to table.
+	 * Append a row for the graph.  It is placed in the layout once it is
+	 * near the visible area.
 	 */
-	left_attach = 0;
-	top_attach = priv->graph_count; // % 4;
-	gtk_table_attach(GTK_TABLE(priv->table), hbox,
-	                 left_attach,
-	                 left_attach + 1,
-	                 top_attach,
-	                 top_attach + 1,
-	                 GTK_FILL | GTK_EXPAND,
-	                 GTK_FILL | GTK_EXPAND,
-	                 0, 0);
+	row.graph = graph;
+	row.container = g_object_ref_sink(hbox);
+	row.attached = FALSE;
+	g_array_append_val(priv->rows, row);
+	uber_window_queue_update(window);
 	/*
 	 * Attach signal to show ticks when label is shown.
 	 */
@@ -246,6 +419,12 @@ uber_window_add_graph (UberWindow  *window, /* IN */
 	                       G_CALLBACK(uber_window_graph_button_press_event),
 	                       window);
 	priv->graphs = g_list_append(priv->graphs, graph);
+	/*
+	 * Drive the graph from the window's frame clock, and keep retrieving
+	 * data while the row is scrolled out of the layout.
+	 */
+	uber_graph_set_frame_clock(graph, priv->clock);
+	uber_graph_set_collect_detached(graph, TRUE);
 	/*
 	 * Cleanup.
 	 */
@@ -253,6 +432,39 @@ uber_window_add_graph (UberWindow  *window, /* IN */
 	priv->graph_count++;
 }
 
+/**
+ * uber_window_dispose:
+ * @object: A #UberWindow.
+ *
+ * Dispose callback for @object.  Destroys the rows which are not placed
+ * in the layout, as they are not destroyed along with the window.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_window_dispose (GObject *object) /* IN */
+{
+	UberWindowPrivate *priv;
+	UberWindowRow *row;
+	gint i;
+
+	priv = UBER_WINDOW(object)->priv;
+	if (priv->update_handler) {
+		g_source_remove(priv->update_handler);
+		priv->update_handler = 0;
+	}
+	for (i = 0; i < priv->rows->len; i++) {
+		row = &g_array_index(priv->rows, UberWindowRow, i);
+		if (!row->attached) {
+			gtk_widget_destroy(row->container);
+		}
+		g_object_unref(row->container);
+	}
+	g_array_set_size(priv->rows, 0);
+	G_OBJECT_CLASS(uber_window_parent_class)->dispose(object);
+}
+
 /**
  * uber_window_finalize:
  * @object: A #UberWindow.
@@ -270,6 +482,8 @@ uber_window_finalize (GObject *object) /* IN */
 
 	priv = UBER_WINDOW(object)->priv;
 	g_list_free(priv->graphs);
+	g_array_free(priv->rows, TRUE);
+	uber_frame_clock_unref(priv->clock);
 	G_OBJECT_CLASS(uber_window_parent_class)->finalize(object);
 }
 
@@ -288,6 +502,7 @@ uber_window_class_init (UberWindowClass *klass) /* IN */
 	GObjectClass *object_class;
 
 	object_class = G_OBJECT_CLASS(klass);
+	object_class->dispose = uber_window_dispose;
 	object_class->finalize = uber_window_finalize;
 	g_type_class_add_private(object_class, sizeof(UberWindowPrivate));
 }
@@ -317,6 +532,8 @@ uber_window_init (UberWindow *window) /* IN */
 	gtk_window_set_title(GTK_WINDOW(window), "Uber Graph");
 	gtk_window_set_default_size(GTK_WINDOW(window), 750, 550);
 	gtk_container_set_border_width(GTK_CONTAINER(window), 12);
+	priv->clock = uber_frame_clock_new(FRAME_CLOCK_FPS);
+	priv->rows = g_array_new(FALSE, FALSE, sizeof(UberWindowRow));
 	/*
 	 * Create notebook container for pages.
 	 */
@@ -326,9 +543,23 @@ uber_window_init (UberWindow *window) /* IN */
 	gtk_container_add(GTK_CONTAINER(window), priv->notebook);
 	gtk_widget_show(priv->notebook);
 	/*
-	 * Create table for graphs.
+	 * Create scrolled layout for graph rows.
 	 */
-	priv->table = gtk_table_new(1, 1, TRUE);
-	gtk_notebook_append_page(GTK_NOTEBOOK(priv->notebook), priv->table, NULL);
-	gtk_widget_show(priv->table);
+	priv->scrolled = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(priv->scrolled),
+	                               GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_notebook_append_page(GTK_NOTEBOOK(priv->notebook), priv->scrolled,
+	                         NULL);
+	gtk_widget_show(priv->scrolled);
+	priv->layout = gtk_layout_new(NULL, NULL);
+	gtk_container_add(GTK_CONTAINER(priv->scrolled), priv->layout);
+	g_signal_connect_after(priv->layout,
+	                       "size-allocate",
+	                       G_CALLBACK(uber_window_layout_size_allocate),
+	                       window);
+	g_signal_connect(gtk_layout_get_vadjustment(GTK_LAYOUT(priv->layout)),
+	                 "value-changed",
+	                 G_CALLBACK(uber_window_vadjustment_value_changed),
+	                 window);
+	gtk_widget_show(priv->layout);
 }
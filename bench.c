@@ -0,0 +1,197 @@
+/* bench.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <gtk/gtk.h>
+
+#include "uber-bench.h"
+#include "uber-frame-clock.h"
+#include "uber-graph.h"
+
+/*
+ * Fixed seed so that every run renders the same data.
+ */
+#define BENCH_SEED (42)
+
+enum
+{
+	SERIES_EXPOSE,
+	SERIES_RENDER_FG,
+	SERIES_RENDER_BG,
+	SERIES_FRAME_INTERVAL,
+	SERIES_LAST
+};
+
+static const gchar *series[]   = { "expose",
+                                   "render_fg",
+                                   "render_bg",
+                                   "frame_interval" };
+static gint         n_graphs   = 4;
+static gint         n_lines    = 4;
+static gint         fps        = 20;
+static gdouble      seconds    = 10.;
+static gdouble      warmup     = 2.;
+static GRand       *bench_rand = NULL;
+static UberBench   *bench      = NULL;
+static GOptionEntry entries[]  = {
+	{ "graphs", 'g', 0, G_OPTION_ARG_INT, &n_graphs,
+	  "Number of graphs", "N" },
+	{ "lines", 'l', 0, G_OPTION_ARG_INT, &n_lines,
+	  "Number of lines per graph", "M" },
+	{ "fps", 'f', 0, G_OPTION_ARG_INT, &fps,
+	  "Frames per second", "FPS" },
+	{ "seconds", 's', 0, G_OPTION_ARG_DOUBLE, &seconds,
+	  "Seconds to measure", "SECONDS" },
+	{ "warmup", 'w', 0, G_OPTION_ARG_DOUBLE, &warmup,
+	  "Seconds to run before measuring", "SECONDS" },
+	{ NULL }
+};
+
+static gboolean
+bench_get_value (UberGraph *graph,     /* IN */
+                 gint       line,      /* IN */
+                 gdouble   *value,     /* OUT */
+                 gpointer   user_data) /* IN */
+{
+	*value = g_rand_double_range(bench_rand, 0., 100.);
+	return TRUE;
+}
+
+static void
+bench_timing (UberGraph       *graph,     /* IN */
+              UberGraphTiming  timing,    /* IN */
+              gint64           elapsed,   /* IN */
+              gpointer         user_data) /* IN */
+{
+	gint64 *last_expose = user_data;
+	gint64 now;
+
+	switch (timing) {
+	case UBER_GRAPH_TIMING_EXPOSE:
+		uber_bench_add_sample(bench, SERIES_EXPOSE, elapsed);
+		now = uber_frame_clock_get_time();
+		if (*last_expose) {
+			uber_bench_add_sample(bench, SERIES_FRAME_INTERVAL,
+			                      now - *last_expose);
+		}
+		*last_expose = now;
+		break;
+	case UBER_GRAPH_TIMING_RENDER_FG:
+		uber_bench_add_sample(bench, SERIES_RENDER_FG, elapsed);
+		break;
+	case UBER_GRAPH_TIMING_RENDER_BG:
+		uber_bench_add_sample(bench, SERIES_RENDER_BG, elapsed);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+}
+
+static gboolean
+bench_start (gpointer data) /* IN */
+{
+	uber_bench_start(bench);
+	return FALSE;
+}
+
+static gboolean
+bench_stop (gpointer data) /* IN */
+{
+	uber_bench_stop(bench);
+	gtk_main_quit();
+	return FALSE;
+}
+
+gint
+main (gint   argc,   /* IN */
+      gchar *argv[]) /* IN */
+{
+	UberRange range = { 0., 100., 100. };
+	GOptionContext *context;
+	GError *error = NULL;
+	GtkWidget *window;
+	GtkWidget *vbox;
+	GtkWidget *graph;
+	gint64 *last_expose;
+	gint i;
+	gint j;
+
+	g_thread_init(NULL);
+	context = g_option_context_new("- benchmark UberGraph rendering");
+	g_option_context_add_main_entries(context, entries, NULL);
+	g_option_context_add_group(context, gtk_get_option_group(TRUE));
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+	if (n_graphs < 1 || n_lines < 1 || fps < 1 || seconds <= 0.) {
+		g_printerr("Invalid benchmark parameters.\n");
+		return EXIT_FAILURE;
+	}
+	bench_rand = g_rand_new_with_seed(BENCH_SEED);
+	bench = uber_bench_new("uber-graph", series, SERIES_LAST);
+	uber_bench_add_param(bench, "graphs", n_graphs);
+	uber_bench_add_param(bench, "lines", n_lines);
+	uber_bench_add_param(bench, "fps", fps);
+	uber_bench_add_param(bench, "seed", BENCH_SEED);
+	/*
+	 * Build the graphs.
+	 */
+	last_expose = g_new0(gint64, n_graphs);
+	window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	gtk_window_set_default_size(GTK_WINDOW(window), 640, 120 * n_graphs);
+	vbox = gtk_vbox_new(TRUE, 3);
+	gtk_container_add(GTK_CONTAINER(window), vbox);
+	for (i = 0; i < n_graphs; i++) {
+		graph = uber_graph_new();
+		uber_graph_set_yrange(UBER_GRAPH(graph), &range);
+		uber_graph_set_fps(UBER_GRAPH(graph), fps);
+		uber_graph_set_render_budget(UBER_GRAPH(graph), 0.);
+		for (j = 0; j < n_lines; j++) {
+			uber_graph_add_line(UBER_GRAPH(graph));
+		}
+		uber_graph_set_value_func(UBER_GRAPH(graph), bench_get_value,
+		                          NULL, NULL);
+		uber_graph_set_timing_func(UBER_GRAPH(graph), bench_timing,
+		                           &last_expose[i]);
+		gtk_box_pack_start(GTK_BOX(vbox), graph, TRUE, TRUE, 0);
+	}
+	gtk_widget_show_all(window);
+	/*
+	 * Measure after the warm up period.
+	 */
+	g_timeout_add(warmup * 1000, bench_start, NULL);
+	g_timeout_add((warmup + seconds) * 1000, bench_stop, NULL);
+	gtk_main();
+	uber_bench_write_json(bench, stdout);
+	/*
+	 * Cleanup.
+	 */
+	gtk_widget_destroy(window);
+	uber_bench_free(bench);
+	g_rand_free(bench_rand);
+	g_free(last_expose);
+	return EXIT_SUCCESS;
+}
@@ -44,6 +44,9 @@
 #include "uber-label.h"
 #include "uber-buffer.h"
 #include "uber-heat-map.h"
+#include "uber-process-tree.h"
+#include "uber-sample-clock.h"
+#include "uber-trace.h"
 
 #ifdef DISABLE_DEBUG
 #define DEBUG(f,...)
@@ -51,6 +54,15 @@
 #define DEBUG(f,...) g_debug(f, ## __VA_ARGS__)
 #endif
 
+/*
+ * Number of individual processes to graph from the process tree, and how
+ * often (in samples) to look for new children.
+ */
+#define PROC_TOP_N            4
+#define PROC_DISCOVER_SAMPLES 5
+
+#define NSEC_PER_SEC G_GINT64_CONSTANT(1000000000)
+
 typedef struct
 {
 	volatile gdouble swapFree;
@@ -78,27 +90,28 @@ typedef struct
 
 typedef struct
 {
-	volatile gdouble size;
+	volatile gdouble cpu;
 	volatile gdouble resident;
-} PmemInfo;
+	volatile gint    n_threads;
+	volatile gint    n_procs;
+	volatile gint    top_cpu_pid[PROC_TOP_N];
+	volatile gdouble top_cpu[PROC_TOP_N];
+	volatile gint    top_mem_pid[PROC_TOP_N];
+	volatile gdouble top_mem[PROC_TOP_N];
+} ProcTreeInfo;
 
 typedef struct
 {
 	volatile gdouble vruntime;
 } SchedInfo;
 
-typedef struct
-{
-	volatile gint n_threads;
-} ThreadInfo;
-
 static MemInfo    mem_info   = { 0 };
 static CpuInfo    cpu_info   = { 0 };
 static NetInfo    net_info   = { 0 };
 static LoadInfo   load_info  = { 0 };
-static PmemInfo   pmem_info  = { 0 };
 static SchedInfo  sched_info = { 0 };
-static ThreadInfo thread_info= { 0 };
+static ProcTreeInfo proc_info = { 0 };
+static UberProcessTree *proc_tree = NULL;
 static GtkWidget *load_graph = NULL;
 static GtkWidget *cpu_graph  = NULL;
 static GtkWidget *cpu_label_hbox = NULL;
@@ -110,10 +123,13 @@ static GtkWidget *mem_graph  = NULL;
 static gboolean   reaped     = FALSE;
 static GtkWidget *vbox       = NULL;
 static GtkWidget *pmem_graph = NULL;
+static GtkWidget *pcpu_graph = NULL;
 static GtkWidget *sched_graph  = NULL;
 static GtkWidget *thread_graph = NULL;
 static GPid       pid        = 0;
 static GPtrArray *labels     = NULL;
+static GPtrArray *pcpu_labels = NULL;
+static GPtrArray *pmem_labels = NULL;
 
 static const gchar* cpu_colors[] = {
 	"#73d216",
@@ -220,7 +236,10 @@ get_threads (UberGraph *graph,
 {
 	switch (line) {
 	case 1:
-		*value = thread_info.n_threads;
+		*value = proc_info.n_threads;
+		break;
+	case 2:
+		*value = proc_info.n_procs;
 		break;
 	default:
 		g_assert_not_reached();
@@ -406,11 +425,13 @@ next_cpu (void)
 }
 
 static void
-next_net (void)
+next_net (gint64 stamp)
 {
 	static gboolean initialized = FALSE;
 	static gdouble lastTotalIn = 0;
 	static gdouble lastTotalOut = 0;
+	static gint64 lastStamp = 0;
+	gdouble elapsed;
 	char buf[4096];
 	char iface[32];
 	char *line;
@@ -457,13 +478,22 @@ next_net (void)
 		goto finish;
 	}
 
-	net_info.bytesIn = (totalIn - lastTotalIn);
-	net_info.bytesOut = (totalOut - lastTotalOut);
+	/*
+	 * Convert to bytes per second using the time that actually elapsed
+	 * between the stamps of the two samples rather than assuming the
+	 * sample period was met.
+	 */
+	elapsed = (stamp - lastStamp) / (gdouble)NSEC_PER_SEC;
+	if (elapsed > 0.) {
+		net_info.bytesIn = (totalIn - lastTotalIn) / elapsed;
+		net_info.bytesOut = (totalOut - lastTotalOut) / elapsed;
+	}
 
   finish:
 	close(fd);
 	lastTotalOut = totalOut;
 	lastTotalIn = totalIn;
+	lastStamp = stamp;
 }
 
 static void
@@ -538,32 +568,13 @@ next_mem (void)
 }
 
 static void
-next_pmem (void)
-{
-	static char *path = NULL;
-	int fd;
-	char buf[1024];
-	long size = 0;
-	long resident = 0;
-
-	if (G_UNLIKELY(!path)) {
-		path = g_strdup_printf("/proc/%d/statm", pid);
-	}
-
-	fd = open(path, O_RDONLY);
-	read(fd, buf, sizeof(buf));
-	sscanf(buf, "%ld %ld", &size, &resident);
-	pmem_info.size = size;
-	pmem_info.resident = resident;
-	close(fd);
-}
-
-static void
-next_sched (void)
+next_sched (gint64 stamp)
 {
 	static char *path = NULL;
 	static gdouble last_vruntime = 0;
+	static gint64 last_stamp = 0;
 	gdouble vruntime = 0;
+	gdouble elapsed;
 	int fd;
 	char buf[4096];
 	char name[128];
@@ -587,7 +598,10 @@ next_sched (void)
 					g_printerr("Failed to parse vruntime.\n");
 					break;
 				}
-				sched_info.vruntime = (vruntime - last_vruntime);
+				elapsed = (stamp - last_stamp) / (gdouble)NSEC_PER_SEC;
+				if (last_stamp && elapsed > 0.) {
+					sched_info.vruntime = (vruntime - last_vruntime) / elapsed;
+				}
 				break;
 			}
 			line = &buf[++i];
@@ -595,27 +609,38 @@ next_sched (void)
 	}
 	close(fd);
 	last_vruntime = vruntime;
+	last_stamp = stamp;
 }
 
 static void
-next_threads (void)
+next_process_tree (void)
 {
-	static gchar *path = NULL;
-	gint n_threads = 0;
-	GDir *dir;
+	static guint n_samples = 0;
+	UberProcessInfo totals;
+	UberProcessInfo top[PROC_TOP_N];
+	gint i;
 
-	if (G_UNLIKELY(!path)) {
-		path = g_strdup_printf("/proc/%d/task", pid);
+	if (!(n_samples++ % PROC_DISCOVER_SAMPLES)) {
+		uber_process_tree_discover(proc_tree);
 	}
-
-	if (!(dir = g_dir_open(path, 0, NULL))) {
-		return;
+	uber_process_tree_refresh(proc_tree);
+
+	uber_process_tree_get_totals(proc_tree, &totals);
+	proc_info.cpu = totals.cpu;
+	proc_info.resident = totals.resident;
+	proc_info.n_threads = totals.n_threads;
+	proc_info.n_procs = uber_process_tree_get_count(proc_tree);
+
+	uber_process_tree_get_top(proc_tree, UBER_PROCESS_SORT_CPU, top, PROC_TOP_N);
+	for (i = 0; i < PROC_TOP_N; i++) {
+		proc_info.top_cpu_pid[i] = top[i].pid;
+		proc_info.top_cpu[i] = top[i].pid ? top[i].cpu : -INFINITY;
 	}
-	while (g_dir_read_name(dir)) {
-		n_threads++;
+	uber_process_tree_get_top(proc_tree, UBER_PROCESS_SORT_RESIDENT, top, PROC_TOP_N);
+	for (i = 0; i < PROC_TOP_N; i++) {
+		proc_info.top_mem_pid[i] = top[i].pid;
+		proc_info.top_mem[i] = top[i].pid ? top[i].resident : -INFINITY;
 	}
-	g_dir_close(dir);
-	thread_info.n_threads = n_threads;
 }
 
 static inline GtkWidget*
@@ -827,38 +852,73 @@ create_main_window (void)
 	next_load();
 	next_cpu();
 	next_mem();
-	next_net();
-	next_pmem();
-	next_sched();
-	next_threads();
-
-	next_load();
-	next_cpu();
-	next_mem();
-	next_net();
-	next_pmem();
-	next_sched();
+	next_net(uber_sample_clock_get_time());
 
 	return window;
 }
 
+static inline void
+set_proc_label (GPtrArray   *array,
+                gint         line,
+                gint         pid,
+                const gchar *text)
+{
+	gchar *str;
+
+	if (pid) {
+		str = g_strdup_printf("PID %d  %s", pid, text);
+	} else {
+		str = g_strdup("-");
+	}
+	uber_label_set_text(g_ptr_array_index(array, line - 2), str);
+	g_free(str);
+}
+
 static gboolean
 get_pmem (UberGraph *graph,
           gint       line,
           gdouble   *value,
           gpointer   user_data)
 {
-	switch (line) {
-	case 1:
-		*value = pmem_info.size;
-		break;
-	case 2:
-		*value = pmem_info.resident;
-		break;
-	default:
+	gchar *str;
+	gint i = line - 2;
+
+	if (line == 1) {
+		*value = proc_info.resident;
+		return TRUE;
+	}
+	if (i < 0 || i >= PROC_TOP_N) {
+		*value = 0;
+		return FALSE;
+	}
+	*value = proc_info.top_mem[i];
+	str = g_strdup_printf("%.1f MiB", proc_info.top_mem[i] / (1024. * 1024.));
+	set_proc_label(pmem_labels, line, proc_info.top_mem_pid[i], str);
+	g_free(str);
+	return TRUE;
+}
+
+static gboolean
+get_pcpu (UberGraph *graph,
+          gint       line,
+          gdouble   *value,
+          gpointer   user_data)
+{
+	gchar *str;
+	gint i = line - 2;
+
+	if (line == 1) {
+		*value = proc_info.cpu;
+		return TRUE;
+	}
+	if (i < 0 || i >= PROC_TOP_N) {
 		*value = 0;
 		return FALSE;
 	}
+	*value = proc_info.top_cpu[i];
+	str = g_strdup_printf("%.1f%%", proc_info.top_cpu[i]);
+	set_proc_label(pcpu_labels, line, proc_info.top_cpu_pid[i], str);
+	g_free(str);
 	return TRUE;
 }
 
@@ -879,21 +939,62 @@ get_sched (UberGraph *graph,
 	return TRUE;
 }
 
-static void
-create_pid_graphs (GPid pid)
+static GtkWidget*
+create_proc_group (const gchar *title,
+                   GtkWidget   *graph,
+                   GPtrArray   *array)
 {
+	GtkWidget *hbox;
 	GtkWidget *label;
+	gchar *text;
+	gint i;
 
 	label = gtk_label_new(NULL);
-	gtk_label_set_markup(GTK_LABEL(label), "<b>Process Memory</b>");
+	gtk_label_set_markup(GTK_LABEL(label), title);
 	gtk_box_pack_start(GTK_BOX(vbox), label, FALSE, TRUE, 0);
 	gtk_misc_set_alignment(GTK_MISC(label), .0, .5);
 	gtk_widget_show(label);
 
+	gtk_box_pack_start(GTK_BOX(vbox), graph, TRUE, TRUE, 0);
+	uber_graph_set_yautoscale(UBER_GRAPH(graph), TRUE);
+	uber_graph_add_line(UBER_GRAPH(graph));
+	SET_LINE_COLOR(graph, 1, "#2e3436");
+
+	hbox = new_label_container();
+	gtk_box_pack_start(GTK_BOX(vbox), gtk_widget_get_parent(hbox), FALSE, TRUE, 0);
+	label = add_label(hbox, "Process Tree", "#2e3436");
+	uber_label_bind_graph(UBER_LABEL(label), UBER_GRAPH(graph), 1);
+	for (i = 0; i < PROC_TOP_N; i++) {
+		text = g_strdup_printf("#%d", i + 1);
+		uber_graph_add_line(UBER_GRAPH(graph));
+		SET_LINE_COLOR(graph, i + 2, cpu_colors[i % G_N_ELEMENTS(cpu_colors)]);
+		label = add_label(hbox, text, cpu_colors[i % G_N_ELEMENTS(cpu_colors)]);
+		uber_label_bind_graph(UBER_LABEL(label), UBER_GRAPH(graph), i + 2);
+		g_ptr_array_add(array, label);
+		g_free(text);
+	}
+	gtk_widget_show(hbox);
+	return hbox;
+}
+
+static void
+create_pid_graphs (GPid pid)
+{
+	GtkWidget *label;
+
+	proc_tree = uber_process_tree_new(pid);
+	uber_process_tree_discover(proc_tree);
+	uber_process_tree_refresh(proc_tree);
+
+	pcpu_labels = g_ptr_array_new();
+	pcpu_graph = create_graph();
+	create_proc_group("<b>Process CPU</b>", pcpu_graph, pcpu_labels);
+	uber_graph_set_value_func(UBER_GRAPH(pcpu_graph), get_pcpu, NULL, NULL);
+
+	pmem_labels = g_ptr_array_new();
 	pmem_graph = create_graph();
-	uber_graph_set_yautoscale(UBER_GRAPH(pmem_graph), TRUE);
-	uber_graph_add_line(UBER_GRAPH(pmem_graph));
-	uber_graph_add_line(UBER_GRAPH(pmem_graph));
+	uber_graph_set_format(UBER_GRAPH(pmem_graph), UBER_GRAPH_DIRECT1024);
+	create_proc_group("<b>Process Memory</b>", pmem_graph, pmem_labels);
 	uber_graph_set_value_func(UBER_GRAPH(pmem_graph), get_pmem, NULL, NULL);
 
 	label = gtk_label_new(NULL);
@@ -917,24 +1018,36 @@ create_pid_graphs (GPid pid)
 	uber_graph_set_format(UBER_GRAPH(thread_graph), UBER_GRAPH_INTEGRAL);
 	uber_graph_set_yautoscale(UBER_GRAPH(thread_graph), TRUE);
 	uber_graph_add_line(UBER_GRAPH(thread_graph));
+	uber_graph_add_line(UBER_GRAPH(thread_graph));
 	uber_graph_set_value_func(UBER_GRAPH(thread_graph), get_threads, NULL, NULL);
+
+	next_sched(uber_sample_clock_get_time());
 }
 
 static volatile gboolean quit = FALSE;
+static UberSampleClock *sample_clock = NULL;
 
 static gpointer
 sample_func (gpointer data)
 {
+	gdouble elapsed;
+	gint64 stamp;
+
+	/*
+	 * Each sampler normalizes by the time since its own previous stamp,
+	 * so a late wakeup or a skipped sampler does not skew its rates.
+	 */
 	while (!quit) {
-		DEBUG("Running samplers ...");
+		elapsed = uber_sample_clock_wait(sample_clock, &stamp);
+		DEBUG("Running samplers after %.6f seconds ...", elapsed);
 		next_load();
 		next_cpu();
-		next_net();
+		next_net(stamp);
 		next_mem();
-		next_pmem();
-		next_sched();
-		next_threads();
-		g_usleep(G_USEC_PER_SEC);
+		if (pid) {
+			next_process_tree();
+			next_sched(stamp);
+		}
 	}
 	return NULL;
 }
@@ -1075,10 +1188,27 @@ main (gint   argc,
 	}
 
 	g_signal_connect(window, "delete-event", gtk_main_quit, NULL);
+#ifdef UBER_TRACE
+	/* dump the function trace when we get SIGUSR1 */
+	uber_trace_dump_on_signal(SIGUSR1, "uber-graph-trace.json");
+#endif
+	sample_clock = uber_sample_clock_new(G_USEC_PER_SEC);
 	g_thread_create(sample_func, NULL, FALSE, NULL);
 
 	gtk_main();
 
+	/* report how well the sampler kept its schedule */
+	if (g_getenv("UBER_SHOW_SAMPLER")) {
+		UberSampleClockStats stats;
+
+		uber_sample_clock_get_stats(sample_clock, &stats);
+		g_print("Sampler: %" G_GUINT64_FORMAT " ticks, "
+		        "%" G_GUINT64_FORMAT " overruns, "
+		        "jitter mean %.1f usec max %.1f usec\n",
+		        stats.n_ticks, stats.n_overruns,
+		        stats.jitter_mean, stats.jitter_max);
+	}
+
 	/* kill child process if needed */
 	if (pid && !reaped) {
 		g_print("Exiting, killing child prcess.\n");
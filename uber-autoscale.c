@@ -0,0 +1,344 @@
+/* uber-autoscale.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <time.h>
+
+#include "uber-autoscale.h"
+
+#define NSEC_PER_SEC       (1000000000.)
+#define DEFAULT_HEADROOM   (0.2)  /* Space kept above the largest value. */
+#define DEFAULT_HYSTERESIS (0.25) /* Extra margin required to shrink. */
+#define DEFAULT_INTERVAL   (10.)  /* Seconds between shrinking. */
+
+/**
+ * SECTION:uber-autoscale
+ * @title: UberAutoscale
+ * @short_description: Autoscaling policy for the y-axis.
+ *
+ * When a value lands outside the range, uber_autoscale_grow() extends the
+ * range to the value plus the headroom, rounded out to the next step of
+ * 1, 2 or 5 times a power of ten.  Since every growth is at least one such
+ * step, a series can only cause a few growths for each order of magnitude
+ * it covers.  If the range changed less than the interval ago, the growth
+ * skips ahead one further step since the series is evidently still
+ * moving.
+ *
+ * uber_autoscale_shrink() is called periodically with the range of the
+ * values still shown.  It shrinks at most once per interval, and only to
+ * a step which leaves the headroom plus the hysteresis margin free, so
+ * that values jittering near a step do not grow the range again right
+ * away.
+ */
+
+struct _UberAutoscale
+{
+	gdouble headroom;    /* Fraction of space kept beyond the values. */
+	gdouble hysteresis;  /* Additional fraction required to shrink. */
+	gint64  interval;    /* Nanoseconds between changes to skip ahead or shrink. */
+	gint64  last_change; /* Monotonic time of the last change. */
+};
+
+/**
+ * uber_autoscale_get_time:
+ *
+ * Retrieves the current monotonic time in nanoseconds.
+ *
+ * Returns: The monotonic time.
+ * Side effects: None.
+ */
+static inline gint64
+uber_autoscale_get_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000)) + ts.tv_nsec;
+}
+
+/**
+ * uber_autoscale_new:
+ *
+ * Creates a new #UberAutoscale with the default policy.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_autoscale_free().
+ * Side effects: None.
+ */
+UberAutoscale*
+uber_autoscale_new (void)
+{
+	UberAutoscale *autoscale;
+
+	autoscale = g_slice_new0(UberAutoscale);
+	uber_autoscale_set_policy(autoscale, DEFAULT_HEADROOM,
+	                          DEFAULT_HYSTERESIS, DEFAULT_INTERVAL);
+	return autoscale;
+}
+
+/**
+ * uber_autoscale_free:
+ * @autoscale: An #UberAutoscale.
+ *
+ * Frees @autoscale.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_autoscale_free (UberAutoscale *autoscale) /* IN */
+{
+	g_return_if_fail(autoscale != NULL);
+
+	g_slice_free(UberAutoscale, autoscale);
+}
+
+/**
+ * uber_autoscale_set_policy:
+ * @autoscale: An #UberAutoscale.
+ * @headroom: The fraction of the largest value kept free above it.
+ * @hysteresis: The additional fraction which must be free to shrink.
+ * @interval: The minimum number of seconds between shrinking.
+ *
+ * Sets the policy used to grow and shrink ranges.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_autoscale_set_policy (UberAutoscale *autoscale,  /* IN */
+                           gdouble        headroom,   /* IN */
+                           gdouble        hysteresis, /* IN */
+                           gdouble        interval)   /* IN */
+{
+	g_return_if_fail(autoscale != NULL);
+	g_return_if_fail(headroom >= 0.);
+	g_return_if_fail(hysteresis >= 0. && hysteresis < 1.);
+	g_return_if_fail(interval >= 0.);
+
+	autoscale->headroom = headroom;
+	autoscale->hysteresis = hysteresis;
+	autoscale->interval = interval * NSEC_PER_SEC;
+}
+
+/**
+ * uber_autoscale_nice_ceil:
+ * @value: A value.
+ *
+ * Rounds the magnitude of @value up to 1, 2 or 5 times a power of ten.
+ *
+ * Returns: The rounded value, with the sign of @value.
+ * Side effects: None.
+ */
+gdouble
+uber_autoscale_nice_ceil (gdouble value) /* IN */
+{
+	gdouble magnitude;
+	gdouble base;
+	gdouble f;
+
+	if (value == 0. || isnan(value) || isinf(value)) {
+		return value;
+	}
+	magnitude = fabs(value);
+	base = pow(10., floor(log10(magnitude)));
+	f = magnitude / base;
+	/*
+	 * Allow for rounding error in values already on a step.
+	 */
+	if (f <= 1. + 1e-9) {
+		f = 1.;
+	} else if (f <= 2. + 1e-9) {
+		f = 2.;
+	} else if (f <= 5. + 1e-9) {
+		f = 5.;
+	} else {
+		f = 10.;
+	}
+	return (value < 0.) ? -(f * base) : (f * base);
+}
+
+/**
+ * uber_autoscale_next_step:
+ * @value: A value already on a step.
+ *
+ * Retrieves the step after @value, away from zero.
+ *
+ * Returns: The next step.
+ * Side effects: None.
+ */
+static gdouble
+uber_autoscale_next_step (gdouble value) /* IN */
+{
+	return uber_autoscale_nice_ceil(value * 1.5);
+}
+
+/**
+ * uber_autoscale_grow_to:
+ * @autoscale: An #UberAutoscale.
+ * @range: The range to grow.
+ * @value: A new value.
+ * @skip: Should the growth skip ahead one further step.
+ *
+ * Grows the end of @range nearest to @value so that it holds @value.
+ *
+ * Returns: %TRUE if @range changed.
+ * Side effects: None.
+ */
+static gboolean
+uber_autoscale_grow_to (UberAutoscale *autoscale, /* IN */
+                        UberRange     *range,     /* IN/OUT */
+                        gdouble        value,     /* IN */
+                        gboolean       skip)      /* IN */
+{
+	if (isnan(value) || isinf(value) ||
+	    (value < range->end && value >= range->begin)) {
+		return FALSE;
+	}
+	if (value >= range->end) {
+		range->end = value + fabs(value * autoscale->headroom);
+		range->end = uber_autoscale_nice_ceil(range->end);
+		if (range->end <= value) {
+			range->end = value + 1.;
+		} else if (skip && range->end > 0.) {
+			range->end = uber_autoscale_next_step(range->end);
+		}
+	} else {
+		range->begin = value - fabs(value * autoscale->headroom);
+		range->begin = uber_autoscale_nice_ceil(range->begin);
+		if (range->begin >= value) {
+			range->begin = value - 1.;
+		} else if (skip && range->begin < 0.) {
+			range->begin = uber_autoscale_next_step(range->begin);
+		}
+	}
+	range->range = range->end - range->begin;
+	return TRUE;
+}
+
+/**
+ * uber_autoscale_grow:
+ * @autoscale: An #UberAutoscale.
+ * @range: The range to grow.
+ * @value: A new value.
+ *
+ * Grows @range to hold @value if it lies outside of it.  Values which are
+ * not finite are ignored.
+ *
+ * Returns: %TRUE if @range changed.
+ * Side effects: None.
+ */
+gboolean
+uber_autoscale_grow (UberAutoscale *autoscale, /* IN */
+                     UberRange     *range,     /* IN/OUT */
+                     gdouble        value)     /* IN */
+{
+	gboolean skip;
+	gint64 now;
+
+	g_return_val_if_fail(autoscale != NULL, FALSE);
+	g_return_val_if_fail(range != NULL, FALSE);
+
+	now = uber_autoscale_get_time();
+	skip = (now - autoscale->last_change) < autoscale->interval;
+	if (!uber_autoscale_grow_to(autoscale, range, value, skip)) {
+		return FALSE;
+	}
+	autoscale->last_change = now;
+	return TRUE;
+}
+
+/**
+ * uber_autoscale_grow_range:
+ * @autoscale: An #UberAutoscale.
+ * @range: The range to grow.
+ * @values: The range of the new values.
+ *
+ * Grows @range to hold both ends of @values, such as after loading many
+ * values at once.  Both ends are grown as a single change, so growing one
+ * end does not make the other skip ahead.
+ *
+ * Returns: %TRUE if @range changed.
+ * Side effects: None.
+ */
+gboolean
+uber_autoscale_grow_range (UberAutoscale   *autoscale, /* IN */
+                           UberRange       *range,     /* IN/OUT */
+                           const UberRange *values)    /* IN */
+{
+	gboolean changed;
+	gboolean skip;
+	gint64 now;
+
+	g_return_val_if_fail(autoscale != NULL, FALSE);
+	g_return_val_if_fail(range != NULL, FALSE);
+	g_return_val_if_fail(values != NULL, FALSE);
+
+	now = uber_autoscale_get_time();
+	skip = (now - autoscale->last_change) < autoscale->interval;
+	changed = uber_autoscale_grow_to(autoscale, range, values->end, skip);
+	changed |= uber_autoscale_grow_to(autoscale, range, values->begin, skip);
+	if (changed) {
+		autoscale->last_change = now;
+	}
+	return changed;
+}
+
+/**
+ * uber_autoscale_shrink:
+ * @autoscale: An #UberAutoscale.
+ * @range: The range to shrink.
+ * @values: The range of the values still shown.
+ *
+ * Shrinks the end of @range towards the largest of @values if there is
+ * enough space free and it has not changed within the interval.
+ *
+ * Returns: %TRUE if @range changed.
+ * Side effects: None.
+ */
+gboolean
+uber_autoscale_shrink (UberAutoscale   *autoscale, /* IN */
+                       UberRange       *range,     /* IN/OUT */
+                       const UberRange *values)    /* IN */
+{
+	gdouble end;
+	gint64 now;
+
+	g_return_val_if_fail(autoscale != NULL, FALSE);
+	g_return_val_if_fail(range != NULL, FALSE);
+	g_return_val_if_fail(values != NULL, FALSE);
+
+	now = uber_autoscale_get_time();
+	if ((now - autoscale->last_change) < autoscale->interval ||
+	    values->end <= 0.) {
+		return FALSE;
+	}
+	end = uber_autoscale_nice_ceil(values->end * (1. + autoscale->headroom) /
+	                               (1. - autoscale->hysteresis));
+	if (end >= range->end || end <= range->begin) {
+		return FALSE;
+	}
+	range->end = end;
+	range->range = range->end - range->begin;
+	autoscale->last_change = now;
+	return TRUE;
+}
@@ -0,0 +1,58 @@
+/* uber-autoscale.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_AUTOSCALE_H__
+#define __UBER_AUTOSCALE_H__
+
+#include <glib.h>
+
+#include "uber-range.h"
+
+G_BEGIN_DECLS
+
+/**
+ * UberAutoscale:
+ *
+ * #UberAutoscale decides when the y-axis range of a graph should grow or
+ * shrink to fit its values.  Ranges are rounded out to "nice" steps with
+ * some headroom, and shrinking is held back by a hysteresis margin and a
+ * minimum interval, so that a jittery series only causes a bounded number
+ * of full redraws.
+ */
+typedef struct _UberAutoscale UberAutoscale;
+
+UberAutoscale* uber_autoscale_new            (void);
+void           uber_autoscale_free           (UberAutoscale   *autoscale);
+void           uber_autoscale_set_policy     (UberAutoscale   *autoscale,
+                                              gdouble          headroom,
+                                              gdouble          hysteresis,
+                                              gdouble          interval);
+gdouble        uber_autoscale_nice_ceil      (gdouble          value);
+gboolean       uber_autoscale_grow           (UberAutoscale   *autoscale,
+                                              UberRange       *range,
+                                              gdouble          value);
+gboolean       uber_autoscale_grow_range     (UberAutoscale   *autoscale,
+                                              UberRange       *range,
+                                              const UberRange *values);
+gboolean       uber_autoscale_shrink         (UberAutoscale   *autoscale,
+                                              UberRange       *range,
+                                              const UberRange *values);
+
+G_END_DECLS
+
+#endif /* __UBER_AUTOSCALE_H__ */
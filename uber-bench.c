@@ -0,0 +1,309 @@
+/* uber-bench.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "uber-bench.h"
+
+#define NSEC_PER_USEC (1000.)
+#define TIMEVAL_SEC(tv) ((tv).tv_sec + ((tv).tv_usec / 1000000.))
+
+struct _UberBench
+{
+	gchar          *name;      /* Name of the benchmark. */
+	GArray        **samples;   /* Array of gint64 samples per series. */
+	gchar         **series;    /* Names of the series. */
+	guint           n_series;  /* Number of series. */
+	GString        *params;    /* JSON members describing the run. */
+	gboolean        running;   /* Are samples being recorded. */
+	gdouble         wall;      /* Wall seconds of the run. */
+	gdouble         cpu;       /* CPU seconds of the run. */
+	glong           max_rss;   /* Peak resident set size in KiB. */
+	struct timespec begin;     /* Wall time at start. */
+	struct rusage   usage;     /* Resource usage at start. */
+};
+
+/**
+ * uber_bench_new:
+ * @name: The name of the benchmark.
+ * @series: The names of the timing series.
+ * @n_series: The number of timing series.
+ *
+ * Creates a new #UberBench.  Samples are added to a series by its index
+ * within @series.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_bench_free().
+ * Side effects: None.
+ */
+UberBench*
+uber_bench_new (const gchar         *name,     /* IN */
+                const gchar * const *series,   /* IN */
+                guint                n_series) /* IN */
+{
+	UberBench *bench;
+	gint i;
+
+	g_return_val_if_fail(name != NULL, NULL);
+	g_return_val_if_fail(series != NULL, NULL);
+
+	bench = g_slice_new0(UberBench);
+	bench->name = g_strdup(name);
+	bench->n_series = n_series;
+	bench->series = g_new0(gchar*, n_series + 1);
+	bench->samples = g_new0(GArray*, n_series);
+	for (i = 0; i < n_series; i++) {
+		bench->series[i] = g_strdup(series[i]);
+		bench->samples[i] = g_array_new(FALSE, FALSE, sizeof(gint64));
+	}
+	bench->params = g_string_new(NULL);
+	return bench;
+}
+
+/**
+ * uber_bench_free:
+ * @bench: An #UberBench.
+ *
+ * Frees @bench and its samples.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_bench_free (UberBench *bench) /* IN */
+{
+	gint i;
+
+	g_return_if_fail(bench != NULL);
+
+	for (i = 0; i < bench->n_series; i++) {
+		g_array_unref(bench->samples[i]);
+	}
+	g_free(bench->samples);
+	g_strfreev(bench->series);
+	g_string_free(bench->params, TRUE);
+	g_free(bench->name);
+	g_slice_free(UberBench, bench);
+}
+
+/**
+ * uber_bench_add_param:
+ * @bench: An #UberBench.
+ * @key: The name of the parameter.
+ * @value: The value of the parameter.
+ *
+ * Records a parameter of the run, such as the number of graphs, so that it
+ * is included in the results.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_bench_add_param (UberBench   *bench, /* IN */
+                      const gchar *key,   /* IN */
+                      gdouble      value) /* IN */
+{
+	g_return_if_fail(bench != NULL);
+	g_return_if_fail(key != NULL);
+
+	g_string_append_printf(bench->params, "%s\"%s\": %g",
+	                       bench->params->len ? ", " : "", key, value);
+}
+
+/**
+ * uber_bench_add_sample:
+ * @bench: An #UberBench.
+ * @series: The index of the series.
+ * @elapsed: The measured time in nanoseconds.
+ *
+ * Adds a sample to a series.  Samples outside of uber_bench_start() and
+ * uber_bench_stop() are ignored so that warm up can be excluded.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_bench_add_sample (UberBench *bench,   /* IN */
+                       guint      series,  /* IN */
+                       gint64     elapsed) /* IN */
+{
+	g_return_if_fail(bench != NULL);
+	g_return_if_fail(series < bench->n_series);
+
+	if (bench->running) {
+		g_array_append_val(bench->samples[series], elapsed);
+	}
+}
+
+/**
+ * uber_bench_start:
+ * @bench: An #UberBench.
+ *
+ * Starts recording samples and resource usage.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_bench_start (UberBench *bench) /* IN */
+{
+	g_return_if_fail(bench != NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &bench->begin);
+	getrusage(RUSAGE_SELF, &bench->usage);
+	bench->running = TRUE;
+}
+
+/**
+ * uber_bench_stop:
+ * @bench: An #UberBench.
+ *
+ * Stops recording samples and calculates the resource usage of the run.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_bench_stop (UberBench *bench) /* IN */
+{
+	struct timespec end;
+	struct rusage usage;
+
+	g_return_if_fail(bench != NULL);
+	g_return_if_fail(bench->running);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	getrusage(RUSAGE_SELF, &usage);
+	bench->running = FALSE;
+	bench->wall = (end.tv_sec - bench->begin.tv_sec)
+	            + ((end.tv_nsec - bench->begin.tv_nsec) / 1000000000.);
+	bench->cpu = (TIMEVAL_SEC(usage.ru_utime) -
+	              TIMEVAL_SEC(bench->usage.ru_utime)) +
+	             (TIMEVAL_SEC(usage.ru_stime) -
+	              TIMEVAL_SEC(bench->usage.ru_stime));
+	bench->max_rss = usage.ru_maxrss;
+}
+
+/**
+ * uber_bench_compare:
+ * @a: A gint64.
+ * @b: A gint64.
+ *
+ * qsort() style comparison of two samples.
+ *
+ * Returns: Less than, equal to, or greater than zero.
+ * Side effects: None.
+ */
+static gint
+uber_bench_compare (gconstpointer a, /* IN */
+                    gconstpointer b) /* IN */
+{
+	gint64 av = *(const gint64 *)a;
+	gint64 bv = *(const gint64 *)b;
+
+	return (av > bv) - (av < bv);
+}
+
+/**
+ * uber_bench_percentile:
+ * @sorted: A sorted array of gint64 samples.
+ * @percent: The percentile to retrieve.
+ *
+ * Retrieves a percentile of @sorted using the nearest rank.
+ *
+ * Returns: The percentile in microseconds.
+ * Side effects: None.
+ */
+static inline gdouble
+uber_bench_percentile (GArray  *sorted,  /* IN */
+                       gdouble  percent) /* IN */
+{
+	guint rank;
+
+	if (!sorted->len) {
+		return 0.;
+	}
+	rank = MIN(sorted->len - 1, (guint)(percent / 100. * sorted->len));
+	return g_array_index(sorted, gint64, rank) / NSEC_PER_USEC;
+}
+
+/**
+ * uber_bench_write_json:
+ * @bench: An #UberBench.
+ * @stream: A FILE to write to.
+ *
+ * Writes the results of the run to @stream as a JSON object.  Times are
+ * in microseconds; "cpu_per_sec" is the cpu seconds used per wall second.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_bench_write_json (UberBench *bench,  /* IN */
+                       FILE      *stream) /* IN */
+{
+	GArray *sorted;
+	gdouble total;
+	gint i;
+	gint j;
+
+	g_return_if_fail(bench != NULL);
+	g_return_if_fail(stream != NULL);
+
+	fprintf(stream, "{\n");
+	fprintf(stream, "  \"name\": \"%s\",\n", bench->name);
+	fprintf(stream, "  \"params\": { %s },\n", bench->params->str);
+	fprintf(stream, "  \"seconds\": %.3f,\n", bench->wall);
+	fprintf(stream, "  \"cpu_per_sec\": %.4f,\n",
+	        bench->wall > 0. ? bench->cpu / bench->wall : 0.);
+	fprintf(stream, "  \"peak_rss_kb\": %ld,\n", bench->max_rss);
+	fprintf(stream, "  \"series\": {\n");
+	for (i = 0; i < bench->n_series; i++) {
+		sorted = g_array_sized_new(FALSE, FALSE, sizeof(gint64),
+		                           bench->samples[i]->len);
+		g_array_append_vals(sorted, bench->samples[i]->data,
+		                    bench->samples[i]->len);
+		g_array_sort(sorted, uber_bench_compare);
+		total = 0.;
+		for (j = 0; j < sorted->len; j++) {
+			total += g_array_index(sorted, gint64, j);
+		}
+		fprintf(stream,
+		        "    \"%s\": { \"count\": %u, \"per_sec\": %.2f, "
+		        "\"mean_us\": %.2f, \"p50_us\": %.2f, \"p90_us\": %.2f, "
+		        "\"p99_us\": %.2f, \"max_us\": %.2f }%s\n",
+		        bench->series[i], sorted->len,
+		        bench->wall > 0. ? sorted->len / bench->wall : 0.,
+		        sorted->len ? total / sorted->len / NSEC_PER_USEC : 0.,
+		        uber_bench_percentile(sorted, 50.),
+		        uber_bench_percentile(sorted, 90.),
+		        uber_bench_percentile(sorted, 99.),
+		        uber_bench_percentile(sorted, 100.),
+		        (i + 1 < bench->n_series) ? "," : "");
+		g_array_unref(sorted);
+	}
+	fprintf(stream, "  }\n");
+	fprintf(stream, "}\n");
+	fflush(stream);
+}
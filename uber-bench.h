@@ -0,0 +1,54 @@
+/* uber-bench.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_BENCH_H__
+#define __UBER_BENCH_H__
+
+#include <stdio.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberBench:
+ *
+ * #UberBench collects the results of a benchmark run: samples of named
+ * timing series, the cpu time and wall time between uber_bench_start() and
+ * uber_bench_stop(), and the peak resident set size.  The results are
+ * written as a single JSON object so that runs can be compared by scripts.
+ */
+typedef struct _UberBench UberBench;
+
+UberBench* uber_bench_new        (const gchar         *name,
+                                  const gchar * const *series,
+                                  guint                n_series);
+void       uber_bench_free       (UberBench           *bench);
+void       uber_bench_add_param  (UberBench           *bench,
+                                  const gchar         *key,
+                                  gdouble              value);
+void       uber_bench_add_sample (UberBench           *bench,
+                                  guint                series,
+                                  gint64               elapsed);
+void       uber_bench_start      (UberBench           *bench);
+void       uber_bench_stop       (UberBench           *bench);
+void       uber_bench_write_json (UberBench           *bench,
+                                  FILE                *stream);
+
+G_END_DECLS
+
+#endif /* __UBER_BENCH_H__ */
@@ -0,0 +1,310 @@
+/* uber-fps-governor.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <time.h>
+
+#include "uber-fps-governor.h"
+
+#define NSEC_PER_SEC   (1000000000.)
+#define MIN_FPS        (1)
+#define COST_WEIGHT    (0.125) /* Weight of a new sample in the average. */
+#define EVAL_INTERVAL  G_GINT64_CONSTANT(500000000)
+#define RECOVER_MARGIN (1.25)  /* Headroom required before raising fps. */
+
+/**
+ * SECTION:uber-fps-governor
+ * @title: UberFpsGovernor
+ * @short_description: Frame rate control from measured render cost.
+ *
+ * The time spent between uber_fps_governor_begin() and
+ * uber_fps_governor_end() is accumulated as the cost of the current frame.
+ * Each call to uber_fps_governor_tick() closes a frame and folds its cost
+ * into an exponentially weighted moving average.
+ *
+ * The budget is the fraction of one CPU that rendering may consume.  At
+ * most twice a second, the frame rate that the budget affords is computed
+ * from the average cost.  If the current rate is above it, the rate drops
+ * to it immediately.  If there is enough headroom, the rate is raised by
+ * one frame per second towards the requested rate so that it does not
+ * oscillate around the limit.
+ */
+
+struct _UberFpsGovernor
+{
+	guint   fps;        /* Requested frames per second. */
+	guint   fps_real;   /* Effective frames per second. */
+	gdouble budget;     /* Fraction of a CPU, or 0 for no limit. */
+	gdouble cost;       /* Average cost of a frame in nanoseconds. */
+	gint64  frame_cost; /* Accumulated cost of the current frame. */
+	gint64  begin;      /* Start of the current measurement. */
+	gint64  last_eval;  /* Frame time of the last evaluation. */
+};
+
+/**
+ * uber_fps_governor_get_time:
+ *
+ * Retrieves the current monotonic time in nanoseconds.
+ *
+ * Returns: The monotonic time.
+ * Side effects: None.
+ */
+static inline gint64
+uber_fps_governor_get_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000)) + ts.tv_nsec;
+}
+
+/**
+ * uber_fps_governor_new:
+ * @fps: The requested frames per second.
+ *
+ * Creates a new #UberFpsGovernor with no budget.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_fps_governor_free().
+ * Side effects: None.
+ */
+UberFpsGovernor*
+uber_fps_governor_new (guint fps) /* IN */
+{
+	UberFpsGovernor *governor;
+
+	g_return_val_if_fail(fps > 0, NULL);
+
+	governor = g_slice_new0(UberFpsGovernor);
+	governor->fps = fps;
+	governor->fps_real = fps;
+	return governor;
+}
+
+/**
+ * uber_fps_governor_free:
+ * @governor: An #UberFpsGovernor.
+ *
+ * Frees @governor.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_fps_governor_free (UberFpsGovernor *governor) /* IN */
+{
+	g_return_if_fail(governor != NULL);
+
+	g_slice_free(UberFpsGovernor, governor);
+}
+
+/**
+ * uber_fps_governor_set_fps:
+ * @governor: An #UberFpsGovernor.
+ * @fps: The requested frames per second.
+ *
+ * Sets the frame rate that @governor tries to achieve.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_fps_governor_set_fps (UberFpsGovernor *governor, /* IN */
+                           guint            fps)      /* IN */
+{
+	g_return_if_fail(governor != NULL);
+	g_return_if_fail(fps > 0);
+
+	governor->fps = fps;
+	governor->fps_real = MIN(governor->fps_real, fps);
+	if (governor->budget <= 0.) {
+		governor->fps_real = fps;
+	}
+}
+
+/**
+ * uber_fps_governor_get_fps:
+ * @governor: An #UberFpsGovernor.
+ *
+ * Retrieves the frame rate that should currently be rendered.
+ *
+ * Returns: The effective frames per second.
+ * Side effects: None.
+ */
+guint
+uber_fps_governor_get_fps (UberFpsGovernor *governor) /* IN */
+{
+	g_return_val_if_fail(governor != NULL, MIN_FPS);
+
+	return governor->fps_real;
+}
+
+/**
+ * uber_fps_governor_set_budget:
+ * @governor: An #UberFpsGovernor.
+ * @budget: The fraction of one CPU that rendering may use, or 0.
+ *
+ * Sets the share of a CPU that rendering may consume.  A @budget of 0
+ * disables the governor and the requested frame rate is always used.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_fps_governor_set_budget (UberFpsGovernor *governor, /* IN */
+                              gdouble          budget)   /* IN */
+{
+	g_return_if_fail(governor != NULL);
+	g_return_if_fail(budget >= 0.);
+
+	governor->budget = budget;
+	if (budget <= 0.) {
+		governor->fps_real = governor->fps;
+	}
+}
+
+/**
+ * uber_fps_governor_get_budget:
+ * @governor: An #UberFpsGovernor.
+ *
+ * Retrieves the share of a CPU that rendering may consume.
+ *
+ * Returns: The budget, or 0 if disabled.
+ * Side effects: None.
+ */
+gdouble
+uber_fps_governor_get_budget (UberFpsGovernor *governor) /* IN */
+{
+	g_return_val_if_fail(governor != NULL, 0.);
+
+	return governor->budget;
+}
+
+/**
+ * uber_fps_governor_get_cost:
+ * @governor: An #UberFpsGovernor.
+ *
+ * Retrieves the average cost of rendering a frame.
+ *
+ * Returns: The cost in milliseconds.
+ * Side effects: None.
+ */
+gdouble
+uber_fps_governor_get_cost (UberFpsGovernor *governor) /* IN */
+{
+	g_return_val_if_fail(governor != NULL, 0.);
+
+	return governor->cost / 1000000.;
+}
+
+/**
+ * uber_fps_governor_begin:
+ * @governor: An #UberFpsGovernor.
+ *
+ * Starts measuring a section of rendering work.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_fps_governor_begin (UberFpsGovernor *governor) /* IN */
+{
+	g_return_if_fail(governor != NULL);
+
+	governor->begin = uber_fps_governor_get_time();
+}
+
+/**
+ * uber_fps_governor_end:
+ * @governor: An #UberFpsGovernor.
+ *
+ * Stops measuring a section of rendering work and adds its duration to
+ * the cost of the current frame.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_fps_governor_end (UberFpsGovernor *governor) /* IN */
+{
+	g_return_if_fail(governor != NULL);
+
+	if (governor->begin) {
+		governor->frame_cost += uber_fps_governor_get_time() - governor->begin;
+		governor->begin = 0;
+	}
+}
+
+/**
+ * uber_fps_governor_tick:
+ * @governor: An #UberFpsGovernor.
+ * @frame_time: The monotonic time of the frame in nanoseconds.
+ *
+ * Closes the current frame and re-evaluates the frame rate if needed.
+ *
+ * Returns: %TRUE if the effective frame rate changed; otherwise %FALSE.
+ * Side effects: None.
+ */
+gboolean
+uber_fps_governor_tick (UberFpsGovernor *governor,   /* IN */
+                        gint64           frame_time) /* IN */
+{
+	gdouble allowed;
+	guint fps_real;
+
+	g_return_val_if_fail(governor != NULL, FALSE);
+
+	/*
+	 * Fold the cost of this frame into the running average.
+	 */
+	if (governor->cost == 0.) {
+		governor->cost = governor->frame_cost;
+	} else {
+		governor->cost += COST_WEIGHT * (governor->frame_cost - governor->cost);
+	}
+	governor->frame_cost = 0;
+	/*
+	 * Only evaluate periodically so a single slow frame does not cause
+	 * the frame rate to jump around.
+	 */
+	if (governor->budget <= 0. || governor->cost <= 0.) {
+		return FALSE;
+	}
+	if ((frame_time - governor->last_eval) < EVAL_INTERVAL) {
+		return FALSE;
+	}
+	governor->last_eval = frame_time;
+	/*
+	 * Back off immediately, recover one frame at a time.
+	 */
+	fps_real = governor->fps_real;
+	allowed = governor->budget * NSEC_PER_SEC / governor->cost;
+	if (allowed < fps_real) {
+		fps_real = MAX(MIN_FPS, (guint)allowed);
+	} else if (allowed >= (fps_real + 1) * RECOVER_MARGIN) {
+		fps_real = MIN(governor->fps, fps_real + 1);
+	}
+	if (fps_real != governor->fps_real) {
+		governor->fps_real = fps_real;
+		return TRUE;
+	}
+	return FALSE;
+}
@@ -0,0 +1,52 @@
+/* uber-fps-governor.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_FPS_GOVERNOR_H__
+#define __UBER_FPS_GOVERNOR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberFpsGovernor:
+ *
+ * #UberFpsGovernor measures how long a graph spends rendering each frame
+ * and lowers the frame rate when rendering would exceed a share of the CPU.
+ * The frame rate recovers gradually towards the requested rate once the
+ * cost of rendering drops.
+ */
+typedef struct _UberFpsGovernor UberFpsGovernor;
+
+UberFpsGovernor* uber_fps_governor_new        (guint            fps);
+void             uber_fps_governor_free       (UberFpsGovernor *governor);
+void             uber_fps_governor_set_fps    (UberFpsGovernor *governor,
+                                               guint            fps);
+guint            uber_fps_governor_get_fps    (UberFpsGovernor *governor);
+void             uber_fps_governor_set_budget (UberFpsGovernor *governor,
+                                               gdouble          budget);
+gdouble          uber_fps_governor_get_budget (UberFpsGovernor *governor);
+gdouble          uber_fps_governor_get_cost   (UberFpsGovernor *governor);
+void             uber_fps_governor_begin      (UberFpsGovernor *governor);
+void             uber_fps_governor_end        (UberFpsGovernor *governor);
+gboolean         uber_fps_governor_tick       (UberFpsGovernor *governor,
+                                               gint64           frame_time);
+
+G_END_DECLS
+
+#endif /* __UBER_FPS_GOVERNOR_H__ */
@@ -0,0 +1,476 @@
+/* uber-frame-clock.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gdk/gdk.h>
+#include <time.h>
+
+#include "uber-frame-clock.h"
+
+#define NSEC_PER_SEC  G_GINT64_CONSTANT(1000000000)
+#define NSEC_PER_MSEC G_GINT64_CONSTANT(1000000)
+#define DEFAULT_FPS   (60)
+
+/**
+ * SECTION:uber-frame-clock
+ * @title: UberFrameClock
+ * @short_description: Shared frame timing for a set of graphs.
+ *
+ * Without a shared clock, every graph installs its own timeouts and a window
+ * full of graphs wakes up at as many unaligned phases.  #UberFrameClock is a
+ * single #GSource which keeps a list of clients, each with an absolute
+ * deadline on %CLOCK_MONOTONIC in nanoseconds.  Deadlines are rounded up to
+ * the next tick of the clock's frame grid so that clients due at about the
+ * same time are dispatched together.  Once every due client has run,
+ * pending window invalidations are processed in a single pass.
+ */
+
+typedef struct
+{
+	guint              id;       /* Client identifier. */
+	gint64             deadline; /* Grid aligned deadline, or -1 if idle. */
+	UberFrameClockFunc func;     /* Client callback, NULL once removed. */
+	gpointer           data;     /* User data for func. */
+} UberFrameClockClient;
+
+typedef struct
+{
+	GSource         source;
+	UberFrameClock *clock;
+} UberFrameClockSource;
+
+struct _UberFrameClock
+{
+	volatile gint  ref_count;   /* Reference count. */
+	GSource       *source;      /* Main loop source. */
+	GList         *clients;     /* List of UberFrameClockClient. */
+	guint          last_id;     /* Last handed out client id. */
+	gint64         epoch;       /* Origin of the frame grid. */
+	gint64         period;      /* Frame grid period in nanoseconds. */
+	gint64         frame_time;  /* Time of the frame being dispatched. */
+	gboolean       in_dispatch; /* Are clients currently being ticked. */
+	gboolean       removed;     /* Were clients removed during dispatch. */
+};
+
+static UberFrameClock *default_clock = NULL;
+
+/**
+ * uber_frame_clock_get_time:
+ *
+ * Retrieves the current monotonic time in nanoseconds.
+ *
+ * Returns: The monotonic time.
+ * Side effects: None.
+ */
+gint64
+uber_frame_clock_get_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((gint64)ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+/**
+ * uber_frame_clock_align:
+ * @clock: An #UberFrameClock.
+ * @deadline: An absolute deadline in nanoseconds.
+ *
+ * Rounds @deadline up to the next tick of the frame grid.
+ *
+ * Returns: The aligned deadline.
+ * Side effects: None.
+ */
+static inline gint64
+uber_frame_clock_align (UberFrameClock *clock,    /* IN */
+                        gint64          deadline) /* IN */
+{
+	gint64 rel;
+
+	if (deadline < 0) {
+		return -1;
+	}
+	rel = deadline - clock->epoch;
+	if (rel <= 0) {
+		return clock->epoch;
+	}
+	return clock->epoch + (((rel + clock->period - 1) / clock->period)
+	                       * clock->period);
+}
+
+/**
+ * uber_frame_clock_find:
+ * @clock: An #UberFrameClock.
+ * @id: A client id.
+ *
+ * Finds the client identified by @id.
+ *
+ * Returns: The client or %NULL.
+ * Side effects: None.
+ */
+static UberFrameClockClient*
+uber_frame_clock_find (UberFrameClock *clock, /* IN */
+                       guint           id)    /* IN */
+{
+	UberFrameClockClient *client;
+	GList *iter;
+
+	for (iter = clock->clients; iter; iter = iter->next) {
+		client = iter->data;
+		if (client->id == id && client->func) {
+			return client;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * uber_frame_clock_prune:
+ * @clock: An #UberFrameClock.
+ *
+ * Frees clients that were removed while the clock was dispatching.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_frame_clock_prune (UberFrameClock *clock) /* IN */
+{
+	UberFrameClockClient *client;
+	GList *iter;
+	GList *next;
+
+	for (iter = clock->clients; iter; iter = next) {
+		next = iter->next;
+		client = iter->data;
+		if (!client->func) {
+			clock->clients = g_list_delete_link(clock->clients, iter);
+			g_slice_free(UberFrameClockClient, client);
+		}
+	}
+	clock->removed = FALSE;
+}
+
+static gboolean
+uber_frame_clock_prepare (GSource *source,  /* IN */
+                          gint    *timeout) /* OUT */
+{
+	UberFrameClock *clock = ((UberFrameClockSource *)source)->clock;
+	UberFrameClockClient *client;
+	gint64 deadline = -1;
+	gint64 now;
+	GList *iter;
+
+	/*
+	 * Find the earliest deadline of all clients.
+	 */
+	for (iter = clock->clients; iter; iter = iter->next) {
+		client = iter->data;
+		if (client->func && client->deadline >= 0) {
+			if (deadline < 0 || client->deadline < deadline) {
+				deadline = client->deadline;
+			}
+		}
+	}
+	if (deadline < 0) {
+		*timeout = -1;
+		return FALSE;
+	}
+	/*
+	 * Round the delay up so that we never wake before the deadline.
+	 */
+	now = uber_frame_clock_get_time();
+	if (deadline <= now) {
+		*timeout = 0;
+		return TRUE;
+	}
+	*timeout = (deadline - now + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+	return FALSE;
+}
+
+static gboolean
+uber_frame_clock_check (GSource *source) /* IN */
+{
+	gint timeout;
+
+	return uber_frame_clock_prepare(source, &timeout);
+}
+
+static gboolean
+uber_frame_clock_dispatch (GSource     *source,    /* IN */
+                           GSourceFunc  callback,  /* IN */
+                           gpointer     user_data) /* IN */
+{
+	UberFrameClock *clock = ((UberFrameClockSource *)source)->clock;
+	UberFrameClockClient *client;
+	gint64 deadline;
+	GList *iter;
+
+	/*
+	 * Tick every client that is due using the same frame time so that
+	 * their scroll offsets agree with each other.
+	 */
+	uber_frame_clock_ref(clock);
+	clock->frame_time = uber_frame_clock_get_time();
+	clock->in_dispatch = TRUE;
+	for (iter = clock->clients; iter; iter = iter->next) {
+		client = iter->data;
+		if (!client->func || client->deadline < 0 ||
+		    client->deadline > clock->frame_time) {
+			continue;
+		}
+		client->deadline = -1;
+		deadline = client->func(clock, clock->frame_time, client->data);
+		/*
+		 * The client may have been removed or rescheduled from within
+		 * its callback.
+		 */
+		if (client->func && client->deadline < 0) {
+			client->deadline = uber_frame_clock_align(clock, deadline);
+		}
+	}
+	/*
+	 * Flush the invalidations queued by the clients in one expose pass.
+	 * The frame time stays valid so that exposes agree with the ticks.
+	 */
+	gdk_window_process_all_updates();
+	clock->in_dispatch = FALSE;
+	if (clock->removed) {
+		uber_frame_clock_prune(clock);
+	}
+	uber_frame_clock_unref(clock);
+	return TRUE;
+}
+
+static GSourceFuncs uber_frame_clock_funcs = {
+	uber_frame_clock_prepare,
+	uber_frame_clock_check,
+	uber_frame_clock_dispatch,
+	NULL,
+};
+
+/**
+ * uber_frame_clock_new:
+ * @fps: The rate of the frame grid.
+ *
+ * Creates a new #UberFrameClock and attaches it to the default main
+ * context.  Client deadlines are aligned to multiples of 1 / @fps seconds.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_frame_clock_unref().
+ * Side effects: None.
+ */
+UberFrameClock*
+uber_frame_clock_new (guint fps) /* IN */
+{
+	UberFrameClock *clock;
+
+	g_return_val_if_fail(fps > 0, NULL);
+
+	clock = g_slice_new0(UberFrameClock);
+	clock->ref_count = 1;
+	clock->period = NSEC_PER_SEC / fps;
+	clock->epoch = uber_frame_clock_get_time();
+	clock->frame_time = clock->epoch;
+	clock->source = g_source_new(&uber_frame_clock_funcs,
+	                             sizeof(UberFrameClockSource));
+	((UberFrameClockSource *)clock->source)->clock = clock;
+#if GLIB_CHECK_VERSION(2, 25, 8)
+	g_source_set_name(clock->source, "Uber frame clock");
+#endif
+	g_source_attach(clock->source, NULL);
+	return clock;
+}
+
+/**
+ * uber_frame_clock_get_default:
+ *
+ * Retrieves the process wide #UberFrameClock.  Graphs which have not been
+ * given a clock explicitly share this one.
+ *
+ * Returns: An #UberFrameClock which should not be unref'd.
+ * Side effects: The default clock is created on first use.
+ */
+UberFrameClock*
+uber_frame_clock_get_default (void)
+{
+	if (G_UNLIKELY(!default_clock)) {
+		default_clock = uber_frame_clock_new(DEFAULT_FPS);
+	}
+	return default_clock;
+}
+
+/**
+ * uber_frame_clock_ref:
+ * @clock: An #UberFrameClock.
+ *
+ * Atomically increments the reference count of @clock by one.
+ *
+ * Returns: A reference to @clock.
+ * Side effects: None.
+ */
+UberFrameClock*
+uber_frame_clock_ref (UberFrameClock *clock) /* IN */
+{
+	g_return_val_if_fail(clock != NULL, NULL);
+	g_return_val_if_fail(clock->ref_count > 0, NULL);
+
+	g_atomic_int_inc(&clock->ref_count);
+	return clock;
+}
+
+/**
+ * uber_frame_clock_unref:
+ * @clock: An #UberFrameClock.
+ *
+ * Atomically decrements the reference count of @clock by one.  When the
+ * reference count reaches zero, the source is removed from the main loop
+ * and the structure is freed.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_frame_clock_unref (UberFrameClock *clock) /* IN */
+{
+	GList *iter;
+
+	g_return_if_fail(clock != NULL);
+	g_return_if_fail(clock->ref_count > 0);
+
+	if (g_atomic_int_dec_and_test(&clock->ref_count)) {
+		g_source_destroy(clock->source);
+		g_source_unref(clock->source);
+		for (iter = clock->clients; iter; iter = iter->next) {
+			g_slice_free(UberFrameClockClient, iter->data);
+		}
+		g_list_free(clock->clients);
+		g_slice_free(UberFrameClock, clock);
+	}
+}
+
+/**
+ * uber_frame_clock_add:
+ * @clock: An #UberFrameClock.
+ * @func: The callback to tick.
+ * @user_data: User data for @func.
+ *
+ * Adds a client to @clock.  The client is idle until a deadline is set
+ * with uber_frame_clock_schedule().
+ *
+ * Returns: A client id greater than zero.
+ * Side effects: None.
+ */
+guint
+uber_frame_clock_add (UberFrameClock     *clock,     /* IN */
+                      UberFrameClockFunc  func,      /* IN */
+                      gpointer            user_data) /* IN */
+{
+	UberFrameClockClient *client;
+
+	g_return_val_if_fail(clock != NULL, 0);
+	g_return_val_if_fail(func != NULL, 0);
+
+	client = g_slice_new0(UberFrameClockClient);
+	client->id = ++clock->last_id;
+	client->deadline = -1;
+	client->func = func;
+	client->data = user_data;
+	clock->clients = g_list_append(clock->clients, client);
+	return client->id;
+}
+
+/**
+ * uber_frame_clock_remove:
+ * @clock: An #UberFrameClock.
+ * @id: A client id returned from uber_frame_clock_add().
+ *
+ * Removes a client from @clock.  It is safe to call this from within a
+ * client callback.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_frame_clock_remove (UberFrameClock *clock, /* IN */
+                         guint           id)    /* IN */
+{
+	UberFrameClockClient *client;
+
+	g_return_if_fail(clock != NULL);
+
+	if (!(client = uber_frame_clock_find(clock, id))) {
+		return;
+	}
+	client->func = NULL;
+	clock->removed = TRUE;
+	if (!clock->in_dispatch) {
+		uber_frame_clock_prune(clock);
+	}
+}
+
+/**
+ * uber_frame_clock_schedule:
+ * @clock: An #UberFrameClock.
+ * @id: A client id returned from uber_frame_clock_add().
+ * @deadline: The absolute monotonic deadline in nanoseconds, or -1.
+ *
+ * Sets the next deadline for a client, replacing any previous deadline.
+ * The deadline is rounded up to the frame grid of @clock.  A @deadline of
+ * -1 leaves the client idle.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_frame_clock_schedule (UberFrameClock *clock,    /* IN */
+                           guint           id,       /* IN */
+                           gint64          deadline) /* IN */
+{
+	UberFrameClockClient *client;
+
+	g_return_if_fail(clock != NULL);
+
+	if ((client = uber_frame_clock_find(clock, id))) {
+		client->deadline = uber_frame_clock_align(clock, deadline);
+	}
+}
+
+/**
+ * uber_frame_clock_get_frame_time:
+ * @clock: An #UberFrameClock.
+ *
+ * Retrieves the time of the frame currently being dispatched.  Outside of
+ * a dispatch, the current monotonic time is returned.
+ *
+ * Returns: The frame time in nanoseconds.
+ * Side effects: None.
+ */
+gint64
+uber_frame_clock_get_frame_time (UberFrameClock *clock) /* IN */
+{
+	g_return_val_if_fail(clock != NULL, 0);
+
+	if (clock->in_dispatch) {
+		return clock->frame_time;
+	}
+	return uber_frame_clock_get_time();
+}
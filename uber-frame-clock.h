@@ -0,0 +1,69 @@
+/* uber-frame-clock.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_FRAME_CLOCK_H__
+#define __UBER_FRAME_CLOCK_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberFrameClock:
+ *
+ * #UberFrameClock drives the animation of many graphs from a single main
+ * loop source.  Client deadlines are rounded up onto a shared frame grid so
+ * that graphs with similar rates wake up in the same main loop iteration,
+ * and their invalidations are flushed together in a single expose pass.
+ */
+typedef struct _UberFrameClock UberFrameClock;
+
+/**
+ * UberFrameClockFunc:
+ * @clock: An #UberFrameClock.
+ * @frame_time: The monotonic time of this frame in nanoseconds.
+ * @user_data: User data supplied to uber_frame_clock_add().
+ *
+ * Callback invoked when a client deadline has been reached.
+ *
+ * Returns: The next absolute deadline in nanoseconds, or -1 to sleep until
+ *   uber_frame_clock_schedule() is called.
+ * Side effects: Implementation specific.
+ */
+typedef gint64 (*UberFrameClockFunc) (UberFrameClock *clock,
+                                      gint64          frame_time,
+                                      gpointer        user_data);
+
+UberFrameClock* uber_frame_clock_new            (guint               fps);
+UberFrameClock* uber_frame_clock_get_default    (void);
+UberFrameClock* uber_frame_clock_ref            (UberFrameClock     *clock);
+void            uber_frame_clock_unref          (UberFrameClock     *clock);
+guint           uber_frame_clock_add            (UberFrameClock     *clock,
+                                                 UberFrameClockFunc  func,
+                                                 gpointer            user_data);
+void            uber_frame_clock_remove         (UberFrameClock     *clock,
+                                                 guint               id);
+void            uber_frame_clock_schedule       (UberFrameClock     *clock,
+                                                 guint               id,
+                                                 gint64              deadline);
+gint64          uber_frame_clock_get_frame_time (UberFrameClock     *clock);
+gint64          uber_frame_clock_get_time       (void);
+
+G_END_DECLS
+
+#endif /* __UBER_FRAME_CLOCK_H__ */
@@ -23,7 +23,12 @@
 #include <math.h>
 
 #include "uber-graph.h"
+#include "uber-autoscale.h"
 #include "uber-buffer.h"
+#include "uber-frame-clock.h"
+#include "uber-fps-governor.h"
+#include "uber-render-worker.h"
+#include "uber-text-cache.h"
 
 #define BASE_CLASS   (GTK_WIDGET_CLASS(uber_graph_parent_class))
 #define DEFAULT_SIZE (64)
@@ -40,7 +45,10 @@
 #define GIBIBYTE     (1073741824)
 #define GIBIBYTE_STR ("Gi")
 
-#define SCALE_FACTOR (1.3334)
+#define NSEC_PER_SEC G_GINT64_CONSTANT(1000000000)
+#define REDRAW_BUDGET (NSEC_PER_SEC / 250) /* Time per slice of a full redraw. */
+#define REDRAW_CHUNK  (16)                 /* Segments rendered between clock checks. */
+#define DEFAULT_RENDER_BUDGET (0.05)
 
 #define GET_PIXEL_RANGE(pr, rect)                \
     G_STMT_START {                               \
@@ -51,28 +59,25 @@
 
 #define DRAW_Y_LABEL_FRACTION(y, i, n)                               \
     G_STMT_START {                                                   \
-        gchar *v = uber_graph_get_ylabel_at_pos(graph, y, i, n);     \
+        gchar v[64];                                                 \
         gint h, w;                                                   \
-        pango_layout_set_markup(info->tick_layout, v, -1);           \
-        pango_layout_get_pixel_size(info->tick_layout, &w, &h);      \
-        cairo_move_to(info->bg_cairo,                                \
+        uber_graph_get_ylabel_at_pos(graph, y, i, n, v, sizeof(v));  \
+        uber_text_cache_get_size(priv->label_cache, v, &w, &h);      \
+        uber_text_cache_show(priv->label_cache, info->bg_cairo, v,   \
                       priv->content_rect.x - priv->tick_len - w - 3, \
 		              ((gint)y) - (h / 2) + .5);                     \
-		pango_cairo_show_layout(info->bg_cairo, info->tick_layout);  \
-		g_free(v);                                                   \
     } G_STMT_END
 
 #define DRAW_Y_LABEL(_y, i)                                                \
     G_STMT_START {                                                         \
     	gdouble o = i;                                                     \
-    	gchar *v;                                                          \
+    	gchar v[64];                                                       \
         gint h, w;                                                         \
         gdouble ry = _y;                                                   \
         priv->scale(graph, &priv->yrange, &pixel_range, &o);               \
-    	v = g_strdup_printf("<span size=\"smaller\">%d </span>",           \
-    	                    (gint)i);                                      \
-        pango_layout_set_markup(info->tick_layout, v, -1);                 \
-        pango_layout_get_pixel_size(info->tick_layout, &w, &h);            \
+    	g_snprintf(v, sizeof(v), "<span size=\"smaller\">%d </span>",      \
+    	           (gint)i);                                               \
+        uber_text_cache_get_size(priv->label_cache, v, &w, &h);            \
         if (ry == -1) {                                                    \
 			ry = i;                                                        \
 			priv->scale(graph, &priv->yrange, &pixel_range, &ry);          \
@@ -84,38 +89,36 @@
 						  priv->content_rect.x + priv->content_rect.width, \
 						  (gint)ry + .5);                                  \
 			cairo_stroke(info->bg_cairo);                                  \
+			uber_graph_add_grid_line(graph, priv->content_rect.x,          \
+			                         (gint)ry, priv->content_rect.width, 1); \
 		}                                                                  \
-        cairo_move_to(info->bg_cairo,                                      \
+        uber_text_cache_show(priv->label_cache, info->bg_cairo, v,         \
                       priv->content_rect.x - priv->tick_len - w - 3,       \
 		              ((gint)ry) - (h / 2) + .5);                          \
-		pango_cairo_show_layout(info->bg_cairo, info->tick_layout);        \
-		g_free(v);                                                         \
     } G_STMT_END
 
 #ifdef UBER_TRACE
-#define TRACE(_f,...) \
-    G_STMT_START { \
-        g_log(G_LOG_DOMAIN, 1 << G_LOG_LEVEL_USER_SHIFT, _f, ## __VA_ARGS__); \
-    } G_STMT_END
-#define ENTRY TRACE("ENTRY: %s():%d", G_STRFUNC, __LINE__)
+#include "uber-trace.h"
+#define TRACE(_t,_l) uber_trace_record(_t, G_STRFUNC, _l, __LINE__)
+#define ENTRY TRACE(UBER_TRACE_ENTRY, NULL)
 #define EXIT \
     G_STMT_START { \
-        TRACE(" EXIT: %s():%d", G_STRFUNC, __LINE__); \
+        TRACE(UBER_TRACE_EXIT, NULL); \
         return; \
     } G_STMT_END
 #define RETURN(_r) \
     G_STMT_START { \
-        TRACE(" EXIT: %s():%d", G_STRFUNC, __LINE__); \
+        TRACE(UBER_TRACE_EXIT, NULL); \
         return (_r); \
 	} G_STMT_END
 #define GOTO(_l) \
     G_STMT_START { \
-        TRACE(" GOTO: %s():%d %s", G_STRFUNC, __LINE__, #_l); \
+        TRACE(UBER_TRACE_GOTO, #_l); \
         goto _l; \
 	} G_STMT_END
 #define CASE(_l) \
     case _l: \
-        TRACE(" CASE: %s():%d %s", G_STRFUNC, __LINE__, #_l)
+        TRACE(UBER_TRACE_CASE, #_l)
 #else
 #define ENTRY
 #define EXIT       return
@@ -137,17 +140,23 @@
  * When adding new values to the graph, the contents of the pixmap are shifted
  * and the new sliver of content added to the pixmap.  This helps reduce the
  * amount of data to send to the X-server.
+ *
+ * To render without a display, call uber_graph_set_offscreen() before the
+ * graph is realized.  The background and foreground are then kept in client
+ * side image surfaces, and frames are produced on demand with
+ * uber_graph_paint().
  */
 
 G_DEFINE_TYPE(UberGraph, uber_graph, GTK_TYPE_DRAWING_AREA)
 
 typedef struct
 {
-	GdkPixmap   *bg_pixmap;   /* Server-side pixmap for background. */
-	GdkPixmap   *fg_pixmap;   /* Server-side pixmap for foreground. */
-	cairo_t     *bg_cairo;    /* Cairo context for foreground pixmap. */
-	cairo_t     *fg_cairo;    /* Cairo context for background pixmap. */
-	PangoLayout *tick_layout; /* Pango layout for tick labels. */
+	GdkPixmap       *bg_pixmap;  /* Server-side pixmap for background. */
+	GdkPixmap       *fg_pixmap;  /* Server-side pixmap for foreground. */
+	cairo_surface_t *bg_surface; /* Image surface for offscreen background. */
+	cairo_surface_t *fg_surface; /* Image surface for offscreen foreground. */
+	cairo_t         *bg_cairo;   /* Cairo context for foreground pixmap. */
+	cairo_t         *fg_cairo;   /* Cairo context for background pixmap. */
 } GraphInfo;
 
 typedef struct
@@ -157,21 +166,49 @@ typedef struct
 	GdkColor    color;
 } LineInfo;
 
+typedef struct
+{
+	UberGraph       *graph;       /* Graph the job renders for. */
+	guint            serial;      /* render_serial when queued. */
+	guint            n_shifted;   /* n_shifted when queued. */
+	gint             slot;        /* fg_slot when queued. */
+	gint             x_slots;     /* Number of slots in the ring. */
+	gfloat           x_each;      /* Width of each slot. */
+	gint             width;       /* Width of the foreground ring. */
+	gint             height;      /* Height of the foreground ring. */
+	UberRange        pixel_range; /* Pixel range of the content area. */
+	gdouble          line_width;  /* Width of the lines. */
+	guint            n_lines;     /* Number of lines. */
+	GdkColor        *colors;      /* Color of each line. */
+	gdouble         *values;      /* Scaled values of each line, newest first. */
+	cairo_surface_t *surface;     /* Rendered foreground ring. */
+} RenderJob;
+
 struct _UberGraphPrivate
 {
-	GraphInfo         info[2];         /* Two GraphInfo's for swapping. */
-	gboolean          flipped;         /* Which GraphInfo is active. */
+	GraphInfo         info;            /* Server-side pixmaps. */
+	gboolean          offscreen;       /* Render without a GdkWindow. */
+	gint              fg_slot;         /* Next slot in the foreground ring. */
+	gint              scroll_off;      /* Frame offset of the last invalidation. */
+	GdkRegion        *grid_region;     /* Grid lines drawn within the content. */
+	guint             refine_handler;  /* Idle handler to redraw after a rescale. */
+	gint              redraw_k;        /* Next segment of a progressive redraw. */
+	guint             redraw_handler;  /* Idle handler continuing the redraw. */
+	gboolean          render_worker;   /* Render the foreground on worker threads. */
+	guint             render_serial;   /* Serial of the current worker render. */
+	guint             n_shifted;       /* Number of shifted renders so far. */
 	gint              tick_len;        /* Length of axis ticks in pixels. */
 	gdouble           line_width;      /* The desired line width. */
 	gint              fps;             /* Frames per second. */
 	gint              fps_calc;        /* Calculated FPS, might be reduced from fps. */
 	gint              fps_off;         /* Offset in frame-slide */
-	gint              fps_to;          /* Frames per second timeout (in MS) */
 	gint              stride;          /* Number of data points to store. */
 	gfloat            fps_each;        /* How much each frame skews. */
 	gfloat            x_each;          /* Precalculated space between points.  */
+	gint              x_slots;         /* Data points within the content area. */
 	UberGraphFormat   format;          /* The graph format. */
-	guint             fps_handler;     /* GSource identifier for invalidating rect. */
+	guint             fps_handler;     /* Frame clock client for invalidating rect. */
+	gint64            fps_deadline;    /* Monotonic deadline of the next frame. */
 	guint             down_handler;    /* Downscale timeout handler. */
 	UberScale         scale;           /* Scaling of values to pixels. */
 	UberRange         yrange;          /* Y-Axis range in for raw values. */
@@ -180,6 +217,7 @@ struct _UberGraphPrivate
 	gboolean          fg_dirty;        /* Do we need to update the foreground. */
 	gboolean          yautoscale;      /* Should the graph autoscale to handle values
 	                                    * outside the current range. */
+	UberAutoscale    *autoscale;       /* Policy for autoscaling the y-axis. */
 	gboolean          show_xlabel;     /* Should the xlabels be shown. */
 	gboolean          have_rgba;       /* Do we have RGBA colormaps. */
 	GdkGC            *bg_gc;           /* Drawing context for blitting background */
@@ -193,21 +231,19 @@ struct _UberGraphPrivate
 	UberGraphFunc     value_func;      /* Callback to retrieve next value. */
 	gpointer          value_user_data; /* User data for callback. */
 	GDestroyNotify    value_notify;    /* Cleanup callback for value_user_data. */
+	gboolean          mapped;          /* Is the widget mapped. */
+	gboolean          obscured;        /* Is the widget fully obscured. */
+	gboolean          iconified;       /* Is the toplevel iconified or withdrawn. */
+	gboolean          suspended;       /* Is rendering suspended. */
+	gboolean          rescale_pending; /* Did the scale change while suspended. */
+	GtkWidget        *toplevel;        /* Toplevel watched for state changes. */
+	gulong            state_handler;   /* Handler for "window-state-event". */
+	UberFpsGovernor  *governor;        /* Adapts fps to the render cost. */
+	UberGraphTimingFunc timing_func;   /* Callback for rendering times. */
+	gpointer          timing_data;     /* User data for timing_func. */
+	UberTextCache    *label_cache;     /* Rendered tick labels. */
 };
 
-typedef struct
-{
-	UberGraph *graph;
-	GraphInfo *info;
-	UberScale  scale;
-	UberRange  pixel_range;
-	UberRange  value_range;
-	gdouble    last_y;
-	gdouble    last_x;
-	gdouble    x_epoch;
-	gint       offset;
-	gboolean   first;
-} RenderClosure;
 
 enum
 {
@@ -236,8 +272,7 @@ static void uber_graph_calculate_rects        (UberGraph    *graph);
 static void uber_graph_init_graph_info        (UberGraph    *graph,
                                                GraphInfo    *info);
 static void uber_graph_render_fg_shifted_task (UberGraph    *graph,
-                                               GraphInfo    *src,
-                                               GraphInfo    *dst);
+                                               GraphInfo    *info);
 static void uber_graph_render_fg_task         (UberGraph    *graph,
                                                GraphInfo    *info);
 static void uber_graph_render_bg_task         (UberGraph    *graph,
@@ -263,25 +298,103 @@ uber_graph_new (void)
 	RETURN(GTK_WIDGET(graph));
 }
 
+/**
+ * uber_graph_get_fg_size:
+ * @info: A GraphInfo.
+ * @width: A location for the width.
+ * @height: A location for the height.
+ *
+ * Retrieves the size of the foreground ring, whether it is a pixmap or an
+ * offscreen image surface.
+ *
+ * Returns: %TRUE if the foreground exists; otherwise %FALSE.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_get_fg_size (GraphInfo *info,   /* IN */
+                        gint      *width,  /* OUT */
+                        gint      *height) /* OUT */
+{
+	if (info->fg_pixmap) {
+		gdk_drawable_get_size(GDK_DRAWABLE(info->fg_pixmap), width, height);
+		return TRUE;
+	}
+	if (info->fg_surface) {
+		*width = cairo_image_surface_get_width(info->fg_surface);
+		*height = cairo_image_surface_get_height(info->fg_surface);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * uber_graph_set_layer_source:
+ * @cr: A cairo_t.
+ * @pixmap: A #GdkPixmap or %NULL.
+ * @surface: A #cairo_surface_t used if @pixmap is %NULL.
+ * @x: The x offset of the layer.
+ * @y: The y offset of the layer.
+ *
+ * Sets a foreground or background layer as the source of @cr.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
 static inline void
-uber_graph_copy_background (UberGraph *graph, /* IN */
-                            GraphInfo *src,   /* IN */
-                            GraphInfo *dst)   /* IN */
+uber_graph_set_layer_source (cairo_t         *cr,      /* IN */
+                             GdkPixmap       *pixmap,  /* IN */
+                             cairo_surface_t *surface, /* IN */
+                             gdouble          x,       /* IN */
+                             gdouble          y)       /* IN */
 {
-	UberGraphPrivate *priv;
-	GtkAllocation alloc;
+	if (pixmap) {
+		gdk_cairo_set_source_pixmap(cr, pixmap, x, y);
+	} else {
+		cairo_set_source_surface(cr, surface, x, y);
+	}
+}
 
-	g_return_if_fail(UBER_IS_GRAPH(graph));
+/**
+ * uber_graph_timing_begin:
+ * @graph: A #UberGraph.
+ *
+ * Starts timing a section of rendering if a timing callback is set.
+ *
+ * Returns: The current monotonic time, or 0 if timing is disabled.
+ * Side effects: None.
+ */
+static inline gint64
+uber_graph_timing_begin (UberGraph *graph) /* IN */
+{
+	if (G_LIKELY(!graph->priv->timing_func)) {
+		return 0;
+	}
+	return uber_frame_clock_get_time();
+}
+
+/**
+ * uber_graph_timing_end:
+ * @graph: A #UberGraph.
+ * @timing: The #UberGraphTiming that was measured.
+ * @begin: The result of uber_graph_timing_begin().
+ *
+ * Reports the time spent since @begin to the timing callback.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static inline void
+uber_graph_timing_end (UberGraph       *graph,  /* IN */
+                       UberGraphTiming  timing, /* IN */
+                       gint64           begin)  /* IN */
+{
+	UberGraphPrivate *priv;
 
-	ENTRY;
 	priv = graph->priv;
-	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
-	cairo_save(dst->bg_cairo);
-	gdk_cairo_set_source_pixmap(dst->bg_cairo, src->bg_pixmap, 0, 0);
-	cairo_rectangle(dst->bg_cairo, 0, 0, alloc.width, alloc.height);
-	cairo_paint(dst->bg_cairo);
-	cairo_restore(dst->bg_cairo);
-	EXIT;
+	if (G_UNLIKELY(priv->timing_func && begin)) {
+		priv->timing_func(graph, timing, uber_frame_clock_get_time() - begin,
+		                  priv->timing_data);
+	}
 }
 
 static void
@@ -297,16 +410,137 @@ uber_graph_scale_changed (UberGraph *graph) /* IN */
 	fps_off = priv->fps_off;
 	uber_graph_update_scaled(graph);
 	uber_graph_calculate_rects(graph);
-	uber_graph_init_graph_info(graph, &priv->info[0]);
-	uber_graph_init_graph_info(graph, &priv->info[1]);
-	uber_graph_render_bg_task(graph, &priv->info[0]);
-	uber_graph_copy_background(graph, &priv->info[0], &priv->info[1]);
+	uber_graph_init_graph_info(graph, &priv->info);
+	uber_graph_render_bg_task(graph, &priv->info);
 	priv->fg_dirty = TRUE;
 	priv->fps_off = fps_off;
 	gtk_widget_queue_draw(GTK_WIDGET(graph));
 	EXIT;
 }
 
+/**
+ * uber_graph_refine_timeout:
+ * @data: An #UberGraph.
+ *
+ * Idle handler which replaces the approximate foreground shown after a
+ * rescale with a full render at the new scale.
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_refine_timeout (gpointer data) /* IN */
+{
+	UberGraph *graph = data;
+	UberGraphPrivate *priv;
+	GdkWindow *window;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	ENTRY;
+	priv = graph->priv;
+	priv->refine_handler = 0;
+	/*
+	 * A pending full render will happen on the next expose anyway.
+	 */
+	if (priv->fg_dirty || priv->suspended) {
+		RETURN(FALSE);
+	}
+	uber_graph_render_fg_task(graph, &priv->info);
+	if ((window = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+		gdk_window_invalidate_rect(window, &priv->content_rect, FALSE);
+	}
+	RETURN(FALSE);
+}
+
+/**
+ * uber_graph_rescale:
+ * @graph: A #UberGraph.
+ * @yorig: The y-axis range before it changed.
+ *
+ * Updates the graph after the y-axis range changed from @yorig.  Rather
+ * than rendering every line again right away, the foreground already
+ * rendered is stretched vertically to the new range and shown until the
+ * lines are rendered again at the new scale when idle.  Scales other than
+ * uber_scale_linear() cannot be stretched and are rendered in full.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_rescale (UberGraph       *graph, /* IN */
+                    const UberRange *yorig) /* IN */
+{
+	UberGraphPrivate *priv;
+	GraphInfo *info;
+	UberRange pixel_range;
+	cairo_surface_t *target;
+	cairo_surface_t *copy;
+	cairo_t *cr;
+	gdouble factor;
+	gdouble y_end;
+	gint width;
+	gint height;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(yorig != NULL);
+
+	ENTRY;
+	priv = graph->priv;
+	info = &priv->info;
+	uber_graph_update_scaled(graph);
+	priv->bg_dirty = TRUE;
+	gtk_widget_queue_draw(GTK_WIDGET(graph));
+	if (priv->fg_dirty || !uber_graph_get_fg_size(info, &width, &height) ||
+	    priv->scale != uber_scale_linear ||
+	    yorig->range <= 0. || priv->yrange.range <= 0.) {
+		priv->fg_dirty = TRUE;
+		EXIT;
+	}
+	/*
+	 * Linear scaling maps values to pixels above the bottom of the content
+	 * area in proportion to the range, so the new foreground is the old
+	 * one scaled vertically about that line.
+	 */
+	factor = yorig->range / priv->yrange.range;
+	GET_PIXEL_RANGE(pixel_range, priv->content_rect);
+	y_end = pixel_range.end;
+	target = cairo_get_target(info->fg_cairo);
+	copy = cairo_surface_create_similar(target,
+	                                    cairo_surface_get_content(target),
+	                                    width, height);
+	cr = cairo_create(copy);
+	cairo_set_source_surface(cr, target, 0, 0);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_paint(cr);
+	cairo_destroy(cr);
+	cairo_save(info->fg_cairo);
+	cairo_set_operator(info->fg_cairo, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(info->fg_cairo);
+	cairo_set_operator(info->fg_cairo, CAIRO_OPERATOR_OVER);
+	cairo_rectangle(info->fg_cairo,
+	                0, priv->content_rect.y,
+	                width, priv->content_rect.height);
+	cairo_clip(info->fg_cairo);
+	cairo_translate(info->fg_cairo, 0, y_end * (1. - factor));
+	cairo_scale(info->fg_cairo, 1., factor);
+	cairo_set_source_surface(info->fg_cairo, copy, 0, 0);
+	cairo_paint(info->fg_cairo);
+	cairo_restore(info->fg_cairo);
+	cairo_surface_destroy(copy);
+	/*
+	 * Drop any worker render at the previous scale and render the lines
+	 * again once the main loop is idle.
+	 */
+	priv->render_serial++;
+	if (!priv->refine_handler) {
+		priv->refine_handler = g_idle_add_full(G_PRIORITY_LOW,
+		                                       uber_graph_refine_timeout,
+		                                       graph, NULL);
+	}
+	EXIT;
+}
+
 /**
  * uber_graph_set_scale:
  * @graph: An #UberGraph.
@@ -456,19 +690,13 @@ uber_graph_append (UberGraph *graph, /* IN */
 	GET_PIXEL_RANGE(pixel_range, priv->content_rect);
 	uber_buffer_append(info->buffer, value);
 	if (value != -INFINITY) {
-		if (priv->yautoscale) {
-			if (value >= priv->yrange.end) {
-				priv->yrange.end = value + ABS((SCALE_FACTOR - 1.) * value);
-				if (priv->format == UBER_GRAPH_INTEGRAL) {
-					priv->yrange.end = ceil(priv->yrange.end);
-				}
+		if (priv->yautoscale &&
+		    uber_autoscale_grow(priv->autoscale, &priv->yrange, value)) {
+			if (priv->format == UBER_GRAPH_INTEGRAL) {
+				priv->yrange.end = ceil(priv->yrange.end);
 				priv->yrange.range = priv->yrange.end - priv->yrange.begin;
-				scale_changed = TRUE;
-			} else if (value < priv->yrange.begin) {
-				priv->yrange.begin = value - ABS((SCALE_FACTOR - 1.) * value);
-				priv->yrange.range = priv->yrange.end - priv->yrange.begin;
-				scale_changed = TRUE;
 			}
+			scale_changed = TRUE;
 		}
 		if (!priv->scale(graph, &priv->yrange, &pixel_range, &value)) {
 			value = -INFINITY;
@@ -519,6 +747,66 @@ uber_graph_set_line_width (UberGraph *graph,      /* IN */
 	EXIT;
 }
 
+/**
+ * uber_graph_get_render_worker:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves if the foreground is rendered on worker threads.
+ *
+ * Returns: %TRUE if the render workers are used.
+ * Side effects: None.
+ */
+gboolean
+uber_graph_get_render_worker (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	ENTRY;
+	RETURN(graph->priv->render_worker);
+}
+
+/**
+ * uber_graph_set_render_worker:
+ * @graph: A #UberGraph.
+ * @render_worker: Should the render workers be used.
+ *
+ * Sets if full renders of the foreground happen on a pool of worker
+ * threads shared by all graphs.  The lines are rasterized from a snapshot
+ * of their values and the main loop only copies the result into the
+ * foreground, so many graphs may render in parallel without blocking the
+ * main loop.  The newest data point is still rendered on the main loop.
+ *
+ * This defaults to %TRUE if the UBER_RENDER_WORKER environment variable is
+ * set.
+ *
+ * Returns: None.
+ * Side effects: The foreground is rendered again.
+ */
+void
+uber_graph_set_render_worker (UberGraph *graph,         /* IN */
+                              gboolean   render_worker) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	ENTRY;
+	priv = graph->priv;
+	render_worker = !!render_worker;
+	if (priv->render_worker == render_worker) {
+		EXIT;
+	}
+	priv->render_worker = render_worker;
+	if (priv->redraw_handler) {
+		g_source_remove(priv->redraw_handler);
+		priv->redraw_handler = 0;
+	}
+	priv->render_serial++;
+	priv->fg_dirty = TRUE;
+	gtk_widget_queue_draw(GTK_WIDGET(graph));
+	EXIT;
+}
+
 /**
  * uber_graph_set_stride:
  * @graph: A UberGraph.
@@ -548,8 +836,7 @@ uber_graph_set_stride (UberGraph *graph, /* IN */
 		uber_buffer_set_size(line->scaled, stride);
 	}
 	uber_graph_calculate_rects(graph);
-	uber_graph_init_graph_info(graph, &priv->info[0]);
-	uber_graph_init_graph_info(graph, &priv->info[1]);
+	uber_graph_init_graph_info(graph, &priv->info);
 	EXIT;
 }
 
@@ -608,8 +895,8 @@ uber_graph_extend_range (UberBuffer *buffer, /* IN */
  * @data: An #UberGraph.
  *
  * Timeout handler called when we need to recalculate if we can shrink
- * the range of the graph.  If the graph y-axis range can be shrunk,
- * the the graph contents are marked dirty and re-rendered.
+ * the range of the graph.  If the autoscale policy allows the y-axis range
+ * to shrink, the graph contents are marked dirty and re-rendered.
  *
  * Returns: %TRUE always to keep the timeout continuing.
  * Side effects: None.
@@ -636,15 +923,15 @@ uber_graph_downscale_timeout (gpointer data) /* IN */
 	if (range.begin == range.end) {
 		RETURN(TRUE);
 	}
-	if ((range.end * SCALE_FACTOR) < priv->yrange.end) {
-		priv->yrange.end = range.end * SCALE_FACTOR;
+	if (uber_autoscale_shrink(priv->autoscale, &priv->yrange, &range)) {
 		if (priv->format == UBER_GRAPH_INTEGRAL) {
 			priv->yrange.end = ceil(priv->yrange.end);
+			priv->yrange.range = priv->yrange.end - priv->yrange.begin;
 		}
-		priv->yrange.range = priv->yrange.end - priv->yrange.begin;
-		if ((yorig.begin != priv->yrange.begin) &&
-		    (yorig.end != priv->yrange.end)) {
-			uber_graph_scale_changed(graph);
+		if (priv->suspended) {
+			priv->rescale_pending = TRUE;
+		} else {
+			uber_graph_rescale(graph, &yorig);
 		}
 	}
 	/* TODO: Scale yrange.begin */
@@ -661,8 +948,8 @@ uber_graph_downscale_timeout (gpointer data) /* IN */
  * is %TRUE, new values outside the current y range will cause the range to
  * grow and the graph redrawn to match the new scale.
  *
- * In the future, the graph may compact the scale when the larger values
- * have moved off the graph.  However, this has not yet been implemented.
+ * The range is compacted once the larger values have moved off the graph.
+ * See uber_graph_set_yautoscale_policy() for how often this happens.
  *
  * Returns: None.
  * Side effects: None.
@@ -688,6 +975,36 @@ uber_graph_set_yautoscale (UberGraph *graph,      /* IN */
 	EXIT;
 }
 
+/**
+ * uber_graph_set_yautoscale_policy:
+ * @graph: A UberGraph.
+ * @headroom: The fraction of the largest value kept free above it.
+ * @hysteresis: The additional fraction which must be free to shrink.
+ * @interval: The minimum number of seconds between shrinking the range.
+ *
+ * Sets how the y-axis autoscales.  The range grows to the next step of 1,
+ * 2 or 5 times a power of ten above a new value plus @headroom, and only
+ * shrinks at most once every @interval seconds to a step which leaves
+ * @headroom plus @hysteresis free.  This bounds the number of full
+ * redraws a jittery series causes.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_yautoscale_policy (UberGraph *graph,      /* IN */
+                                  gdouble    headroom,   /* IN */
+                                  gdouble    hysteresis, /* IN */
+                                  gdouble    interval)   /* IN */
+{
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	ENTRY;
+	uber_autoscale_set_policy(graph->priv->autoscale, headroom, hysteresis,
+	                          interval);
+	EXIT;
+}
+
 /**
  * uber_graph_get_yautoscale:
  * @graph: A UberGraph.
@@ -707,22 +1024,19 @@ uber_graph_get_yautoscale (UberGraph *graph) /* IN */
 }
 
 /**
- * uber_graph_fps_timeout:
+ * uber_graph_ingest:
  * @graph: A #UberGraph.
  *
- * GSourceFunc that is called when the amount of time has passed between each
- * frame that needs to be rendered.
+ * Retrieves and appends the next value for every line in the graph.
  *
- * Returns: %TRUE always.
+ * Returns: %TRUE if the scale changed; otherwise %FALSE.
  * Side effects: None.
  */
 static gboolean
-uber_graph_fps_timeout (gpointer data) /* IN */
+uber_graph_ingest (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
-	UberGraph *graph = data;
 	LineInfo *info;
-	GdkWindow *window;
 	gdouble value;
 	gboolean scale_changed = FALSE;
 	gint i;
@@ -730,102 +1044,395 @@ uber_graph_fps_timeout (gpointer data) /* IN */
 	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
 
 	priv = graph->priv;
-	/*
-	 * Retrieve the next value for the graph if necessary.
-	 */
-	if (G_UNLIKELY(priv->fps_off >= priv->fps_calc)) {
-		for (i = 0; i < priv->lines->len; i++) {
-			info = &g_array_index(priv->lines, LineInfo, i);
-			uber_graph_get_next_value(graph, i + 1, info, &value);
-			if (uber_graph_append(graph, info, value)) {
-				scale_changed = TRUE;
-			}
-		}
-		if (scale_changed) {
-			uber_graph_scale_changed(graph);
-		} else {
-			uber_graph_render_fg_shifted_task(graph,
-											  &priv->info[priv->flipped],
-											  &priv->info[!priv->flipped]);
-			priv->flipped = !priv->flipped;
+	for (i = 0; i < priv->lines->len; i++) {
+		info = &g_array_index(priv->lines, LineInfo, i);
+		uber_graph_get_next_value(graph, i + 1, info, &value);
+		if (uber_graph_append(graph, info, value)) {
+			scale_changed = TRUE;
 		}
-		priv->fps_off = 0;
 	}
-	/*
-	 * Update the content area.
-	 */
-	window = gtk_widget_get_window(GTK_WIDGET(graph));
-	gdk_window_invalidate_rect(window, &graph->priv->content_rect, FALSE);
-	return TRUE;
+	return scale_changed;
 }
 
 /**
- * uber_graph_set_fps:
- * @graph: A UberGraph.
- * @fps: The number of frames-per-second.
+ * uber_graph_get_fg_area:
+ * @graph: A #UberGraph.
+ * @area: A location for the area.
  *
- * Sets the frames-per-second which should be rendered by UberGraph.
+ * Retrieves the area of the window the foreground is drawn to, which is
+ * the content area within its border.
  *
  * Returns: None.
  * Side effects: None.
  */
-void
-uber_graph_set_fps (UberGraph *graph, /* IN */
-                    gint       fps)   /* IN */
+static inline void
+uber_graph_get_fg_area (UberGraph    *graph, /* IN */
+                        GdkRectangle *area)  /* OUT */
+{
+	*area = graph->priv->content_rect;
+	area->x += 1;
+	area->y += 1;
+	area->width -= 2;
+	area->height -= 2;
+}
+
+/**
+ * uber_graph_invalidate_frame:
+ * @graph: A #UberGraph.
+ * @shifted: If a new data point was added since the last frame.
+ *
+ * Invalidates the window for the next frame.  If the previous frame is
+ * still valid, the foreground already on screen is scrolled by the server
+ * and only the newly exposed sliver and the grid lines are repainted.
+ * Otherwise the whole content area is repainted.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_invalidate_frame (UberGraph *graph,   /* IN */
+                             gboolean   shifted) /* IN */
 {
 	UberGraphPrivate *priv;
+	GdkRectangle area;
+	GdkRegion *region;
+	GdkRegion *damage;
+	GdkWindow *window;
+	gint scroll_off;
+	gint dx;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
-	g_return_if_fail(fps > 0 && fps <= 60);
 
-	ENTRY;
 	priv = graph->priv;
-	priv->fps = fps;
-	priv->fps_calc = fps;
-	priv->fps_to = 1000. / fps;
-	priv->fps_each = (gfloat)priv->content_rect.width /
-	                 (gfloat)priv->stride /
-	                 (gfloat)priv->fps;
-	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
+	if (!(window = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+		return;
 	}
+	uber_graph_get_fg_area(graph, &area);
+	scroll_off = (gint)(priv->fps_each * priv->fps_off);
+	dx = priv->scroll_off - scroll_off;
+	if (shifted) {
+		dx -= priv->x_each;
+	}
+	priv->scroll_off = scroll_off;
 	/*
-	 * If we are moving less than one pixel per frame, then go ahead and lower
-	 * the actual framerate and move 1 pixel at a time.
+	 * Anything pending a full render must be repainted in full.
 	 */
-	if (priv->fps_each < 1.) {
-		priv->fps_each = 1.;
-		priv->fps_calc = (gfloat)priv->content_rect.width / (gfloat)priv->stride;
-		priv->fps_to = 1000. / priv->fps_calc;
+	if (priv->fg_dirty || priv->bg_dirty || !priv->grid_region ||
+	    dx > 0 || -dx >= area.width) {
+		gdk_window_invalidate_rect(window, &priv->content_rect, FALSE);
+		return;
 	}
-	priv->fps_handler = g_timeout_add(priv->fps_to,
-	                                  uber_graph_fps_timeout,
-	                                  graph);
-	EXIT;
+	if (dx == 0) {
+		return;
+	}
+	/*
+	 * Scroll the foreground on the server.  Only the part that lands
+	 * within the foreground is moved, and the sliver uncovered at the
+	 * right is invalidated by GDK.
+	 */
+	area.x -= dx;
+	area.width += dx;
+	region = gdk_region_rectangle(&area);
+	gdk_window_move_region(window, region, dx, 0);
+	gdk_region_destroy(region);
+	uber_graph_get_fg_area(graph, &area);
+	region = gdk_region_rectangle(&area);
+	/*
+	 * Grid lines stay put, so repaint them where they are and where the
+	 * scroll moved a copy of them to.
+	 */
+	damage = gdk_region_copy(priv->grid_region);
+	gdk_region_offset(damage, dx, 0);
+	gdk_region_union(damage, priv->grid_region);
+	gdk_region_intersect(damage, region);
+	gdk_window_invalidate_region(window, damage, FALSE);
+	gdk_region_destroy(damage);
+	gdk_region_destroy(region);
 }
 
 /**
- * uber_graph_prepare_layout:
+ * uber_graph_fps_timeout:
  * @graph: A #UberGraph.
- * @layout: A #PangoLayout.
- * @mode: The layout mode.
  *
- * Prepares the #PangoLayout with the settings required to render the given
- * mode, such as LAYOUT_TICK.
+ * GSourceFunc that is called when the amount of time has passed between each
+ * frame that needs to be rendered.
  *
- * Returns: None.
+ * Returns: %TRUE always.
  * Side effects: None.
  */
-static void
-uber_graph_prepare_layout (UberGraph   *graph,  /* IN */
-                           PangoLayout *layout, /* IN */
-                           gint         mode)   /* IN */
-{
+static gboolean
+uber_graph_fps_timeout (gpointer data) /* IN */
+{
 	UberGraphPrivate *priv;
-	PangoFontDescription *desc;
+	UberGraph *graph = data;
+	gboolean shifted = FALSE;
+	UberRange yorig;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	priv = graph->priv;
+	priv->fps_off++;
+	/*
+	 * Retrieve the next value for the graph if necessary.
+	 */
+	if (G_UNLIKELY(priv->fps_off >= priv->fps_calc)) {
+		yorig = priv->yrange;
+		if (uber_graph_ingest(graph)) {
+			uber_graph_rescale(graph, &yorig);
+		}
+		if (G_LIKELY(!priv->fg_dirty)) {
+			uber_graph_render_fg_shifted_task(graph, &priv->info);
+		}
+		priv->fps_off = 0;
+		shifted = TRUE;
+	}
+	/*
+	 * Update the content area.
+	 */
+	uber_graph_invalidate_frame(graph, shifted);
+	return TRUE;
+}
+
+/**
+ * uber_graph_calculate_fps:
+ * @graph: A #UberGraph.
+ *
+ * Calculates the frame rate and per-frame movement from the frame rate
+ * currently allowed by the governor.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_calculate_fps (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+	gint fps;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	ENTRY;
+	priv = graph->priv;
+	fps = uber_fps_governor_get_fps(priv->governor);
+	priv->fps_calc = fps;
+	priv->fps_each = priv->x_each / (gfloat)fps;
+	/*
+	 * If we are moving less than one pixel per frame, then go ahead and lower
+	 * the actual framerate and move 1 pixel at a time.
+	 */
+	if (priv->fps_each < 1.) {
+		priv->fps_each = 1.;
+		priv->fps_calc = priv->x_each;
+	}
+	EXIT;
+}
+
+/**
+ * uber_graph_get_tick_period:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves the period between frame clock ticks.  While suspended, the
+ * graph only ticks once per data point.
+ *
+ * Returns: The period in nanoseconds.
+ * Side effects: None.
+ */
+static inline gint64
+uber_graph_get_tick_period (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	priv = graph->priv;
+	if (priv->suspended) {
+		return NSEC_PER_SEC; /* One data point per second. */
+	}
+	return NSEC_PER_SEC / MAX(priv->fps_calc, 1);
+}
+
+/**
+ * uber_graph_fps_tick:
+ * @clock: An #UberFrameClock.
+ * @frame_time: The frame time in nanoseconds.
+ * @data: An #UberGraph.
+ *
+ * Frame clock callback for the graph.  All graphs share the default frame
+ * clock so that they are invalidated, and exposed, together.
+ *
+ * Returns: The next frame deadline.
+ * Side effects: None.
+ */
+static gint64
+uber_graph_fps_tick (UberFrameClock *clock,      /* IN */
+                     gint64          frame_time, /* IN */
+                     gpointer        data)       /* IN */
+{
+	UberGraph *graph = data;
+	UberGraphPrivate *priv;
+	gint64 period;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), -1);
+
+	priv = graph->priv;
+	if (G_UNLIKELY(priv->suspended)) {
+		/*
+		 * Nobody can see the graph, so only ingest the data.  The
+		 * foreground is rendered in full once we are visible again.
+		 */
+		if (uber_graph_ingest(graph)) {
+			priv->rescale_pending = TRUE;
+		}
+		priv->fg_dirty = TRUE;
+	} else {
+		uber_fps_governor_begin(priv->governor);
+		uber_graph_fps_timeout(graph);
+		uber_fps_governor_end(priv->governor);
+		/*
+		 * Lower or raise the frame rate to match the render cost.
+		 */
+		if (uber_fps_governor_tick(priv->governor, frame_time)) {
+			uber_graph_calculate_fps(graph);
+		}
+	}
+	/*
+	 * Advance on the original schedule, skipping frames we missed.
+	 */
+	period = uber_graph_get_tick_period(graph);
+	priv->fps_deadline += period;
+	if (priv->fps_deadline <= frame_time) {
+		priv->fps_deadline = frame_time + period;
+	}
+	return priv->fps_deadline;
+}
+
+/**
+ * uber_graph_set_fps:
+ * @graph: A UberGraph.
+ * @fps: The number of frames-per-second.
+ *
+ * Sets the frames-per-second which should be rendered by UberGraph.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_fps (UberGraph *graph, /* IN */
+                    gint       fps)   /* IN */
+{
+	UberGraphPrivate *priv;
+	UberFrameClock *clock;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(fps > 0 && fps <= 60);
+
+	ENTRY;
+	priv = graph->priv;
+	priv->fps = fps;
+	uber_fps_governor_set_fps(priv->governor, fps);
+	uber_graph_calculate_fps(graph);
+	clock = uber_frame_clock_get_default();
+	if (!priv->fps_handler) {
+		priv->fps_handler = uber_frame_clock_add(clock, uber_graph_fps_tick,
+		                                         graph);
+	}
+	priv->fps_deadline = uber_frame_clock_get_time()
+	                   + uber_graph_get_tick_period(graph);
+	uber_frame_clock_schedule(clock, priv->fps_handler, priv->fps_deadline);
+	EXIT;
+}
+
+/**
+ * uber_graph_set_render_budget:
+ * @graph: A #UberGraph.
+ * @budget: The fraction of one CPU that rendering may use, or 0.
+ *
+ * Sets how much of a CPU the graph may spend rendering.  When the measured
+ * cost of rendering exceeds @budget, the frame rate is lowered below the
+ * rate set with uber_graph_set_fps() and recovers once the cost drops.  A
+ * @budget of 0 disables the adjustment.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_render_budget (UberGraph *graph,  /* IN */
+                              gdouble    budget) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(budget >= 0.);
+
+	ENTRY;
+	priv = graph->priv;
+	uber_fps_governor_set_budget(priv->governor, budget);
+	uber_graph_calculate_fps(graph);
+	EXIT;
+}
+
+/**
+ * uber_graph_get_render_budget:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves the fraction of a CPU the graph may spend rendering.
+ *
+ * Returns: The budget, or 0 if unlimited.
+ * Side effects: None.
+ */
+gdouble
+uber_graph_get_render_budget (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), 0.);
+
+	ENTRY;
+	RETURN(uber_fps_governor_get_budget(graph->priv->governor));
+}
+
+/**
+ * uber_graph_set_timing_func:
+ * @graph: A #UberGraph.
+ * @func: An #UberGraphTimingFunc or %NULL.
+ * @user_data: User data for @func.
+ *
+ * Sets a callback that receives the time spent in each expose and in each
+ * render of the foreground and background.  This is meant for benchmarks;
+ * when no callback is set, the clock is not read.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_timing_func (UberGraph           *graph,     /* IN */
+                            UberGraphTimingFunc  func,      /* IN */
+                            gpointer             user_data) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
 
 	ENTRY;
 	priv = graph->priv;
+	priv->timing_func = func;
+	priv->timing_data = user_data;
+	EXIT;
+}
+
+/**
+ * uber_graph_create_font:
+ * @mode: The layout mode.
+ *
+ * Creates the font description used to render the given mode, such as
+ * LAYOUT_TICK.
+ *
+ * Returns: A new #PangoFontDescription which should be freed with
+ *   pango_font_description_free().
+ * Side effects: None.
+ */
+static PangoFontDescription*
+uber_graph_create_font (gint mode) /* IN */
+{
+	PangoFontDescription *desc;
+
+	ENTRY;
 	desc = pango_font_description_new();
 	switch (mode) {
 	case LAYOUT_TICK:
@@ -835,6 +1442,30 @@ uber_graph_prepare_layout (UberGraph   *graph,  /* IN */
 	default:
 		g_assert_not_reached();
 	}
+	RETURN(desc);
+}
+
+/**
+ * uber_graph_prepare_layout:
+ * @graph: A #UberGraph.
+ * @layout: A #PangoLayout.
+ * @mode: The layout mode.
+ *
+ * Prepares the #PangoLayout with the settings required to render the given
+ * mode, such as LAYOUT_TICK.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_prepare_layout (UberGraph   *graph,  /* IN */
+                           PangoLayout *layout, /* IN */
+                           gint         mode)   /* IN */
+{
+	PangoFontDescription *desc;
+
+	ENTRY;
+	desc = uber_graph_create_font(mode);
 	pango_layout_set_font_description(layout, desc);
 	pango_font_description_free(desc);
 	EXIT;
@@ -883,6 +1514,7 @@ uber_graph_calculate_rects (UberGraph *graph) /* IN */
 	GtkAllocation alloc;
 	GdkWindow *window;
 	PangoLayout *pl;
+	cairo_surface_t *surface;
 	cairo_t *cr;
 	gint tick_w;
 	gint tick_h;
@@ -891,15 +1523,22 @@ uber_graph_calculate_rects (UberGraph *graph) /* IN */
 
 	ENTRY;
 	priv = graph->priv;
-	if (!(window = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+	window = gtk_widget_get_window(GTK_WIDGET(graph));
+	if (!window && !priv->offscreen) {
 		return;
 	}
 	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
 	/*
 	 * Create a cairo context and PangoLayout to calculate the sizing
-	 * of various strings.
+	 * of various strings.  Offscreen graphs measure on an image surface.
 	 */
-	cr = gdk_cairo_create(GDK_DRAWABLE(window));
+	if (window) {
+		cr = gdk_cairo_create(GDK_DRAWABLE(window));
+	} else {
+		surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+		cr = cairo_create(surface);
+		cairo_surface_destroy(surface);
+	}
 	pl = pango_cairo_create_layout(cr);
 	/*
 	 * Determine largest size of tick labels.
@@ -935,7 +1574,21 @@ uber_graph_calculate_rects (UberGraph *graph) /* IN */
 	priv->content_rect.y = tick_h / 2 + 1;
 	priv->content_rect.width = alloc.width - priv->content_rect.x - 2;
 	priv->content_rect.height = priv->x_tick_rect.y - priv->content_rect.y - 2;
-	gdk_gc_set_clip_rectangle(priv->fg_gc, &priv->content_rect);
+	if (priv->fg_gc) {
+		gdk_gc_set_clip_rectangle(priv->fg_gc, &priv->content_rect);
+	}
+	/*
+	 * Space data points a whole number of pixels apart so that each fits
+	 * exactly within its slot of the foreground ring.  Rounding up means
+	 * fewer than stride data points may fit within the content area, so
+	 * the ring only holds and the axis only labels the ones that do.
+	 */
+	priv->x_each = ceil(((gdouble)priv->content_rect.width - 2)
+	                    / MAX((gdouble)priv->stride - 2., 1.));
+	priv->x_slots = ceil(((gdouble)priv->content_rect.width - 2)
+	                     / MAX(priv->x_each, 1.)) + 2;
+	priv->x_slots = CLAMP(priv->x_slots, 1, priv->stride);
+	priv->fg_slot %= priv->x_slots;
 	/*
 	 * Cleanup after allocations.
 	 */
@@ -944,6 +1597,37 @@ uber_graph_calculate_rects (UberGraph *graph) /* IN */
 	EXIT;
 }
 
+/**
+ * uber_graph_add_grid_line:
+ * @graph: A #UberGraph.
+ * @x: The left of the line.
+ * @y: The top of the line.
+ * @width: The width of the line.
+ * @height: The height of the line.
+ *
+ * Notes that a grid line was drawn within the content area.  Grid lines do
+ * not move with the foreground, so they must be repainted when the window
+ * contents are scrolled.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static inline void
+uber_graph_add_grid_line (UberGraph *graph,  /* IN */
+                          gint       x,      /* IN */
+                          gint       y,      /* IN */
+                          gint       width,  /* IN */
+                          gint       height) /* IN */
+{
+	GdkRectangle rect;
+
+	rect.x = x;
+	rect.y = y;
+	rect.width = width;
+	rect.height = height;
+	gdk_region_union_with_rect(graph->priv->grid_region, &rect);
+}
+
 /**
  * uber_graph_render_bg_x_ticks:
  * @graph: A #UberGraph.
@@ -975,30 +1659,26 @@ uber_graph_render_bg_x_ticks (UberGraph *graph, /* IN */
 	#define DRAW_TICK_LABEL(v, o)                                            \
 	    G_STMT_START {                                                       \
 	        gint _v = (v);                                                   \
-	        gchar *_v_str;                                                   \
-	        _v_str = g_markup_printf_escaped(                                \
+	        gchar _v_str[64];                                                \
+	        gdouble _x;                                                      \
+	        g_snprintf(_v_str, sizeof(_v_str),                               \
 	            "<span size='smaller'>%d</span>",                            \
 	            _v);                                                         \
-	        pango_layout_set_markup(info->tick_layout, _v_str, -1);          \
-	        pango_layout_get_pixel_size(info->tick_layout, &w, &h);          \
+	        uber_text_cache_get_size(priv->label_cache, _v_str, &w, &h);     \
 	        if (o == 0) { \
-	             cairo_move_to(info->bg_cairo, \
-	                           priv->content_rect.x + priv->content_rect.width - w, \
-	                           priv->content_rect.y + priv->content_rect.height + priv->tick_len + 5); \
+	             _x = priv->content_rect.x + priv->content_rect.width - w; \
 	        } else { \
-	             cairo_move_to(info->bg_cairo,                                    \
-		                       priv->content_rect.x + priv->content_rect.width - (int)(o * (priv->x_tick_rect.width / (gfloat)n_lines)) + .5 - (w / 2), \
-	                           priv->content_rect.y + priv->content_rect.height + priv->tick_len + 5); \
+		         _x = priv->content_rect.x + priv->content_rect.width - (int)(o * (priv->x_tick_rect.width / (gfloat)n_lines)) + .5 - (w / 2); \
 	        } \
 	        if (priv->show_xlabel) { \
-	            pango_cairo_show_layout(info->bg_cairo, info->tick_layout);      \
+	            uber_text_cache_show(priv->label_cache, info->bg_cairo, _v_str, _x, \
+	                                 priv->content_rect.y + priv->content_rect.height + priv->tick_len + 5); \
 			} \
-	        g_free(_v_str);                                                  \
 		} G_STMT_END
 
 	cairo_save(info->bg_cairo);
 	gdk_cairo_set_source_color(info->bg_cairo, &color);
-	n_lines = priv->stride / 10;
+	n_lines = MAX(priv->x_slots / 10, 1);
 	DRAW_TICK_LABEL(0, 0);
 	for (i = 1; i < n_lines; i++) {
 		cairo_move_to(info->bg_cairo,
@@ -1008,10 +1688,14 @@ uber_graph_render_bg_x_ticks (UberGraph *graph, /* IN */
 		              priv->content_rect.x + (int)(i * (priv->x_tick_rect.width / (gfloat)n_lines)) + .5,
 		              priv->x_tick_rect.y + priv->tick_len);
 		cairo_stroke(info->bg_cairo);
-		fraction = (1. / (gfloat)n_lines) * priv->stride;
+		uber_graph_add_grid_line(graph,
+		                         priv->content_rect.x + (int)(i * (priv->x_tick_rect.width / (gfloat)n_lines)),
+		                         priv->content_rect.y,
+		                         1, priv->content_rect.height);
+		fraction = (1. / (gfloat)n_lines) * priv->x_slots;
 		DRAW_TICK_LABEL(fraction * i, i);
 	}
-	DRAW_TICK_LABEL(priv->stride, n_lines);
+	DRAW_TICK_LABEL(priv->x_slots, n_lines);
 	cairo_restore(info->bg_cairo);
 	EXIT;
 	#undef DRAW_TICK_LABEL
@@ -1023,26 +1707,30 @@ uber_graph_render_bg_x_ticks (UberGraph *graph, /* IN */
  * @y: the pixel where the line will be placed.
  * @lineno: This is line X of @lines.
  * @lines: total number of lines to be drawn.
+ * @label: A location for the label markup.
+ * @label_len: The size of @label in bytes.
  *
  * Formats the value at pixel offset @y based on the current format operation.
+ * The label is written into a caller buffer since it is only needed to look
+ * up the rendered copy in the label cache.
  *
- * Returns: A string containing the label.  This value should be freed with
- *   g_free().
+ * Returns: None.
  * Side effects: None.
  */
-static gchar*
-uber_graph_get_ylabel_at_pos (UberGraph *graph,  /* IN */
-                              gdouble    y,      /* IN */
-                              gint       lineno, /* IN */
-                              gint       lines)  /* IN */
+static void
+uber_graph_get_ylabel_at_pos (UberGraph *graph,     /* IN */
+                              gdouble    y,         /* IN */
+                              gint       lineno,    /* IN */
+                              gint       lines,     /* IN */
+                              gchar     *label,     /* OUT */
+                              gsize      label_len) /* IN */
 {
 	UberGraphPrivate *priv;
 	UberRange range;
 	const gchar *a = "";
-	gchar *ret = NULL;
 	gfloat f;
 
-	g_return_val_if_fail(UBER_IS_GRAPH(graph), NULL);
+	g_return_if_fail(UBER_IS_GRAPH(graph));
 
 	ENTRY;
 	priv = graph->priv;
@@ -1060,7 +1748,7 @@ uber_graph_get_ylabel_at_pos (UberGraph *graph,  /* IN */
 			f /= 1000;
 			a = "k ";
 		}
-		ret = g_markup_printf_escaped("<span size='smaller'>%.1f %s</span>", f, a);
+		g_snprintf(label, label_len, "<span size='smaller'>%.1f %s</span>", f, a);
 		break;
 	}
 	CASE(UBER_GRAPH_DIRECT1024); {
@@ -1075,19 +1763,19 @@ uber_graph_get_ylabel_at_pos (UberGraph *graph,  /* IN */
 			f /= KIBIBYTE;
 			a = KIBIBYTE_STR;
 		}
-		ret = g_markup_printf_escaped("<span size='smaller'>%.1f %s</span>", f, a);
+		g_snprintf(label, label_len, "<span size='smaller'>%.1f %s</span>", f, a);
 		break;
 	}
 	CASE(UBER_GRAPH_PERCENT); {
 		f = (gfloat)(lines - lineno) / (gfloat)lines * 100.;
-		ret = g_markup_printf_escaped("<span size='smaller'>%d %% </span>", (gint)f);
+		g_snprintf(label, label_len, "<span size='smaller'>%d %% </span>", (gint)f);
 		break;
 	}
 	CASE(UBER_GRAPH_INTEGRAL);
 	default:
 		g_assert_not_reached();
 	}
-	RETURN(ret);
+	EXIT;
 }
 
 static void
@@ -1119,6 +1807,8 @@ uber_graph_render_bg_y_ticks_basic (UberGraph *graph, /* IN */
 		              priv->content_rect.x + priv->content_rect.width,
 		              y + .5);
 		cairo_stroke(info->bg_cairo);
+		uber_graph_add_grid_line(graph, priv->content_rect.x, (gint)y,
+		                         priv->content_rect.width, 2);
 		DRAW_Y_LABEL_FRACTION(y, i, n_lines);
 	}
 	DRAW_Y_LABEL_FRACTION(range.end, n_lines, n_lines);
@@ -1218,13 +1908,27 @@ uber_graph_render_bg_task (UberGraph *graph, /* IN */
 	GdkColor bg_color;
 	GdkColor fg_color;
 	GdkColor white;
+	gint64 begin;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 	g_return_if_fail(info != NULL);
 
 	ENTRY;
 	priv = graph->priv;
+	begin = uber_graph_timing_begin(graph);
 	cairo_save(info->bg_cairo);
+	if (priv->grid_region) {
+		gdk_region_destroy(priv->grid_region);
+	}
+	priv->grid_region = gdk_region_new();
+	/*
+	 * Lay out labels as the widget would.  Offscreen graphs may have no
+	 * screen, in which case the defaults are used.
+	 */
+	if (gtk_widget_has_screen(GTK_WIDGET(graph))) {
+		uber_text_cache_set_context(priv->label_cache,
+		                            gtk_widget_get_pango_context(GTK_WIDGET(graph)));
+	}
 	/*
 	 * Retrieve required data for rendering.
 	 */
@@ -1261,54 +1965,64 @@ uber_graph_render_bg_task (UberGraph *graph, /* IN */
 	 * Cleanup.
 	 */
 	cairo_restore(info->bg_cairo);
+	uber_graph_timing_end(graph, UBER_GRAPH_TIMING_RENDER_BG, begin);
 	EXIT;
 }
 
 /**
- * uber_graph_render_fg_each:
+ * uber_graph_get_line_color:
  * @graph: A #UberGraph.
- * @value: The translated value in graph coordinates.
- * @user_data: A RenderClosure.
+ * @line: A LineInfo.
+ * @color: A location for the color.
  *
- * Callback for each data point in the buffer.  Renders the value to the
- * foreground pixmap on the server-side.
+ * Retrieves the color to draw @line with.  Without an alpha channel the
+ * foreground is blitted with XOR, so the color is adjusted for that.
  *
- * Returns: %FALSE always.
+ * Returns: None.
  * Side effects: None.
  */
-static inline gboolean
-uber_graph_render_fg_each (UberBuffer *buffer,    /* IN */
-                           gdouble     value,     /* IN */
-                           gpointer    user_data) /* IN */
+static void
+uber_graph_get_line_color (UberGraph *graph, /* IN */
+                           LineInfo  *line,  /* IN */
+                           GdkColor  *color) /* OUT */
 {
 	UberGraphPrivate *priv;
-	RenderClosure *closure = user_data;
-	gdouble y;
-	gdouble x;
+	GdkColor white;
 
-	g_return_val_if_fail(closure->graph != NULL, FALSE);
-
-	priv = closure->graph->priv;
-	x = closure->x_epoch - (closure->offset++ * priv->x_each);
-	if (isnan(value) || isinf(value)) {
-		goto skip;
-	}
-	y = closure->pixel_range.end - value;
-	if (G_UNLIKELY(closure->first)) {
-		closure->first = FALSE;
-		cairo_move_to(closure->info->fg_cairo, x, y);
-		goto finish;
-	}
-	cairo_curve_to(closure->info->fg_cairo,
-	               closure->last_x - (priv->x_each / 2.),
-	               closure->last_y,
-	               closure->last_x - (priv->x_each / 2.),
-	               y, x, y);
-  skip:
-  finish:
-  	closure->last_x = x;
-  	closure->last_y = y;
-	return FALSE;
+	priv = graph->priv;
+	*color = line->color;
+	if (!priv->have_rgba) {
+		white = gtk_widget_get_style(GTK_WIDGET(graph))->light[GTK_STATE_NORMAL];
+		color->red ^= white.red;
+		color->green ^= white.green;
+		color->blue ^= white.blue;
+	}
+}
+
+/**
+ * uber_graph_stylize_cairo:
+ * @cr: A cairo context.
+ * @color: The color of the line.
+ * @line_width: The width of the line.
+ *
+ * Stylizes the cairo context for drawing a line.  This does not use GDK
+ * so that it may be called from the render workers.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static inline void
+uber_graph_stylize_cairo (cairo_t        *cr,         /* IN */
+                          const GdkColor *color,      /* IN */
+                          gdouble         line_width) /* IN */
+{
+	cairo_set_line_width(cr, line_width);
+	cairo_set_source_rgb(cr,
+	                     color->red / 65535.,
+	                     color->green / 65535.,
+	                     color->blue / 65535.);
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
 }
 
 /**
@@ -1327,192 +2041,522 @@ uber_graph_stylize_line (UberGraph *graph, /* IN */
                          LineInfo  *line,  /* IN */
                          cairo_t   *cr)    /* IN */
 {
-	UberGraphPrivate *priv;
 	GdkColor color;
-	GdkColor white;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 	g_return_if_fail(line != NULL);
 	g_return_if_fail(cr != NULL);
 
-	priv = graph->priv;
-	cairo_set_line_width(cr, priv->line_width);
-	color = line->color;
-	if (!priv->have_rgba) {
-		white = gtk_widget_get_style(GTK_WIDGET(graph))->light[GTK_STATE_NORMAL];
-		color.red ^= white.red;
-		color.green ^= white.green;
-		color.blue ^= white.blue;
+	uber_graph_get_line_color(graph, line, &color);
+	uber_graph_stylize_cairo(cr, &color, graph->priv->line_width);
+}
+
+/**
+ * uber_graph_path_values:
+ * @cr: A cairo context.
+ * @values: Scaled values, newest first.
+ * @n_values: The number of values.
+ * @x_epoch: The x position of the first value.
+ * @x_each: The space between values.
+ * @y_end: The y position of a value of zero.
+ *
+ * Adds the values to the path of @cr as bezier curves from newest to
+ * oldest.  The line is broken at values that are not yet known.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_path_values (cairo_t       *cr,       /* IN */
+                        const gdouble *values,   /* IN */
+                        gint           n_values, /* IN */
+                        gdouble        x_epoch,  /* IN */
+                        gdouble        x_each,   /* IN */
+                        gdouble        y_end)    /* IN */
+{
+	gboolean first = TRUE;
+	gdouble last_x = 0.;
+	gdouble last_y = 0.;
+	gdouble x;
+	gdouble y;
+	gint k;
+
+	for (k = 0; k < n_values; k++) {
+		y = values[k];
+		x = x_epoch - (k * x_each);
+		/*
+		 * Don't try to draw before we have real values.
+		 */
+		if (isnan(y) || isinf(y)) {
+			first = TRUE;
+			continue;
+		}
+		y = y_end - y;
+		if (first) {
+			cairo_move_to(cr, x, y);
+			first = FALSE;
+		} else {
+			cairo_curve_to(cr,
+			               last_x - (x_each / 2.),
+			               last_y,
+			               last_x - (x_each / 2.),
+			               y, x, y);
+		}
+		last_x = x;
+		last_y = y;
 	}
-	gdk_cairo_set_source_color(cr, &color);
-	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
-	cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
 }
 
 /**
- * uber_graph_render_fg_task:
+ * uber_graph_render_fg_range:
  * @graph: A #UberGraph.
  * @info: A GraphInfo.
+ * @begin: The first segment to render.
+ * @end: The segment after the last to render.
  *
- * XXX
+ * Renders segments @begin through @end - 1 of the foreground.  Segment k
+ * joins data point k + 1 to data point k, where data point 0 is the most
+ * recent, and is drawn within its own slot of the foreground ring.  The
+ * slots of the segments must not wrap around the end of the ring.  The
+ * last segment has no older data point and only clears its slot.
  *
  * Returns: None.
  * Side effects: None.
  */
 static void
-uber_graph_render_fg_task (UberGraph *graph, /* IN */
-                           GraphInfo *info)  /* IN */
+uber_graph_render_fg_range (UberGraph *graph, /* IN */
+                            GraphInfo *info,  /* IN */
+                            gint       begin, /* IN */
+                            gint       end)   /* IN */
 {
 	UberGraphPrivate *priv;
-	GtkAllocation alloc;
-	RenderClosure closure = { 0 };
+	UberRange pixel_range;
 	LineInfo *line;
+	gdouble values[REDRAW_CHUNK + 1];
+	gdouble x_epoch;
+	gdouble x_start;
+	gint n_values;
+	gint slot;
 	gint i;
+	gint k;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 	g_return_if_fail(info != NULL);
+	g_return_if_fail(begin < end);
+	g_return_if_fail(end - begin <= REDRAW_CHUNK);
 
-	ENTRY;
 	priv = graph->priv;
-	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
-	/*
-	 * Prepare graph closure.
-	 */
-	closure.graph = graph;
-	closure.info = info;
-	closure.scale = priv->scale;
-	GET_PIXEL_RANGE(closure.pixel_range, priv->content_rect);
-	closure.value_range = priv->yrange;
-	closure.x_epoch = priv->content_rect.x + priv->content_rect.width + priv->x_each;
-	/*
-	 * Clear the background.
-	 */
-	cairo_save(info->fg_cairo);
-	cairo_set_operator(info->fg_cairo, CAIRO_OPERATOR_CLEAR);
-	cairo_rectangle(info->fg_cairo, 0, 0, alloc.width + priv->x_each, alloc.height);
-	cairo_fill(info->fg_cairo);
-	cairo_restore(info->fg_cairo);
+	GET_PIXEL_RANGE(pixel_range, priv->content_rect);
+	slot = (priv->fg_slot - 1 - begin) % priv->x_slots;
+	if (slot < 0) {
+		slot += priv->x_slots;
+	}
+	x_epoch = (slot + 1) * priv->x_each;
+	x_start = x_epoch - ((end - begin) * priv->x_each);
 	/*
-	 * Render data point contents.
+	 * Clear the slots being replaced and clip to them.
 	 */
 	cairo_save(info->fg_cairo);
 	cairo_rectangle(info->fg_cairo,
-	                priv->content_rect.x,
+	                x_start,
 	                priv->content_rect.y,
-	                priv->content_rect.width + priv->x_each,
+	                x_epoch - x_start,
 	                priv->content_rect.height);
 	cairo_clip(info->fg_cairo);
+	cairo_set_operator(info->fg_cairo, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(info->fg_cairo);
+	cairo_set_operator(info->fg_cairo, CAIRO_OPERATOR_OVER);
+	/*
+	 * Render the lines of data as bezier curves from newest to oldest.
+	 */
 	for (i = 0; i < priv->lines->len; i++) {
 		line = &g_array_index(priv->lines, LineInfo, i);
-		closure.last_x = -INFINITY;
-		closure.last_y = -INFINITY;
-		closure.first = TRUE;
-		closure.offset = 0;
-		cairo_move_to(info->fg_cairo,
-		              closure.x_epoch,
-		              priv->content_rect.y + priv->content_rect.height - 1);
 		uber_graph_stylize_line(graph, line, info->fg_cairo);
-		uber_buffer_foreach(line->scaled, uber_graph_render_fg_each, &closure);
+		n_values = 0;
+		for (k = begin; k <= end && k < priv->stride; k++) {
+			values[n_values++] = uber_buffer_get_index(line->scaled, k);
+		}
+		cairo_new_path(info->fg_cairo);
+		uber_graph_path_values(info->fg_cairo, values, n_values, x_epoch,
+		                       priv->x_each, pixel_range.end);
 		cairo_stroke(info->fg_cairo);
 	}
 	cairo_restore(info->fg_cairo);
-	priv->fg_dirty = FALSE;
-	priv->fps_off++;
+}
+
+/**
+ * uber_graph_render_fg_slice:
+ * @graph: A #UberGraph.
+ * @info: A GraphInfo.
+ *
+ * Continues a full redraw of the foreground, newest segments first, until
+ * it completes or REDRAW_BUDGET has elapsed.
+ *
+ * Returns: %TRUE if segments remain to be redrawn; otherwise %FALSE.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_render_fg_slice (UberGraph *graph, /* IN */
+                            GraphInfo *info)  /* IN */
+{
+	UberGraphPrivate *priv;
+	gint64 begin;
+	gint n_segments;
+	gint slot;
+	gint end;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+	g_return_val_if_fail(info != NULL, FALSE);
+
+	ENTRY;
+	priv = graph->priv;
+	begin = uber_graph_timing_begin(graph);
+	n_segments = priv->x_slots;
+	while (priv->redraw_k < n_segments) {
+		/*
+		 * Stop at the end of the ring so the range does not wrap.
+		 */
+		slot = (priv->fg_slot - 1 - priv->redraw_k) % priv->x_slots;
+		if (slot < 0) {
+			slot += priv->x_slots;
+		}
+		end = MIN(priv->redraw_k + REDRAW_CHUNK, n_segments);
+		end = MIN(end, priv->redraw_k + slot + 1);
+		uber_graph_render_fg_range(graph, info, priv->redraw_k, end);
+		priv->redraw_k = end;
+		if (uber_frame_clock_get_time() - begin >= REDRAW_BUDGET) {
+			break;
+		}
+	}
+	uber_graph_timing_end(graph, UBER_GRAPH_TIMING_RENDER_FG, begin);
+	RETURN(priv->redraw_k < n_segments);
+}
+
+/**
+ * uber_graph_redraw_timeout:
+ * @data: An #UberGraph.
+ *
+ * Idle handler which renders the next slice of a full redraw and
+ * invalidates the columns it covered.
+ *
+ * Returns: %TRUE while segments remain to be redrawn.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_redraw_timeout (gpointer data) /* IN */
+{
+	UberGraph *graph = data;
+	UberGraphPrivate *priv;
+	GdkRectangle rect;
+	GdkRectangle area;
+	GdkWindow *window;
+	gboolean more;
+	gint right;
+	gint begin;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	priv = graph->priv;
+	/*
+	 * The foreground is rendered in full once visible again.
+	 */
+	if (priv->suspended) {
+		priv->fg_dirty = TRUE;
+		priv->redraw_handler = 0;
+		return FALSE;
+	}
+	begin = priv->redraw_k;
+	more = uber_graph_render_fg_slice(graph, &priv->info);
+	if (!more) {
+		priv->redraw_handler = 0;
+	}
+	/*
+	 * Segment k is drawn k segments left of the most recent data point.
+	 */
+	if ((window = gtk_widget_get_window(GTK_WIDGET(graph)))) {
+		right = priv->content_rect.x + priv->content_rect.width + priv->x_each
+		      - (gint)(priv->fps_each * priv->fps_off);
+		rect.x = right - (priv->redraw_k * priv->x_each);
+		rect.y = priv->content_rect.y;
+		rect.width = (priv->redraw_k - begin) * priv->x_each;
+		rect.height = priv->content_rect.height;
+		uber_graph_get_fg_area(graph, &area);
+		if (gdk_rectangle_intersect(&rect, &area, &rect)) {
+			gdk_window_invalidate_rect(window, &rect, FALSE);
+		}
+	}
+	return more;
+}
+
+/**
+ * uber_graph_render_job_free:
+ * @job: A RenderJob.
+ *
+ * Frees @job and releases its reference on the graph.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_render_job_free (RenderJob *job) /* IN */
+{
+	if (job->surface) {
+		cairo_surface_destroy(job->surface);
+	}
+	g_object_unref(job->graph);
+	g_free(job->colors);
+	g_free(job->values);
+	g_slice_free(RenderJob, job);
+}
+
+/**
+ * uber_graph_render_job_thread:
+ * @data: A RenderJob.
+ *
+ * Renders the whole foreground ring of a job into an image surface.  This
+ * runs on a render worker and only uses the snapshot within the job.
+ *
+ * Each line is drawn once at its place in the ring and once a ring width
+ * to the right, so that the part which wraps around the start of the ring
+ * lands within the surface.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_render_job_thread (gpointer data) /* IN */
+{
+	RenderJob *job = data;
+	gdouble x_epoch;
+	gdouble ring;
+	cairo_t *cr;
+	guint i;
+	gint j;
+
+	ENTRY;
+	job->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+	                                          job->width, job->height);
+	cr = cairo_create(job->surface);
+	x_epoch = job->slot * job->x_each;
+	ring = job->x_slots * job->x_each;
+	for (i = 0; i < job->n_lines; i++) {
+		uber_graph_stylize_cairo(cr, &job->colors[i], job->line_width);
+		for (j = 0; j < 2; j++) {
+			cairo_new_path(cr);
+			uber_graph_path_values(cr, &job->values[i * job->x_slots],
+			                       job->x_slots, x_epoch + (j * ring),
+			                       job->x_each, job->pixel_range.end);
+			cairo_stroke(cr);
+		}
+	}
+	cairo_destroy(cr);
 	EXIT;
 }
 
 /**
- * uber_graph_render_fg_shifted_task:
+ * uber_graph_render_job_done:
+ * @data: A RenderJob.
+ *
+ * Main loop callback which hands a rendered foreground to the graph.  The
+ * slots which were rendered by shifted renders since the job was queued
+ * are newer than the job and are kept; the rest of the ring is replaced
+ * with the rendered surface.  Jobs superseded by a later render, or
+ * whose slots have all been rendered again since, are dropped.
+ *
+ * Returns: %FALSE always.
+ * Side effects: @data is freed.
+ */
+static gboolean
+uber_graph_render_job_done (gpointer data) /* IN */
+{
+	RenderJob *job = data;
+	UberGraphPrivate *priv;
+	GraphInfo *info;
+	GdkWindow *window;
+	GdkRectangle area;
+	guint n_new;
+	gint start;
+	gint count;
+	gint width;
+	gint height;
+
+	ENTRY;
+	priv = job->graph->priv;
+	info = &priv->info;
+	if (job->serial != priv->render_serial || priv->fg_dirty ||
+	    !uber_graph_get_fg_size(info, &width, &height)) {
+		GOTO(cleanup);
+	}
+	if (job->x_slots != priv->x_slots || job->x_each != priv->x_each ||
+	    job->width != width || job->height != height) {
+		GOTO(cleanup);
+	}
+	n_new = priv->n_shifted - job->n_shifted;
+	if (n_new >= job->x_slots) {
+		/*
+		 * Every slot has been rendered again since by shifted renders at
+		 * the current scale, so the ring is already complete.
+		 */
+		GOTO(cleanup);
+	}
+	start = (job->slot + n_new) % job->x_slots;
+	count = job->x_slots - n_new;
+	cairo_save(info->fg_cairo);
+	cairo_rectangle(info->fg_cairo,
+	                start * job->x_each,
+	                priv->content_rect.y,
+	                MIN(count, job->x_slots - start) * job->x_each,
+	                priv->content_rect.height);
+	if (count > job->x_slots - start) {
+		cairo_rectangle(info->fg_cairo,
+		                0,
+		                priv->content_rect.y,
+		                (count - (job->x_slots - start)) * job->x_each,
+		                priv->content_rect.height);
+	}
+	cairo_clip(info->fg_cairo);
+	cairo_set_operator(info->fg_cairo, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface(info->fg_cairo, job->surface, 0, 0);
+	cairo_paint(info->fg_cairo);
+	cairo_restore(info->fg_cairo);
+	if ((window = gtk_widget_get_window(GTK_WIDGET(job->graph)))) {
+		uber_graph_get_fg_area(job->graph, &area);
+		gdk_window_invalidate_rect(window, &area, FALSE);
+	}
+  cleanup:
+	uber_graph_render_job_free(job);
+	RETURN(FALSE);
+}
+
+/**
+ * uber_graph_render_job_push:
  * @graph: A #UberGraph.
- * @src: A GraphInfo with contents to copy.
- * @dst: A GraphInfo to copy shifted src contents to.
  *
- * Renders a portion of @src pixmap to @dst pixmap at the shifting
- * rate.  It is assumed that the most recent value in the circular buffer
- * is the value that needs to be rendered and added to the pixmap.
+ * Snapshots the scaled values and settings of the foreground and queues
+ * them to be rendered by the render workers.  Any job already queued is
+ * superseded.
  *
  * Returns: None.
  * Side effects: None.
  */
 static void
-uber_graph_render_fg_shifted_task (UberGraph    *graph,  /* IN */
-                                   GraphInfo    *src,    /* IN */
-                                   GraphInfo    *dst)    /* IN */
+uber_graph_render_job_push (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
+	RenderJob *job;
 	LineInfo *line;
-	GtkAllocation alloc;
-	gdouble last_y;
-	gdouble x_epoch;
-	gdouble y_end;
-	gdouble y;
-	gint i;
+	guint i;
+	gint k;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
-	g_return_if_fail(src != NULL);
-	g_return_if_fail(dst != NULL);
 
 	ENTRY;
 	priv = graph->priv;
-	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
-	/*
-	 * Clear the old pixmap contents.
-	 */
-	cairo_save(dst->fg_cairo);
-	cairo_set_operator(dst->fg_cairo, CAIRO_OPERATOR_CLEAR);
-	cairo_set_source_rgb(dst->fg_cairo, 1, 1, 1);
-	cairo_rectangle(dst->fg_cairo, 0, 0, alloc.width, alloc.height);
-	cairo_paint(dst->fg_cairo);
-	cairo_restore(dst->fg_cairo);
+	job = g_slice_new0(RenderJob);
+	job->graph = g_object_ref(graph);
+	job->serial = ++priv->render_serial;
+	job->n_shifted = priv->n_shifted;
+	job->slot = priv->fg_slot;
+	job->x_slots = priv->x_slots;
+	job->x_each = priv->x_each;
+	uber_graph_get_fg_size(&priv->info, &job->width, &job->height);
+	GET_PIXEL_RANGE(job->pixel_range, priv->content_rect);
+	job->line_width = priv->line_width;
+	job->n_lines = priv->lines->len;
+	job->colors = g_new(GdkColor, job->n_lines);
+	job->values = g_new(gdouble, job->n_lines * job->x_slots);
+	for (i = 0; i < job->n_lines; i++) {
+		line = &g_array_index(priv->lines, LineInfo, i);
+		uber_graph_get_line_color(graph, line, &job->colors[i]);
+		for (k = 0; k < job->x_slots; k++) {
+			job->values[(i * job->x_slots) + k] =
+				uber_buffer_get_index(line->scaled, k);
+		}
+	}
+	uber_render_worker_push(uber_graph_render_job_thread,
+	                        uber_graph_render_job_done, job);
+	EXIT;
+}
+
+/**
+ * uber_graph_render_fg_task:
+ * @graph: A #UberGraph.
+ * @info: A GraphInfo.
+ *
+ * Starts a full redraw of the foreground.  The most recent segments are
+ * rendered right away and the rest in slices from an idle handler so that
+ * a large graph does not block the main loop.  Until then the previous
+ * contents of the ring are shown for the older segments.
+ *
+ * With the render workers enabled, the whole ring is rendered on a worker
+ * instead and handed back once complete.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_render_fg_task (UberGraph *graph, /* IN */
+                           GraphInfo *info)  /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(info != NULL);
+
+	ENTRY;
+	priv = graph->priv;
+	priv->fg_dirty = FALSE;
 	/*
-	 * Shift contents of source onto destination pixmap.  The unused
-	 * data point is lost and contents shifted over.
+	 * Offscreen graphs render in place so that uber_graph_paint() always
+	 * produces a complete frame.
 	 */
-	cairo_save(dst->fg_cairo);
-	cairo_set_operator(dst->fg_cairo, CAIRO_OPERATOR_OVER);
-	gdk_cairo_set_source_pixmap(dst->fg_cairo, src->fg_pixmap, -(gint)priv->x_each, 0);
-	cairo_rectangle(dst->fg_cairo, 0, 0, alloc.width, alloc.height);
-	cairo_fill(dst->fg_cairo);
-	cairo_restore(dst->fg_cairo);
+	if (priv->render_worker && info->fg_pixmap) {
+		uber_graph_render_job_push(graph);
+		EXIT;
+	}
+	priv->redraw_k = 0;
+	if (uber_graph_render_fg_slice(graph, info) && !priv->redraw_handler) {
+		priv->redraw_handler = g_idle_add(uber_graph_redraw_timeout, graph);
+	}
+	EXIT;
+}
+
+/**
+ * uber_graph_render_fg_shifted_task:
+ * @graph: A #UberGraph.
+ * @info: A GraphInfo.
+ *
+ * Renders the most recent value in the circular buffer into the next slot
+ * of the foreground ring pixmap.  Only that slot is cleared and drawn; the
+ * rest of the ring is left as is and scrolled into place when exposed.
+ *
+ * Returns: None.
+ * Side effects: The ring slot is advanced.
+ */
+static void
+uber_graph_render_fg_shifted_task (UberGraph *graph, /* IN */
+                                   GraphInfo *info)  /* IN */
+{
+	UberGraphPrivate *priv;
+	gint64 begin;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(info != NULL);
+
+	ENTRY;
+	priv = graph->priv;
+	begin = uber_graph_timing_begin(graph);
+	priv->fg_slot = (priv->fg_slot + 1) % priv->x_slots;
+	priv->n_shifted++;
 	/*
-	 * Render the lines of data.  Clip the region to the new area only.
+	 * Segments of a redraw in progress are now one further from the most
+	 * recent data point.
 	 */
-	y_end = priv->content_rect.y + priv->content_rect.height - 1;
-	x_epoch = priv->content_rect.x + priv->content_rect.width + priv->x_each;
-	cairo_save(dst->fg_cairo);
-	cairo_rectangle(dst->fg_cairo,
-	                priv->content_rect.x + priv->content_rect.width,
-	                priv->content_rect.y,
-	                priv->x_each,
-	                priv->content_rect.height);
-	cairo_clip(dst->fg_cairo);
-	for (i = 0; i < priv->lines->len; i++) {
-		line = &g_array_index(priv->lines, LineInfo, i);
-		y = uber_buffer_get_index(line->scaled, 0);
-		last_y = uber_buffer_get_index(line->scaled, 1);
-		/*
-		 * Don't try to draw before we have real values.
-		 */
-		if ((isnan(y) || isinf(y)) || (isnan(last_y) || isinf(last_y))) {
-			continue;
-		}
-		y = y_end - y;
-		last_y = y_end - last_y;
-		/*
-		 * Convert relative position to fixed from bottom pixel.
-		 */
-		uber_graph_stylize_line(graph, line, dst->fg_cairo);
-		cairo_move_to(dst->fg_cairo, x_epoch, y);
-		cairo_curve_to(dst->fg_cairo,
-		               x_epoch - (priv->x_each / 2.),
-		               y,
-		               x_epoch - (priv->x_each / 2.),
-		               last_y,
-		               priv->content_rect.x + priv->content_rect.width,
-		               last_y);
-		cairo_stroke(dst->fg_cairo);
-	}
-	cairo_restore(dst->fg_cairo);
+	if (priv->redraw_handler) {
+		priv->redraw_k++;
+	}
+	uber_graph_render_fg_range(graph, info, 0, 1);
+	uber_graph_timing_end(graph, UBER_GRAPH_TIMING_RENDER_FG, begin);
 	EXIT;
 }
 
@@ -1523,7 +2567,8 @@ uber_graph_render_fg_shifted_task (UberGraph    *graph,  /* IN */
  *
  * Initializes the GraphInfo structure to match the current settings of the
  * #UberGraph.  If @info has existing server-side pixmaps, they will be scaled
- * to match the new size of the widget.
+ * to match the new size of the widget.  Offscreen graphs use client side
+ * image surfaces instead.
  *
  * The renderer will perform a redraw of the entire area on its next pass as
  * the contents will potentially be lossy and skewed.  But this is still far
@@ -1539,8 +2584,10 @@ uber_graph_init_graph_info (UberGraph *graph, /* IN */
 	UberGraphPrivate *priv;
 	GtkAllocation alloc;
 	GdkDrawable *drawable;
-	GdkPixmap *bg_pixmap;
-	GdkPixmap *fg_pixmap;
+	GdkPixmap *bg_pixmap = NULL;
+	GdkPixmap *fg_pixmap = NULL;
+	cairo_surface_t *bg_surface = NULL;
+	cairo_surface_t *fg_surface = NULL;
 	GdkColormap *colormap;
 	GdkVisual *visual;
 	GdkColor bg_color;
@@ -1553,48 +2600,45 @@ uber_graph_init_graph_info (UberGraph *graph, /* IN */
 	ENTRY;
 	priv = graph->priv;
 	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
-	drawable = GDK_DRAWABLE(gtk_widget_get_window(GTK_WIDGET(graph)));
-	priv->have_rgba = !!gdk_screen_get_rgba_colormap(gdk_drawable_get_screen(drawable));
-	bg_pixmap = gdk_pixmap_new(drawable, alloc.width, alloc.height, -1);
 	/*
-	 * Try to use a 32-bit colormap for alpha channel. If the system doesn't
-	 * support it, we need to note it so we can fallback to an XOR draw.
+	 * The foreground is a ring of one slot per data point, so it is only
+	 * as tall as the widget and as wide as all of the slots.
 	 */
-	fg_width = alloc.width + priv->x_each + 1;
-	if (priv->have_rgba) {
-		visual = gdk_visual_get_best_with_depth(32);
-		fg_pixmap = gdk_pixmap_new(NULL, fg_width, alloc.height, 32);
-		colormap = gdk_colormap_new(visual, FALSE);
-		gdk_drawable_set_colormap(GDK_DRAWABLE(fg_pixmap), colormap);
-		g_object_unref(colormap);
+	fg_width = MAX(priv->x_slots * priv->x_each, 1);
+	if (priv->offscreen) {
+		/*
+		 * Image surfaces always have an alpha channel.
+		 */
+		priv->have_rgba = TRUE;
+		bg_surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+		                                        MAX(alloc.width, 1),
+		                                        MAX(alloc.height, 1));
+		fg_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+		                                        fg_width,
+		                                        MAX(alloc.height, 1));
 	} else {
-		fg_pixmap = gdk_pixmap_new(drawable, fg_width, alloc.height, -1);
+		drawable = GDK_DRAWABLE(gtk_widget_get_window(GTK_WIDGET(graph)));
+		priv->have_rgba = !!gdk_screen_get_rgba_colormap(gdk_drawable_get_screen(drawable));
+		bg_pixmap = gdk_pixmap_new(drawable, alloc.width, alloc.height, -1);
+		/*
+		 * Try to use a 32-bit colormap for alpha channel. If the system
+		 * doesn't support it, we need to note it so we can fallback to an
+		 * XOR draw.
+		 */
+		if (priv->have_rgba) {
+			visual = gdk_visual_get_best_with_depth(32);
+			fg_pixmap = gdk_pixmap_new(NULL, fg_width, alloc.height, 32);
+			colormap = gdk_colormap_new(visual, FALSE);
+			gdk_drawable_set_colormap(GDK_DRAWABLE(fg_pixmap), colormap);
+			g_object_unref(colormap);
+		} else {
+			fg_pixmap = gdk_pixmap_new(drawable, fg_width, alloc.height, -1);
+		}
 	}
-	/*
-	 * Set background to default widget background.
-	 */
-	bg_color = gtk_widget_get_style(GTK_WIDGET(graph))->bg[GTK_STATE_NORMAL];
-	cr = gdk_cairo_create(GDK_DRAWABLE(bg_pixmap));
-	gdk_cairo_set_source_color(cr, &bg_color);
-	cairo_rectangle(cr, 0, 0, alloc.width, alloc.height);
-	cairo_fill(cr);
-	cairo_destroy(cr);
-	/*
-	 * Clear contents of foreground.
-	 */
-	cr = gdk_cairo_create(GDK_DRAWABLE(fg_pixmap));
-	cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
-	cairo_rectangle(cr, 0, 0, alloc.width, alloc.height);
-	cairo_set_source_rgb(cr, 1, 1, 1);
-	cairo_paint(cr);
-	cairo_destroy(cr);
 	/*
 	 * Cleanup after any previous cairo contexts.
 	 */
 	if (info->bg_cairo) {
-		if (info->tick_layout) {
-			g_object_unref(info->tick_layout);
-		}
 		cairo_destroy(info->bg_cairo);
 	}
 	if (info->fg_cairo) {
@@ -1611,21 +2655,49 @@ uber_graph_init_graph_info (UberGraph *graph, /* IN */
 	if (info->fg_pixmap) {
 		g_object_unref(info->fg_pixmap);
 	}
+	if (info->bg_surface) {
+		cairo_surface_destroy(info->bg_surface);
+	}
+	if (info->fg_surface) {
+		cairo_surface_destroy(info->fg_surface);
+	}
 	info->bg_pixmap = bg_pixmap;
 	info->fg_pixmap = fg_pixmap;
+	info->bg_surface = bg_surface;
+	info->fg_surface = fg_surface;
 	/*
 	 * Update cached cairo contexts.
 	 */
-	info->bg_cairo = gdk_cairo_create(GDK_DRAWABLE(info->bg_pixmap));
-	info->fg_cairo = gdk_cairo_create(GDK_DRAWABLE(info->fg_pixmap));
+	if (priv->offscreen) {
+		info->bg_cairo = cairo_create(info->bg_surface);
+		info->fg_cairo = cairo_create(info->fg_surface);
+	} else {
+		info->bg_cairo = gdk_cairo_create(GDK_DRAWABLE(info->bg_pixmap));
+		info->fg_cairo = gdk_cairo_create(GDK_DRAWABLE(info->fg_pixmap));
+	}
+	/*
+	 * Set background to default widget background.
+	 */
+	bg_color = gtk_widget_get_style(GTK_WIDGET(graph))->bg[GTK_STATE_NORMAL];
+	cr = info->bg_cairo;
+	cairo_save(cr);
+	gdk_cairo_set_source_color(cr, &bg_color);
+	cairo_rectangle(cr, 0, 0, alloc.width, alloc.height);
+	cairo_fill(cr);
+	cairo_restore(cr);
 	/*
-	 * Create PangoLayouts for rendering text.
+	 * Clear contents of foreground.
 	 */
-	info->tick_layout = pango_cairo_create_layout(info->bg_cairo);
+	cr = info->fg_cairo;
+	cairo_save(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(cr);
+	cairo_restore(cr);
 	/*
-	 * Update the layouts to reflect proper styling.
+	 * The ring is empty, so the foreground must be rendered in full.
 	 */
-	uber_graph_prepare_layout(graph, info->tick_layout, LAYOUT_TICK);
+	priv->fg_slot = 0;
+	priv->fg_dirty = TRUE;
 	EXIT;
 }
 
@@ -1644,9 +2716,6 @@ uber_graph_destroy_graph_info (UberGraph *graph, /* IN */
                                GraphInfo *info)  /* IN */
 {
 	ENTRY;
-	if (info->tick_layout) {
-		g_object_unref(info->tick_layout);
-	}
 	if (info->bg_cairo) {
 		cairo_destroy(info->bg_cairo);
 	}
@@ -1659,6 +2728,12 @@ uber_graph_destroy_graph_info (UberGraph *graph, /* IN */
 	if (info->fg_pixmap) {
 		g_object_unref(info->fg_pixmap);
 	}
+	if (info->bg_surface) {
+		cairo_surface_destroy(info->bg_surface);
+	}
+	if (info->fg_surface) {
+		cairo_surface_destroy(info->fg_surface);
+	}
 	EXIT;
 }
 
@@ -1699,6 +2774,220 @@ uber_graph_update_scaled (UberGraph *graph) /* IN */
 	EXIT;
 }
 
+/**
+ * uber_graph_update_suspended:
+ * @graph: A #UberGraph.
+ *
+ * Suspends rendering if the graph cannot be seen, or resumes it with a
+ * single full render once it can be seen again.  Values are still
+ * retrieved while suspended.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_update_suspended (UberGraph *graph) /* IN */
+{
+	UberGraphPrivate *priv;
+	gboolean suspended;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	ENTRY;
+	priv = graph->priv;
+	suspended = !priv->mapped || priv->obscured || priv->iconified;
+	if (suspended == priv->suspended) {
+		EXIT;
+	}
+	priv->suspended = suspended;
+	if (!suspended) {
+		/*
+		 * Rescale the values that arrived while hidden and render the
+		 * foreground from scratch.
+		 */
+		if (priv->rescale_pending) {
+			uber_graph_update_scaled(graph);
+			priv->bg_dirty = TRUE;
+			priv->rescale_pending = FALSE;
+		}
+		priv->fg_dirty = TRUE;
+		priv->fps_off = 0;
+		gtk_widget_queue_draw(GTK_WIDGET(graph));
+	}
+	/*
+	 * Switch between the frame rate and the data rate.
+	 */
+	priv->fps_deadline = uber_frame_clock_get_time()
+	                   + uber_graph_get_tick_period(graph);
+	uber_frame_clock_schedule(uber_frame_clock_get_default(),
+	                          priv->fps_handler, priv->fps_deadline);
+	EXIT;
+}
+
+/**
+ * uber_graph_map:
+ * @widget: A #GtkWidget.
+ *
+ * Resumes rendering when the graph is mapped.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_map (GtkWidget *widget) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(widget));
+
+	ENTRY;
+	priv = UBER_GRAPH(widget)->priv;
+	BASE_CLASS->map(widget);
+	priv->mapped = TRUE;
+	priv->obscured = FALSE;
+	uber_graph_update_suspended(UBER_GRAPH(widget));
+	EXIT;
+}
+
+/**
+ * uber_graph_unmap:
+ * @widget: A #GtkWidget.
+ *
+ * Suspends rendering when the graph is unmapped.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_unmap (GtkWidget *widget) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(widget));
+
+	ENTRY;
+	priv = UBER_GRAPH(widget)->priv;
+	priv->mapped = FALSE;
+	uber_graph_update_suspended(UBER_GRAPH(widget));
+	BASE_CLASS->unmap(widget);
+	EXIT;
+}
+
+/**
+ * uber_graph_visibility_notify_event:
+ * @widget: A #GtkWidget.
+ * @visibility: A #GdkEventVisibility.
+ *
+ * Suspends rendering while the graph is fully obscured, such as when it is
+ * covered by another window or scrolled out of view.
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_visibility_notify_event (GtkWidget          *widget,     /* IN */
+                                    GdkEventVisibility *visibility) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(widget), FALSE);
+
+	ENTRY;
+	priv = UBER_GRAPH(widget)->priv;
+	priv->obscured = (visibility->state == GDK_VISIBILITY_FULLY_OBSCURED);
+	uber_graph_update_suspended(UBER_GRAPH(widget));
+	RETURN(FALSE);
+}
+
+/**
+ * uber_graph_toplevel_window_state_event:
+ * @toplevel: The toplevel #GtkWidget.
+ * @state: A #GdkEventWindowState.
+ * @graph: A #UberGraph.
+ *
+ * Suspends rendering while the toplevel is iconified or withdrawn, which
+ * is also how many window managers hide windows on other workspaces.
+ *
+ * Returns: %FALSE always.
+ * Side effects: None.
+ */
+static gboolean
+uber_graph_toplevel_window_state_event (GtkWidget           *toplevel, /* IN */
+                                        GdkEventWindowState *state,    /* IN */
+                                        UberGraph           *graph)    /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	ENTRY;
+	priv = graph->priv;
+	priv->iconified = !!(state->new_window_state &
+	                     (GDK_WINDOW_STATE_ICONIFIED |
+	                      GDK_WINDOW_STATE_WITHDRAWN));
+	uber_graph_update_suspended(graph);
+	RETURN(FALSE);
+}
+
+/**
+ * uber_graph_set_toplevel:
+ * @graph: A #UberGraph.
+ * @toplevel: The new toplevel #GtkWidget or %NULL.
+ *
+ * Moves the "window-state-event" handler to the new toplevel.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_set_toplevel (UberGraph *graph,    /* IN */
+                         GtkWidget *toplevel) /* IN */
+{
+	UberGraphPrivate *priv;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+
+	ENTRY;
+	priv = graph->priv;
+	if (priv->toplevel) {
+		g_signal_handler_disconnect(priv->toplevel, priv->state_handler);
+		priv->toplevel = NULL;
+		priv->state_handler = 0;
+	}
+	priv->iconified = FALSE;
+	if (toplevel && GTK_IS_WINDOW(toplevel)) {
+		priv->toplevel = toplevel;
+		priv->state_handler =
+			g_signal_connect(toplevel, "window-state-event",
+			                 G_CALLBACK(uber_graph_toplevel_window_state_event),
+			                 graph);
+	}
+	uber_graph_update_suspended(graph);
+	EXIT;
+}
+
+/**
+ * uber_graph_hierarchy_changed:
+ * @widget: A #GtkWidget.
+ * @old_toplevel: The previous toplevel or %NULL.
+ *
+ * Tracks the toplevel of the graph so that iconification is noticed.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_hierarchy_changed (GtkWidget *widget,       /* IN */
+                              GtkWidget *old_toplevel) /* IN */
+{
+	g_return_if_fail(UBER_IS_GRAPH(widget));
+
+	ENTRY;
+	uber_graph_set_toplevel(UBER_GRAPH(widget),
+	                        gtk_widget_get_toplevel(widget));
+	EXIT;
+}
+
 /**
  * uber_graph_size_allocate:
  * @widget: A GtkWidget.
@@ -1729,8 +3018,6 @@ uber_graph_size_allocate (GtkWidget     *widget, /* IN */
 	priv->bg_dirty = TRUE;
 	uber_graph_calculate_rects(UBER_GRAPH(widget));
 	uber_graph_set_fps(graph, priv->fps); /* Re-calculate */
-	priv->x_each = ((gdouble)priv->content_rect.width - 2)
-	             / ((gdouble)priv->stride - 2.);
 	uber_graph_scale_changed(graph);
 	EXIT;
 }
@@ -1766,6 +3053,192 @@ gdk_cairo_rectangle_clean (cairo_t      *cr,   /* IN */
 	cairo_rectangle(cr, x, y, w, h);
 }
 
+/**
+ * uber_graph_paint_fg:
+ * @graph: A #UberGraph.
+ * @cr: A cairo_t clipped to the foreground area.
+ *
+ * Paints the foreground ring to @cr.  Slots before the current slot hold
+ * the most recent data points and are drawn on the right, the rest hold the
+ * oldest data points and are drawn to their left.  The most recent data
+ * point lines up with the right edge of the content area once the frame has
+ * fully scrolled.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_graph_paint_fg (UberGraph *graph, /* IN */
+                     cairo_t   *cr)    /* IN */
+{
+	UberGraphPrivate *priv;
+	GraphInfo *info;
+	GtkAllocation alloc;
+	gint ring_width;
+	gint split;
+	gint x;
+
+	priv = graph->priv;
+	info = &priv->info;
+	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
+	split = priv->fg_slot * priv->x_each;
+	ring_width = priv->x_slots * priv->x_each;
+	x = priv->content_rect.x + priv->content_rect.width + priv->x_each - split
+	  - (gint)(priv->fps_each * priv->fps_off);
+	/*
+	 * Blit both portions of the ring.
+	 */
+	uber_graph_set_layer_source(cr, info->fg_pixmap, info->fg_surface, x, 0);
+	cairo_rectangle(cr, x, 0, split, alloc.height);
+	cairo_fill(cr);
+	uber_graph_set_layer_source(cr, info->fg_pixmap, info->fg_surface,
+	                            x - ring_width, 0);
+	cairo_rectangle(cr, x + split - ring_width, 0, ring_width - split,
+	                alloc.height);
+	cairo_fill(cr);
+}
+
+/**
+ * uber_graph_paint:
+ * @graph: A #UberGraph.
+ * @cr: A cairo_t to paint to.
+ *
+ * Paints the current frame of the graph to @cr with the origin of the graph
+ * at the origin of @cr.  The background and foreground are rendered in full
+ * first if they are out of date.  This is used to produce frames of graphs
+ * rendered with uber_graph_set_offscreen().
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_paint (UberGraph *graph, /* IN */
+                  cairo_t   *cr)    /* IN */
+{
+	UberGraphPrivate *priv;
+	GraphInfo *info;
+	GtkAllocation alloc;
+	GdkRectangle area;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(cr != NULL);
+
+	priv = graph->priv;
+	info = &priv->info;
+	g_return_if_fail(info->bg_cairo != NULL);
+
+	gtk_widget_get_allocation(GTK_WIDGET(graph), &alloc);
+	/*
+	 * Offscreen graphs are never mapped, so values are only ingested
+	 * between frames; rescale them as would happen on resume.
+	 */
+	if (priv->rescale_pending) {
+		uber_graph_update_scaled(graph);
+		priv->bg_dirty = TRUE;
+		priv->fg_dirty = TRUE;
+		priv->rescale_pending = FALSE;
+	}
+	if (priv->bg_dirty) {
+		uber_graph_render_bg_task(graph, info);
+		priv->bg_dirty = FALSE;
+	}
+	/*
+	 * Finish the foreground now rather than in slices from the main loop.
+	 */
+	if (priv->fg_dirty) {
+		uber_graph_render_fg_task(graph, info);
+	}
+	if (priv->redraw_handler) {
+		while (uber_graph_render_fg_slice(graph, info)) {
+			/* Keep rendering. */
+		}
+		g_source_remove(priv->redraw_handler);
+		priv->redraw_handler = 0;
+	}
+	/*
+	 * Paint the background.
+	 */
+	cairo_save(cr);
+	uber_graph_set_layer_source(cr, info->bg_pixmap, info->bg_surface, 0, 0);
+	cairo_rectangle(cr, 0, 0, alloc.width, alloc.height);
+	cairo_fill(cr);
+	cairo_restore(cr);
+	/*
+	 * Paint the foreground within the content area.
+	 */
+	if (priv->have_rgba) {
+		cairo_save(cr);
+		uber_graph_get_fg_area(graph, &area);
+		gdk_cairo_rectangle(cr, &area);
+		cairo_clip(cr);
+		uber_graph_paint_fg(graph, cr);
+		cairo_restore(cr);
+	} else {
+		/*
+		 * TODO: Use XOR command for fallback.
+		 */
+		g_warn_if_reached();
+	}
+}
+
+/**
+ * uber_graph_set_offscreen:
+ * @graph: A #UberGraph.
+ * @width: The width of the graph in pixels.
+ * @height: The height of the graph in pixels.
+ *
+ * Renders @graph into client side image surfaces of the given size rather
+ * than server side pixmaps, so that no display is required.  Values are
+ * retrieved on the frame clock as usual; frames are produced on demand
+ * with uber_graph_paint().
+ *
+ * This must be called before the graph is realized.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_graph_set_offscreen (UberGraph *graph,  /* IN */
+                          gint       width,  /* IN */
+                          gint       height) /* IN */
+{
+	GtkAllocation alloc;
+
+	g_return_if_fail(UBER_IS_GRAPH(graph));
+	g_return_if_fail(!gtk_widget_get_realized(GTK_WIDGET(graph)));
+	g_return_if_fail(width > 0);
+	g_return_if_fail(height > 0);
+
+	ENTRY;
+	graph->priv->offscreen = TRUE;
+	/*
+	 * Allocate the requested size, which creates the surfaces.
+	 */
+	alloc.x = 0;
+	alloc.y = 0;
+	alloc.width = width;
+	alloc.height = height;
+	gtk_widget_size_allocate(GTK_WIDGET(graph), &alloc);
+	EXIT;
+}
+
+/**
+ * uber_graph_get_offscreen:
+ * @graph: A #UberGraph.
+ *
+ * Retrieves if @graph renders without a display.
+ *
+ * Returns: %TRUE if uber_graph_set_offscreen() was called.
+ * Side effects: None.
+ */
+gboolean
+uber_graph_get_offscreen (UberGraph *graph) /* IN */
+{
+	g_return_val_if_fail(UBER_IS_GRAPH(graph), FALSE);
+
+	return graph->priv->offscreen;
+}
+
 /**
  * uber_graph_expose_event:
  * @widget: A #UberGraph.
@@ -1784,31 +3257,36 @@ uber_graph_expose_event (GtkWidget      *widget, /* IN */
 	UberGraphPrivate *priv;
 	GdkDrawable *dst;
 	GraphInfo *info;
-	GdkRectangle clip;
 	GdkRectangle area;
+	GdkRegion *clip;
 	cairo_t *cr;
 	GtkAllocation alloc;
+	gint64 begin;
+	gint ring_width;
+	gint split;
+	gint x;
 
 	g_return_val_if_fail(UBER_IS_GRAPH(widget), FALSE);
 	g_return_val_if_fail(expose != NULL, FALSE);
 
 	priv = UBER_GRAPH(widget)->priv;
+	begin = uber_graph_timing_begin(UBER_GRAPH(widget));
+	uber_fps_governor_begin(priv->governor);
 	gtk_widget_get_allocation(widget, &alloc);
 	dst = expose->window;
-	info = &priv->info[priv->flipped];
+	info = &priv->info;
 	cr = gdk_cairo_create(dst);
 	/*
-	 * Set the clip region.
+	 * Set the clip region.  After a scroll this is only the uncovered
+	 * sliver and the grid lines, not their bounding box.
 	 */
-	gdk_cairo_rectangle(cr, &expose->area);
+	gdk_cairo_region(cr, expose->region);
 	cairo_clip(cr);
 	/*
 	 * Render the background to the pixmap again if needed.
 	 */
 	if (G_UNLIKELY(priv->bg_dirty)) {
 		uber_graph_render_bg_task(UBER_GRAPH(widget), info);
-		uber_graph_copy_background(UBER_GRAPH(widget), info,
-		                           &priv->info[!priv->flipped]);
 		priv->bg_dirty = FALSE;
 	}
 	/*
@@ -1828,11 +3306,7 @@ uber_graph_expose_event (GtkWidget      *widget, /* IN */
 	/*
 	 * Determine the foreground clipping area.
 	 */
-	area = priv->content_rect;
-	area.x += 1;
-	area.y += 1;
-	area.width -= 2;
-	area.height -= 2;
+	uber_graph_get_fg_area(UBER_GRAPH(widget), &area);
 	/*
 	 * Render the full foreground if needed.
 	 */
@@ -1842,7 +3316,19 @@ uber_graph_expose_event (GtkWidget      *widget, /* IN */
 	/*
 	 * Determine the clip region for the foreground.
 	 */
-	gdk_rectangle_intersect(&area, &expose->area, &clip);
+	clip = gdk_region_rectangle(&area);
+	gdk_region_intersect(clip, expose->region);
+	/*
+	 * The foreground pixmap is a ring buffer.  Slots before the current
+	 * slot hold the most recent data points and are drawn on the right,
+	 * the rest hold the oldest data points and are drawn to their left.
+	 * The most recent data point lines up with the right edge of the
+	 * content area once the frame has fully scrolled.
+	 */
+	split = priv->fg_slot * priv->x_each;
+	ring_width = priv->x_slots * priv->x_each;
+	x = priv->content_rect.x + priv->content_rect.width + priv->x_each - split
+	  - (gint)(priv->fps_each * priv->fps_off);
 	/*
 	 * Render the foreground lines on top of the background.
 	 */
@@ -1853,27 +3339,18 @@ uber_graph_expose_event (GtkWidget      *widget, /* IN */
 		 * overlapping the grid lines to be incorrect.  It's not really all
 		 * that bad though, it just has an effect similar to flicker.
 		 */
-		gdk_gc_set_clip_rectangle(priv->fg_gc, &clip);
+		gdk_gc_set_clip_region(priv->fg_gc, clip);
 		/*
-		 * Blit the drawable.
+		 * Blit both portions of the ring.
 		 */
-		if (G_UNLIKELY(priv->fg_dirty)) {
-			gdk_draw_drawable(dst, priv->fg_gc, GDK_DRAWABLE(info->fg_pixmap),
-			                  priv->content_rect.x,
-			                  priv->content_rect.y,
-			                  priv->content_rect.x,
-			                  priv->content_rect.y,
-			                  priv->content_rect.width,
-			                  priv->content_rect.height);
-		} else {
-			gdk_draw_drawable(dst, priv->fg_gc, GDK_DRAWABLE(info->fg_pixmap),
-			                  priv->content_rect.x,
-			                  priv->content_rect.y,
-			                  priv->content_rect.x - (priv->fps_each * priv->fps_off),
-			                  priv->content_rect.y,
-			                  priv->content_rect.width + priv->x_each,
-			                  priv->content_rect.height);
-		}
+		gdk_draw_drawable(dst, priv->fg_gc, GDK_DRAWABLE(info->fg_pixmap),
+		                  0, priv->content_rect.y,
+		                  x, priv->content_rect.y,
+		                  split, priv->content_rect.height);
+		gdk_draw_drawable(dst, priv->fg_gc, GDK_DRAWABLE(info->fg_pixmap),
+		                  split, priv->content_rect.y,
+		                  x + split - ring_width, priv->content_rect.y,
+		                  ring_width - split, priv->content_rect.height);
 		gdk_gc_set_clip_rectangle(priv->fg_gc, NULL);
 	} else {
 		/*
@@ -1882,26 +3359,17 @@ uber_graph_expose_event (GtkWidget      *widget, /* IN */
 		 * even if on top of grid lines.
 		 */
 		gdk_cairo_reset_clip(cr, expose->window);
-		gdk_cairo_rectangle(cr, &clip);
+		gdk_cairo_region(cr, clip);
 		cairo_clip(cr);
-		/*
-		 * Blit the drawable.
-		 */
-		if (G_UNLIKELY(priv->fg_dirty)) {
-			gdk_cairo_set_source_pixmap(cr, info->fg_pixmap, 0, 0);
-		} else {
-			gdk_cairo_set_source_pixmap(cr, info->fg_pixmap,
-			                            -(gint)(priv->fps_each * priv->fps_off),
-			                            0);
-		}
-		cairo_rectangle(cr, 0, 0, alloc.width, alloc.height);
-		cairo_paint(cr);
+		uber_graph_paint_fg(UBER_GRAPH(widget), cr);
 	}
-	priv->fps_off++;
+	gdk_region_destroy(clip);
 	/*
 	 * Reset the clip region.
 	 */
 	cairo_destroy(cr);
+	uber_fps_governor_end(priv->governor);
+	uber_graph_timing_end(UBER_GRAPH(widget), UBER_GRAPH_TIMING_EXPOSE, begin);
 	return FALSE;
 }
 
@@ -1926,11 +3394,11 @@ uber_graph_style_set (GtkWidget *widget,     /* IN */
 	ENTRY;
 	priv = UBER_GRAPH(widget)->priv;
 	BASE_CLASS->style_set(widget, old_style);
-	if (!gtk_widget_get_window(widget)) {
+	uber_text_cache_clear(priv->label_cache);
+	if (!gtk_widget_get_window(widget) && !priv->offscreen) {
 		return;
 	}
-	uber_graph_init_graph_info(UBER_GRAPH(widget), &priv->info[0]);
-	uber_graph_init_graph_info(UBER_GRAPH(widget), &priv->info[1]);
+	uber_graph_init_graph_info(UBER_GRAPH(widget), &priv->info);
 	EXIT;
 }
 
@@ -2139,8 +3607,18 @@ uber_graph_finalize (GObject *object) /* IN */
 
 	ENTRY;
 	priv = UBER_GRAPH(object)->priv;
-	uber_graph_destroy_graph_info(UBER_GRAPH(object), &priv->info[0]);
-	uber_graph_destroy_graph_info(UBER_GRAPH(object), &priv->info[1]);
+	uber_graph_destroy_graph_info(UBER_GRAPH(object), &priv->info);
+	uber_text_cache_free(priv->label_cache);
+	uber_autoscale_free(priv->autoscale);
+	if (priv->grid_region) {
+		gdk_region_destroy(priv->grid_region);
+	}
+	if (priv->refine_handler) {
+		g_source_remove(priv->refine_handler);
+	}
+	if (priv->redraw_handler) {
+		g_source_remove(priv->redraw_handler);
+	}
 	if (priv->fg_gc) {
 		g_object_unref(priv->fg_gc);
 	}
@@ -2148,7 +3626,11 @@ uber_graph_finalize (GObject *object) /* IN */
 		g_object_unref(priv->bg_gc);
 	}
 	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
+		uber_frame_clock_remove(uber_frame_clock_get_default(),
+		                        priv->fps_handler);
+	}
+	if (priv->toplevel) {
+		g_signal_handler_disconnect(priv->toplevel, priv->state_handler);
 	}
 	if (priv->value_notify) {
 		priv->value_notify(priv->value_user_data);
@@ -2159,6 +3641,7 @@ uber_graph_finalize (GObject *object) /* IN */
 		uber_buffer_unref(line->scaled);
 	}
 	g_array_unref(priv->lines);
+	uber_fps_governor_free(priv->governor);
 	G_OBJECT_CLASS(uber_graph_parent_class)->finalize(object);
 	EXIT;
 }
@@ -2224,10 +3707,14 @@ uber_graph_class_init (UberGraphClass *klass) /* IN */
 	 */
 	widget_class = GTK_WIDGET_CLASS(klass);
 	widget_class->expose_event = uber_graph_expose_event;
+	widget_class->hierarchy_changed = uber_graph_hierarchy_changed;
+	widget_class->map = uber_graph_map;
 	widget_class->realize = uber_graph_realize;
 	widget_class->size_allocate = uber_graph_size_allocate;
 	widget_class->style_set = uber_graph_style_set;
 	widget_class->size_request = uber_graph_size_request;
+	widget_class->unmap = uber_graph_unmap;
+	widget_class->visibility_notify_event = uber_graph_visibility_notify_event;
 	/**
 	 * UberGraph:line-width:
 	 *
@@ -2259,6 +3746,7 @@ static void
 uber_graph_init (UberGraph *graph) /* IN */
 {
 	UberGraphPrivate *priv;
+	PangoFontDescription *desc;
 
 	g_return_if_fail(UBER_IS_GRAPH(graph));
 
@@ -2266,6 +3754,7 @@ uber_graph_init (UberGraph *graph) /* IN */
 	graph->priv = GET_PRIVATE(graph, UBER_TYPE_GRAPH, UberGraphPrivate);
 	priv = graph->priv;
 	priv->stride = 60;
+	priv->x_slots = priv->stride;
 	priv->tick_len = 5;
 	priv->line_width = 1.0;
 	priv->scale = uber_scale_linear;
@@ -2273,9 +3762,18 @@ uber_graph_init (UberGraph *graph) /* IN */
 	priv->yrange.end = 1.;
 	priv->yrange.range = 1.;
 	priv->format = UBER_GRAPH_DIRECT;
+	priv->autoscale = uber_autoscale_new();
 	priv->lines = g_array_sized_new(FALSE, TRUE, sizeof(LineInfo), 2);
 	priv->colors = g_strdupv((gchar **)default_colors);
 	priv->colors_len = G_N_ELEMENTS(default_colors);
+	priv->suspended = TRUE;
+	desc = uber_graph_create_font(LAYOUT_TICK);
+	priv->label_cache = uber_text_cache_new(desc, TRUE);
+	pango_font_description_free(desc);
+	gtk_widget_add_events(GTK_WIDGET(graph), GDK_VISIBILITY_NOTIFY_MASK);
+	priv->render_worker = (g_getenv("UBER_RENDER_WORKER") != NULL);
+	priv->governor = uber_fps_governor_new(20);
+	uber_fps_governor_set_budget(priv->governor, DEFAULT_RENDER_BUDGET);
 	uber_graph_set_fps(graph, 20);
 	EXIT;
 }
@@ -92,6 +92,38 @@ typedef enum
 	UBER_GRAPH_INTEGRAL,
 } UberGraphFormat;
 
+/**
+ * UberGraphTiming:
+ * @UBER_GRAPH_TIMING_EXPOSE: Handling of an expose event.
+ * @UBER_GRAPH_TIMING_RENDER_FG: Rendering of the foreground.
+ * @UBER_GRAPH_TIMING_RENDER_BG: Rendering of the background.
+ *
+ * #UberGraphTiming describes which section of rendering was measured.
+ */
+typedef enum
+{
+	UBER_GRAPH_TIMING_EXPOSE,
+	UBER_GRAPH_TIMING_RENDER_FG,
+	UBER_GRAPH_TIMING_RENDER_BG,
+} UberGraphTiming;
+
+/**
+ * UberGraphTimingFunc:
+ * @graph: A #UberGraph.
+ * @timing: The section of rendering that was measured.
+ * @elapsed: The time spent in nanoseconds.
+ * @user_data: User data supplied to uber_graph_set_timing_func().
+ *
+ * Callback receiving rendering times of the graph.
+ *
+ * Returns: None.
+ * Side effects: Implementation specific.
+ */
+typedef void (*UberGraphTimingFunc) (UberGraph       *graph,
+                                     UberGraphTiming  timing,
+                                     gint64           elapsed,
+                                     gpointer         user_data);
+
 struct _UberGraph
 {
 	GtkDrawingArea parent;
@@ -108,15 +140,27 @@ struct _UberGraphClass
 guint           uber_graph_add_line       (UberGraph       *graph);
 UberGraphFormat uber_graph_get_format     (UberGraph       *graph);
 gdouble         uber_graph_get_line_width (UberGraph       *graph);
+gboolean        uber_graph_get_offscreen  (UberGraph       *graph);
+gdouble         uber_graph_get_render_budget(UberGraph     *graph);
+gboolean        uber_graph_get_render_worker(UberGraph     *graph);
 GType           uber_graph_get_type       (void) G_GNUC_CONST;
 gboolean        uber_graph_get_yautoscale (UberGraph       *graph);
 GtkWidget*      uber_graph_new            (void);
+void            uber_graph_paint          (UberGraph       *graph,
+                                           cairo_t         *cr);
 void            uber_graph_set_format     (UberGraph       *graph,
                                            UberGraphFormat  format);
 void            uber_graph_set_fps        (UberGraph       *graph,
                                            gint             fps);
 void            uber_graph_set_line_width (UberGraph       *graph,
                                            gdouble          line_width);
+void            uber_graph_set_offscreen  (UberGraph       *graph,
+                                           gint             width,
+                                           gint             height);
+void            uber_graph_set_render_budget(UberGraph     *graph,
+                                           gdouble          budget);
+void            uber_graph_set_render_worker(UberGraph     *graph,
+                                           gboolean         render_worker);
 void            uber_graph_set_line_color (UberGraph       *graph,
                                            gint             line,
                                            const GdkColor  *color);
@@ -126,12 +170,19 @@ void            uber_graph_set_show_xlabel(UberGraph       *graph,
                                            gboolean         xlabel);
 void            uber_graph_set_stride     (UberGraph       *graph,
                                            gint             stride);
+void            uber_graph_set_timing_func(UberGraph       *graph,
+                                           UberGraphTimingFunc func,
+                                           gpointer         user_data);
 void            uber_graph_set_value_func (UberGraph       *graph,
                                            UberGraphFunc    func,
                                            gpointer         user_data,
                                            GDestroyNotify   notify);
 void            uber_graph_set_yautoscale (UberGraph       *graph,
                                            gboolean         yautoscale);
+void            uber_graph_set_yautoscale_policy(UberGraph *graph,
+                                           gdouble          headroom,
+                                           gdouble          hysteresis,
+                                           gdouble          interval);
 void            uber_graph_set_yrange     (UberGraph       *graph,
                                            const UberRange *range);
 gboolean        uber_scale_linear         (UberGraph       *graph,
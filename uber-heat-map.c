@@ -23,9 +23,11 @@
 #include <math.h>
 
 #include "g-ring.h"
+#include "uber-frame-clock.h"
 #include "uber-heat-map.h"
 
 #define WIDGET ((GtkWidgetClass *)uber_heat_map_parent_class)
+#define NSEC_PER_SEC G_GINT64_CONSTANT(1000000000)
 
 #define DEBUG_RECT(r)                                       \
     g_debug("GdkRectangle(X=%d, Y=%d, Width=%d, Height=%d", \
@@ -68,8 +70,8 @@ struct _UberHeatMapPrivate
 	gint             fps;
 	gint             fps_calc;
 	gdouble          fps_each;
-	gint             fps_to;
 	guint            fps_handler;
+	gint64           fps_deadline;
 	gint             fps_off;
 	gint             stride;
 	gint             col_count;
@@ -946,6 +948,38 @@ uber_heat_map_fps_timeout (UberHeatMap *map) /* IN */
 	return TRUE;
 }
 
+/**
+ * uber_heat_map_fps_tick:
+ * @clock: An #UberFrameClock.
+ * @frame_time: The frame time in nanoseconds.
+ * @data: An #UberHeatMap.
+ *
+ * Frame clock callback for the heat map.
+ *
+ * Returns: The next frame deadline.
+ * Side effects: None.
+ */
+static gint64
+uber_heat_map_fps_tick (UberFrameClock *clock,      /* IN */
+                        gint64          frame_time, /* IN */
+                        gpointer        data)       /* IN */
+{
+	UberHeatMap *map = data;
+	UberHeatMapPrivate *priv;
+	gint64 period;
+
+	g_return_val_if_fail(UBER_IS_HEAT_MAP(map), -1);
+
+	priv = map->priv;
+	uber_heat_map_fps_timeout(map);
+	period = NSEC_PER_SEC / MAX(priv->fps_calc, 1);
+	priv->fps_deadline += period;
+	if (priv->fps_deadline <= frame_time) {
+		priv->fps_deadline = frame_time + period;
+	}
+	return priv->fps_deadline;
+}
+
 /**
  * uber_heat_map_set_fps:
  * @map: A #UberHeatMap.
@@ -962,6 +996,7 @@ uber_heat_map_set_fps (UberHeatMap *map, /* IN */
                        gint         fps) /* IN */
 {
 	UberHeatMapPrivate *priv;
+	UberFrameClock *clock;
 
 	g_return_if_fail(UBER_IS_HEAT_MAP(map));
 	g_return_if_fail(fps > 0);
@@ -969,13 +1004,9 @@ uber_heat_map_set_fps (UberHeatMap *map, /* IN */
 	priv = map->priv;
 	priv->fps = fps;
 	priv->fps_calc = fps;
-	priv->fps_to = 1000. / fps;
 	priv->fps_each = (gfloat)priv->content_rect.width /
 	                 (gfloat)priv->stride /
 	                 (gfloat)priv->fps;
-	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
-	}
 	/*
 	 * If we are moving less than one pixel per frame, then go ahead and lower
 	 * the actual framerate and move 1 pixel at a time.
@@ -983,11 +1014,15 @@ uber_heat_map_set_fps (UberHeatMap *map, /* IN */
 	if (priv->fps_each < 1.) {
 		priv->fps_each = 1.;
 		priv->fps_calc = (gfloat)priv->content_rect.width / (gfloat)priv->stride;
-		priv->fps_to = 1000. / priv->fps_calc;
 	}
-	priv->fps_handler = g_timeout_add(priv->fps_to,
-	                                  (GSourceFunc)uber_heat_map_fps_timeout,
-	                                  map);
+	clock = uber_frame_clock_get_default();
+	if (!priv->fps_handler) {
+		priv->fps_handler = uber_frame_clock_add(clock, uber_heat_map_fps_tick,
+		                                         map);
+	}
+	priv->fps_deadline = uber_frame_clock_get_time()
+	                   + (NSEC_PER_SEC / MAX(priv->fps_calc, 1));
+	uber_frame_clock_schedule(clock, priv->fps_handler, priv->fps_deadline);
 }
 
 /**
@@ -1248,7 +1283,8 @@ uber_heat_map_finalize (GObject *object) /* IN */
 	uber_heat_map_destroy_texture(UBER_HEAT_MAP(object),
 	                              &priv->textures[!priv->flipped]);
 	if (priv->fps_handler) {
-		g_source_remove(priv->fps_handler);
+		uber_frame_clock_remove(uber_frame_clock_get_default(),
+		                        priv->fps_handler);
 	}
 	G_OBJECT_CLASS(uber_heat_map_parent_class)->finalize(object);
 }
@@ -25,29 +25,27 @@
 #include "uber-label.h"
 
 #ifdef UBER_TRACE
-#define TRACE(_f,...) \
-    G_STMT_START { \
-        g_log(G_LOG_DOMAIN, 1 << G_LOG_LEVEL_USER_SHIFT, _f, ## __VA_ARGS__); \
-    } G_STMT_END
-#define ENTRY TRACE("ENTRY: %s():%d", G_STRFUNC, __LINE__)
+#include "uber-trace.h"
+#define TRACE(_t,_l) uber_trace_record(_t, G_STRFUNC, _l, __LINE__)
+#define ENTRY TRACE(UBER_TRACE_ENTRY, NULL)
 #define EXIT \
     G_STMT_START { \
-        TRACE(" EXIT: %s():%d", G_STRFUNC, __LINE__); \
+        TRACE(UBER_TRACE_EXIT, NULL); \
         return; \
     } G_STMT_END
 #define RETURN(_r) \
     G_STMT_START { \
-        TRACE(" EXIT: %s():%d", G_STRFUNC, __LINE__); \
+        TRACE(UBER_TRACE_EXIT, NULL); \
         return (_r); \
 	} G_STMT_END
 #define GOTO(_l) \
     G_STMT_START { \
-        TRACE(" GOTO: %s():%d %s", G_STRFUNC, __LINE__, #_l); \
+        TRACE(UBER_TRACE_GOTO, #_l); \
         goto _l; \
 	} G_STMT_END
 #define CASE(_l) \
     case _l: \
-        TRACE(" CASE: %s():%d %s", G_STRFUNC, __LINE__, #_l)
+        TRACE(UBER_TRACE_CASE, #_l)
 #else
 #define ENTRY
 #define EXIT       return
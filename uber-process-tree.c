@@ -0,0 +1,649 @@
+/* uber-process-tree.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uber-process-tree.h"
+
+/**
+ * SECTION:uber-process-tree
+ * @title: UberProcessTree
+ * @short_description: Incremental monitoring of a process and its children.
+ *
+ * #UberProcessTree keeps an open descriptor to the /proc/PID directory of
+ * every process in the tree.  Refreshing the statistics only requires a
+ * single openat() and read() of "stat" per process, which keeps the cost
+ * flat even with hundreds of children.  Since the directory descriptor is
+ * bound to the process instance, a recycled pid can never be mistaken for
+ * a member of the tree; openat() simply fails once the process exits.
+ *
+ * Discovering new children is more expensive and is performed separately
+ * by uber_process_tree_discover().  When the kernel provides
+ * /proc/PID/task/TID/children it is used to walk only the tree itself,
+ * otherwise /proc is scanned for processes whose parent is in the tree.
+ */
+
+typedef struct
+{
+	GPid    pid;        /* Process id */
+	gint    dirfd;      /* Descriptor for /proc/PID */
+	guint   generation; /* Last discovery pass that saw the process */
+	guint64 ticks;      /* utime + stime at last refresh */
+	gboolean have_ticks;
+	gdouble cpu;        /* Percentage of a single cpu */
+	gdouble resident;   /* Resident set size in bytes */
+	gint    n_threads;  /* Number of threads */
+} UberProcess;
+
+struct _UberProcessTree
+{
+	GPid        root;          /* Process the tree is rooted at */
+	GHashTable *procs;         /* pid -> UberProcess */
+	guint       generation;    /* Discovery pass counter */
+	gboolean    scan_proc;     /* No children files, scan /proc instead */
+	gint64      last_refresh;  /* Monotonic time of last refresh in usec */
+	glong       clk_tck;       /* Clock ticks per second */
+	glong       page_size;     /* Size of a page in bytes */
+};
+
+/**
+ * uber_process_tree_get_time:
+ *
+ * Retrieves the current monotonic time in microseconds.
+ *
+ * Returns: The monotonic time.
+ * Side effects: None.
+ */
+static inline gint64
+uber_process_tree_get_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((gint64)ts.tv_sec * G_USEC_PER_SEC) + (ts.tv_nsec / 1000);
+}
+
+/**
+ * uber_process_tree_read_at:
+ * @dirfd: A directory descriptor.
+ * @path: The path relative to @dirfd.
+ * @buf: A buffer to read into.
+ * @len: The length of @buf.
+ *
+ * Reads the contents of @path relative to @dirfd into @buf.  @buf is
+ * always nul-terminated.
+ *
+ * Returns: The number of bytes read, or -1 on failure.
+ * Side effects: None.
+ */
+static gssize
+uber_process_tree_read_at (gint         dirfd, /* IN */
+                           const gchar *path,  /* IN */
+                           gchar       *buf,   /* OUT */
+                           gsize        len)   /* IN */
+{
+	gssize r;
+	gint fd;
+
+	if ((fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC)) < 0) {
+		return -1;
+	}
+	r = read(fd, buf, len - 1);
+	close(fd);
+	buf[MAX(r, 0)] = '\0';
+	return r;
+}
+
+/**
+ * uber_process_tree_parse_stat:
+ * @buf: The contents of /proc/PID/stat.
+ * @ppid: A location for the parent pid, or %NULL.
+ * @ticks: A location for utime + stime, or %NULL.
+ * @n_threads: A location for the number of threads, or %NULL.
+ * @rss: A location for the resident set size in pages, or %NULL.
+ *
+ * Parses the fields of interest from /proc/PID/stat.  The command name may
+ * contain spaces and parenthesis, so parsing starts after the last ')'.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE.
+ * Side effects: None.
+ */
+static gboolean
+uber_process_tree_parse_stat (gchar   *buf,       /* IN */
+                              GPid    *ppid,      /* OUT */
+                              guint64 *ticks,     /* OUT */
+                              gint    *n_threads, /* OUT */
+                              glong   *rss)       /* OUT */
+{
+	guint64 utime = 0;
+	guint64 stime = 0;
+	gchar *p;
+	gint field;
+
+	if (!(p = strrchr(buf, ')'))) {
+		return FALSE;
+	}
+	/*
+	 * Walk the space separated fields.  Field 3 (state) directly follows
+	 * the command name.
+	 */
+	for (field = 3, p++; *p && field <= 24; field++) {
+		while (*p == ' ') {
+			p++;
+		}
+		switch (field) {
+		case 4:
+			if (ppid) {
+				*ppid = strtol(p, NULL, 10);
+			}
+			break;
+		case 14:
+			utime = g_ascii_strtoull(p, NULL, 10);
+			break;
+		case 15:
+			stime = g_ascii_strtoull(p, NULL, 10);
+			break;
+		case 20:
+			if (n_threads) {
+				*n_threads = strtol(p, NULL, 10);
+			}
+			break;
+		case 24:
+			if (rss) {
+				*rss = strtol(p, NULL, 10);
+			}
+			break;
+		default:
+			break;
+		}
+		while (*p && *p != ' ') {
+			p++;
+		}
+	}
+	if (field <= 24) {
+		return FALSE;
+	}
+	if (ticks) {
+		*ticks = utime + stime;
+	}
+	return TRUE;
+}
+
+/**
+ * uber_process_free:
+ * @data: An #UberProcess.
+ *
+ * Closes the cached directory descriptor and frees the process.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_process_free (gpointer data) /* IN */
+{
+	UberProcess *proc = data;
+
+	if (proc->dirfd >= 0) {
+		close(proc->dirfd);
+	}
+	g_slice_free(UberProcess, proc);
+}
+
+/**
+ * uber_process_tree_mark:
+ * @tree: An #UberProcessTree.
+ * @pid: A process id.
+ *
+ * Marks @pid as a member of the tree for the current discovery pass,
+ * opening a descriptor to its /proc directory if it is new.
+ *
+ * Returns: %TRUE if @pid is a live member of the tree; otherwise %FALSE.
+ * Side effects: None.
+ */
+static gboolean
+uber_process_tree_mark (UberProcessTree *tree, /* IN */
+                        GPid             pid)  /* IN */
+{
+	UberProcess *proc;
+	gchar path[32];
+	gint dirfd;
+
+	if ((proc = g_hash_table_lookup(tree->procs, GINT_TO_POINTER(pid)))) {
+		if (proc->generation == tree->generation) {
+			return FALSE;
+		}
+		proc->generation = tree->generation;
+		return TRUE;
+	}
+	g_snprintf(path, sizeof(path), "/proc/%d", (gint)pid);
+	if ((dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return FALSE;
+	}
+	proc = g_slice_new0(UberProcess);
+	proc->pid = pid;
+	proc->dirfd = dirfd;
+	proc->generation = tree->generation;
+	g_hash_table_insert(tree->procs, GINT_TO_POINTER(pid), proc);
+	return TRUE;
+}
+
+/**
+ * uber_process_tree_walk_children:
+ * @proc: An #UberProcess.
+ * @queue: A queue of pids to visit.
+ *
+ * Appends the children of each thread of @proc to @queue using the
+ * /proc/PID/task/TID/children files.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_process_tree_walk_children (UberProcess     *proc,  /* IN */
+                                 GArray          *queue) /* IN/OUT */
+{
+	struct dirent *ent;
+	gchar buf[4096];
+	gchar path[64];
+	gchar *p;
+	GPid child;
+	DIR *dir;
+	gint fd;
+
+	if ((fd = openat(proc->dirfd, "task", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		return;
+	}
+	if (!(dir = fdopendir(fd))) {
+		close(fd);
+		return;
+	}
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.') {
+			continue;
+		}
+		g_snprintf(path, sizeof(path), "%s/children", ent->d_name);
+		if (uber_process_tree_read_at(dirfd(dir), path, buf, sizeof(buf)) < 0) {
+			continue;
+		}
+		for (p = buf; *p;) {
+			child = strtol(p, &p, 10);
+			if (child > 0) {
+				g_array_append_val(queue, child);
+			}
+			while (*p == ' ' || *p == '\n') {
+				p++;
+			}
+		}
+	}
+	closedir(dir);
+}
+
+/**
+ * uber_process_tree_scan_proc:
+ * @tree: An #UberProcessTree.
+ *
+ * Discovers the members of the tree by scanning every process in /proc
+ * for its parent.  This is the fallback when the kernel does not provide
+ * the children files.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_process_tree_scan_proc (UberProcessTree *tree) /* IN */
+{
+	struct dirent *ent;
+	GHashTable *parents;
+	GArray *queue;
+	GPid parent;
+	GPid pid;
+	gchar buf[1024];
+	gchar path[64];
+	DIR *dir;
+	guint i;
+
+	if (!(dir = opendir("/proc"))) {
+		return;
+	}
+	/*
+	 * Build a map of parent -> children for every process on the system.
+	 */
+	parents = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                (GDestroyNotify)g_slist_free);
+	while ((ent = readdir(dir))) {
+		if (!g_ascii_isdigit(ent->d_name[0])) {
+			continue;
+		}
+		g_snprintf(path, sizeof(path), "%s/stat", ent->d_name);
+		if (uber_process_tree_read_at(dirfd(dir), path, buf, sizeof(buf)) < 0) {
+			continue;
+		}
+		parent = 0;
+		if (!uber_process_tree_parse_stat(buf, &parent, NULL, NULL, NULL)) {
+			continue;
+		}
+		pid = strtol(ent->d_name, NULL, 10);
+		g_hash_table_replace(parents, GINT_TO_POINTER(parent),
+		                     g_slist_prepend(g_hash_table_lookup(parents,
+		                                     GINT_TO_POINTER(parent)),
+		                                     GINT_TO_POINTER(pid)));
+	}
+	closedir(dir);
+	/*
+	 * Breadth first walk from the root of the tree.
+	 */
+	queue = g_array_new(FALSE, FALSE, sizeof(GPid));
+	g_array_append_val(queue, tree->root);
+	for (i = 0; i < queue->len; i++) {
+		GSList *iter;
+
+		pid = g_array_index(queue, GPid, i);
+		if (!uber_process_tree_mark(tree, pid)) {
+			continue;
+		}
+		iter = g_hash_table_lookup(parents, GINT_TO_POINTER(pid));
+		for (; iter; iter = iter->next) {
+			pid = GPOINTER_TO_INT(iter->data);
+			g_array_append_val(queue, pid);
+		}
+	}
+	g_array_free(queue, TRUE);
+	g_hash_table_destroy(parents);
+}
+
+/**
+ * uber_process_tree_is_stale:
+ * @key: The pid.
+ * @value: An #UberProcess.
+ * @user_data: An #UberProcessTree.
+ *
+ * Callback to remove processes that were not seen during the most recent
+ * discovery pass.
+ *
+ * Returns: %TRUE if the process should be removed.
+ * Side effects: None.
+ */
+static gboolean
+uber_process_tree_is_stale (gpointer key,       /* IN */
+                            gpointer value,     /* IN */
+                            gpointer user_data) /* IN */
+{
+	UberProcessTree *tree = user_data;
+	UberProcess *proc = value;
+
+	return (proc->generation != tree->generation);
+}
+
+/**
+ * uber_process_tree_discover:
+ * @tree: An #UberProcessTree.
+ *
+ * Discovers new descendants of the root process and forgets about those
+ * that have exited.  This is more expensive than
+ * uber_process_tree_refresh() and should be called on a slow cadence.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_process_tree_discover (UberProcessTree *tree) /* IN */
+{
+	UberProcess *proc;
+	GArray *queue;
+	GPid pid;
+	guint i;
+
+	g_return_if_fail(tree != NULL);
+
+	tree->generation++;
+	if (tree->scan_proc) {
+		uber_process_tree_scan_proc(tree);
+		goto prune;
+	}
+	queue = g_array_new(FALSE, FALSE, sizeof(GPid));
+	g_array_append_val(queue, tree->root);
+	for (i = 0; i < queue->len; i++) {
+		pid = g_array_index(queue, GPid, i);
+		if (!uber_process_tree_mark(tree, pid)) {
+			continue;
+		}
+		proc = g_hash_table_lookup(tree->procs, GINT_TO_POINTER(pid));
+		uber_process_tree_walk_children(proc, queue);
+	}
+	g_array_free(queue, TRUE);
+
+  prune:
+	g_hash_table_foreach_remove(tree->procs, uber_process_tree_is_stale, tree);
+}
+
+/**
+ * uber_process_tree_refresh:
+ * @tree: An #UberProcessTree.
+ *
+ * Refreshes the statistics for every known member of the tree.  Processes
+ * that have exited since the last discovery pass are dropped.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_process_tree_refresh (UberProcessTree *tree) /* IN */
+{
+	GHashTableIter iter;
+	UberProcess *proc;
+	gdouble elapsed;
+	guint64 ticks;
+	gint64 now;
+	gchar buf[1024];
+	glong rss;
+
+	g_return_if_fail(tree != NULL);
+
+	now = uber_process_tree_get_time();
+	elapsed = (now - tree->last_refresh) / (gdouble)G_USEC_PER_SEC;
+	tree->last_refresh = now;
+
+	g_hash_table_iter_init(&iter, tree->procs);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&proc)) {
+		if (uber_process_tree_read_at(proc->dirfd, "stat", buf, sizeof(buf)) < 0 ||
+		    !uber_process_tree_parse_stat(buf, NULL, &ticks,
+		                                  &proc->n_threads, &rss)) {
+			g_hash_table_iter_remove(&iter);
+			continue;
+		}
+		if (proc->have_ticks && elapsed > 0.) {
+			proc->cpu = (100. * (ticks - proc->ticks))
+			          / (tree->clk_tck * elapsed);
+		}
+		proc->ticks = ticks;
+		proc->have_ticks = TRUE;
+		proc->resident = (gdouble)rss * tree->page_size;
+	}
+}
+
+/**
+ * uber_process_tree_get_count:
+ * @tree: An #UberProcessTree.
+ *
+ * Retrieves the number of processes currently in the tree.
+ *
+ * Returns: The number of processes.
+ * Side effects: None.
+ */
+guint
+uber_process_tree_get_count (UberProcessTree *tree) /* IN */
+{
+	g_return_val_if_fail(tree != NULL, 0);
+
+	return g_hash_table_size(tree->procs);
+}
+
+/**
+ * uber_process_tree_get_totals:
+ * @tree: An #UberProcessTree.
+ * @totals: A location for the aggregated statistics.
+ *
+ * Retrieves the statistics aggregated over every process in the tree.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_process_tree_get_totals (UberProcessTree *tree,   /* IN */
+                              UberProcessInfo *totals) /* OUT */
+{
+	GHashTableIter iter;
+	UberProcess *proc;
+
+	g_return_if_fail(tree != NULL);
+	g_return_if_fail(totals != NULL);
+
+	memset(totals, 0, sizeof(*totals));
+	g_hash_table_iter_init(&iter, tree->procs);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&proc)) {
+		totals->cpu += proc->cpu;
+		totals->resident += proc->resident;
+		totals->n_threads += proc->n_threads;
+	}
+}
+
+/**
+ * uber_process_tree_get_top:
+ * @tree: An #UberProcessTree.
+ * @sort: The statistic to sort by.
+ * @top: An array of at least @n_top #UberProcessInfo.
+ * @n_top: The number of processes to retrieve.
+ *
+ * Retrieves the @n_top processes with the largest value for @sort, in
+ * descending order.  Unused entries have a pid of 0.
+ *
+ * Returns: The number of entries filled in @top.
+ * Side effects: None.
+ */
+guint
+uber_process_tree_get_top (UberProcessTree *tree,  /* IN */
+                           UberProcessSort  sort,  /* IN */
+                           UberProcessInfo *top,   /* OUT */
+                           guint            n_top) /* IN */
+{
+	GHashTableIter iter;
+	UberProcess *proc;
+	gdouble value;
+	guint count = 0;
+	guint i;
+
+	g_return_val_if_fail(tree != NULL, 0);
+	g_return_val_if_fail(top != NULL, 0);
+
+	memset(top, 0, sizeof(*top) * n_top);
+	g_hash_table_iter_init(&iter, tree->procs);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&proc)) {
+		switch (sort) {
+		case UBER_PROCESS_SORT_CPU:
+			value = proc->cpu;
+			break;
+		case UBER_PROCESS_SORT_RESIDENT:
+			value = proc->resident;
+			break;
+		default:
+			g_assert_not_reached();
+			return 0;
+		}
+		/*
+		 * Insertion into the small sorted array keeps this linear in the
+		 * number of processes.
+		 */
+		for (i = count; i > 0; i--) {
+			if (((sort == UBER_PROCESS_SORT_CPU) ?
+			     top[i - 1].cpu : top[i - 1].resident) >= value) {
+				break;
+			}
+			if (i < n_top) {
+				top[i] = top[i - 1];
+			}
+		}
+		if (i < n_top) {
+			top[i].pid = proc->pid;
+			top[i].cpu = proc->cpu;
+			top[i].resident = proc->resident;
+			top[i].n_threads = proc->n_threads;
+			count = MIN(count + 1, n_top);
+		}
+	}
+	return count;
+}
+
+/**
+ * uber_process_tree_new:
+ * @root: The process id at the root of the tree.
+ *
+ * Creates a new #UberProcessTree rooted at @root.  Call
+ * uber_process_tree_discover() to find its descendants.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_process_tree_free().
+ * Side effects: None.
+ */
+UberProcessTree*
+uber_process_tree_new (GPid root) /* IN */
+{
+	UberProcessTree *tree;
+	gchar path[64];
+
+	tree = g_slice_new0(UberProcessTree);
+	tree->root = root;
+	tree->procs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	                                    NULL, uber_process_free);
+	tree->clk_tck = sysconf(_SC_CLK_TCK);
+	tree->page_size = sysconf(_SC_PAGESIZE);
+	tree->last_refresh = uber_process_tree_get_time();
+	/*
+	 * The children files require CONFIG_PROC_CHILDREN.  The main thread of
+	 * this process shares its pid, so use it to probe for support.
+	 */
+	g_snprintf(path, sizeof(path), "/proc/self/task/%d/children", (gint)getpid());
+	tree->scan_proc = !g_file_test(path, G_FILE_TEST_EXISTS);
+	return tree;
+}
+
+/**
+ * uber_process_tree_free:
+ * @tree: An #UberProcessTree.
+ *
+ * Closes all cached descriptors and frees @tree.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_process_tree_free (UberProcessTree *tree) /* IN */
+{
+	g_return_if_fail(tree != NULL);
+
+	g_hash_table_destroy(tree->procs);
+	g_slice_free(UberProcessTree, tree);
+}
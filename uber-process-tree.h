@@ -0,0 +1,82 @@
+/* uber-process-tree.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_PROCESS_TREE_H__
+#define __UBER_PROCESS_TREE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberProcessTree:
+ *
+ * #UberProcessTree tracks a process and all of its descendants.  The set of
+ * processes is discovered with uber_process_tree_discover(), which is
+ * expected to be called on a slow cadence, while the per-process statistics
+ * are refreshed with uber_process_tree_refresh() using cached /proc/PID
+ * directory descriptors.
+ */
+typedef struct _UberProcessTree UberProcessTree;
+
+/**
+ * UberProcessSort:
+ * @UBER_PROCESS_SORT_CPU: Sort by cpu usage.
+ * @UBER_PROCESS_SORT_RESIDENT: Sort by resident memory.
+ *
+ * #UberProcessSort describes how uber_process_tree_get_top() should order
+ * the processes within the tree.
+ */
+typedef enum
+{
+	UBER_PROCESS_SORT_CPU,
+	UBER_PROCESS_SORT_RESIDENT,
+} UberProcessSort;
+
+/**
+ * UberProcessInfo:
+ * @pid: The process id, or 0 for the aggregate of the tree.
+ * @cpu: The cpu usage as a percentage of a single cpu.
+ * @resident: The resident set size in bytes.
+ * @n_threads: The number of threads.
+ *
+ * #UberProcessInfo contains the most recent statistics for a process.
+ */
+typedef struct
+{
+	GPid    pid;
+	gdouble cpu;
+	gdouble resident;
+	gint    n_threads;
+} UberProcessInfo;
+
+UberProcessTree* uber_process_tree_new        (GPid             root);
+void             uber_process_tree_free       (UberProcessTree *tree);
+void             uber_process_tree_discover   (UberProcessTree *tree);
+void             uber_process_tree_refresh    (UberProcessTree *tree);
+guint            uber_process_tree_get_count  (UberProcessTree *tree);
+void             uber_process_tree_get_totals (UberProcessTree *tree,
+                                               UberProcessInfo *totals);
+guint            uber_process_tree_get_top    (UberProcessTree *tree,
+                                               UberProcessSort  sort,
+                                               UberProcessInfo *top,
+                                               guint            n_top);
+
+G_END_DECLS
+
+#endif /* __UBER_PROCESS_TREE_H__ */
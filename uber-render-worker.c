@@ -0,0 +1,235 @@
+/* uber-render-worker.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <unistd.h>
+
+#include "uber-render-worker.h"
+
+/**
+ * SECTION:uber-render-worker
+ * @title: UberRenderWorker
+ * @short_description: Rendering on a pool of worker threads.
+ *
+ * Jobs are rendered on a shared pool with one thread per online CPU so
+ * that many graphs rasterize in parallel.  Once a job is rendered, its
+ * completion callback is dispatched from the default main loop, where the
+ * result may be handed to GTK+.
+ *
+ * A single render may also be split into several jobs with
+ * uber_render_worker_run(), which blocks until all of them are done.
+ */
+
+typedef struct
+{
+	GMutex *mutex;   /* Protects pending. */
+	GCond  *cond;    /* Signaled once pending reaches zero. */
+	guint   pending; /* Number of jobs not yet rendered. */
+} UberRenderGroup;
+
+typedef struct
+{
+	UberRenderFunc   render; /* Called on a worker thread. */
+	GSourceFunc      done;   /* Called from the main loop. */
+	gpointer         data;   /* Data for both callbacks. */
+	UberRenderGroup *group;  /* Group waiting on the job, or NULL. */
+} UberRenderJob;
+
+static GThreadPool *worker_pool  = NULL;
+static GStaticMutex worker_mutex = G_STATIC_MUTEX_INIT;
+
+/**
+ * uber_render_worker_done:
+ * @data: An #UberRenderJob.
+ *
+ * Main loop callback which completes a rendered job.
+ *
+ * Returns: %FALSE always.
+ * Side effects: @data is freed.
+ */
+static gboolean
+uber_render_worker_done (gpointer data) /* IN */
+{
+	UberRenderJob *job = data;
+
+	job->done(job->data);
+	g_slice_free(UberRenderJob, job);
+	return FALSE;
+}
+
+/**
+ * uber_render_worker_thread:
+ * @data: An #UberRenderJob.
+ * @user_data: Unused.
+ *
+ * Thread pool callback which renders a job and then passes it back to the
+ * main loop, or wakes up the thread waiting on its group.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_render_worker_thread (gpointer data,      /* IN */
+                           gpointer user_data) /* IN */
+{
+	UberRenderJob *job = data;
+	UberRenderGroup *group;
+
+	job->render(job->data);
+	if (!(group = job->group)) {
+		g_idle_add_full(G_PRIORITY_DEFAULT, uber_render_worker_done, job, NULL);
+		return;
+	}
+	g_slice_free(UberRenderJob, job);
+	g_mutex_lock(group->mutex);
+	if (--group->pending == 0) {
+		g_cond_signal(group->cond);
+	}
+	g_mutex_unlock(group->mutex);
+}
+
+/**
+ * uber_render_worker_get_n_workers:
+ *
+ * Retrieves the number of worker threads, which is the number of online
+ * CPUs.
+ *
+ * Returns: The number of workers, at least one.
+ * Side effects: None.
+ */
+guint
+uber_render_worker_get_n_workers (void)
+{
+	glong n_cpus;
+
+	n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return MAX(n_cpus, 1);
+}
+
+/**
+ * uber_render_worker_get_pool:
+ *
+ * Retrieves the shared thread pool, creating it on first use.
+ *
+ * Returns: A #GThreadPool.
+ * Side effects: None.
+ */
+static GThreadPool*
+uber_render_worker_get_pool (void)
+{
+	GError *error = NULL;
+
+	g_static_mutex_lock(&worker_mutex);
+	if (G_UNLIKELY(!worker_pool)) {
+		worker_pool = g_thread_pool_new(uber_render_worker_thread, NULL,
+		                                uber_render_worker_get_n_workers(),
+		                                FALSE, &error);
+		if (!worker_pool) {
+			g_error("Failed to create render workers: %s", error->message);
+		}
+	}
+	g_static_mutex_unlock(&worker_mutex);
+	return worker_pool;
+}
+
+/**
+ * uber_render_worker_push:
+ * @render: The function to render the job on a worker thread.
+ * @done: The function to complete the job from the main loop.
+ * @data: The data for @render and @done.
+ *
+ * Queues a job to be rendered by the worker threads.  @done is called from
+ * the default main loop once @render has returned; its return value is
+ * ignored.  Jobs may complete in any order.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_render_worker_push (UberRenderFunc render, /* IN */
+                         GSourceFunc    done,   /* IN */
+                         gpointer       data)   /* IN */
+{
+	UberRenderJob *job;
+
+	g_return_if_fail(render != NULL);
+	g_return_if_fail(done != NULL);
+
+	job = g_slice_new0(UberRenderJob);
+	job->render = render;
+	job->done = done;
+	job->data = data;
+	g_thread_pool_push(uber_render_worker_get_pool(), job, NULL);
+}
+
+/**
+ * uber_render_worker_run:
+ * @render: The function to render each job with.
+ * @jobs: An array of data for each job.
+ * @n_jobs: The number of jobs.
+ *
+ * Renders @n_jobs jobs in parallel and waits for all of them to finish.
+ * The first job is rendered on the calling thread and the rest by the
+ * worker threads.  This must not be called from a worker.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_render_worker_run (UberRenderFunc  render, /* IN */
+                        gpointer       *jobs,   /* IN */
+                        guint           n_jobs) /* IN */
+{
+	UberRenderGroup group;
+	UberRenderJob *job;
+	GThreadPool *pool;
+	guint i;
+
+	g_return_if_fail(render != NULL);
+	g_return_if_fail(jobs != NULL || n_jobs == 0);
+
+	if (n_jobs == 0) {
+		return;
+	}
+	if (n_jobs > 1) {
+		pool = uber_render_worker_get_pool();
+		group.mutex = g_mutex_new();
+		group.cond = g_cond_new();
+		group.pending = n_jobs - 1;
+		for (i = 1; i < n_jobs; i++) {
+			job = g_slice_new0(UberRenderJob);
+			job->render = render;
+			job->data = jobs[i];
+			job->group = &group;
+			g_thread_pool_push(pool, job, NULL);
+		}
+	}
+	render(jobs[0]);
+	if (n_jobs > 1) {
+		g_mutex_lock(group.mutex);
+		while (group.pending > 0) {
+			g_cond_wait(group.cond, group.mutex);
+		}
+		g_mutex_unlock(group.mutex);
+		g_mutex_free(group.mutex);
+		g_cond_free(group.cond);
+	}
+}
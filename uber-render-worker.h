@@ -0,0 +1,48 @@
+/* uber-render-worker.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_RENDER_WORKER_H__
+#define __UBER_RENDER_WORKER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberRenderFunc:
+ * @data: The data passed to uber_render_worker_push().
+ *
+ * Renders a job on a worker thread.  It must not touch GTK+, GDK or any
+ * state shared with the main thread other than @data.
+ *
+ * Returns: None.
+ * Side effects: Implementation specific.
+ */
+typedef void (*UberRenderFunc) (gpointer data);
+
+guint uber_render_worker_get_n_workers (void);
+void  uber_render_worker_push          (UberRenderFunc  render,
+                                        GSourceFunc     done,
+                                        gpointer        data);
+void  uber_render_worker_run           (UberRenderFunc  render,
+                                        gpointer       *jobs,
+                                        guint           n_jobs);
+
+G_END_DECLS
+
+#endif /* __UBER_RENDER_WORKER_H__ */
@@ -0,0 +1,195 @@
+/* uber-sample-clock.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "uber-sample-clock.h"
+
+#define NSEC_PER_SEC  G_GINT64_CONSTANT(1000000000)
+#define NSEC_PER_USEC G_GINT64_CONSTANT(1000)
+
+/**
+ * SECTION:uber-sample-clock
+ * @title: UberSampleClock
+ * @short_description: Drift-free pacing for sampling threads.
+ *
+ * #UberSampleClock sleeps until absolute deadlines on %CLOCK_MONOTONIC
+ * using clock_nanosleep() with %TIMER_ABSTIME.  Deadlines are advanced by
+ * exactly one period each tick, so the work done between ticks does not
+ * stretch the sampling period.  If a deadline is missed entirely, the
+ * skipped deadlines are counted as overruns and the clock realigns with
+ * its original schedule.
+ *
+ * uber_sample_clock_wait() returns the real time elapsed since the
+ * previous tick so that counters can be converted into rates without
+ * assuming the period was met.
+ */
+
+struct _UberSampleClock
+{
+	gint64               period;   /* Period in nanoseconds */
+	gint64               deadline; /* Next absolute deadline */
+	gint64               last;     /* Stamp of the previous tick */
+	GStaticMutex         mutex;    /* Protects stats */
+	UberSampleClockStats stats;    /* Schedule statistics */
+};
+
+/**
+ * uber_sample_clock_get_time:
+ *
+ * Retrieves the current monotonic time in nanoseconds.
+ *
+ * Returns: The monotonic time.
+ * Side effects: None.
+ */
+gint64
+uber_sample_clock_get_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((gint64)ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+/**
+ * uber_sample_clock_new:
+ * @period_usec: The sampling period in microseconds.
+ *
+ * Creates a new #UberSampleClock.  The first deadline is one period from
+ * now.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_sample_clock_free().
+ * Side effects: None.
+ */
+UberSampleClock*
+uber_sample_clock_new (gulong period_usec) /* IN */
+{
+	UberSampleClock *clock;
+
+	g_return_val_if_fail(period_usec > 0, NULL);
+
+	clock = g_slice_new0(UberSampleClock);
+	clock->period = (gint64)period_usec * NSEC_PER_USEC;
+	clock->last = uber_sample_clock_get_time();
+	clock->deadline = clock->last + clock->period;
+	g_static_mutex_init(&clock->mutex);
+	return clock;
+}
+
+/**
+ * uber_sample_clock_free:
+ * @clock: An #UberSampleClock.
+ *
+ * Frees @clock.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_sample_clock_free (UberSampleClock *clock) /* IN */
+{
+	g_return_if_fail(clock != NULL);
+
+	g_static_mutex_free(&clock->mutex);
+	g_slice_free(UberSampleClock, clock);
+}
+
+/**
+ * uber_sample_clock_wait:
+ * @clock: An #UberSampleClock.
+ * @stamp: A location for the monotonic time of the tick, or %NULL.
+ *
+ * Blocks until the next deadline of @clock.  Only one thread may wait on
+ * a clock.
+ *
+ * Returns: The number of seconds elapsed since the previous tick.
+ * Side effects: None.
+ */
+gdouble
+uber_sample_clock_wait (UberSampleClock *clock, /* IN */
+                        gint64          *stamp) /* OUT */
+{
+	struct timespec ts;
+	gdouble elapsed;
+	gdouble late;
+	gint64 missed;
+	gint64 now;
+
+	g_return_val_if_fail(clock != NULL, 0.);
+
+	ts.tv_sec = clock->deadline / NSEC_PER_SEC;
+	ts.tv_nsec = clock->deadline % NSEC_PER_SEC;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+		/* Interrupted by a signal, keep sleeping. */
+	}
+
+	now = uber_sample_clock_get_time();
+	late = MAX(0, now - clock->deadline) / (gdouble)NSEC_PER_USEC;
+	/*
+	 * If we woke up after one or more following deadlines already passed,
+	 * skip them rather than firing a burst of back-to-back ticks.
+	 */
+	missed = MAX(0, now - clock->deadline) / clock->period;
+	clock->deadline += (missed + 1) * clock->period;
+	elapsed = (now - clock->last) / (gdouble)NSEC_PER_SEC;
+	clock->last = now;
+
+	g_static_mutex_lock(&clock->mutex);
+	clock->stats.n_ticks++;
+	clock->stats.n_overruns += missed;
+	clock->stats.jitter_last = late;
+	clock->stats.jitter_max = MAX(clock->stats.jitter_max, late);
+	clock->stats.jitter_mean += (late - clock->stats.jitter_mean)
+	                          / clock->stats.n_ticks;
+	g_static_mutex_unlock(&clock->mutex);
+
+	if (stamp) {
+		*stamp = now;
+	}
+	return elapsed;
+}
+
+/**
+ * uber_sample_clock_get_stats:
+ * @clock: An #UberSampleClock.
+ * @stats: A location for the statistics.
+ *
+ * Retrieves a snapshot of the schedule statistics for @clock.  This may be
+ * called from any thread.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_sample_clock_get_stats (UberSampleClock      *clock, /* IN */
+                             UberSampleClockStats *stats) /* OUT */
+{
+	g_return_if_fail(clock != NULL);
+	g_return_if_fail(stats != NULL);
+
+	g_static_mutex_lock(&clock->mutex);
+	memcpy(stats, &clock->stats, sizeof(*stats));
+	g_static_mutex_unlock(&clock->mutex);
+}
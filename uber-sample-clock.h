@@ -0,0 +1,63 @@
+/* uber-sample-clock.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_SAMPLE_CLOCK_H__
+#define __UBER_SAMPLE_CLOCK_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberSampleClock:
+ *
+ * #UberSampleClock paces a sampling loop on absolute monotonic deadlines
+ * so that the time spent sampling does not accumulate as drift.
+ */
+typedef struct _UberSampleClock UberSampleClock;
+
+/**
+ * UberSampleClockStats:
+ * @n_ticks: The number of deadlines that have fired.
+ * @n_overruns: The number of deadlines that were missed entirely.
+ * @jitter_last: How late the most recent wakeup was, in microseconds.
+ * @jitter_mean: The mean wakeup lateness in microseconds.
+ * @jitter_max: The worst wakeup lateness in microseconds.
+ *
+ * Statistics about how well an #UberSampleClock kept its schedule.
+ */
+typedef struct
+{
+	guint64 n_ticks;
+	guint64 n_overruns;
+	gdouble jitter_last;
+	gdouble jitter_mean;
+	gdouble jitter_max;
+} UberSampleClockStats;
+
+UberSampleClock* uber_sample_clock_new       (gulong                period_usec);
+void             uber_sample_clock_free      (UberSampleClock      *clock);
+gdouble          uber_sample_clock_wait      (UberSampleClock      *clock,
+                                              gint64               *stamp);
+void             uber_sample_clock_get_stats (UberSampleClock      *clock,
+                                              UberSampleClockStats *stats);
+gint64           uber_sample_clock_get_time  (void);
+
+G_END_DECLS
+
+#endif /* __UBER_SAMPLE_CLOCK_H__ */
@@ -0,0 +1,495 @@
+/* uber-shm-ring.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "uber-shm-ring.h"
+
+#define MAGIC     (0x55425352) /* "UBSR" */
+#define VERSION   (2)
+#define CACHELINE (64)
+
+/**
+ * SECTION:uber-shm-ring
+ * @title: UberShmRing
+ * @short_description: Shared memory transport for high rate samples.
+ *
+ * The producer creates a named ring with uber_shm_ring_create() and
+ * writes samples into it; the graph opens it by name with
+ * uber_shm_ring_open() and reads new samples once per tick.  The only
+ * shared state besides the samples is a pair of counters.  Like the
+ * sequence of a seqlock, the producer stores how many samples it has
+ * started to write before it overwrites any slot, and publishes how many
+ * it has finished with a release store afterwards, so writing a sample
+ * costs a few stores and never waits for the reader.
+ *
+ * A reader which falls more than a ring behind loses the oldest samples.
+ * After copying samples out, it checks which of them the producer may
+ * have started to overwrite since, so they are discarded rather than
+ * returned torn.  Lost samples are counted as overruns.
+ *
+ * Only syscalls are avoided; samples are still copied out of the mapping
+ * once, since a slot may be overwritten at any time.
+ * uber_shm_ring_read_values() copies the values straight into the array
+ * given to the data function of a scatter or heat map.
+ */
+
+typedef struct
+{
+	guint32 magic;                         /* MAGIC once initialized. */
+	guint32 version;                       /* VERSION. */
+	guint32 capacity;                      /* Number of samples, a power of 2. */
+	guint32 reserved;
+	guint8  padding[CACHELINE - 16];
+	guint64 head;                          /* Number of samples ever written. */
+	guint64 reserve;                       /* Number of samples ever started. */
+	guint8  padding2[CACHELINE - 16];
+} UberShmHeader;
+
+struct _UberShmRing
+{
+	UberShmHeader *header;   /* Start of the mapping. */
+	UberShmSample *samples;  /* Samples following the header. */
+	gsize          size;     /* Size of the mapping. */
+	guint          mask;     /* Capacity less one. */
+	guint64        pos;      /* Samples written, or read by the reader. */
+	guint64        overruns; /* Samples lost by the reader. */
+	gchar         *name;     /* Name to unlink for the producer, or NULL. */
+};
+
+/**
+ * uber_shm_ring_map:
+ * @fd: A shared memory object.
+ * @size: The size of the object.
+ * @writable: Should the mapping be writable.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Maps @fd into a new #UberShmRing.
+ *
+ * Returns: The ring, or %NULL and @error is set.
+ * Side effects: None.
+ */
+static UberShmRing*
+uber_shm_ring_map (gint       fd,       /* IN */
+                   gsize      size,     /* IN */
+                   gboolean   writable, /* IN */
+                   GError   **error)    /* OUT */
+{
+	UberShmRing *ring;
+	gpointer addr;
+
+	addr = mmap(NULL, size, PROT_READ | (writable ? PROT_WRITE : 0),
+	            MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to map shared memory: %s", g_strerror(errno));
+		return NULL;
+	}
+	ring = g_slice_new0(UberShmRing);
+	ring->header = addr;
+	ring->samples = (UberShmSample *)(ring->header + 1);
+	ring->size = size;
+	return ring;
+}
+
+/**
+ * uber_shm_ring_create:
+ * @name: The name of the shared memory object, such as "/myserver".
+ * @capacity: The number of samples, rounded up to a power of two.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Creates a ring for a producer to write samples to, replacing any object
+ * already named @name.  Only one thread should write to the ring.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_shm_ring_free(), or %NULL and @error is set.
+ * Side effects: The shared memory object is created.
+ */
+UberShmRing*
+uber_shm_ring_create (const gchar  *name,     /* IN */
+                      guint         capacity, /* IN */
+                      GError      **error)    /* OUT */
+{
+	UberShmRing *ring;
+	guint32 n = 1;
+	gsize size;
+	gint fd;
+
+	g_return_val_if_fail(name != NULL, NULL);
+	g_return_val_if_fail(capacity > 0 && capacity <= G_MAXINT32, NULL);
+
+	while (n < capacity) {
+		n <<= 1;
+	}
+	size = sizeof(UberShmHeader) + (n * sizeof(UberShmSample));
+	if ((fd = shm_open(name, O_CREAT | O_TRUNC | O_RDWR, 0600)) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to create \"%s\": %s", name, g_strerror(errno));
+		return NULL;
+	}
+	if (ftruncate(fd, size) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to size \"%s\": %s", name, g_strerror(errno));
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+	ring = uber_shm_ring_map(fd, size, TRUE, error);
+	close(fd);
+	if (!ring) {
+		shm_unlink(name);
+		return NULL;
+	}
+	ring->mask = n - 1;
+	ring->name = g_strdup(name);
+	ring->header->version = VERSION;
+	ring->header->capacity = n;
+	/*
+	 * Readers check the magic before anything else.
+	 */
+	__atomic_store_n(&ring->header->magic, MAGIC, __ATOMIC_RELEASE);
+	return ring;
+}
+
+/**
+ * uber_shm_ring_open:
+ * @name: The name of the shared memory object.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Opens the ring created by a producer with uber_shm_ring_create() for
+ * reading.  Only samples written from now on are read.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_shm_ring_free(), or %NULL and @error is set.
+ * Side effects: None.
+ */
+UberShmRing*
+uber_shm_ring_open (const gchar  *name,  /* IN */
+                    GError      **error) /* OUT */
+{
+	UberShmRing *ring;
+	struct stat st;
+	guint32 n;
+	gint fd;
+
+	g_return_val_if_fail(name != NULL, NULL);
+
+	if ((fd = shm_open(name, O_RDONLY, 0)) < 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to open \"%s\": %s", name, g_strerror(errno));
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(UberShmHeader)) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		            "\"%s\" is not a sample ring", name);
+		close(fd);
+		return NULL;
+	}
+	ring = uber_shm_ring_map(fd, st.st_size, FALSE, error);
+	close(fd);
+	if (!ring) {
+		return NULL;
+	}
+	/*
+	 * The rest of the header is only valid once the magic is seen.
+	 */
+	if (__atomic_load_n(&ring->header->magic, __ATOMIC_ACQUIRE) != MAGIC ||
+	    ring->header->version != VERSION ||
+	    (n = ring->header->capacity) == 0 || (n & (n - 1)) != 0 ||
+	    ring->size != sizeof(UberShmHeader) + (n * sizeof(UberShmSample))) {
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+		            "\"%s\" is not a sample ring", name);
+		uber_shm_ring_free(ring);
+		return NULL;
+	}
+	ring->mask = n - 1;
+	ring->pos = __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE);
+	return ring;
+}
+
+/**
+ * uber_shm_ring_free:
+ * @ring: An #UberShmRing.
+ *
+ * Unmaps @ring and frees it.  The producer also removes the name of the
+ * shared memory object, though readers may keep it mapped.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_shm_ring_free (UberShmRing *ring) /* IN */
+{
+	g_return_if_fail(ring != NULL);
+
+	munmap(ring->header, ring->size);
+	if (ring->name) {
+		shm_unlink(ring->name);
+		g_free(ring->name);
+	}
+	g_slice_free(UberShmRing, ring);
+}
+
+/**
+ * uber_shm_ring_write:
+ * @ring: An #UberShmRing created with uber_shm_ring_create().
+ * @timestamp: The time of the sample.
+ * @value: The value of the sample.
+ *
+ * Writes a sample into @ring, overwriting the oldest sample if it is full.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_shm_ring_write (UberShmRing *ring,      /* IN */
+                     gint64       timestamp, /* IN */
+                     gdouble      value)     /* IN */
+{
+	UberShmSample *sample;
+
+	g_return_if_fail(ring != NULL);
+	g_return_if_fail(ring->name != NULL);
+
+	/*
+	 * Claim the slot before overwriting it so readers can tell that the
+	 * sample it held is gone.
+	 */
+	__atomic_store_n(&ring->header->reserve, ring->pos + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	sample = &ring->samples[ring->pos & ring->mask];
+	sample->time = timestamp;
+	sample->value = value;
+	__atomic_store_n(&ring->header->head, ++ring->pos, __ATOMIC_RELEASE);
+}
+
+/**
+ * uber_shm_ring_write_many:
+ * @ring: An #UberShmRing created with uber_shm_ring_create().
+ * @samples: The samples to write.
+ * @n_samples: The number of samples.
+ *
+ * Writes several samples into @ring and publishes them at once, which is
+ * cheaper than uber_shm_ring_write() for producers which batch samples.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_shm_ring_write_many (UberShmRing         *ring,      /* IN */
+                          const UberShmSample *samples,   /* IN */
+                          guint                n_samples) /* IN */
+{
+	guint offset;
+	guint n;
+
+	g_return_if_fail(ring != NULL);
+	g_return_if_fail(ring->name != NULL);
+	g_return_if_fail(samples != NULL || n_samples == 0);
+
+	/*
+	 * Only the last ring of samples survives anyway.
+	 */
+	if (n_samples > ring->mask + 1) {
+		ring->pos += n_samples - (ring->mask + 1);
+		samples += n_samples - (ring->mask + 1);
+		n_samples = ring->mask + 1;
+	}
+	/*
+	 * Claim every slot of the batch before overwriting any of them.
+	 */
+	__atomic_store_n(&ring->header->reserve, ring->pos + n_samples,
+	                 __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	while (n_samples) {
+		offset = ring->pos & ring->mask;
+		n = MIN(n_samples, ring->mask + 1 - offset);
+		memcpy(&ring->samples[offset], samples, n * sizeof(UberShmSample));
+		ring->pos += n;
+		samples += n;
+		n_samples -= n;
+	}
+	__atomic_store_n(&ring->header->head, ring->pos, __ATOMIC_RELEASE);
+}
+
+/**
+ * uber_shm_ring_get_lost:
+ * @ring: An #UberShmRing opened with uber_shm_ring_open().
+ * @limit: The most samples to count.
+ *
+ * Counts the unread samples of @ring, oldest first and at most @limit,
+ * which the producer has started to overwrite.  Samples copied out before
+ * an acquire fence are only valid if they are not counted here.
+ *
+ * Returns: The number of lost samples.
+ * Side effects: None.
+ */
+static inline guint64
+uber_shm_ring_get_lost (UberShmRing *ring,  /* IN */
+                        guint64      limit) /* IN */
+{
+	guint64 capacity;
+	guint64 reserve;
+
+	capacity = ring->mask + 1;
+	reserve = __atomic_load_n(&ring->header->reserve, __ATOMIC_RELAXED);
+	if (reserve - ring->pos > capacity) {
+		return MIN(limit, reserve - ring->pos - capacity);
+	}
+	return 0;
+}
+
+/**
+ * uber_shm_ring_read:
+ * @ring: An #UberShmRing opened with uber_shm_ring_open().
+ * @samples: A location for the samples.
+ * @n_samples: The most samples to read.
+ *
+ * Reads the oldest unread samples of @ring.  Samples overwritten by the
+ * producer before they could be read are skipped and counted as overruns.
+ *
+ * Returns: The number of samples read.
+ * Side effects: None.
+ */
+guint
+uber_shm_ring_read (UberShmRing   *ring,      /* IN */
+                    UberShmSample *samples,   /* OUT */
+                    guint          n_samples) /* IN */
+{
+	guint64 capacity;
+	guint64 head;
+	guint64 lost;
+	guint offset;
+	guint n;
+	guint i;
+
+	g_return_val_if_fail(ring != NULL, 0);
+	g_return_val_if_fail(ring->name == NULL, 0);
+	g_return_val_if_fail(samples != NULL || n_samples == 0, 0);
+
+	/*
+	 * Samples more than a ring behind the samples the producer has started
+	 * to write have already been overwritten.
+	 */
+	capacity = ring->mask + 1;
+	head = __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE);
+	lost = uber_shm_ring_get_lost(ring, head - ring->pos);
+	ring->overruns += lost;
+	ring->pos += lost;
+	n = MIN(n_samples, head - ring->pos);
+	for (i = 0; i < n; i += offset) {
+		offset = (ring->pos + i) & ring->mask;
+		offset = MIN(n - i, capacity - offset);
+		memcpy(&samples[i], &ring->samples[(ring->pos + i) & ring->mask],
+		       offset * sizeof(UberShmSample));
+	}
+	/*
+	 * Discard samples the producer may have overwritten while copying.
+	 */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if ((lost = uber_shm_ring_get_lost(ring, n))) {
+		memmove(samples, &samples[lost], (n - lost) * sizeof(UberShmSample));
+	}
+	ring->overruns += lost;
+	ring->pos += n;
+	return n - lost;
+}
+
+/**
+ * uber_shm_ring_read_values:
+ * @ring: An #UberShmRing opened with uber_shm_ring_open().
+ * @values: A #GArray of gdouble to append to.
+ * @max_values: The most values to append, or 0 for no limit.
+ *
+ * Appends the values of the unread samples of @ring to @values, such as
+ * for the data function of an #UberScatter or #UberHeatMap.  The values
+ * are copied straight from the mapping into @values.  If more than
+ * @max_values samples are unread, only the newest are appended and the
+ * rest are skipped without counting as overruns.
+ *
+ * Returns: The number of values appended.
+ * Side effects: None.
+ */
+guint
+uber_shm_ring_read_values (UberShmRing *ring,       /* IN */
+                           GArray      *values,     /* IN/OUT */
+                           guint        max_values) /* IN */
+{
+	guint64 head;
+	guint64 lost;
+	gdouble *dst;
+	guint len;
+	guint n;
+	guint i;
+
+	g_return_val_if_fail(ring != NULL, 0);
+	g_return_val_if_fail(ring->name == NULL, 0);
+	g_return_val_if_fail(values != NULL, 0);
+
+	head = __atomic_load_n(&ring->header->head, __ATOMIC_ACQUIRE);
+	if (max_values && head - ring->pos > max_values) {
+		ring->pos = head - max_values;
+	}
+	lost = uber_shm_ring_get_lost(ring, head - ring->pos);
+	ring->overruns += lost;
+	ring->pos += lost;
+	n = head - ring->pos;
+	len = values->len;
+	g_array_set_size(values, len + n);
+	dst = &g_array_index(values, gdouble, len);
+	for (i = 0; i < n; i++) {
+		dst[i] = ring->samples[(ring->pos + i) & ring->mask].value;
+	}
+	/*
+	 * Discard values the producer may have overwritten while copying.
+	 */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if ((lost = uber_shm_ring_get_lost(ring, n))) {
+		g_array_remove_range(values, len, lost);
+	}
+	ring->overruns += lost;
+	ring->pos += n;
+	return n - lost;
+}
+
+/**
+ * uber_shm_ring_get_overruns:
+ * @ring: An #UberShmRing opened with uber_shm_ring_open().
+ *
+ * Retrieves the number of samples the producer overwrote before they
+ * were read.
+ *
+ * Returns: The number of lost samples.
+ * Side effects: None.
+ */
+guint64
+uber_shm_ring_get_overruns (UberShmRing *ring) /* IN */
+{
+	g_return_val_if_fail(ring != NULL, 0);
+
+	return ring->overruns;
+}
@@ -0,0 +1,70 @@
+/* uber-shm-ring.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_SHM_RING_H__
+#define __UBER_SHM_RING_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberShmRing:
+ *
+ * #UberShmRing is a ring of timestamped samples in POSIX shared memory,
+ * written by one producer process and read by one graph.  Once mapped,
+ * neither side makes a syscall to pass samples.
+ */
+typedef struct _UberShmRing UberShmRing;
+
+/**
+ * UberShmSample:
+ * @time: The time of the sample, such as from g_get_monotonic_time().
+ * @value: The value of the sample.
+ *
+ * #UberShmSample is a sample as stored in an #UberShmRing.
+ */
+typedef struct
+{
+	gint64  time;
+	gdouble value;
+} UberShmSample;
+
+UberShmRing* uber_shm_ring_create       (const gchar          *name,
+                                         guint                 capacity,
+                                         GError              **error);
+UberShmRing* uber_shm_ring_open         (const gchar          *name,
+                                         GError              **error);
+void         uber_shm_ring_free         (UberShmRing          *ring);
+void         uber_shm_ring_write        (UberShmRing          *ring,
+                                         gint64                timestamp,
+                                         gdouble               value);
+void         uber_shm_ring_write_many   (UberShmRing          *ring,
+                                         const UberShmSample  *samples,
+                                         guint                 n_samples);
+guint        uber_shm_ring_read         (UberShmRing          *ring,
+                                         UberShmSample        *samples,
+                                         guint                 n_samples);
+guint        uber_shm_ring_read_values  (UberShmRing          *ring,
+                                         GArray               *values,
+                                         guint                 max_values);
+guint64      uber_shm_ring_get_overruns (UberShmRing          *ring);
+
+G_END_DECLS
+
+#endif /* __UBER_SHM_RING_H__ */
@@ -0,0 +1,407 @@
+/* uber-text-cache.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include "uber-text-cache.h"
+
+/*
+ * Labels change as graphs autoscale, so the cache is emptied once it grows
+ * beyond this rather than keeping every value ever shown.
+ */
+#define MAX_ENTRIES (256)
+
+/**
+ * SECTION:uber-text-cache
+ * @title: UberTextCache
+ * @short_description: Cache of rendered labels.
+ *
+ * Each string is laid out once and rendered into an alpha-only image
+ * surface.  Showing the string masks the current source of the target
+ * context with that surface, so the color may change between draws
+ * without invalidating the cache.  Strings are always drawn at whole pixel
+ * offsets so the cached copy matches what Pango would have drawn.
+ *
+ * Strings are laid out with the resolution and font options given with
+ * uber_text_cache_set_context(), normally those of the widget, and these
+ * are part of the key of each rendered string.
+ */
+
+struct _UberTextCache
+{
+	PangoFontDescription *font;       /* Font for all strings. */
+	gboolean              markup;     /* Are strings Pango markup. */
+	gdouble               resolution; /* Resolution in dpi, or -1. */
+	cairo_font_options_t *options;    /* Font options to render with. */
+	GHashTable           *entries;    /* Map of UberTextKey to UberTextEntry. */
+};
+
+typedef struct
+{
+	gchar   *text;       /* The string. */
+	gdouble  resolution; /* Resolution it was laid out at. */
+	gulong   options;    /* Hash of the font options it was rendered with. */
+} UberTextKey;
+
+typedef struct
+{
+	cairo_surface_t *mask;   /* Alpha of the ink of the rendered string. */
+	gint             x;      /* Offset of the ink from the layout. */
+	gint             y;      /* Offset of the ink from the layout. */
+	gint             width;  /* Logical width in pixels. */
+	gint             height; /* Logical height in pixels. */
+} UberTextEntry;
+
+/**
+ * uber_text_key_hash:
+ * @data: An #UberTextKey.
+ *
+ * Hashes an #UberTextKey.
+ *
+ * Returns: The hash of @data.
+ * Side effects: None.
+ */
+static guint
+uber_text_key_hash (gconstpointer data) /* IN */
+{
+	const UberTextKey *key = data;
+
+	return g_str_hash(key->text) ^ key->options
+	     ^ g_double_hash(&key->resolution);
+}
+
+/**
+ * uber_text_key_equal:
+ * @a: An #UberTextKey.
+ * @b: An #UberTextKey.
+ *
+ * Compares two #UberTextKey<!-- -->s.
+ *
+ * Returns: %TRUE if @a and @b are equal.
+ * Side effects: None.
+ */
+static gboolean
+uber_text_key_equal (gconstpointer a, /* IN */
+                     gconstpointer b) /* IN */
+{
+	const UberTextKey *key_a = a;
+	const UberTextKey *key_b = b;
+
+	return key_a->resolution == key_b->resolution &&
+	       key_a->options == key_b->options &&
+	       !strcmp(key_a->text, key_b->text);
+}
+
+/**
+ * uber_text_key_free:
+ * @data: An #UberTextKey.
+ *
+ * Frees @data.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_text_key_free (gpointer data) /* IN */
+{
+	UberTextKey *key = data;
+
+	g_free(key->text);
+	g_slice_free(UberTextKey, key);
+}
+
+/**
+ * uber_text_entry_free:
+ * @data: An #UberTextEntry.
+ *
+ * Frees @data and its rendered surface.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_text_entry_free (gpointer data) /* IN */
+{
+	UberTextEntry *entry = data;
+
+	if (entry->mask) {
+		cairo_surface_destroy(entry->mask);
+	}
+	g_slice_free(UberTextEntry, entry);
+}
+
+/**
+ * uber_text_cache_new:
+ * @font: The #PangoFontDescription to render with.
+ * @markup: Are the strings Pango markup rather than plain text.
+ *
+ * Creates a new #UberTextCache.
+ *
+ * Returns: the newly created instance which should be freed with
+ *   uber_text_cache_free().
+ * Side effects: None.
+ */
+UberTextCache*
+uber_text_cache_new (const PangoFontDescription *font,   /* IN */
+                     gboolean                    markup) /* IN */
+{
+	UberTextCache *cache;
+
+	g_return_val_if_fail(font != NULL, NULL);
+
+	cache = g_slice_new0(UberTextCache);
+	cache->font = pango_font_description_copy(font);
+	cache->markup = markup;
+	cache->resolution = -1.;
+	cache->options = cairo_font_options_create();
+	cairo_font_options_set_antialias(cache->options, CAIRO_ANTIALIAS_GRAY);
+	cache->entries = g_hash_table_new_full(uber_text_key_hash,
+	                                       uber_text_key_equal,
+	                                       uber_text_key_free,
+	                                       uber_text_entry_free);
+	return cache;
+}
+
+/**
+ * uber_text_cache_free:
+ * @cache: An #UberTextCache.
+ *
+ * Frees @cache and all rendered strings.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_text_cache_free (UberTextCache *cache) /* IN */
+{
+	g_return_if_fail(cache != NULL);
+
+	g_hash_table_destroy(cache->entries);
+	cairo_font_options_destroy(cache->options);
+	pango_font_description_free(cache->font);
+	g_slice_free(UberTextCache, cache);
+}
+
+/**
+ * uber_text_cache_clear:
+ * @cache: An #UberTextCache.
+ *
+ * Discards all rendered strings.  This should be called when the font
+ * settings of the screen change.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_text_cache_clear (UberTextCache *cache) /* IN */
+{
+	g_return_if_fail(cache != NULL);
+
+	g_hash_table_remove_all(cache->entries);
+}
+
+/**
+ * uber_text_cache_set_context:
+ * @cache: An #UberTextCache.
+ * @context: The #PangoContext of the widget drawing the strings.
+ *
+ * Lays out further strings with the resolution and font options of
+ * @context, so that they match what the widget would draw with Pango.
+ * Alpha-only surfaces cannot hold subpixel antialiasing, so grayscale is
+ * used in its place.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_text_cache_set_context (UberTextCache *cache,   /* IN */
+                             PangoContext  *context) /* IN */
+{
+	const cairo_font_options_t *options;
+
+	g_return_if_fail(cache != NULL);
+	g_return_if_fail(PANGO_IS_CONTEXT(context));
+
+	cache->resolution = pango_cairo_context_get_resolution(context);
+	cairo_font_options_destroy(cache->options);
+	if ((options = pango_cairo_context_get_font_options(context))) {
+		cache->options = cairo_font_options_copy(options);
+	} else {
+		cache->options = cairo_font_options_create();
+	}
+	if (cairo_font_options_get_antialias(cache->options) ==
+	    CAIRO_ANTIALIAS_SUBPIXEL ||
+	    cairo_font_options_get_antialias(cache->options) ==
+	    CAIRO_ANTIALIAS_DEFAULT) {
+		cairo_font_options_set_antialias(cache->options, CAIRO_ANTIALIAS_GRAY);
+	}
+}
+
+/**
+ * uber_text_cache_lookup:
+ * @cache: An #UberTextCache.
+ * @text: The string to retrieve.
+ *
+ * Retrieves the rendered copy of @text, laying it out and rendering it
+ * if it is not yet cached.
+ *
+ * Returns: An #UberTextEntry owned by @cache.
+ * Side effects: None.
+ */
+static UberTextEntry*
+uber_text_cache_lookup (UberTextCache *cache, /* IN */
+                        const gchar   *text)  /* IN */
+{
+	UberTextEntry *entry;
+	UberTextKey lookup;
+	UberTextKey *key;
+	PangoLayout *layout;
+	PangoContext *context;
+	PangoRectangle ink;
+	PangoRectangle logical;
+	cairo_surface_t *surface;
+	cairo_t *cr;
+
+	lookup.text = (gchar *)text;
+	lookup.resolution = cache->resolution;
+	lookup.options = cairo_font_options_hash(cache->options);
+	if ((entry = g_hash_table_lookup(cache->entries, &lookup))) {
+		return entry;
+	}
+	if (g_hash_table_size(cache->entries) >= MAX_ENTRIES) {
+		g_hash_table_remove_all(cache->entries);
+	}
+	entry = g_slice_new0(UberTextEntry);
+	/*
+	 * Lay out the string once to determine its size.
+	 */
+	surface = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+	cr = cairo_create(surface);
+	cairo_set_font_options(cr, cache->options);
+	layout = pango_cairo_create_layout(cr);
+	context = pango_layout_get_context(layout);
+	pango_cairo_context_set_resolution(context, cache->resolution);
+	pango_cairo_context_set_font_options(context, cache->options);
+	pango_layout_context_changed(layout);
+	pango_layout_set_font_description(layout, cache->font);
+	if (cache->markup) {
+		pango_layout_set_markup(layout, text, -1);
+	} else {
+		pango_layout_set_text(layout, text, -1);
+	}
+	pango_layout_get_pixel_extents(layout, &ink, &logical);
+	entry->width = logical.width;
+	entry->height = logical.height;
+	cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+	/*
+	 * Render the ink into a surface of its size, as glyphs may extend
+	 * beyond the logical extents.
+	 */
+	if (ink.width > 0 && ink.height > 0) {
+		entry->x = ink.x;
+		entry->y = ink.y;
+		entry->mask = cairo_image_surface_create(CAIRO_FORMAT_A8,
+		                                         ink.width, ink.height);
+		cr = cairo_create(entry->mask);
+		cairo_set_font_options(cr, cache->options);
+		cairo_translate(cr, -ink.x, -ink.y);
+		pango_cairo_update_layout(cr, layout);
+		pango_cairo_show_layout(cr, layout);
+		cairo_destroy(cr);
+	}
+	g_object_unref(layout);
+	key = g_slice_new(UberTextKey);
+	key->text = g_strdup(text);
+	key->resolution = lookup.resolution;
+	key->options = lookup.options;
+	g_hash_table_insert(cache->entries, key, entry);
+	return entry;
+}
+
+/**
+ * uber_text_cache_get_size:
+ * @cache: An #UberTextCache.
+ * @text: The string to measure.
+ * @width: A location for the width, or %NULL.
+ * @height: A location for the height, or %NULL.
+ *
+ * Retrieves the size of @text in pixels as Pango would lay it out.
+ *
+ * Returns: None.
+ * Side effects: @text is rendered and cached if needed.
+ */
+void
+uber_text_cache_get_size (UberTextCache *cache,  /* IN */
+                          const gchar   *text,   /* IN */
+                          gint          *width,  /* OUT */
+                          gint          *height) /* OUT */
+{
+	UberTextEntry *entry;
+
+	g_return_if_fail(cache != NULL);
+	g_return_if_fail(text != NULL);
+
+	entry = uber_text_cache_lookup(cache, text);
+	if (width) {
+		*width = entry->width;
+	}
+	if (height) {
+		*height = entry->height;
+	}
+}
+
+/**
+ * uber_text_cache_show:
+ * @cache: An #UberTextCache.
+ * @cr: A cairo_t to draw to.
+ * @text: The string to draw.
+ * @x: The left edge of the string.
+ * @y: The top edge of the string.
+ *
+ * Draws @text with the current source of @cr, as pango_cairo_show_layout()
+ * would after a cairo_move_to() to @x and @y rounded to whole pixels.
+ *
+ * Returns: None.
+ * Side effects: @text is rendered and cached if needed.
+ */
+void
+uber_text_cache_show (UberTextCache *cache, /* IN */
+                      cairo_t       *cr,    /* IN */
+                      const gchar   *text,  /* IN */
+                      gdouble        x,     /* IN */
+                      gdouble        y)     /* IN */
+{
+	UberTextEntry *entry;
+
+	g_return_if_fail(cache != NULL);
+	g_return_if_fail(cr != NULL);
+	g_return_if_fail(text != NULL);
+
+	entry = uber_text_cache_lookup(cache, text);
+	if (entry->mask) {
+		cairo_mask_surface(cr, entry->mask,
+		                   floor(x + .5) + entry->x,
+		                   floor(y + .5) + entry->y);
+	}
+}
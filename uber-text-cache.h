@@ -0,0 +1,54 @@
+/* uber-text-cache.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_TEXT_CACHE_H__
+#define __UBER_TEXT_CACHE_H__
+
+#include <pango/pangocairo.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberTextCache:
+ *
+ * #UberTextCache keeps rendered copies of short strings, such as axis
+ * labels, so that they are laid out by Pango only the first time they are
+ * drawn.  Later draws composite the cached copy using the current source
+ * of the cairo context.
+ */
+typedef struct _UberTextCache UberTextCache;
+
+UberTextCache* uber_text_cache_new      (const PangoFontDescription *font,
+                                         gboolean                    markup);
+void           uber_text_cache_free     (UberTextCache              *cache);
+void           uber_text_cache_clear    (UberTextCache              *cache);
+void           uber_text_cache_set_context (UberTextCache           *cache,
+                                         PangoContext               *context);
+void           uber_text_cache_get_size (UberTextCache              *cache,
+                                         const gchar                *text,
+                                         gint                       *width,
+                                         gint                       *height);
+void           uber_text_cache_show     (UberTextCache              *cache,
+                                         cairo_t                    *cr,
+                                         const gchar                *text,
+                                         gdouble                     x,
+                                         gdouble                     y);
+
+G_END_DECLS
+
+#endif /* __UBER_TEXT_CACHE_H__ */
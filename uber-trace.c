@@ -0,0 +1,379 @@
+/* uber-trace.c
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "uber-trace.h"
+
+#define DEFAULT_CAPACITY (1 << 14)
+
+/**
+ * SECTION:uber-trace
+ * @title: UberTrace
+ * @short_description: Low overhead tracing of function calls.
+ *
+ * Each thread records trace events into its own ring of fixed size
+ * events.  Recording an event takes a timestamp and writes one event into
+ * the ring; no locks are taken and nothing is formatted, so tracing can be
+ * left compiled in.  Once a ring is full the oldest events are overwritten.
+ *
+ * The rings can be written as Chrome trace-event JSON with uber_trace_dump(),
+ * which can be loaded in chrome://tracing, either on demand or when a signal
+ * is received (see uber_trace_dump_on_signal()).  A dump taken while other
+ * threads are recording may contain a few torn events at the head of their
+ * rings.
+ */
+
+typedef struct
+{
+	gint64       time;  /* Monotonic time in nanoseconds. */
+	const gchar *func;  /* Static name of the function. */
+	const gchar *label; /* Static label for goto and case, or NULL. */
+	guint32      line;  /* Line of the event. */
+	guint32      type;  /* UberTraceType of the event. */
+} UberTraceEvent;
+
+typedef struct
+{
+	UberTraceEvent *events; /* Ring of events. */
+	guint           mask;   /* Capacity of the ring less one. */
+	guint64         pos;    /* Number of events ever recorded. */
+	guint           tid;    /* Sequential id of the thread. */
+} UberTraceBuffer;
+
+static GStaticPrivate  trace_key      = G_STATIC_PRIVATE_INIT;
+static GStaticMutex    trace_mutex    = G_STATIC_MUTEX_INIT;
+static GSList         *trace_buffers  = NULL;
+static guint           trace_capacity = DEFAULT_CAPACITY;
+static guint           trace_tid      = 0;
+static gint            trace_pipe[2]  = { -1, -1 };
+static gchar          *trace_filename = NULL;
+
+/**
+ * uber_trace_get_time:
+ *
+ * Retrieves the current monotonic time in nanoseconds.
+ *
+ * Returns: The monotonic time.
+ * Side effects: None.
+ */
+static inline gint64
+uber_trace_get_time (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((gint64)ts.tv_sec * G_GINT64_CONSTANT(1000000000)) + ts.tv_nsec;
+}
+
+/**
+ * uber_trace_set_capacity:
+ * @n_events: The number of events kept per thread.
+ *
+ * Sets the number of events kept for each thread, rounded up to a power
+ * of two.  Only rings created after this call are affected, so it should
+ * be called at startup.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_trace_set_capacity (guint n_events) /* IN */
+{
+	g_return_if_fail(n_events > 0);
+
+	g_static_mutex_lock(&trace_mutex);
+	trace_capacity = 1;
+	while (trace_capacity < n_events) {
+		trace_capacity <<= 1;
+	}
+	g_static_mutex_unlock(&trace_mutex);
+}
+
+/**
+ * uber_trace_get_buffer:
+ *
+ * Retrieves the ring of the calling thread, creating it on first use.
+ *
+ * Returns: An #UberTraceBuffer owned by the thread.
+ * Side effects: A new ring is registered for dumping.
+ */
+static UberTraceBuffer*
+uber_trace_get_buffer (void)
+{
+	UberTraceBuffer *buffer;
+
+	buffer = g_static_private_get(&trace_key);
+	if (G_LIKELY(buffer)) {
+		return buffer;
+	}
+	/*
+	 * Rings are kept after their thread exits so that its events can
+	 * still be dumped.
+	 */
+	buffer = g_new0(UberTraceBuffer, 1);
+	g_static_mutex_lock(&trace_mutex);
+	buffer->events = g_new0(UberTraceEvent, trace_capacity);
+	buffer->mask = trace_capacity - 1;
+	buffer->tid = ++trace_tid;
+	trace_buffers = g_slist_append(trace_buffers, buffer);
+	g_static_mutex_unlock(&trace_mutex);
+	g_static_private_set(&trace_key, buffer, NULL);
+	return buffer;
+}
+
+/**
+ * uber_trace_record:
+ * @type: The #UberTraceType of the event.
+ * @func: The name of the function, which must be a static string.
+ * @label: A static string describing the event, or %NULL.
+ * @line: The line of the event.
+ *
+ * Records a trace event for the calling thread.  This is normally called
+ * through the ENTRY, EXIT, RETURN, GOTO and CASE macros.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+void
+uber_trace_record (UberTraceType  type,  /* IN */
+                   const gchar   *func,  /* IN */
+                   const gchar   *label, /* IN */
+                   guint          line)  /* IN */
+{
+	UberTraceBuffer *buffer;
+	UberTraceEvent event;
+
+	buffer = uber_trace_get_buffer();
+	event.time = uber_trace_get_time();
+	event.func = func;
+	event.label = label;
+	event.line = line;
+	event.type = type;
+	buffer->events[buffer->pos & buffer->mask] = event;
+	buffer->pos++;
+}
+
+/**
+ * uber_trace_write_event:
+ * @stream: A FILE to write to.
+ * @event: An #UberTraceEvent.
+ * @pid: The process id.
+ * @tid: The thread id.
+ * @first: Is this the first event written.
+ *
+ * Writes @event as a Chrome trace-event JSON object.  Entry and exit
+ * become duration events; everything else an instant event.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_trace_write_event (FILE                 *stream, /* IN */
+                        const UberTraceEvent *event,  /* IN */
+                        gint                  pid,    /* IN */
+                        guint                 tid,    /* IN */
+                        gboolean              first)  /* IN */
+{
+	const gchar *ph;
+
+	switch ((UberTraceType)event->type) {
+	case UBER_TRACE_ENTRY:
+		ph = "B";
+		break;
+	case UBER_TRACE_EXIT:
+		ph = "E";
+		break;
+	case UBER_TRACE_GOTO:
+	case UBER_TRACE_CASE:
+	case UBER_TRACE_MARK:
+	default:
+		ph = "i";
+		break;
+	}
+	fprintf(stream, "%s\n  { \"name\": \"%s\", \"ph\": \"%s\", "
+	        "\"ts\": %.3f, \"pid\": %d, \"tid\": %u, ",
+	        first ? "" : ",", event->func ? event->func : "?", ph,
+	        event->time / 1000., pid, tid);
+	if (ph[0] == 'i') {
+		fprintf(stream, "\"s\": \"t\", ");
+	}
+	fprintf(stream, "\"args\": { \"line\": %u", event->line);
+	if (event->label) {
+		fprintf(stream, ", \"label\": \"%s\"", event->label);
+	}
+	fprintf(stream, " } }");
+}
+
+/**
+ * uber_trace_dump:
+ * @filename: The file to write to.
+ * @error: A location for a #GError, or %NULL.
+ *
+ * Writes the events of every thread to @filename as Chrome trace-event
+ * JSON, oldest first.  The rings are not cleared.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ * Side effects: None.
+ */
+gboolean
+uber_trace_dump (const gchar  *filename, /* IN */
+                 GError      **error)    /* OUT */
+{
+	UberTraceBuffer *buffer;
+	gboolean first = TRUE;
+	guint64 begin;
+	guint64 end;
+	guint64 i;
+	GSList *iter;
+	FILE *stream;
+	gint pid;
+
+	g_return_val_if_fail(filename != NULL, FALSE);
+
+	if (!(stream = fopen(filename, "w"))) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to open \"%s\": %s", filename, g_strerror(errno));
+		return FALSE;
+	}
+	pid = getpid();
+	fprintf(stream, "{ \"traceEvents\": [");
+	g_static_mutex_lock(&trace_mutex);
+	for (iter = trace_buffers; iter; iter = iter->next) {
+		buffer = iter->data;
+		/*
+		 * Skip the oldest slot of a full ring since it is the next one
+		 * to be overwritten.
+		 */
+		end = buffer->pos;
+		begin = (end > buffer->mask) ? end - buffer->mask : 0;
+		for (i = begin; i < end; i++) {
+			uber_trace_write_event(stream, &buffer->events[i & buffer->mask],
+			                       pid, buffer->tid, first);
+			first = FALSE;
+		}
+	}
+	g_static_mutex_unlock(&trace_mutex);
+	fprintf(stream, "\n] }\n");
+	if (fclose(stream) != 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "Failed to write \"%s\": %s", filename, g_strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * uber_trace_signal_handler:
+ * @signum: The signal received.
+ *
+ * Signal handler which wakes up the main loop to dump the trace.  Only
+ * async-signal-safe work is done here.
+ *
+ * Returns: None.
+ * Side effects: None.
+ */
+static void
+uber_trace_signal_handler (gint signum) /* IN */
+{
+	gint saved = errno;
+
+	if (write(trace_pipe[1], "t", 1) < 0) {
+		/* Nothing can be done about it here. */
+	}
+	errno = saved;
+}
+
+/**
+ * uber_trace_pipe_cb:
+ * @channel: A #GIOChannel.
+ * @condition: The #GIOCondition.
+ * @data: Unused.
+ *
+ * Main loop callback which dumps the trace after a signal.
+ *
+ * Returns: %TRUE always.
+ * Side effects: The trace file is written.
+ */
+static gboolean
+uber_trace_pipe_cb (GIOChannel   *channel,   /* IN */
+                    GIOCondition  condition, /* IN */
+                    gpointer      data)      /* IN */
+{
+	GError *error = NULL;
+	gchar buf[16];
+
+	while (read(trace_pipe[0], buf, sizeof(buf)) > 0) {
+		/* Drain pending wakeups. */
+	}
+	if (!uber_trace_dump(trace_filename, &error)) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return TRUE;
+	}
+	g_printerr("Trace written to %s\n", trace_filename);
+	return TRUE;
+}
+
+/**
+ * uber_trace_dump_on_signal:
+ * @signum: The signal to dump on, such as SIGUSR1.
+ * @filename: The file to write to.
+ *
+ * Dumps the trace to @filename from the default main loop whenever
+ * @signum is received.  Only one signal may be installed.
+ *
+ * Returns: %TRUE if the handler was installed; otherwise %FALSE.
+ * Side effects: The disposition of @signum is replaced.
+ */
+gboolean
+uber_trace_dump_on_signal (gint         signum,   /* IN */
+                           const gchar *filename) /* IN */
+{
+	struct sigaction sa;
+	GIOChannel *channel;
+
+	g_return_val_if_fail(filename != NULL, FALSE);
+	g_return_val_if_fail(trace_pipe[0] < 0, FALSE);
+
+	if (pipe(trace_pipe) < 0) {
+		g_warning("Failed to create trace pipe: %s", g_strerror(errno));
+		return FALSE;
+	}
+	fcntl(trace_pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(trace_pipe[1], F_SETFL, O_NONBLOCK);
+	trace_filename = g_strdup(filename);
+	channel = g_io_channel_unix_new(trace_pipe[0]);
+	g_io_add_watch(channel, G_IO_IN, uber_trace_pipe_cb, NULL);
+	g_io_channel_unref(channel);
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = uber_trace_signal_handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	return sigaction(signum, &sa, NULL) == 0;
+}
@@ -0,0 +1,57 @@
+/* uber-trace.h
+ *
+ * Copyright (C) 2010 Christian Hergert <chris@dronelabs.com>
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __UBER_TRACE_H__
+#define __UBER_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * UberTraceType:
+ * @UBER_TRACE_ENTRY: A function was entered.
+ * @UBER_TRACE_EXIT: A function returned.
+ * @UBER_TRACE_GOTO: A goto label was jumped to.
+ * @UBER_TRACE_CASE: A switch case was taken.
+ * @UBER_TRACE_MARK: An instant event.
+ *
+ * #UberTraceType is the kind of a recorded trace event.
+ */
+typedef enum
+{
+	UBER_TRACE_ENTRY,
+	UBER_TRACE_EXIT,
+	UBER_TRACE_GOTO,
+	UBER_TRACE_CASE,
+	UBER_TRACE_MARK,
+} UberTraceType;
+
+void     uber_trace_set_capacity   (guint          n_events);
+void     uber_trace_record         (UberTraceType  type,
+                                    const gchar   *func,
+                                    const gchar   *label,
+                                    guint          line);
+gboolean uber_trace_dump           (const gchar   *filename,
+                                    GError       **error);
+gboolean uber_trace_dump_on_signal (gint           signum,
+                                    const gchar   *filename);
+
+G_END_DECLS
+
+#endif /* __UBER_TRACE_H__ */